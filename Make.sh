@@ -0,0 +1,24 @@
+#!/bin/sh
+# Generates and builds the headless Linux target.
+# Usage: ./Make.sh [-c] [Debug|RelWithDebInfo|Release]
+
+CLEAN=false
+CONFIG=Release
+for arg in "$@"; do
+    case "$arg" in
+        -c) CLEAN=true ;;
+        *) CONFIG="$arg" ;;
+    esac
+done
+echo
+if [ "$CLEAN" = true ]; then
+    echo "Deleting the old CMake files..."
+    rm -rf ./Cmake/Linux
+else
+    echo "Tip: You can use \"-c\" to forcely clean the old CMake files."
+fi
+echo
+
+# Generate & build.
+cmake -DCMAKE_TOOLCHAIN_FILE=./ToolchainLinux.cmake -DCMAKE_BUILD_TYPE="$CONFIG" -S ./SourceCode -B ./Cmake/Linux || exit 1
+cmake --build ./Cmake/Linux -j"$(nproc)"
@@ -0,0 +1,82 @@
+// Time of CullByFrustum() over items spread in a 1000^3 cube around a camera with a 45 degree, 16:9 frustum, first on one thread,
+// then split by ParallelFor() like the renderer's culling: the calling thread and the workers of a NullRenderer, threads in total.
+// Usage: BenchCulling [--items N] [--threads N] [--frames N]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "Core/Renderers/Renderer.h"
+#include "Core/Renderers/Culling.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   const int32_t Grain = 1024; // Items per ParallelFor range, as the renderer's.
+
+   int32_t itemCount = 100000;
+   int32_t threadCount = 4;
+   int32_t frameCount = 1000;
+}
+
+int main(int argc, char** argv)
+{
+   for (int i = 1; i + 1 < argc; i += 2)
+   {
+      if (std::strcmp(argv[i], "--items") == 0) itemCount = std::max(std::atoi(argv[i + 1]), 1);
+      else if (std::strcmp(argv[i], "--threads") == 0) threadCount = std::clamp(std::atoi(argv[i + 1]), 1, int32_t(Constants::MaxThreadNumRenderer) + 1);
+      else if (std::strcmp(argv[i], "--frames") == 0) frameCount = std::max(std::atoi(argv[i + 1]), 1);
+      else
+      {
+         std::printf("Usage: %s [--items N] [--threads N] [--frames N]\n", argv[0]);
+         return 1;
+      }
+   }
+   BoundsArray bounds;
+   for (int32_t i = 0; i < itemCount; i++)
+   {
+      uint32_t random = uint32_t(i + 1) * 2654435761u;
+      XMFLOAT3 center(float(random % 1000) - 500, float(random / 1000 % 1000) - 500, float(uint32_t(i + 1) * 2246822519u % 1000) - 500);
+      float extent = 0.5f + float(random >> 29);
+      bounds.Push(BoundingBox(center, XMFLOAT3(extent, extent, extent)));
+   }
+   bounds.Pad();
+   BoundingFrustum frustum(XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.f / 9.f, 0.1f, 1000.f));
+   std::vector<uint8_t> visibility(bounds.GetCount());
+   auto start = std::chrono::steady_clock::now();
+   for (int32_t frame = 0; frame < frameCount; frame++) CullByFrustum(bounds, frustum, 0, bounds.GetCount(), visibility.data());
+   double singleTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frameCount;
+   int32_t visibleCount = int32_t(std::count(visibility.begin(), visibility.begin() + itemCount, uint8_t(1)));
+   // The workers wait for frames or jobs, so ParallelFor() gets all of them.
+   double parallelTime = singleTime;
+   if (threadCount > 1)
+   {
+      InitializeRenderer(threadCount - 1, nullptr);
+      Instance->SetWorkerAutotuning(false);
+      Instance->Launch();
+      std::fill(visibility.begin(), visibility.end(), uint8_t(0));
+      start = std::chrono::steady_clock::now();
+      for (int32_t frame = 0; frame < frameCount; frame++)
+      {
+         Instance->ParallelFor(bounds.GetCount(), Grain, [&](int32_t begin, int32_t end)
+            {
+               CullByFrustum(bounds, frustum, begin, end, visibility.data());
+            });
+      }
+      parallelTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frameCount;
+      Instance->Terminate();
+      Instance.reset();
+      if (std::count(visibility.begin(), visibility.begin() + itemCount, uint8_t(1)) != visibleCount)
+      {
+         std::printf("ParallelFor() culled differently from one thread.\n");
+         return 1;
+      }
+   }
+   std::printf("%d items, %d visible, %d threads on %u CPUs, %d frames\n", itemCount, visibleCount, threadCount,
+      std::thread::hardware_concurrency(), frameCount);
+   std::printf("1 thread %.3f ms, %d threads %.3f ms per frame, %.2fx\n", singleTime, threadCount, parallelTime, singleTime / parallelTime);
+   return 0;
+}
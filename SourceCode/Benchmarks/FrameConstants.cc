@@ -0,0 +1,96 @@
+// Time of FrameAllocator's allocations, with transient constants like D3D12's: threads bump-allocate 256-byte blocks from a
+// frame's region of a mapped buffer, and write a matrix into each. The threads live across frames, like the renderer's workers,
+// so thread creation stays out of the times.
+// Usage: BenchFrameConstants [--constants N] [--threads N] [--frames N]
+#include <barrier>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "DirectXMath-apr2025/DirectXMath.h"
+#include "Core/Constants.h"
+#include "Core/Renderers/FrameAllocator.h"
+
+using namespace DirectX;
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   const uint64_t PageSize = 64 << 10;
+   const uint64_t BlockSize = 256;
+
+   int32_t constantCount = 100000; // Per frame, spread over the threads.
+   int32_t threadCount = std::max(int32_t(std::thread::hardware_concurrency()), 1);
+   int32_t frameCount = 1000;
+}
+
+int main(int argc, char** argv)
+{
+   for (int i = 1; i + 1 < argc; i += 2)
+   {
+      if (std::strcmp(argv[i], "--constants") == 0) constantCount = std::max(std::atoi(argv[i + 1]), 1);
+      else if (std::strcmp(argv[i], "--threads") == 0) threadCount = std::max(std::atoi(argv[i + 1]), 1);
+      else if (std::strcmp(argv[i], "--frames") == 0) frameCount = std::max(std::atoi(argv[i + 1]), 1);
+      else
+      {
+         std::printf("Usage: %s [--constants N] [--threads N] [--frames N]\n", argv[0]);
+         return 1;
+      }
+   }
+   // The region fits all blocks and a partly used page per thread.
+   uint64_t regionSize = (uint64_t(constantCount) * BlockSize / PageSize + threadCount + 1) * PageSize;
+   if (regionSize * Constants::SwapChainSize > uint64_t(INT32_MAX))
+   {
+      std::printf("%d constants per frame don't fit in a buffer of 2 GiB.\n", constantCount);
+      return 1;
+   }
+   FrameAllocator allocator(regionSize, Constants::SwapChainSize, threadCount, PageSize, BlockSize);
+   std::unique_ptr<CacheLine[]> memory = CreateAlignedMemory(int32_t(regionSize * Constants::SwapChainSize));
+   // The main thread begins each frame between the two barriers, while no thread allocates.
+   std::barrier frameStart(threadCount + 1), frameEnd(threadCount + 1);
+   std::vector<double> threadTimes(threadCount); // Nanoseconds over all frames.
+   std::vector<std::thread> threads;
+   for (int32_t t = 0; t < threadCount; t++)
+   {
+      threads.emplace_back([&, t]()
+         {
+            uint8_t* base = (uint8_t*)memory.get();
+            for (int32_t frame = 0; frame < frameCount; frame++)
+            {
+               frameStart.arrive_and_wait();
+               auto start = std::chrono::steady_clock::now();
+               XMFLOAT4X4 constants;
+               XMStoreFloat4x4(&constants, XMMatrixTranslation(float(frame), float(t), 0));
+               for (int32_t i = t; i < constantCount; i += threadCount)
+               {
+                  constants._44 = float(i);
+                  memcpy(base + allocator.Allocate(t, sizeof(constants)), &constants, sizeof(constants));
+               }
+               threadTimes[t] += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+               frameEnd.arrive_and_wait();
+            }
+         });
+   }
+   auto start = std::chrono::steady_clock::now();
+   for (int32_t frame = 0; frame < frameCount; frame++)
+   {
+      allocator.BeginFrame(frame % Constants::SwapChainSize);
+      frameStart.arrive_and_wait();
+      frameEnd.arrive_and_wait();
+   }
+   double wallTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+   for (std::thread& thread : threads) thread.join();
+   // Stats cover the last finished frame, so finish the last one.
+   allocator.BeginFrame(frameCount % Constants::SwapChainSize);
+   const FrameAllocatorStats& stats = allocator.GetStats();
+   double threadTime = 0;
+   for (double time : threadTimes) threadTime += time;
+   uint64_t allocations = uint64_t(constantCount) * frameCount;
+   std::printf("%d constants per frame, %d threads, %d frames\n", constantCount, threadCount, frameCount);
+   std::printf("%.1f ns per block on average, %.3f ms per frame\n", threadTime / double(allocations), wallTime / frameCount);
+   std::printf("The last frame used %.1f of %.1f KiB in pages, %.1f KiB allocated\n", stats.UsedBytes / 1024.0, stats.Capacity / 1024.0,
+      stats.AllocatedBytes / 1024.0);
+   return 0;
+}
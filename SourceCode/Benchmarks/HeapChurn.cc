@@ -0,0 +1,70 @@
+// Time of HeapAllocator's allocations and frees under churn, with D3D12's pools: 256-byte buffer ranges, and textures at the
+// 64 KiB placement alignment. Each tick allocates buffers and textures that live for 1 to 60 ticks.
+// Usage: BenchHeapChurn [--allocations N] [--ticks N]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Core/Renderers/HeapAllocator.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   int32_t allocationCount = 100; // Per tick, half of them textures.
+   int32_t tickCount = 1000;
+}
+
+int main(int argc, char** argv)
+{
+   for (int i = 1; i + 1 < argc; i += 2)
+   {
+      if (std::strcmp(argv[i], "--allocations") == 0) allocationCount = std::max(std::atoi(argv[i + 1]), 1);
+      else if (std::strcmp(argv[i], "--ticks") == 0) tickCount = std::max(std::atoi(argv[i + 1]), 1);
+      else
+      {
+         std::printf("Usage: %s [--allocations N] [--ticks N]\n", argv[0]);
+         return 1;
+      }
+   }
+   HeapAllocator bufferHeaps(64 << 20, 256), textureHeaps(64 << 20, 1 << 16);
+   // Allocations are kept in the bucket of the tick they expire at, modulo 64.
+   std::vector<std::pair<bool, HeapAllocation>> items[64];
+   double allocateTime = 0, freeTime = 0;
+   uint64_t allocations = 0, frees = 0;
+   for (int32_t tick = 0; tick < tickCount; tick++)
+   {
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::pair<bool, HeapAllocation>>& expired = items[tick % 64];
+      for (auto& [isTexture, allocation] : expired) (isTexture ? textureHeaps : bufferHeaps).Free(allocation);
+      frees += expired.size();
+      expired.clear();
+      auto middle = std::chrono::steady_clock::now();
+      // Sizes spread over powers of two: buffers from 256 bytes to 1 MiB, textures from 64 KiB to 16 MiB.
+      for (int32_t i = 0; i < allocationCount; i++)
+      {
+         uint32_t random = uint32_t(allocations++ + 1) * 2654435761u;
+         bool isTexture = i % 2;
+         uint64_t size = (isTexture ? uint64_t(1) << (16 + random % 9) : uint64_t(1) << (8 + random % 13)) + (random >> 12) % 4096;
+         items[(tick + 1 + (random >> 24) % 60) % 64].emplace_back(isTexture, (isTexture ? textureHeaps : bufferHeaps).Allocate(size));
+      }
+      auto end = std::chrono::steady_clock::now();
+      freeTime += std::chrono::duration<double, std::nano>(middle - start).count();
+      allocateTime += std::chrono::duration<double, std::nano>(end - middle).count();
+   }
+   // The timed loop skips validation, it walks every range.
+   bufferHeaps.Validate();
+   textureHeaps.Validate();
+   std::printf("%d allocations per tick, %d ticks\n", allocationCount, tickCount);
+   std::printf("%llu allocations at %.1f ns, %llu frees at %.1f ns on average\n", (unsigned long long)allocations, allocateTime / allocations,
+      (unsigned long long)frees, frees > 0 ? freeTime / frees : 0.0);
+   for (HeapAllocator* heaps : { &bufferHeaps, &textureHeaps })
+   {
+      HeapAllocatorStats stats = heaps->GetStats();
+      std::printf("%s heaps: %d live allocations in %.1f of %.1f MiB over %d blocks; %d free ranges, the largest %.1f MiB, %.3f fragmentation\n",
+         heaps == &bufferHeaps ? "Buffer" : "Texture", stats.Allocations, stats.LiveBytes / 1048576.0, stats.ReservedBytes / 1048576.0,
+         stats.Blocks, stats.FreeRanges, stats.LargestFreeRange / 1048576.0, stats.Fragmentation);
+   }
+   return 0;
+}
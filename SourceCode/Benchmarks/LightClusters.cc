@@ -0,0 +1,112 @@
+// Time of light clustering per frame, Begin(), AssignSlices() and Finish(), over the 16 x 9 x 24 froxels of a 45 degree, 16:9
+// view. Lights are scattered through the first 300 units of the view like the headless demo's, a quarter of them spot lights,
+// drifting sideways every frame. Slices are assigned on one thread, then split by ParallelFor() like the renderer's, the calling
+// thread and the workers of a NullRenderer, threads in total. The budget is 1 ms per frame.
+// Usage: BenchLightClusters [--lights N] [--threads N] [--frames N]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "Core/Renderers/Renderer.h"
+#include "Core/Renderers/LightClusters.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   const double BudgetTime = 1;
+   const int32_t SliceGrain = 1; // Slices per ParallelFor range, as the renderer's.
+
+   int32_t lightCount = 1024;
+   int32_t threadCount = 4;
+   int32_t frameCount = 1000;
+
+   void MakeLights(std::vector<Light>& lights, int32_t frame)
+   {
+      float drift = std::sin(float(frame) * 0.05f) * 10;
+      for (int32_t i = 0; i < lightCount; i++)
+      {
+         uint32_t random = uint32_t(i + 1) * 2246822519u;
+         float z = float(random % 300) + 1;
+         Light& light = lights[i];
+         light.Position = XMFLOAT3((float(random / 300 % 1000) / 500 - 1) * z * 0.6f + drift, (float(random / 300000 % 1000) / 500 - 1) * z * 0.4f, z);
+         light.Range = 5 + float(random >> 27);
+         light.Color = XMFLOAT3(1, 1, 1);
+         light.Intensity = 1;
+         if (i % 4 == 0)
+         {
+            light.Direction = XMFLOAT3(0, -1, 0);
+            light.SpotAngle = XM_PI / 8;
+         }
+      }
+   }
+}
+
+int main(int argc, char** argv)
+{
+   for (int i = 1; i + 1 < argc; i += 2)
+   {
+      if (std::strcmp(argv[i], "--lights") == 0) lightCount = std::clamp(std::atoi(argv[i + 1]), 0, int32_t(LightClusters::MaxLights));
+      else if (std::strcmp(argv[i], "--threads") == 0) threadCount = std::clamp(std::atoi(argv[i + 1]), 1, int32_t(Constants::MaxThreadNumRenderer) + 1);
+      else if (std::strcmp(argv[i], "--frames") == 0) frameCount = std::max(std::atoi(argv[i + 1]), 1);
+      else
+      {
+         std::printf("Usage: %s [--lights N] [--threads N] [--frames N]\n", argv[0]);
+         return 1;
+      }
+   }
+   XMMATRIX view = XMMatrixIdentity(), projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.f / 9.f, 0.1f, 1000.f);
+   std::vector<Light> lights(lightCount);
+   LightClusters clusters;
+   // Per frame: the mean, and the worst after the first, which builds the froxels.
+   auto Run = [&](auto assign, double& worstTime)
+      {
+         double totalTime = 0;
+         worstTime = 0;
+         for (int32_t frame = 0; frame < frameCount; frame++)
+         {
+            MakeLights(lights, frame);
+            auto start = std::chrono::steady_clock::now();
+            clusters.Begin(lights, view, projection);
+            assign();
+            clusters.Finish();
+            double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            totalTime += time;
+            if (frame > 0) worstTime = std::max(worstTime, time);
+         }
+         return totalTime / frameCount;
+      };
+   double singleWorst;
+   double singleTime = Run([&]() { clusters.AssignSlices(0, LightClusters::CountZ); }, singleWorst);
+   std::vector<uint32_t> indices = clusters.GetLightIndices();
+   int32_t visibleCount = clusters.GetVisibleLightCount(), maxClusterCount = clusters.GetMaxClusterLightCount();
+   int32_t droppedCount = clusters.GetDroppedLightCount();
+   // The workers wait for frames or jobs, so ParallelFor() gets all of them.
+   double parallelTime = singleTime, parallelWorst = singleWorst;
+   if (threadCount > 1)
+   {
+      InitializeRenderer(threadCount - 1, nullptr);
+      Instance->SetWorkerAutotuning(false);
+      Instance->Launch();
+      parallelTime = Run([&]()
+         {
+            Instance->ParallelFor(LightClusters::CountZ, SliceGrain, [&](int32_t begin, int32_t end) { clusters.AssignSlices(begin, end); });
+         }, parallelWorst);
+      Instance->Terminate();
+      Instance.reset();
+      if (clusters.GetLightIndices() != indices)
+      {
+         std::printf("ParallelFor() assigned differently from one thread.\n");
+         return 1;
+      }
+   }
+   std::printf("%d lights, %d visible, %zu indices, at most %d per cluster, %d dropped; %d threads on %u CPUs, %d frames\n", lightCount,
+      visibleCount, indices.size(), maxClusterCount, droppedCount, threadCount, std::thread::hardware_concurrency(), frameCount);
+   std::printf("1 thread %.3f ms mean, %.3f ms worst; %d threads %.3f ms mean, %.3f ms worst; budget %.1f ms, %s\n", singleTime, singleWorst,
+      threadCount, parallelTime, parallelWorst, BudgetTime, std::min(singleTime, parallelTime) <= BudgetTime ? "within" : "over");
+   return 0;
+}
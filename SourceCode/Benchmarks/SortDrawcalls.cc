@@ -0,0 +1,90 @@
+// Time of SortDrawcalls() and BatchDrawcalls(), which run on the game thread in every Commit().
+// "random" keys have all 64 bits differing, the worst case. "scene" keys come from MakeSortKey() with a few layers, pipeline states,
+// materials and meshes over a spread of depths, like the headless demo.
+// Usage: BenchSortDrawcalls [--drawcalls N] [--runs N]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include "Core/Renderers/Renderer.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   using Clock = std::chrono::steady_clock;
+
+   int32_t drawcallCount = 100000;
+   int32_t runCount = 50;
+
+   double Milliseconds(Clock::time_point from)
+   {
+      return std::chrono::duration<double, std::milli>(Clock::now() - from).count();
+   }
+
+   void Run(const char* name, const std::vector<Drawcall>& drawcalls)
+   {
+      std::vector<uint32_t> order;
+      std::vector<DrawBatch> batches;
+      std::vector<InstanceData> instances;
+      // Warm the buffers up, they are reused across frames.
+      SortDrawcalls(drawcalls, order);
+      for (size_t i = 1; i < order.size(); i++)
+      {
+         uint64_t last = drawcalls[order[i - 1]].SortKey, key = drawcalls[order[i]].SortKey;
+         if (last > key || (last == key && order[i - 1] > order[i]))
+         {
+            std::printf("%s: the order is not sorted or not stable at %zu.\n", name, i);
+            std::exit(1);
+         }
+      }
+      double bestSort = 1e9, totalSort = 0, bestBatch = 1e9, totalBatch = 0;
+      for (int32_t run = 0; run < runCount; run++)
+      {
+         Clock::time_point sortPoint = Clock::now();
+         SortDrawcalls(drawcalls, order);
+         double sortTime = Milliseconds(sortPoint);
+         Clock::time_point batchPoint = Clock::now();
+         BatchDrawcalls(drawcalls, order, batches, instances);
+         double batchTime = Milliseconds(batchPoint);
+         bestSort = std::min(bestSort, sortTime);
+         totalSort += sortTime;
+         bestBatch = std::min(bestBatch, batchTime);
+         totalBatch += batchTime;
+      }
+      std::printf("%-7s sort %.3f ms best, %.3f ms mean; batch %.3f ms best, %.3f ms mean; %zu batches\n",
+         name, bestSort, totalSort / runCount, bestBatch, totalBatch / runCount, batches.size());
+   }
+}
+
+int main(int argc, char** argv)
+{
+   for (int i = 1; i + 1 < argc; i += 2)
+   {
+      if (std::strcmp(argv[i], "--drawcalls") == 0) drawcallCount = std::max(std::atoi(argv[i + 1]), 1);
+      else if (std::strcmp(argv[i], "--runs") == 0) runCount = std::max(std::atoi(argv[i + 1]), 1);
+      else
+      {
+         std::printf("Usage: %s [--drawcalls N] [--runs N]\n", argv[0]);
+         return 1;
+      }
+   }
+   std::printf("%d drawcalls, %d runs\n", drawcallCount, runCount);
+   std::vector<Drawcall> drawcalls(drawcallCount);
+   std::mt19937_64 random(1);
+   for (Drawcall& drawcall : drawcalls) drawcall.SortKey = random();
+   Run("random", drawcalls);
+   for (Drawcall& drawcall : drawcalls)
+   {
+      uint64_t bits = random();
+      uint32_t layer = bits & 3, pipelineState = bits >> 2 & 15, material = bits >> 6 & 255, mesh = bits >> 14 & 255;
+      float depth = float(bits >> 32 & 0xFFFF);
+      drawcall.SortKey = MakeSortKey(layer, pipelineState, material, 0, mesh, depth);
+      drawcall.Mesh = mesh;
+      drawcall.Material = material;
+      drawcall.PipelineState = pipelineState;
+   }
+   Run("scene", drawcalls);
+   return 0;
+}
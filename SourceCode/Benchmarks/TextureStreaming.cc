@@ -0,0 +1,89 @@
+// Time of TextureStreamer::Update() and how well the budget serves a camera flying through a corridor of textured items.
+// Textures of 512 to 4096 texels, BC1 or BC3, are spread over a looping corridor of 2000 units. The camera flies along it
+// 2 units per frame and sees 400 units ahead. Loads take 3 frames, like reading a file and copying it on the copy queue,
+// and dropped mips are reclaimed once the frames in flight are done with them.
+// Usage: BenchTextureStreaming [--textures N] [--budget MIB] [--frames N]
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include "Core/Constants.h"
+#include "Core/Renderers/TextureStreamer.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   const float Corridor = 2000, ViewDistance = 400;
+   const float Focal = 1080 / (2 * std::tan(3.14159265f / 8)); // Of a camera with a vertical field of view of 45 degrees, at 1080p.
+   const uint64_t LoadFrames = 3;
+
+   int32_t textureCount = 2000;
+   int32_t budget = 256; // MiB.
+   int32_t frameCount = 3000;
+}
+
+int main(int argc, char** argv)
+{
+   for (int i = 1; i + 1 < argc; i += 2)
+   {
+      if (std::strcmp(argv[i], "--textures") == 0) textureCount = std::max(std::atoi(argv[i + 1]), 1);
+      else if (std::strcmp(argv[i], "--budget") == 0) budget = std::max(std::atoi(argv[i + 1]), 1);
+      else if (std::strcmp(argv[i], "--frames") == 0) frameCount = std::max(std::atoi(argv[i + 1]), 1);
+      else
+      {
+         std::printf("Usage: %s [--textures N] [--budget MIB] [--frames N]\n", argv[0]);
+         return 1;
+      }
+   }
+   TextureStreamingPolicy policy;
+   policy.Budget = uint64_t(budget) << 20;
+   TextureStreamer streamer(policy);
+   for (int32_t i = 0; i < textureCount; i++)
+   {
+      int32_t width = 512 << (uint32_t(i + 1) * 2654435761u >> 16) % 4;
+      streamer.AddTexture(width, width, int32_t(std::bit_width(uint32_t(width))), i % 2 ? 1.f : 0.5f);
+   }
+   std::queue<std::pair<uint64_t, int32_t>> pendingLoads; // The frame a load completes at, and its texture.
+   double updateTime = 0, worstUpdate = 0;
+   uint64_t missingMips = 0, deferredFrames = 0;
+   for (uint64_t frame = 1; frame <= uint64_t(frameCount); frame++)
+   {
+      while (!pendingLoads.empty() && pendingLoads.front().first <= frame)
+      {
+         streamer.CompleteLoad(pendingLoads.front().second);
+         pendingLoads.pop();
+      }
+      if (frame > uint64_t(Constants::SwapChainSize)) streamer.Reclaim(frame - Constants::SwapChainSize);
+      float cameraZ = std::fmod(float(frame) * 2, Corridor);
+      for (int32_t i = 0; i < textureCount; i++)
+      {
+         uint32_t random = uint32_t(i + 1) * 2246822519u;
+         float distance = std::fmod(float(random % 20000) / 10 - cameraZ + Corridor, Corridor);
+         if (distance > ViewDistance) continue;
+         distance = std::max(distance, 1.f);
+         float size = 1 + float(random >> 29); // Units across the item.
+         streamer.ReportUse(i, size * Focal / distance, distance, frame);
+      }
+      streamer.Update(frame);
+      for (const MipRequest& load : streamer.GetLoads()) pendingLoads.emplace(frame + LoadFrames, load.Texture);
+      const TextureStreamingStats& stats = streamer.GetStats();
+      updateTime += stats.UpdateTime;
+      worstUpdate = std::max(worstUpdate, stats.UpdateTime);
+      missingMips += stats.MissingMips;
+      // Loads waited for dropped mips to be reclaimed.
+      deferredFrames += stats.Loads == 0 && stats.RetiringBytes > 0 && stats.MissingMips > 0;
+   }
+   const TextureStreamingStats& stats = streamer.GetStats();
+   std::printf("%d textures, %d MiB budget, %d frames\n", textureCount, budget, frameCount);
+   std::printf("Update %.3f ms on average, %.3f ms at worst\n", updateTime / frameCount, worstUpdate);
+   std::printf("%llu loads and %llu evictions; %.1f mips missing per frame on average; %llu frames loaded nothing while mips retired\n",
+      (unsigned long long)stats.TotalLoads, (unsigned long long)stats.TotalEvictions, double(missingMips) / frameCount,
+      (unsigned long long)deferredFrames);
+   std::printf("Last frame: %.1f MiB resident, %.1f MiB loading, %.1f MiB retiring, %.1f MiB wanted\n", stats.ResidentBytes / 1048576.0,
+      stats.LoadingBytes / 1048576.0, stats.RetiringBytes / 1048576.0, stats.WantedBytes / 1048576.0);
+   return 0;
+}
@@ -0,0 +1,143 @@
+// Wake latency and CPU time of idle renderer threads, parked the old way (yield loops) and the current way (SpinThenWait()).
+// The main thread plays the game: it ticks for a while, then kicks all waiters and waits until they finish a small job.
+// Before the frames, the main thread sleeps for an idle window while the waiters wait, which is what idle waiting costs alone.
+// Usage: BenchWakeLatency [--frames N] [--waiters N] [--tick-time MS] [--job-time US] [--idle-time MS]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "Core/Auxiliaries.h"
+
+using namespace Pillow;
+
+namespace
+{
+   using Clock = std::chrono::steady_clock;
+
+   enum class WaitMode
+   {
+      Yield, // Before: spin on std::this_thread::yield().
+      Park,  // After: spin briefly, then atomic::wait().
+   };
+
+   struct Result
+   {
+      double MeanWake;  // Microseconds from the kick to a waiter running.
+      double P99Wake;
+      double CpuPerFrame; // Milliseconds of process CPU time.
+      double WallPerFrame; // Milliseconds, longer than the tick and the jobs if waiters take CPU time from them.
+      double IdleCpu; // Milliseconds of process CPU time per second of the idle window.
+   };
+
+   int32_t frameCount = 1000;
+   int32_t waiterCount = std::max(int32_t(std::thread::hardware_concurrency()) - 1, 1);
+   double tickTime = 2;  // Milliseconds.
+   double jobTime = 50;  // Microseconds.
+   double idleTime = 1000; // Milliseconds.
+
+   std::atomic<uint32_t> frameSequence;
+   std::atomic<int32_t> pendingWaiters;
+   std::atomic<Clock::rep> kickTime;
+
+   template<typename T>
+   void WaitWhileEqual(WaitMode mode, std::atomic<T>& signal, T old, int32_t& spinBudget)
+   {
+      if (mode == WaitMode::Park) SpinThenWait(signal, old, spinBudget);
+      else while (signal.load(std::memory_order::acquire) == old) std::this_thread::yield();
+   }
+
+   void BusyFor(double microseconds)
+   {
+      Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::micro>(microseconds));
+      while (Clock::now() < end) CpuRelax();
+   }
+
+   double CpuMilliseconds()
+   {
+      rusage usage{};
+      getrusage(RUSAGE_SELF, &usage);
+      return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-3;
+   }
+
+   Result Run(WaitMode mode)
+   {
+      frameSequence.store(0);
+      pendingWaiters.store(0);
+      std::vector<double> wakes(size_t(frameCount) * waiterCount);
+      std::vector<std::thread> waiters;
+      for (int32_t w = 0; w < waiterCount; w++)
+      {
+         waiters.emplace_back([mode, w, &wakes]()
+            {
+               int32_t spinBudget = MinSpinCount;
+               for (uint32_t sequence = 0; sequence < uint32_t(frameCount); sequence++)
+               {
+                  WaitWhileEqual(mode, frameSequence, sequence, spinBudget);
+                  Clock::time_point woken = Clock::now();
+                  wakes[size_t(sequence) * waiterCount + w] =
+                     std::chrono::duration<double, std::micro>(woken - Clock::time_point(Clock::duration(kickTime.load(std::memory_order::relaxed)))).count();
+                  BusyFor(jobTime);
+                  if (pendingWaiters.fetch_sub(1, std::memory_order::acq_rel) == 1) pendingWaiters.notify_one();
+               }
+            });
+      }
+      // Let the waiters settle into waiting, then sleep.
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      double idleStart = CpuMilliseconds();
+      std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(idleTime));
+      double idleCpu = (CpuMilliseconds() - idleStart) / idleTime * 1000;
+      double cpuStart = CpuMilliseconds();
+      Clock::time_point wallStart = Clock::now();
+      int32_t spinBudget = MinSpinCount;
+      for (int32_t frame = 0; frame < frameCount; frame++)
+      {
+         // The tick keeps the main thread busy, the waiters are idle meanwhile.
+         BusyFor(tickTime * 1000);
+         pendingWaiters.store(waiterCount, std::memory_order::relaxed);
+         kickTime.store(Clock::now().time_since_epoch().count(), std::memory_order::relaxed);
+         frameSequence.fetch_add(1, std::memory_order::release);
+         if (mode == WaitMode::Park) frameSequence.notify_all();
+         for (int32_t pending = pendingWaiters.load(std::memory_order::acquire); pending != 0; pending = pendingWaiters.load(std::memory_order::acquire))
+         {
+            WaitWhileEqual(mode, pendingWaiters, pending, spinBudget);
+         }
+      }
+      double cpuTime = CpuMilliseconds() - cpuStart;
+      double wallTime = std::chrono::duration<double, std::milli>(Clock::now() - wallStart).count();
+      for (std::thread& waiter : waiters) waiter.join();
+      std::sort(wakes.begin(), wakes.end());
+      double sum = 0;
+      for (double wake : wakes) sum += wake;
+      return Result{ sum / wakes.size(), wakes[std::min(wakes.size() - 1, wakes.size() * 99 / 100)], cpuTime / frameCount, wallTime / frameCount, idleCpu };
+   }
+}
+
+int main(int argc, char** argv)
+{
+   for (int i = 1; i + 1 < argc; i += 2)
+   {
+      if (std::strcmp(argv[i], "--frames") == 0) frameCount = std::max(std::atoi(argv[i + 1]), 1);
+      else if (std::strcmp(argv[i], "--waiters") == 0) waiterCount = std::max(std::atoi(argv[i + 1]), 1);
+      else if (std::strcmp(argv[i], "--tick-time") == 0) tickTime = std::strtod(argv[i + 1], nullptr);
+      else if (std::strcmp(argv[i], "--job-time") == 0) jobTime = std::strtod(argv[i + 1], nullptr);
+      else if (std::strcmp(argv[i], "--idle-time") == 0) idleTime = std::max(std::strtod(argv[i + 1], nullptr), 1.0);
+      else
+      {
+         std::printf("Usage: %s [--frames N] [--waiters N] [--tick-time MS] [--job-time US] [--idle-time MS]\n", argv[0]);
+         return 1;
+      }
+   }
+   // Without waiting, a frame costs the tick plus the jobs: tickTime + jobTime * waiterCount on one CPU.
+   std::printf("%d frames, %d waiters on %u CPUs, %.2f ms ticks, %.0f us jobs, %.0f ms idle\n",
+      frameCount, waiterCount, std::thread::hardware_concurrency(), tickTime, jobTime, idleTime);
+   const char* names[] = { "yield", "park" };
+   for (WaitMode mode : { WaitMode::Yield, WaitMode::Park })
+   {
+      Result result = Run(mode);
+      std::printf("%-6s idle %7.1f ms CPU time per second; wake %8.1f us mean, %8.1f us p99; %.3f ms CPU time and %.3f ms wall time per frame\n",
+         names[int32_t(mode)], result.IdleCpu, result.MeanWake, result.P99Wake, result.CpuPerFrame, result.WallPerFrame);
+   }
+   return 0;
+}
@@ -1,5 +1,6 @@
+#include <regex> // Before DirectXMath, whose SAL shim defines "__pre" on non-Windows platforms.
 #include "Auxiliaries.h"
-#include <regex>
+#include <cstdio>
 
 using namespace Pillow;
 using namespace std::chrono;
@@ -97,13 +98,15 @@ string Pillow::GetResourcePath(const string& name)
          }
          currentPath = currentPath.parent_path();
       } while (currentPath != currentPath.root_path());
-      if (resourceRootPath.empty()) throw std::exception("\"Resources\" folder does not exist.");
+      if (resourceRootPath.empty()) throw std::runtime_error("\"Resources\" folder does not exist.");
    }
    string result;
 #if defined(_WIN64)
    std::wstring _result = resourceRootPath / name;
    utf8::utf16to8(_result.begin(), _result.end(), std::back_inserter(result));
 #elif defined(__ANDROID__)
+#elif defined(__linux__)
+   result = (resourceRootPath / name).string();
 #endif
    return result;
 }
@@ -116,6 +119,8 @@ void Pillow::LogSystem(const string& text)
    OutputDebugString(_text.c_str());
    OutputDebugString(L"\n");
 #elif defined(__ANDROID__)
+#elif defined(__linux__)
+   std::fprintf(stderr, "%s\n", text.c_str());
 #endif
 }
 
@@ -3,12 +3,16 @@
 #include <typeinfo>
 #include <type_traits>
 #include <exception>
+#include <stdexcept>
+#include <memory>
 #include <shared_mutex>
 #include <string>
 #include <ranges>
 #include <filesystem>
 #include <locale>
 #include <chrono>
+#include <atomic>
+#include <algorithm>
 #if defined(_WIN64)
 #define NOMINMAX
 #include <Windows.h>
@@ -25,7 +29,7 @@
 #if defined(_MSC_VER)
 #define ForceInline __forceinline
 #elif defined(__GNUC__) | defined(__clang__)
-#define ForceInline __attribute__((always_inline))
+#define ForceInline inline __attribute__((always_inline))
 #endif
 
 // A known issue: VS applies wrong formats for consecutive "PropertyReadonly" macros.
@@ -37,7 +41,7 @@ public: ForceInline type Get##name() const { return f_##name; }
 
 #define SingletonCheck() \
 static decltype(this) instance = nullptr; \
-if(instance) throw std::exception("A singleton class cannot be created twice."); \
+if(instance) throw std::runtime_error("A singleton class cannot be created twice."); \
 instance = this;
 
 #define DeleteDefautedMethods(type) \
@@ -82,6 +86,43 @@ namespace Pillow
       return (size + alignment - 1) & ~(alignment - 1);
    }
 
+   // Tells the core that the caller is in a spin-wait loop, which saves power and frees the sibling hyper-thread.
+   ForceInline void CpuRelax()
+   {
+#if defined(_WIN64)
+      YieldProcessor();
+#elif defined(__x86_64__)
+      __builtin_ia32_pause();
+#elif defined(__aarch64__)
+      __asm__ __volatile__("yield");
+#endif
+   }
+
+   // Idle threads must not burn a whole core, but a parked thread takes a kernel round trip to wake up.
+   // So spin for a short budget first: a hit doubles the budget, a miss halves it.
+   // Frames arriving back-to-back are caught by the spin, while idle frames quickly fall back to parking.
+   const int32_t MinSpinCount = 16;
+   const int32_t MaxSpinCount = 4096;
+
+   // Block until the signal differs from "old". Parks on atomic::wait (futex / WaitOnAddress) when spinning fails.
+   // spinBudget: Owned by the waiting thread, start it at MinSpinCount.
+   template<typename T>
+   void SpinThenWait(std::atomic<T>& signal, T old, int32_t& spinBudget)
+   {
+      for (int32_t i = 0; i < spinBudget; i++)
+      {
+         if (signal.load(std::memory_order::acquire) != old)
+         {
+            spinBudget = std::min(spinBudget * 2, MaxSpinCount);
+            return;
+         }
+         CpuRelax();
+      }
+      spinBudget = std::max(spinBudget / 2, MinSpinCount);
+      // atomic::wait() may return spuriously, recheck the value.
+      while (signal.load(std::memory_order::acquire) == old) signal.wait(old, std::memory_order::acquire);
+   }
+
    class KeyValuePair
    {
    public:
@@ -1,15 +1,19 @@
 #include "Constants.h"
+#include <algorithm>
 
 using namespace Pillow;
 
 int32_t Pillow::Constants::ThreadNumRenderer{};
+int32_t Pillow::Constants::ThreadNumRendererActive{};
 int32_t Pillow::Constants::ThreadNumPhysics{};
 int32_t Pillow::Constants::ThreadNumTick{};
 
-void Constants::SetThreadNumbers()
+void Constants::SetThreadNumbers(int32_t cpuCount)
 {
    if (ThreadNumRenderer != 0) throw std::runtime_error("Thread numbers have already been set.");
-   int32_t threadNum = std::thread::hardware_concurrency();
-   ThreadNumRenderer = std::clamp(threadNum / 4, 1, MaxThreadNumRenderer);
+   int32_t threadNum = std::max(cpuCount, 1);
+   // Workers for every hardware thread but the game thread's. Parked ones cost nothing but their stacks.
+   ThreadNumRenderer = std::clamp(threadNum - 1, 1, MaxThreadNumRenderer);
+   ThreadNumRendererActive = std::clamp(threadNum / 4, 1, ThreadNumRenderer);
    ThreadNumTick = ThreadNumPhysics = std::clamp(threadNum / 4, 1, MaxThreadNumOther);
 }
\ No newline at end of file
@@ -24,9 +24,22 @@ namespace Pillow::Constants
 
    const int32_t MaxUIRenderItems = 1 << 8;
 
-   const int32_t MaxThreadNumRenderer = 4, MaxThreadNumOther = 8;
+   const int32_t MaxThreadNumRenderer = 8, MaxThreadNumOther = 8;
 
-   extern int32_t ThreadNumRenderer, ThreadNumPhysics, ThreadNumTick;
+   // Draws (instanced batches of drawcalls) are recorded in chunks, each one into its own command list.
+   // Idle workers steal chunks from busy ones. The prologue and the epilogue chunks are included in MaxRecordChunks.
+   const int32_t MaxRecordChunks = 32, MinDrawcallsPerChunk = 64;
 
-   void SetThreadNumbers();
+   // Slots of each ResourceTable, allocated up front so lookups never reallocate.
+   const int32_t MaxResourcesPerType = 1 << 16;
+
+   // Frames kept by the renderer's timeline ring buffer, about 4 seconds at 60 FPS.
+   const int32_t FrameTimelineSize = 256;
+
+   // The renderer creates ThreadNumRenderer workers, and starts with ThreadNumRendererActive of them.
+   // Its autotuner grows or shrinks the active set at runtime, see GenericRenderer::SetWorkerAutotuning().
+   extern int32_t ThreadNumRenderer, ThreadNumRendererActive, ThreadNumPhysics, ThreadNumTick;
+
+   // cpuCount: The CPUs the process may run on, see CpuTopology. It may be fewer than the hardware has.
+   void SetThreadNumbers(int32_t cpuCount);
 }
\ No newline at end of file
@@ -1,5 +1,16 @@
 #include "Mesh.h"
 
+void LodChain::AddLevel(uint32_t mesh, int32_t triangleCount, float geometricError)
+{
+   if (int32_t(Levels.size()) >= MaxLevels) throw std::runtime_error("Too many levels of detail.");
+   if (triangleCount <= 0 || geometricError < 0) throw std::runtime_error("Invalid level of detail.");
+   if (!Levels.empty() && (geometricError < Levels.back().GeometricError || triangleCount > Levels.back().TriangleCount))
+   {
+      throw std::runtime_error("Levels of detail must be added from the finest.");
+   }
+   Levels.push_back(MeshLod{ mesh, triangleCount, geometricError });
+}
+
 std::unique_ptr<StaticMesh> Pillow::Graphics::CreateCube(float xHalf, float yHalf, float zHalf)
 {
    return std::unique_ptr<StaticMesh>();
@@ -45,6 +45,26 @@ namespace Pillow::Graphics
       XMFLOAT4 tangent_boneWeight1;
    };
 
+   // A level of detail, from the finest (0) to the coarsest.
+   struct MeshLod
+   {
+      uint32_t Mesh;         // The ResourceHandle of the level's geometry.
+      int32_t TriangleCount;
+      float GeometricError;  // The world-space deviation from the finest level.
+   };
+
+   // Levels of detail of a mesh, chosen per item by the renderer, see SubmitDrawcall().
+   class LodChain
+   {
+   public:
+      static const int32_t MaxLevels = 8;
+
+      std::vector<MeshLod> Levels;
+
+      // Levels must be added from the finest, with non-decreasing errors and non-increasing triangle counts.
+      void AddLevel(uint32_t mesh, int32_t triangleCount, float geometricError);
+   };
+
    class BasicMesh
    {
 
@@ -52,12 +72,14 @@ namespace Pillow::Graphics
 
    class StaticMesh
    {
-
+   public:
+      LodChain Lods;
    };
 
    class SkeletalMesh
    {
-
+   public:
+      LodChain Lods;
    };
 
    std::unique_ptr<StaticMesh> CreateCube(float xHalf = 0.5f, float yHalf = 0.5f, float zHalf = 0.5f);
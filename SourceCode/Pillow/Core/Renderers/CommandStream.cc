@@ -0,0 +1,173 @@
+#include "Renderer.h"
+#include <unordered_map>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   const char* const CommandNames[] = { "BindPipelineState", "BindMesh", "BindConstantBuffer", "Draw", "Barrier", "Copy", "SetConstants" };
+   static_assert(std::size(CommandNames) == size_t(CommandType::Count));
+
+   ForceInline bool IsHandleOf(uint32_t handle, ResourceType type)
+   {
+      return IsValidHandle(handle) && GetResourceType(handle) == type;
+   }
+
+   // Pipeline states have no memory to transition or copy.
+   ForceInline bool IsMemoryHandle(uint32_t handle)
+   {
+      return IsValidHandle(handle) && GetResourceType(handle) != ResourceType::PiplelineState && GetResourceType(handle) != ResourceType::None;
+   }
+}
+
+void CommandStream::Reset()
+{
+   words.clear();
+   constants.clear();
+   commandCount = 0;
+   hasTransfers = false;
+   boundPipelineState = Unbound;
+   boundMesh = Unbound;
+   for (uint32_t& constantBuffer : boundConstantBuffers) constantBuffer = Unbound;
+}
+
+void CommandStream::BindPipelineState(uint32_t pipelineState)
+{
+   if (pipelineState == boundPipelineState) return;
+   boundPipelineState = pipelineState;
+   Append(CommandType::BindPipelineState, { pipelineState });
+}
+
+void CommandStream::BindMesh(uint32_t mesh)
+{
+   if (mesh == boundMesh) return;
+   boundMesh = mesh;
+   Append(CommandType::BindMesh, { mesh });
+}
+
+void CommandStream::BindConstantBuffer(uint32_t slot, uint32_t constantBuffer)
+{
+   if (slot >= uint32_t(MaxConstantBufferSlots)) throw std::runtime_error("Invalid constant buffer slot.");
+   if (constantBuffer == boundConstantBuffers[slot]) return;
+   boundConstantBuffers[slot] = constantBuffer;
+   Append(CommandType::BindConstantBuffer, { slot, constantBuffer });
+}
+
+void CommandStream::Draw(uint32_t instanceCount, uint32_t firstInstance)
+{
+   Append(CommandType::Draw, { instanceCount, firstInstance });
+}
+
+void CommandStream::Barrier(uint32_t resource, ResourceState before, ResourceState after)
+{
+   hasTransfers = true;
+   Append(CommandType::Barrier, { resource, uint32_t(before), uint32_t(after) });
+}
+
+void CommandStream::Copy(uint32_t destination, uint32_t destinationOffset, uint32_t source, uint32_t sourceOffset, uint32_t size)
+{
+   hasTransfers = true;
+   Append(CommandType::Copy, { destination, destinationOffset, source, sourceOffset, size });
+}
+
+void CommandStream::SetConstants(uint32_t slot, const void* data, uint32_t size)
+{
+   if (slot >= uint32_t(MaxConstantBufferSlots)) throw std::runtime_error("Invalid constant buffer slot.");
+   if (size == 0) throw std::runtime_error("Constants cannot be empty.");
+   // The slot no longer holds a constant buffer, so binding one again isn't skipped.
+   boundConstantBuffers[slot] = Unbound;
+   uint32_t offset = uint32_t(constants.size() * sizeof(uint32_t));
+   constants.resize(constants.size() + (size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+   memcpy((uint8_t*)constants.data() + offset, data, size);
+   Append(CommandType::SetConstants, { slot, offset, size });
+}
+
+void CommandStream::Append(CommandType type, std::initializer_list<uint32_t> arguments)
+{
+   words.push_back(uint32_t(type));
+   words.insert(words.end(), arguments);
+   commandCount++;
+}
+
+bool CommandReader::Next(Command& command)
+{
+   if (position >= words.size()) return false;
+   command.Type = CommandType(words[position++]);
+   int32_t count = CommandArgumentCounts[size_t(command.Type)];
+   for (int32_t i = 0; i < count; i++) command.Arguments[i] = words[position++];
+   return true;
+}
+
+bool Pillow::Graphics::ValidateCommandStream(const CommandStream& stream, string& message)
+{
+   const std::vector<uint32_t>& words = stream.GetWords();
+   bool hasPipelineState = false, hasMesh = false;
+   std::unordered_map<uint32_t, ResourceState> states; // Resources transitioned by the stream.
+   int32_t index = 0;
+   auto Fail = [&message, &index](CommandType type, const char* reason)
+      {
+         message = "Command " + std::to_string(index) + " (" + CommandNames[size_t(type)] + "): " + reason;
+         return false;
+      };
+   for (size_t position = 0; position < words.size(); index++)
+   {
+      if (words[position] >= uint32_t(CommandType::Count))
+      {
+         message = "Command " + std::to_string(index) + ": unknown type " + std::to_string(words[position]) + ".";
+         return false;
+      }
+      CommandType type = CommandType(words[position]);
+      size_t count = size_t(CommandArgumentCounts[size_t(type)]);
+      if (position + 1 + count > words.size()) return Fail(type, "truncated.");
+      const uint32_t* arguments = &words[position + 1];
+      position += 1 + count;
+      switch (type)
+      {
+      case CommandType::BindPipelineState:
+         if (!IsHandleOf(arguments[0], ResourceType::PiplelineState)) return Fail(type, "not a pipeline state handle.");
+         hasPipelineState = true;
+         break;
+      case CommandType::BindMesh:
+         if (!IsHandleOf(arguments[0], ResourceType::Mesh)) return Fail(type, "not a mesh handle.");
+         hasMesh = true;
+         break;
+      case CommandType::BindConstantBuffer:
+         if (!IsHandleOf(arguments[1], ResourceType::ConstantBuffer)) return Fail(type, "not a constant buffer handle.");
+         break;
+      case CommandType::Draw:
+         if (!hasPipelineState || !hasMesh) return Fail(type, "no pipeline state or mesh is bound.");
+         if (arguments[0] == 0) return Fail(type, "no instance.");
+         break;
+      case CommandType::Barrier:
+      {
+         if (!IsMemoryHandle(arguments[0])) return Fail(type, "not a memory resource handle.");
+         if (arguments[1] >= uint32_t(ResourceState::Count) || arguments[2] >= uint32_t(ResourceState::Count)) return Fail(type, "invalid state.");
+         if (arguments[1] == arguments[2]) return Fail(type, "the states are the same.");
+         auto state = states.find(arguments[0]);
+         if (state != states.end() && state->second != ResourceState(arguments[1])) return Fail(type, "the state before doesn't match the last transition.");
+         states[arguments[0]] = ResourceState(arguments[2]);
+         break;
+      }
+      case CommandType::Copy:
+      {
+         if (!IsMemoryHandle(arguments[0]) || !IsMemoryHandle(arguments[2])) return Fail(type, "not a memory resource handle.");
+         if (arguments[4] == 0) return Fail(type, "empty copy.");
+         if (arguments[0] == arguments[2]) return Fail(type, "the source and the destination are the same resource.");
+         auto destination = states.find(arguments[0]);
+         auto source = states.find(arguments[2]);
+         if (destination != states.end() && destination->second != ResourceState::CopyDestination) return Fail(type, "the destination isn't in the copy destination state.");
+         if (source != states.end() && source->second != ResourceState::CopySource) return Fail(type, "the source isn't in the copy source state.");
+         break;
+      }
+      case CommandType::SetConstants:
+         if (arguments[2] == 0) return Fail(type, "no data.");
+         if (arguments[1] % sizeof(uint32_t) != 0 || uint64_t(arguments[1]) + arguments[2] > stream.GetConstants().size() * sizeof(uint32_t))
+            return Fail(type, "the data is out of the stream's constants.");
+         break;
+      default:
+         break;
+      }
+   }
+   return true;
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <vector>
+#include "../Auxiliaries.h"
+
+namespace Pillow::Graphics
+{
+   // Platform-neutral resource states, mapped to native ones by backends.
+   enum class ResourceState : uint8_t
+   {
+      Common,
+      VertexAndConstantBuffer,
+      IndexBuffer,
+      RenderTarget,
+      DepthWrite,
+      ShaderResource,
+      CopySource,
+      CopyDestination,
+      Present,
+      UnorderedAccess,
+      Count
+   };
+
+   // Arguments are 32-bit words, handles are ResourceHandles.
+   enum class CommandType : uint8_t
+   {
+      BindPipelineState,  // Handle
+      BindMesh,           // Handle, the vertex and index buffers of the mesh
+      BindConstantBuffer, // Slot, Handle
+      Draw,               // InstanceCount, FirstInstance, over all indices of the bound mesh
+      Barrier,            // Handle, Before, After (ResourceStates)
+      Copy,               // Destination, DestinationOffset, Source, SourceOffset, Size (bytes)
+      SetConstants,       // Slot, Offset, Size (bytes) of the data in the stream's constants
+      Count
+   };
+
+   const int32_t CommandArgumentCounts[size_t(CommandType::Count)] = { 1, 1, 2, 2, 3, 5, 3 };
+
+   struct Command
+   {
+      CommandType Type;
+      uint32_t Arguments[5];
+   };
+
+   // A compact command list, recorded by workers and translated into native commands by backends.
+   // Each command is a header word (its CommandType), followed by its arguments.
+   // Binding what is already bound is skipped, so streams are compact and equal streams mean equal native commands.
+   class CommandStream
+   {
+   public:
+      void Reset();
+      void BindPipelineState(uint32_t pipelineState);
+      void BindMesh(uint32_t mesh);
+      void BindConstantBuffer(uint32_t slot, uint32_t constantBuffer);
+      void Draw(uint32_t instanceCount, uint32_t firstInstance);
+      // Transitions the whole native resource. In D3D12, buffers in default heaps are ranges of one placed buffer per heap, so a
+      // barrier moves every buffer of the heap, and buffers sharing one must be used in the same state.
+      void Barrier(uint32_t resource, ResourceState before, ResourceState after);
+      void Copy(uint32_t destination, uint32_t destinationOffset, uint32_t source, uint32_t sourceOffset, uint32_t size);
+      // Bind transient data to a constant buffer slot, like per-draw constants. The data is copied into the stream, and backends
+      // copy it into memory that lives until the GPU is done with the frame, see FrameAllocator.
+      void SetConstants(uint32_t slot, const void* data, uint32_t size);
+
+      ForceInline int32_t GetCommandCount() const { return commandCount; }
+      ForceInline const std::vector<uint32_t>& GetWords() const { return words; }
+      // The data of SetConstants commands, each one starting at a word.
+      ForceInline const std::vector<uint32_t>& GetConstants() const { return constants; }
+      // Barriers and copies are not allowed in D3D12 bundles, for example.
+      ForceInline bool HasTransfers() const { return hasTransfers; }
+      // Their memory is per frame, so replaying the native commands of an earlier frame would read stale data.
+      ForceInline bool HasConstants() const { return !constants.empty(); }
+      ForceInline bool Equals(const CommandStream& other) const { return words == other.words && constants == other.constants; }
+
+   private:
+      static const uint32_t Unbound = UINT32_MAX;
+      static const int32_t MaxConstantBufferSlots = 4;
+
+      void Append(CommandType type, std::initializer_list<uint32_t> arguments);
+
+      std::vector<uint32_t> words;
+      std::vector<uint32_t> constants;
+      int32_t commandCount = 0;
+      bool hasTransfers = false;
+      uint32_t boundPipelineState = Unbound;
+      uint32_t boundMesh = Unbound;
+      uint32_t boundConstantBuffers[MaxConstantBufferSlots]{ Unbound, Unbound, Unbound, Unbound };
+   };
+
+   // Decodes a stream, which must be valid, see ValidateCommandStream().
+   class CommandReader
+   {
+   public:
+      CommandReader(const CommandStream& stream) : words(stream.GetWords()) {}
+      // Return false at the end of the stream.
+      bool Next(Command& command);
+
+   private:
+      const std::vector<uint32_t>& words;
+      size_t position = 0;
+   };
+
+   // Check the encoding, handle types, binding order and barrier chains of a stream.
+   // Return false with a message on the first error. Resources start in any state, but the stream's own transitions must chain.
+   bool ValidateCommandStream(const CommandStream& stream, string& message);
+}
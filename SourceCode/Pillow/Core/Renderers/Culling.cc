@@ -0,0 +1,94 @@
+#include "Culling.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+void BoundsArray::Clear()
+{
+   CenterX.clear();
+   CenterY.clear();
+   CenterZ.clear();
+   ExtentX.clear();
+   ExtentY.clear();
+   ExtentZ.clear();
+}
+
+void BoundsArray::Push(const BoundingBox& box)
+{
+   CenterX.push_back(box.Center.x);
+   CenterY.push_back(box.Center.y);
+   CenterZ.push_back(box.Center.z);
+   ExtentX.push_back(box.Extents.x);
+   ExtentY.push_back(box.Extents.y);
+   ExtentZ.push_back(box.Extents.z);
+}
+
+void BoundsArray::Append(const BoundsArray& other)
+{
+   CenterX.insert(CenterX.end(), other.CenterX.begin(), other.CenterX.end());
+   CenterY.insert(CenterY.end(), other.CenterY.begin(), other.CenterY.end());
+   CenterZ.insert(CenterZ.end(), other.CenterZ.begin(), other.CenterZ.end());
+   ExtentX.insert(ExtentX.end(), other.ExtentX.begin(), other.ExtentX.end());
+   ExtentY.insert(ExtentY.end(), other.ExtentY.begin(), other.ExtentY.end());
+   ExtentZ.insert(ExtentZ.end(), other.ExtentZ.begin(), other.ExtentZ.end());
+}
+
+void BoundsArray::Pad()
+{
+   while (GetCount() % 4) Push(BoundingBox(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0)));
+}
+
+void BoundsArray::Resize(int32_t count)
+{
+   CenterX.resize(count);
+   CenterY.resize(count);
+   CenterZ.resize(count);
+   ExtentX.resize(count);
+   ExtentY.resize(count);
+   ExtentZ.resize(count);
+}
+
+void Pillow::Graphics::CullByFrustum(const BoundsArray& bounds, const BoundingFrustum& frustum, int32_t begin, int32_t end, uint8_t* visibility)
+{
+   // Frustum planes point outwards, so a box is outside a plane if its center's distance exceeds its projected radius.
+   XMVECTOR planes[6];
+   frustum.GetPlanes(&planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+   XMVECTOR normalX[6], normalY[6], normalZ[6], distance[6];
+   XMVECTOR absX[6], absY[6], absZ[6];
+   for (int32_t i = 0; i < 6; i++)
+   {
+      normalX[i] = XMVectorSplatX(planes[i]);
+      normalY[i] = XMVectorSplatY(planes[i]);
+      normalZ[i] = XMVectorSplatZ(planes[i]);
+      distance[i] = XMVectorSplatW(planes[i]);
+      absX[i] = XMVectorAbs(normalX[i]);
+      absY[i] = XMVectorAbs(normalY[i]);
+      absZ[i] = XMVectorAbs(normalZ[i]);
+   }
+   for (int32_t i = begin; i < end; i += 4)
+   {
+      XMVECTOR centerX = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterX[i]);
+      XMVECTOR centerY = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterY[i]);
+      XMVECTOR centerZ = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterZ[i]);
+      XMVECTOR extentX = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentX[i]);
+      XMVECTOR extentY = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentY[i]);
+      XMVECTOR extentZ = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentZ[i]);
+      XMVECTOR outside = XMVectorFalseInt();
+      for (int32_t p = 0; p < 6; p++)
+      {
+         XMVECTOR d = XMVectorMultiplyAdd(normalX[p], centerX, distance[p]);
+         d = XMVectorMultiplyAdd(normalY[p], centerY, d);
+         d = XMVectorMultiplyAdd(normalZ[p], centerZ, d);
+         XMVECTOR r = XMVectorMultiply(absX[p], extentX);
+         r = XMVectorMultiplyAdd(absY[p], extentY, r);
+         r = XMVectorMultiplyAdd(absZ[p], extentZ, r);
+         outside = XMVectorOrInt(outside, XMVectorGreater(d, r));
+      }
+      uint32_t mask[4];
+      XMStoreInt4(mask, outside);
+      visibility[i] = mask[0] == 0;
+      visibility[i + 1] = mask[1] == 0;
+      visibility[i + 2] = mask[2] == 0;
+      visibility[i + 3] = mask[3] == 0;
+   }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include "../Auxiliaries.h"
+#include "DirectXMath-apr2025/DirectXCollision.h"
+
+using namespace DirectX;
+
+namespace Pillow::Graphics
+{
+   // Axis-aligned bounds of render items as a structure of arrays, so a component of 4 items is a single SIMD load.
+   // Pad() fills the arrays with empty boxes to a multiple of 4, so SIMD loops need no remainder.
+   class BoundsArray
+   {
+   public:
+      std::vector<float> CenterX, CenterY, CenterZ;
+      std::vector<float> ExtentX, ExtentY, ExtentZ;
+
+      ForceInline int32_t GetCount() const { return int32_t(CenterX.size()); }
+      void Clear();
+      void Push(const BoundingBox& box);
+      void Append(const BoundsArray& other);
+      void Pad();
+      // Keep the first "count" items, e.g. after compacting them with Move().
+      void Resize(int32_t count);
+      ForceInline void Move(int32_t from, int32_t to)
+      {
+         CenterX[to] = CenterX[from];
+         CenterY[to] = CenterY[from];
+         CenterZ[to] = CenterZ[from];
+         ExtentX[to] = ExtentX[from];
+         ExtentY[to] = ExtentY[from];
+         ExtentZ[to] = ExtentZ[from];
+      }
+   };
+
+   // Test the items in [begin, end) against the frustum, 4 at a time. Both ends must be multiples of 4.
+   // visibility[i] is 1 if the item may be visible, otherwise 0.
+   void CullByFrustum(const BoundsArray& bounds, const BoundingFrustum& frustum, int32_t begin, int32_t end, uint8_t* visibility);
+}
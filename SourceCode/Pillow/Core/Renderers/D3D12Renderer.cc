@@ -1,15 +1,21 @@
-// TODO: bundle cmd lists
 #if defined(_WIN64)
 #include "Renderer.h"
+#include "ResourceTable.h"
+#include "RenderGraph.h"
+#include "UploadRing.h"
+#include "HeapAllocator.h"
+#include "FrameAllocator.h"
 #include <memory>
 #include <vector>
 #include <comdef.h>
 #include <queue>
+#include <mutex>
 #include <wrl.h> // import Component Object Model Pointer
 #include <d3d12.h>
 #include <dxgi1_6.h>
 #include <d3dcompiler.h>
 #include <fstream>
+#include <algorithm>
 
 using namespace Pillow;
 using Microsoft::WRL::ComPtr;
@@ -42,6 +48,15 @@ typedef ID3D12Resource IResource;                // The original one is fine
 namespace
 {
    const int32_t CBAlignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+   // All uploads to default heaps go through one ring of this size, so a frame may upload at most this much.
+   const uint64_t UploadRingSize = 64 << 20;
+   const uint64_t BufferUploadAlignment = 16;
+   // Default-heap memory is suballocated from blocks of this size. Buffers are aligned for constant buffers,
+   // textures to the placement alignment.
+   const uint64_t HeapBlockSize = 64 << 20;
+   // Transient constants of a frame, see CommandStream::SetConstants(). Workers take pages of the frame's region.
+   const uint64_t FrameConstantsSize = 4 << 20;
+   const uint64_t FrameConstantsPageSize = 64 << 10;
    const int32_t BCBlockLength = 16; // 4 rows, 4 columns
    const int32_t BC1BlockSize = 8; // C0(2B) C1(2B) Indices(16*2bits = 4B)
    const int32_t BC4BlockSize = 8; // C0(1B) C1(1B) Indices(16*3bits = 6B)
@@ -62,6 +77,19 @@ namespace
       DXGI_FORMAT_BC5_UNORM,
       DXGI_FORMAT_BC4_UNORM,
    };
+   const D3D12_RESOURCE_STATES NativeResourceStates[size_t(ResourceState::Count)]
+   {
+      D3D12_RESOURCE_STATE_COMMON,
+      D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER,
+      D3D12_RESOURCE_STATE_INDEX_BUFFER,
+      D3D12_RESOURCE_STATE_RENDER_TARGET,
+      D3D12_RESOURCE_STATE_DEPTH_WRITE,
+      D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+      D3D12_RESOURCE_STATE_COPY_SOURCE,
+      D3D12_RESOURCE_STATE_COPY_DEST,
+      D3D12_RESOURCE_STATE_PRESENT,
+      D3D12_RESOURCE_STATE_UNORDERED_ACCESS
+   };
 #define DEFAULT_LAYOUT \
 0,D3D12_APPEND_ALIGNED_ELEMENT,D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA,0
    const D3D12_INPUT_ELEMENT_DESC _BasicVertex[3]
@@ -106,25 +134,67 @@ D3D12_STATIC_BORDER_COLOR(0), 0, maxLOD, registerNum, 0, D3D12_SHADER_VISIBILITY
    };
 
    class FenceSync;
+   class CopyQueue;
    class DescriptorHeapManager;
    class LateReleaseManager;
    class UnitedBuffer;
+   class ResourceStateTracker;
+   // Default-heap memory, indexed by the allocators' blocks and guarded by the mutex. Textures are placed in texture heaps,
+   // buffers are ranges of one placed buffer spanning each buffer heap. Declared before the tables, so it outlives their buffers.
+   // D3D12 tracks states per resource, so all buffers of a heap share their placed buffer's state: a barrier on one transitions
+   // the others too, and buffers in different states must not share a heap.
+   std::unique_ptr<HeapAllocator> bufferHeapAllocator, textureHeapAllocator;
+   std::vector<ComPtr<ID3D12Heap>> bufferHeaps, textureHeaps;
+   std::vector<ComPtr<IResource>> heapBuffers;
+   std::mutex heapMutex;
    std::unique_ptr<FenceSync> fenceSync;
    std::unique_ptr<DescriptorHeapManager> descriptorMgr;
    std::unique_ptr<LateReleaseManager> lateReleaseMgr;
+   // Uploads to default heaps: the ring's bookkeeping, its persistently mapped upload buffer and the queue copying from it,
+   // guarded by the mutex.
+   std::unique_ptr<UploadRing> uploadRing;
+   std::unique_ptr<UnitedBuffer> uploadBuffer;
+   std::unique_ptr<CopyQueue> copyQueue;
+   std::mutex uploadMutex;
+   std::unique_ptr<ResourceTable<std::unique_ptr<UnitedBuffer>>> meshTable;
+   std::unique_ptr<ResourceTable<std::unique_ptr<UnitedBuffer>>> textureTable;
+   std::unique_ptr<ResourceTable<std::unique_ptr<UnitedBuffer>>> constantBufferTable;
+   std::unique_ptr<ResourceTable<ComPtr<ID3D12PipelineState>>> pipelineStateTable;
    ComPtr<IFactory> factory;
    ComPtr<IDevice> device;
    ComPtr<ID3D12CommandQueue> cmdQueue;
-   std::vector<ComPtr<ICommandList>> cmdLists;
+   std::vector<ComPtr<ICommandList>> cmdLists; // One per record chunk.
    std::vector<ID3D12CommandList*> _cmdLists; // A copy of cmdLists, prepared for ExecuteCommandLists()
-   std::vector<ComPtr<ID3D12CommandAllocator>> cmdAllocators;
+   std::vector<ComPtr<ID3D12CommandAllocator>> cmdAllocators; // One per record chunk per frame.
+   std::vector<ComPtr<ICommandList>> bundles; // Translated command streams, one per record chunk per frame, see Record().
+   std::vector<ComPtr<ID3D12CommandAllocator>> bundleAllocators;
+   std::unique_ptr<ResourceStateTracker[]> stateTrackers; // One per record chunk, used by the worker recording it.
+   // GPU frame timing: a timestamp at the start of the prologue and one at the end of the epilogue, 2 per frame array index.
+   ComPtr<ID3D12QueryHeap> timestampHeap;
+   std::unique_ptr<UnitedBuffer> timestampReadback;
+   std::unique_ptr<CacheLine[]> timestampData;
+   double timestampPeriod; // Milliseconds per tick.
+   bool hasTimestamps[Constants::SwapChainSize] = { false }; // The frame array index's last frame resolved its timestamps.
    ComPtr<ISwapChain> swapChain;
 
    uint16_t tempRTVs[Constants::SwapChainSize] = { 0 }; // Temporary RTVs for swapchain buffers
    ComPtr<IResource> backbuffers[Constants::SwapChainSize]{};
+   std::unique_ptr<UnitedBuffer> instanceBuffers[Constants::SwapChainSize]{}; // Per-instance vertex streams, see Pioneer().
+   // Clustered lighting, structured buffers for the shaders: lights, LightCluster per cluster, and the clusters' light indices.
+   std::unique_ptr<UnitedBuffer> lightBuffers[Constants::SwapChainSize]{};
+   std::unique_ptr<UnitedBuffer> clusterBuffers[Constants::SwapChainSize]{};
+   std::unique_ptr<UnitedBuffer> lightIndexBuffers[Constants::SwapChainSize]{};
+   // A region per frame array index, reset in Pioneer() like the allocators. Persistently mapped, so workers write it directly.
+   std::unique_ptr<FrameAllocator> frameConstants;
+   std::unique_ptr<UnitedBuffer> frameConstantBuffer;
+
+   // The frame's passes, compiled once, see CreateFrameGraph(). The backbuffer resource is the one of the current frame array index.
+   RenderGraph frameGraph;
+   int32_t graphBackbuffer;
+   int32_t clearPass;
+   int32_t scenePass;
 
    HWND hwnd;
-   int32_t threads;
    bool allowTearing;
    XMINT2 backbufferSize;
    int32_t verticalBlanks{ 1 };
@@ -133,7 +203,156 @@ D3D12_STATIC_BORDER_COLOR(0), 0, maxLOD, registerNum, 0, D3D12_SHADER_VISIBILITY
 // Types
 namespace
 {
-   ForceInline void ApplyBarrier(ComPtr<ICommandList>& cmdList, ComPtr<IResource>& resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after);
+   // Tracks the states of resources within a command list per subresource, and batches their barriers.
+   // 1.Transitions to the current state are dropped, and so are read transitions the current read state covers, like
+   // COPY_SOURCE under GENERIC_READ. Upload heaps, which must stay in GENERIC_READ, never get a barrier that way.
+   // 2.A pending transition of the same subresource is merged: A->B then B->C becomes A->C, A->B then B->A disappears.
+   // 3.Pending barriers are issued with one ResourceBarrier() call per Flush(). Flush before recording work that uses them.
+   // 4.Split barriers begin at one flush and end at a later one, the GPU may overlap the transition with the work between.
+   // States across command lists are the callers' business, so a resource starts in the state passed with its first transition.
+   // Buffers in default heaps are tracked as their shared placed buffer, see heapBuffers.
+   class ResourceStateTracker
+   {
+      ReadonlyProperty(int32_t, IssuedBarriers)
+         ReadonlyProperty(int32_t, Flushes)
+
+   public:
+      void Reset()
+      {
+         tracked.clear();
+         pending.clear();
+         splits.clear();
+         f_IssuedBarriers = 0;
+         f_Flushes = 0;
+      }
+
+      // "subresource" may be D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES.
+      void Transition(IResource* resource, uint32_t subresource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)
+      {
+         Change(resource, subresource, before, after, D3D12_RESOURCE_BARRIER_FLAG_NONE);
+      }
+
+      void BeginTransition(IResource* resource, uint32_t subresource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)
+      {
+         Change(resource, subresource, before, after, D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY);
+      }
+
+      // End all split transitions begun so far. They take effect at the next Flush().
+      void EndTransitions()
+      {
+         for (D3D12_RESOURCE_BARRIER barrier : splits)
+         {
+            barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+            pending.push_back(barrier);
+         }
+         splits.clear();
+      }
+
+      void Flush(ComPtr<ICommandList>& cmdList)
+      {
+         if (pending.empty()) return;
+         cmdList->ResourceBarrier(uint32_t(pending.size()), pending.data());
+         f_IssuedBarriers += int32_t(pending.size());
+         f_Flushes++;
+         pending.clear();
+      }
+
+   private:
+      struct Tracked
+      {
+         IResource* Resource;
+         uint32_t SubresourceCount;
+         D3D12_RESOURCE_STATES Whole;                      // Valid if Subresources is empty.
+         std::vector<D3D12_RESOURCE_STATES> Subresources; // Filled only while subresources differ.
+      };
+
+      static bool IsRead(D3D12_RESOURCE_STATES state)
+      {
+         return state != D3D12_RESOURCE_STATE_COMMON && (state & ~D3D12_RESOURCE_STATE_GENERIC_READ) == 0;
+      }
+
+      // True if a resource in "current" may already be used as "requested".
+      static bool Covers(D3D12_RESOURCE_STATES current, D3D12_RESOURCE_STATES requested)
+      {
+         return current == requested || (IsRead(current) && IsRead(requested) && (current & requested) == requested);
+      }
+
+      Tracked& Track(IResource* resource, D3D12_RESOURCE_STATES before)
+      {
+         for (Tracked& entry : tracked)
+         {
+            if (entry.Resource == resource) return entry;
+         }
+         // Planar formats aren't used, so a texture has a subresource per mip per array slice.
+         D3D12_RESOURCE_DESC desc = resource->GetDesc();
+         uint32_t count = desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ? 1 :
+            uint32_t(desc.MipLevels) * (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : desc.DepthOrArraySize);
+         tracked.push_back(Tracked{ resource, count, before, {} });
+         return tracked.back();
+      }
+
+      // Return false if "current" already covers "after".
+      bool Push(IResource* resource, uint32_t subresource, D3D12_RESOURCE_STATES current, D3D12_RESOURCE_STATES after, D3D12_RESOURCE_BARRIER_FLAGS flags)
+      {
+         if (Covers(current, after)) return false;
+         D3D12_RESOURCE_BARRIER barrier
+         {
+            D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+            flags,
+            D3D12_RESOURCE_TRANSITION_BARRIER { resource, subresource, current, after }
+         };
+         if (flags == D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY)
+         {
+            splits.push_back(barrier);
+            pending.push_back(barrier);
+            return true;
+         }
+         for (size_t i = pending.size(); i-- > 0;)
+         {
+            D3D12_RESOURCE_TRANSITION_BARRIER& transition = pending[i].Transition;
+            if (pending[i].Flags != D3D12_RESOURCE_BARRIER_FLAG_NONE || transition.pResource != resource || transition.Subresource != subresource) continue;
+            transition.StateAfter = after;
+            if (transition.StateBefore == transition.StateAfter) pending.erase(pending.begin() + i);
+            return true;
+         }
+         pending.push_back(barrier);
+         return true;
+      }
+
+      void Change(IResource* resource, uint32_t subresource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after, D3D12_RESOURCE_BARRIER_FLAGS flags)
+      {
+         Tracked& entry = Track(resource, before);
+         if (subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+         {
+            if (entry.Subresources.empty())
+            {
+               if (Push(resource, subresource, entry.Whole, after, flags)) entry.Whole = after;
+               return;
+            }
+            // Subresources differ, so each one needs its own transition.
+            for (uint32_t i = 0; i < entry.SubresourceCount; i++) Push(resource, i, entry.Subresources[i], after, flags);
+            entry.Subresources.clear();
+            entry.Whole = after;
+            return;
+         }
+         if (subresource >= entry.SubresourceCount) throw std::runtime_error("Invalid subresource.");
+         if (entry.Subresources.empty())
+         {
+            if (Covers(entry.Whole, after)) return;
+            entry.Subresources.assign(entry.SubresourceCount, entry.Whole);
+         }
+         if (Push(resource, subresource, entry.Subresources[subresource], after, flags)) entry.Subresources[subresource] = after;
+         if (std::all_of(entry.Subresources.begin(), entry.Subresources.end(), [&entry](D3D12_RESOURCE_STATES state) { return state == entry.Subresources[0]; }))
+         {
+            entry.Whole = entry.Subresources[0];
+            entry.Subresources.clear();
+         }
+      }
+
+      std::vector<Tracked> tracked; // A command list touches few resources, so a linear search is fine.
+      std::vector<D3D12_RESOURCE_BARRIER> pending;
+      std::vector<D3D12_RESOURCE_BARRIER> splits; // Begun and not ended yet.
+   };
 
    // Fence synchronization wrapper
    class FenceSync
@@ -156,16 +375,21 @@ namespace
 
       uint64_t GetTargetFence() { return f_FrameIndex + 1; }
       uint64_t GetCompletedFence() { return fence->GetCompletedValue(); }
+      // The fence of the last frame submitted to the queue, which other queues may wait for.
+      uint64_t GetSignaledFence() { return f_FrameIndex; }
+      ID3D12Fence* GetFence() { return fence.Get(); }
       int32_t GetFrameArrayIdx() { return f_FrameIndex % Constants::SwapChainSize; }
 
-      // Get the next frame.
+      // Get the next frame, and let at most "framesInFlight" submitted frames remain on the GPU.
       // ***WARNING***
       // Invoke this AFTER ExecuteCommandList() in one frame.
-      void NextFrame()
+      void NextFrame(int32_t framesInFlight)
       {
          f_FrameIndex++;
          commandQueue->Signal(fence.Get(), f_FrameIndex);
-         uint64_t minFence = (f_FrameIndex < Constants::SwapChainSize) ? 0 : (f_FrameIndex - Constants::SwapChainSize + 1);
+         // Frame resources are indexed by SwapChainSize, which caps the depth.
+         framesInFlight = std::clamp(framesInFlight, 1, Constants::SwapChainSize);
+         uint64_t minFence = (f_FrameIndex < uint64_t(framesInFlight)) ? 0 : (f_FrameIndex - framesInFlight + 1);
          Synchronize(minFence);
       }
 
@@ -195,6 +419,158 @@ namespace
       ComPtr<ID3D12CommandQueue> commandQueue;
    };
 
+   // Uploads run on a copy queue with its own fence timeline, so the copy engine moves them while the graphics queue renders.
+   // 1.Each Submit() is a batch, recorded with the allocator of its slot. A slot is reused once the copy fence passes its last batch.
+   // 2.SyncQueue() makes the graphics queue wait on the GPU for the batches submitted so far, the CPU never blocks for it.
+   // 3.Before a batch runs, the copy queue waits on the GPU for the graphics frames submitted so far. They may still read the
+   // destinations, buffers written again or textures whose memory was reused, so the copies must not overwrite them early.
+   // 4.Batches are timed with copy-queue timestamps where the device supports them, which gives the upload bandwidth.
+   // Default-heap resources rest in COMMON: the copy queue promotes them to COPY_DEST, the graphics queue to the read states,
+   // and both decay back to COMMON when their command lists finish. So no queue needs barriers for uploads.
+   class CopyQueue
+   {
+      ReadonlyProperty(uint64_t, SubmittedFence)
+
+   public:
+      CopyQueue(ComPtr<IDevice>& device)
+      {
+         D3D12_COMMAND_QUEUE_DESC queueDesc{ D3D12_COMMAND_LIST_TYPE_COPY, 0, D3D12_COMMAND_QUEUE_FLAG_NONE, 0 };
+         CheckHResult(device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&queue)));
+         CheckHResult(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)));
+         for (Batch& batch : batches)
+         {
+            CheckHResult(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&batch.Allocator)));
+         }
+         CheckHResult(device->CreateCommandList1(0, D3D12_COMMAND_LIST_TYPE_COPY, D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&cmdList)));
+         D3D12_FEATURE_DATA_D3D12_OPTIONS3 options{};
+         hasTimestamps = SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS3, &options, sizeof(options))) &&
+            options.CopyQueueTimestampQueriesSupported;
+         if (!hasTimestamps) return;
+         D3D12_QUERY_HEAP_DESC queryDesc{ D3D12_QUERY_HEAP_TYPE_COPY_QUEUE_TIMESTAMP, 2 * BatchCount, 0 };
+         CheckHResult(device->CreateQueryHeap(&queryDesc, IID_PPV_ARGS(&timestampHeap)));
+         uint64_t frequency = 0;
+         CheckHResult(queue->GetTimestampFrequency(&frequency));
+         timestampPeriod = 1000.0 / double(frequency);
+         D3D12_HEAP_PROPERTIES heapProperties{ D3D12_HEAP_TYPE_READBACK };
+         D3D12_RESOURCE_DESC desc
+         {
+            D3D12_RESOURCE_DIMENSION_BUFFER, 0, 2 * BatchCount * sizeof(uint64_t), 1, 1, 1, DXGI_FORMAT_UNKNOWN,
+            DXGI_SAMPLE_DESC{1, 0}, D3D12_TEXTURE_LAYOUT_ROW_MAJOR, D3D12_RESOURCE_FLAG_NONE
+         };
+         CheckHResult(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_COPY_DEST,
+            nullptr, IID_PPV_ARGS(&timestampReadback)));
+         CheckHResult(timestampReadback->Map(0, nullptr, (void**)(&timestamps)));
+      }
+
+      // Record a batch of "bytes" with record(cmdList), execute it once "graphicsFence" reaches "graphicsValue", and signal the next
+      // copy fence, which is returned. The caller keeps the sources and destinations alive until that fence completes.
+      template<typename Record>
+      uint64_t Submit(uint64_t bytes, ID3D12Fence* graphicsFence, uint64_t graphicsValue, Record&& record)
+      {
+         uint32_t slot = uint32_t(f_SubmittedFence % BatchCount);
+         Batch& batch = batches[slot];
+         WaitForFence(batch.Fence);
+         Reclaim();
+         CheckHResult(batch.Allocator->Reset());
+         CheckHResult(cmdList->Reset(batch.Allocator.Get(), nullptr));
+         if (hasTimestamps) cmdList->EndQuery(timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * slot);
+         record(cmdList);
+         if (hasTimestamps)
+         {
+            cmdList->EndQuery(timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * slot + 1);
+            cmdList->ResolveQueryData(timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * slot, 2, timestampReadback.Get(),
+               2 * slot * sizeof(uint64_t));
+         }
+         CheckHResult(cmdList->Close());
+         if (graphicsFence->GetCompletedValue() < graphicsValue)
+         {
+            CheckHResult(queue->Wait(graphicsFence, graphicsValue));
+            stats.CopyWaits++;
+         }
+         ID3D12CommandList* lists[] = { cmdList.Get() };
+         queue->ExecuteCommandLists(1, lists);
+         CheckHResult(queue->Signal(fence.Get(), ++f_SubmittedFence));
+         batch.Fence = f_SubmittedFence;
+         batch.Bytes = bytes;
+         stats.Batches++;
+         stats.Bytes += bytes;
+         return f_SubmittedFence;
+      }
+
+      void SyncQueue(ComPtr<ID3D12CommandQueue>& graphicsQueue)
+      {
+         if (f_SubmittedFence == syncedFence) return;
+         CheckHResult(graphicsQueue->Wait(fence.Get(), f_SubmittedFence));
+         syncedFence = f_SubmittedFence;
+         // Seen from the CPU, so a batch finishing right after the check still counts.
+         if (fence->GetCompletedValue() < syncedFence) stats.GraphicsWaits++;
+      }
+
+      // Block until the copy queue arrives at "targetFence", and return the completed fence. The time blocked counts as waiting.
+      uint64_t WaitForFence(uint64_t targetFence)
+      {
+         if (fence->GetCompletedValue() < targetFence)
+         {
+            auto start = std::chrono::steady_clock::now();
+            CheckHResult(fence->SetEventOnCompletion(targetFence, nullptr));
+            stats.WaitTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+         }
+         return fence->GetCompletedValue();
+      }
+
+      // Collect the timestamps of completed batches, and return the completed fence.
+      uint64_t Reclaim()
+      {
+         uint64_t completedFence = fence->GetCompletedValue();
+         for (Batch& batch : batches)
+         {
+            if (batch.Bytes == 0 || batch.Fence > completedFence) continue;
+            if (hasTimestamps)
+            {
+               const uint64_t* ticks = timestamps + 2 * (&batch - batches);
+               if (ticks[1] > ticks[0])
+               {
+                  stats.CopyTime += double(ticks[1] - ticks[0]) * timestampPeriod;
+                  timedBytes += batch.Bytes;
+               }
+            }
+            batch.Bytes = 0;
+         }
+         return completedFence;
+      }
+
+      CopyQueueStats GetStats() const
+      {
+         CopyQueueStats result = stats;
+         result.Bandwidth = result.CopyTime > 0 ? double(timedBytes) / double(1 << 20) / (result.CopyTime / 1000.0) : 0;
+         return result;
+      }
+
+   private:
+      // Enough for the batches of the frames in flight, one per frame.
+      static const int32_t BatchCount = Constants::SwapChainSize + 1;
+
+      struct Batch
+      {
+         ComPtr<ID3D12CommandAllocator> Allocator;
+         uint64_t Fence = 0;
+         uint64_t Bytes = 0; // 0 once its time is collected.
+      };
+
+      ComPtr<ID3D12CommandQueue> queue;
+      ComPtr<ID3D12Fence> fence;
+      ComPtr<ICommandList> cmdList;
+      Batch batches[BatchCount];
+      uint64_t syncedFence = 0; // The last fence the graphics queue was made to wait for.
+      bool hasTimestamps;
+      ComPtr<ID3D12QueryHeap> timestampHeap;
+      ComPtr<IResource> timestampReadback;
+      const uint64_t* timestamps = nullptr; // Persistently mapped, 2 per slot.
+      double timestampPeriod = 0;           // Milliseconds per tick.
+      uint64_t timedBytes = 0;              // Of the batches CopyTime covers.
+      CopyQueueStats stats{};
+   };
+
    class LateReleaseManager
    {
    public:
@@ -440,7 +816,6 @@ namespace
       enum HeapType : uint8_t
       {
          Upload = D3D12_HEAP_TYPE_UPLOAD,
-         TextureUpload = D3D12_HEAP_TYPE_CUSTOM,
          Readback = D3D12_HEAP_TYPE_READBACK,
          Default = D3D12_HEAP_TYPE_DEFAULT
       };
@@ -452,9 +827,6 @@ namespace
          VertexOrIdxBuffer
       };
 
-      // For texture arrays, create only a minimal number of mid buffers for uploading, which saves a lot of memory.
-      static const int32_t MaxMidPoolSize = 4;
-
       const HeapType _HeapType;
       const DataType _DataType;
       const GenericTextureInfo TexInfo;
@@ -462,26 +834,42 @@ namespace
       const int32_t RawElementSize;
       const int32_t AlignedElementSize;
       const int32_t TotalSize;
-      const bool KeepMidPool;
 
-      UnitedBuffer(HeapType heapType, DataType dataType, int32_t _rawElementSize, int32_t count, bool keepMiddlePool = false):
-         UnitedBuffer(heapType, dataType, _rawElementSize, count, keepMiddlePool, GenericTextureInfo{})
+      UnitedBuffer(HeapType heapType, DataType dataType, int32_t _rawElementSize, int32_t count):
+         UnitedBuffer(heapType, dataType, _rawElementSize, count, GenericTextureInfo{})
       {
          bool wrongUseCheck = dataType == Texture;
          if (wrongUseCheck) throw std::runtime_error("Wrong constructor usage.");
       }
 
-      UnitedBuffer(HeapType heapType, DataType dataType, const GenericTextureInfo& texInfo, bool keepMiddlePool = false):
-         UnitedBuffer(heapType, dataType, 0, 0, keepMiddlePool, texInfo)
+      UnitedBuffer(HeapType heapType, DataType dataType, const GenericTextureInfo& texInfo):
+         UnitedBuffer(heapType, dataType, 0, 0, texInfo)
       {
          bool wrongUseCheck = dataType != Texture;
-         wrongUseCheck |= dataType == Texture && (heapType == Upload || heapType == TextureUpload);
+         wrongUseCheck |= dataType == Texture && heapType == Upload;
          if (wrongUseCheck) throw std::runtime_error("Wrong constructor usage.");
       }
 
-      ~UnitedBuffer() = default;
+      // The tables and the late release manager destroy buffers once the GPU is done with them, so their memory is free to reuse.
+      ~UnitedBuffer()
+      {
+         if (placement.Block < 0) return;
+         bool isTexture = _DataType == Texture;
+         heap.Reset(); // A placed resource goes before its heap.
+         std::lock_guard<std::mutex> lock(heapMutex);
+         int32_t released = (isTexture ? textureHeapAllocator : bufferHeapAllocator)->Free(placement);
+         if (released < 0) return;
+         (isTexture ? textureHeaps : bufferHeaps)[released].Reset();
+         if (!isTexture) heapBuffers[released].Reset();
+      }
 
       uint64_t GetGPUAddress(int index = 0) { return pointerGPU + index * RawElementSize; };
+      // Buffers in default heaps share a resource, see heapBuffers. Their barriers transition all of it.
+      ComPtr<IResource>& GetResource() { return heap; }
+      // Where the buffer starts in its resource.
+      uint64_t GetResourceOffset() { return resourceOffset; }
+      // Null for default heaps.
+      uint8_t* GetCPUPointer() { return pointerCPU; }
 
       // The destination data should align with 64 bytes(the cache line size).
       void ReadBack(std::unique_ptr<CacheLine[]>& destination, int32_t destinationSize = 0)
@@ -498,105 +886,91 @@ namespace
          else memcpy(destination.get(), pointerCPU, TotalSize);
       }
 
+      // Constant buffer elements are read from "rawData" at the same index they are written to, as if it held the whole buffer.
+      // Vertex and index elements are read from the start of "rawData".
       void WriteNumericData(const uint8_t* rawData, int indexOffset = 0, int _elementCount = 1)
       {
          if (_DataType == DataType::Texture) throw new std::runtime_error("Cannot use WriteNumericData() with textures.");
          if (indexOffset + _elementCount > ElementCount) throw std::exception("Out of Range");
-         if (_HeapType == HeapType::Default)
+         if (_DataType == DataType::ConstBuffer) rawData += size_t(indexOffset) * RawElementSize;
+         if (_HeapType != HeapType::Default)
          {
-            RegisterGPUCopy();
-            middlePool[0]->WriteNumericData(rawData, indexOffset, _elementCount);
+            CopyElements(pointerCPU + indexOffset * AlignedElementSize, rawData, _elementCount);
             return;
          }
-         // Write to the middle buffer
-         if (_DataType == DataType::VertexOrIdxBuffer)
-         {
-            memcpy(pointerCPU + indexOffset * RawElementSize, rawData, _elementCount * RawElementSize);
-         }
-         else if (_DataType == DataType::ConstBuffer)
-         {
-            int32_t alignedSize = GetAlignedSize(RawElementSize, CBAlignment);
-            for (int32_t i = 0; i < _elementCount; i++)
-            {
-               int32_t destOffset = (indexOffset + i) * alignedSize;
-               int32_t srcOffset = (indexOffset + i) * RawElementSize;
-               memcpy(pointerCPU + destOffset, rawData + srcOffset, RawElementSize);
-            }
-         }
+         // Stage the elements in the upload ring, the copy queue copies them before the next recorded frame.
+         std::lock_guard<std::mutex> lock(uploadMutex);
+         uint64_t size = uint64_t(_elementCount) * AlignedElementSize;
+         PendingCopy copy{ heap.Get(), D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, resourceOffset + uint64_t(indexOffset) * AlignedElementSize, size, {} };
+         copy.Source.Offset = AllocateUpload(size, BufferUploadAlignment);
+         CopyElements(uploadBuffer->GetCPUPointer() + copy.Source.Offset, rawData, _elementCount);
+         PendingCopies.push_back(copy);
       }
 
       // 1.D3D12 texture subresource indexing: SubRes[PlaneIdx][ArrayIdx][MipIdx]
       // Normally, planar formats are not used to store RGBA data.
       // 
       // 2.ABOUT THE FOOTPRINT: In Direct3D 12 terminology, footprint describes the memory layouts of D3D12 resources.
-      // In detail, the size of a texture row should be aligned(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT), which makes memory allocation more sophisticated.
-      // But there are ways to avoid touching the footprints.
-      // For instance, we can use ID3D12Resource::WriteToSubresource to copy unaligned data into a custom upload heap,
-      // then use ID3DCommandList::CopyTextureRegion to copy it into a default buffer while ignoring the footprints.
-      void WriteTexture(const uint8_t* rawTexture, const GenericTextureInfo& texInfo, int32_t arrayIndex = 0)
+      // In detail, the size of a texture row should be aligned(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT), and so should the start of
+      // a subresource(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT). Each mip is staged in the upload ring with its footprint,
+      // row by row, then ID3DCommandList::CopyTextureRegion copies it from the placed footprint into the texture.
+      // Rows of the source are packed, for block-compressed formats a row is a row of blocks.
+      // 3.The source holds the mips from "firstMip" on, "mipCount" of them or down to the last one if it's -1. So streamed mips,
+      // see TextureStreamer, are uploaded as they arrive. Returns the end of the source, where the next array slice may start.
+      const uint8_t* WriteTexture(const uint8_t* rawTexture, const GenericTextureInfo& texInfo, int32_t arrayIndex = 0, int32_t firstMip = 0, int32_t mipCount = -1)
       {
          if (_DataType != DataType::Texture) throw std::runtime_error("Cannot use WriteTexture() with numeric data.");
-         if(middleTargets.size() == MaxMidPoolSize)  throw std::runtime_error("The middle pool is exhausted.");
-         if (_HeapType == HeapType::Default)
-         {
-            RegisterGPUCopy();
-            if (std::find(middleTargets.begin(), middleTargets.end(), arrayIndex) != middleTargets.end())
-               throw std::runtime_error("Write to a same texture twice in one frame.");
-            middlePool[middleTargets.size()]->WriteTexture(rawTexture, texInfo, arrayIndex);
-            middleTargets.push_back(arrayIndex);
-            return;
-         }
-         // Write to the middle buffer
-         for (int32_t mip = 0; mip < texInfo.GetMipCount(); mip++)
+         if (_HeapType != HeapType::Default) throw std::runtime_error("Only textures in default heaps can be written.");
+         int32_t endMip = mipCount < 0 ? texInfo.GetMipCount() : firstMip + mipCount;
+         if (firstMip < 0 || endMip > texInfo.GetMipCount()) throw std::runtime_error("Invalid mip range.");
+         D3D12_RESOURCE_DESC desc = heap->GetDesc();
+         std::lock_guard<std::mutex> lock(uploadMutex);
+         for (int32_t mip = firstMip; mip < endMip; mip++)
          {
-            int32_t width = texInfo.GetWidth() >> mip;
-            int32_t rowPitch = width * texInfo.GetPixelSize();
-            int32_t depthPitch = width * rowPitch;
-            heap->WriteToSubresource(arrayIndex * texInfo.GetMipCount() + mip, nullptr, rawTexture, rowPitch, depthPitch);
-            rawTexture += depthPitch;
+            PendingCopy copy{ heap.Get(), uint32_t(arrayIndex * texInfo.GetMipCount() + mip), 0, 0, {} };
+            uint32_t rowCount;
+            uint64_t rowSize;
+            device->GetCopyableFootprints(&desc, copy.Subresource, 1, 0, &copy.Source, &rowCount, &rowSize, &copy.Size);
+            copy.Source.Offset = AllocateUpload(copy.Size, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+            uint8_t* destination = uploadBuffer->GetCPUPointer() + copy.Source.Offset;
+            for (uint32_t row = 0; row < rowCount; row++)
+            {
+               memcpy(destination + row * copy.Source.Footprint.RowPitch, rawTexture, rowSize);
+               rawTexture += rowSize;
+            }
+            PendingCopies.push_back(copy);
          }
+         return rawTexture;
       }
 
-      static void GPUCopy(ComPtr<ICommandList>& cmdList)
+      // Submit the copies of all uploads staged so far to the copy queue, and tag their ring space with its fence.
+      // Destinations rest in COMMON, and the ring lives in an upload heap, so the copies need no barriers, see CopyQueue.
+      // The copies wait for the frames already submitted, which may read what they overwrite.
+      static void SubmitUploads()
       {
-         if (DirtyPool.empty()) return;
-         while (!DirtyPool.empty())
-         {
-            UnitedBuffer& buffer = *DirtyPool.back();
-            DirtyPool.pop_back();
-            if (buffer.middlePool.size() == 1)
+         std::lock_guard<std::mutex> lock(uploadMutex);
+         if (PendingCopies.empty()) return;
+         uint64_t bytes = 0;
+         for (const PendingCopy& copy : PendingCopies) bytes += copy.Size;
+         IResource* source = uploadBuffer->GetResource().Get();
+         uint64_t fence = copyQueue->Submit(bytes, fenceSync->GetFence(), fenceSync->GetSignaledFence(), [source](ComPtr<ICommandList>& cmdList)
             {
-               ApplyBarrier(cmdList, buffer.middlePool[0]->heap, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_SOURCE);
-               ApplyBarrier(cmdList, buffer.heap, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST);
-               cmdList->CopyResource(buffer.heap.Get(), buffer.middlePool[0]->heap.Get()); // GPU Copy
-               ApplyBarrier(cmdList, buffer.middlePool[0]->heap, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_GENERIC_READ);
-               ApplyBarrier(cmdList, buffer.heap, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
-            }
-            else // Texture array
-            {
-               while (buffer.middleTargets.size())
+               for (const PendingCopy& copy : PendingCopies)
                {
-                  // Preparation
-                  int32_t target = buffer.middleTargets.back();
-                  buffer.middleTargets.pop_back();
-                  int32_t midIdx = buffer.middleTargets.size();
-                  D3D12_TEXTURE_COPY_LOCATION src{ buffer.middlePool[midIdx]->heap.Get(), D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX, 0 };
-                  D3D12_TEXTURE_COPY_LOCATION dst{ buffer.heap.Get(), D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX, 0 };
-                  // GPU copy
-                  ApplyBarrier(cmdList, buffer.middlePool[midIdx]->heap, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_SOURCE);
-                  ApplyBarrier(cmdList, buffer.heap, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST);
-                  for (int mip = 0; mip < buffer.TexInfo.GetMipCount(); mip++)
+                  if (copy.Subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
                   {
-                     src.SubresourceIndex = mip;
-                     dst.SubresourceIndex = target * buffer.TexInfo.GetMipCount() + mip;
-                     cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, NULL);
+                     cmdList->CopyBufferRegion(copy.Destination, copy.DestinationOffset, source, copy.Source.Offset, copy.Size);
+                     continue;
                   }
-                  ApplyBarrier(cmdList, buffer.middlePool[midIdx]->heap, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_GENERIC_READ);
-                  ApplyBarrier(cmdList, buffer.heap, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+                  D3D12_TEXTURE_COPY_LOCATION src{ source, D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT };
+                  src.PlacedFootprint = copy.Source;
+                  D3D12_TEXTURE_COPY_LOCATION dst{ copy.Destination, D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX };
+                  dst.SubresourceIndex = copy.Subresource;
+                  cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
                }
-            }
-
-         }
+            });
+         uploadRing->FinishFrame(fence);
+         PendingCopies.clear();
       }
 
    private:
@@ -606,24 +980,33 @@ namespace
          DXGI_SAMPLE_DESC{1, 0}, D3D12_TEXTURE_LAYOUT_ROW_MAJOR, D3D12_RESOURCE_FLAG_NONE
       };
 
-      inline static std::vector<UnitedBuffer*> DirtyPool{};
-      std::vector<std::unique_ptr<UnitedBuffer>> middlePool;
-      std::vector<int8_t> middleTargets;
+      // An upload staged in the ring, waiting for the next SubmitUploads().
+      struct PendingCopy
+      {
+         IResource* Destination;
+         uint32_t Subresource;       // D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES for buffers.
+         uint64_t DestinationOffset; // Buffers only.
+         uint64_t Size;              // Staged in the ring, row padding of textures included.
+         D3D12_PLACED_SUBRESOURCE_FOOTPRINT Source; // Offset is the one in the ring, the footprint is for textures only.
+      };
+
+      inline static std::vector<PendingCopy> PendingCopies{};
       ComPtr<IResource> heap{};
+      HeapAllocation placement{};  // Default heaps only.
+      uint64_t resourceOffset{};
       uint64_t pointerGPU{};
       uint8_t* pointerCPU{};
 
-      UnitedBuffer(HeapType heapType, DataType dataType, int32_t _rawElementSize, int32_t count, bool keepMiddlePool, const GenericTextureInfo& texInfo) :
+      UnitedBuffer(HeapType heapType, DataType dataType, int32_t _rawElementSize, int32_t count, const GenericTextureInfo& texInfo) :
          _HeapType(heapType),
          _DataType(dataType),
          TexInfo(texInfo),
          ElementCount(count),
          RawElementSize(_rawElementSize),
          AlignedElementSize(GetAlignedSize(_rawElementSize, dataType == ConstBuffer ? CBAlignment : 1)),
-         TotalSize(GetAlignedSize(_rawElementSize, dataType == ConstBuffer ? CBAlignment : 1)* count),
-         KeepMidPool(keepMiddlePool)
+         TotalSize(GetAlignedSize(_rawElementSize, dataType == ConstBuffer ? CBAlignment : 1)* count)
       {
-         bool isUpload = heapType == Upload || heapType == TextureUpload;
+         bool isUpload = heapType == Upload;
          bool isRdBack = heapType == Readback;
          if (isRdBack && dataType == Texture && texInfo.GetMipCount() != 1)
             throw std::runtime_error("Texture readback buffers don't support mipmaps. It's a restriction of the Pillow Basics design.");
@@ -646,25 +1029,48 @@ namespace
             resourceDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
          }
          auto flags = D3D12_HEAP_FLAG_NONE;
-         auto state = heapType == Readback ? D3D12_RESOURCE_STATE_COPY_DEST : D3D12_RESOURCE_STATE_GENERIC_READ;
-         CheckHResult(device->CreateCommittedResource(&heapProperties, flags, &resourceDesc, state, nullptr, IID_PPV_ARGS(&heap)));
+         // Default heaps rest in COMMON, so both the copy queue and the graphics queue can promote them, see CopyQueue.
+         auto state = heapType == Readback ? D3D12_RESOURCE_STATE_COPY_DEST :
+            (heapType == Default ? D3D12_RESOURCE_STATE_COMMON : D3D12_RESOURCE_STATE_GENERIC_READ);
+         if (heapType == Default) PlaceResource(resourceDesc, state);
+         else CheckHResult(device->CreateCommittedResource(&heapProperties, flags, &resourceDesc, state, nullptr, IID_PPV_ARGS(&heap)));
          GetCPUGPUPointers();
-         CreateMiddleBuffers();
       }
 
-      void CreateMiddleBuffers()
+      // Suballocate default-heap memory, and create the heap the first time an allocation lands in it.
+      void PlaceResource(const D3D12_RESOURCE_DESC& resourceDesc, D3D12_RESOURCE_STATES state)
       {
-         if (_HeapType != Default) return;
-         if (!middlePool.empty()) throw std::runtime_error("The middle buffer has been created.");
-         HeapType heapType = _DataType == Texture ? TextureUpload : Upload;
-         int32_t count = _DataType == Texture ? MaxMidPoolSize : 1;
-         middlePool.reserve(count);
-         middleTargets.reserve(count);
-         for (int i = 0; i < count; i++)
+         bool isTexture = _DataType == Texture;
+         uint64_t size = isTexture ? device->GetResourceAllocationInfo(0, 1, &resourceDesc).SizeInBytes : uint64_t(TotalSize);
+         HeapAllocator& allocator = isTexture ? *textureHeapAllocator : *bufferHeapAllocator;
+         std::vector<ComPtr<ID3D12Heap>>& heaps = isTexture ? textureHeaps : bufferHeaps;
+         std::lock_guard<std::mutex> lock(heapMutex);
+         placement = allocator.Allocate(size);
+         int32_t block = placement.Block;
+         if (heaps.size() <= size_t(block)) heaps.resize(block + 1);
+         if (!heaps[block])
+         {
+            D3D12_HEAP_DESC heapDesc
+            {
+               allocator.GetBlockSize(block), D3D12_HEAP_PROPERTIES{ D3D12_HEAP_TYPE_DEFAULT }, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+               isTexture ? D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES : D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS
+            };
+            CheckHResult(device->CreateHeap(&heapDesc, IID_PPV_ARGS(&heaps[block])));
+            if (!isTexture)
+            {
+               if (heapBuffers.size() <= size_t(block)) heapBuffers.resize(block + 1);
+               D3D12_RESOURCE_DESC bufferDesc = DefaultResDesc;
+               bufferDesc.Width = heapDesc.SizeInBytes;
+               CheckHResult(device->CreatePlacedResource(heaps[block].Get(), 0, &bufferDesc, state, nullptr, IID_PPV_ARGS(&heapBuffers[block])));
+            }
+         }
+         if (isTexture)
          {
-            auto ptr = std::unique_ptr<UnitedBuffer>(new UnitedBuffer(heapType, _DataType, ElementCount, RawElementSize, KeepMidPool, TexInfo));
-            middlePool.push_back(std::move(ptr));
+            CheckHResult(device->CreatePlacedResource(heaps[block].Get(), placement.Offset, &resourceDesc, state, nullptr, IID_PPV_ARGS(&heap)));
+            return;
          }
+         heap = heapBuffers[block];
+         resourceOffset = placement.Offset;
       }
 
       void GetCPUGPUPointers()
@@ -677,21 +1083,25 @@ namespace
          }
          if (_DataType != Texture)
          {
-            pointerGPU = heap->GetGPUVirtualAddress();
+            pointerGPU = heap->GetGPUVirtualAddress() + resourceOffset;
          }
       }
 
-      void RegisterGPUCopy()
+      // Elements are tightly packed in "rawData", and AlignedElementSize apart in "destination".
+      void CopyElements(uint8_t* destination, const uint8_t* rawData, int32_t count)
       {
-         if (middlePool.empty()) throw std::runtime_error("The middle buffer of current default buffer died.");
-         DirtyPool.push_back(this);
-         // Release the mid pool.
-         if (KeepMidPool) return;
-         while (middlePool.size())
+         if (AlignedElementSize == RawElementSize)
          {
-            lateReleaseMgr->Enqueue(std::move(middlePool.back()));
-            middlePool.pop_back();
+            memcpy(destination, rawData, size_t(count) * RawElementSize);
+            return;
          }
+         for (int32_t i = 0; i < count; i++) memcpy(destination + i * AlignedElementSize, rawData + i * RawElementSize, RawElementSize);
+      }
+
+      // While the ring is full, wait for the copy queue to finish the oldest batch in it. Invoke it with uploadMutex locked.
+      static uint64_t AllocateUpload(uint64_t size, uint64_t alignment)
+      {
+         return uploadRing->Allocate(size, alignment, [](uint64_t fence) { return copyQueue->WaitForFence(fence); });
       }
    };
 
@@ -1133,15 +1543,70 @@ namespace
       EncodeBC4Alpha(blockGreen, destination + BC4BlockSize);
    }
 
-   ForceInline void ApplyBarrier(ComPtr<ICommandList>& cmdList, ComPtr<IResource>& resource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after)
+   void CreateHeapAllocators()
    {
-      D3D12_RESOURCE_BARRIER barrier
+      bufferHeapAllocator = std::make_unique<HeapAllocator>(HeapBlockSize, CBAlignment);
+      textureHeapAllocator = std::make_unique<HeapAllocator>(HeapBlockSize, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+   }
+
+   void CreateUploadRing()
+   {
+      uploadRing = std::make_unique<UploadRing>(UploadRingSize);
+      copyQueue = std::make_unique<CopyQueue>(device);
+      uploadBuffer = std::make_unique<UnitedBuffer>(UnitedBuffer::Upload, UnitedBuffer::VertexOrIdxBuffer, 1, int32_t(UploadRingSize));
+   }
+
+   void CreateFrameConstants(int32_t threadCount)
+   {
+      frameConstants = std::make_unique<FrameAllocator>(FrameConstantsSize, Constants::SwapChainSize, threadCount, FrameConstantsPageSize, CBAlignment);
+      frameConstantBuffer = std::make_unique<UnitedBuffer>(UnitedBuffer::Upload, UnitedBuffer::VertexOrIdxBuffer, 1,
+         int32_t(FrameConstantsSize * Constants::SwapChainSize));
+   }
+
+   void CreateTimestampQueries()
+   {
+      D3D12_QUERY_HEAP_DESC queryDesc{ D3D12_QUERY_HEAP_TYPE_TIMESTAMP, 2 * Constants::SwapChainSize, 0 };
+      CheckHResult(device->CreateQueryHeap(&queryDesc, IID_PPV_ARGS(&timestampHeap)));
+      uint64_t frequency = 0;
+      CheckHResult(cmdQueue->GetTimestampFrequency(&frequency));
+      timestampPeriod = 1000.0 / double(frequency);
+      timestampReadback = std::make_unique<UnitedBuffer>(UnitedBuffer::Readback, UnitedBuffer::VertexOrIdxBuffer, int32_t(sizeof(uint64_t)),
+         2 * Constants::SwapChainSize);
+   }
+
+   // The backbuffer is presented, so passes drawing it are live. The clear discards it, the scene loads what the clear left.
+   void CreateFrameGraph()
+   {
+      frameGraph.Reset();
+      graphBackbuffer = frameGraph.ImportResource("Backbuffer", ResourceState::Present, ResourceState::Present, true);
+      clearPass = frameGraph.AddPass("Clear");
+      frameGraph.Write(clearPass, graphBackbuffer, ResourceState::RenderTarget, true);
+      scenePass = frameGraph.AddPass("Scene");
+      frameGraph.Write(scenePass, graphBackbuffer, ResourceState::RenderTarget);
+      frameGraph.Compile();
+   }
+
+   // Queued into the tracker, flush it before recording the pass.
+   void ApplyGraphBarriers(ResourceStateTracker& tracker, const std::vector<RenderGraphBarrier>& barriers, int32_t frameIdx)
+   {
+      for (const RenderGraphBarrier& barrier : barriers)
       {
-         D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
-         D3D12_RESOURCE_BARRIER_FLAG_NONE,
-         D3D12_RESOURCE_TRANSITION_BARRIER { resource.Get(), D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, before, after }
-      };
-      cmdList->ResourceBarrier(1, &barrier);
+         // The graph has no transient resources yet, the backbuffer is the only one.
+         if (barrier.Resource != graphBackbuffer) throw std::runtime_error("Unknown render graph resource.");
+         tracker.Transition(backbuffers[frameIdx].Get(), D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, NativeResourceStates[size_t(barrier.Before)],
+            NativeResourceStates[size_t(barrier.After)]);
+      }
+   }
+
+   // The barriers before a pass, none if it was culled.
+   const std::vector<RenderGraphBarrier>& GetPassBarriers(int32_t pass)
+   {
+      static const std::vector<RenderGraphBarrier> none;
+      for (const CompiledPass& compiled : frameGraph.GetCompiledPasses())
+      {
+         if (compiled.Pass == pass) return compiled.Barriers;
+      }
+      return none;
    }
 
    // Return true if the client size doesn't change.
@@ -1196,7 +1661,7 @@ namespace
       DXGI_RGBA color{ 0.f, 0.f, 0.f, 1.f };
       swapChain->SetBackgroundColor(&color);
       // Command Allocators & Lists
-      int32_t count = Constants::SwapChainSize * threads;
+      int32_t count = Constants::SwapChainSize * Constants::MaxRecordChunks;
       cmdAllocators.reserve(count);
       for (int i = 0; i < count; i++)
       {
@@ -1205,17 +1670,32 @@ namespace
          cmdAllocators.push_back(std::move(temp));
       }
       // CreateCommandList1 closes the cmd list automatically.
-      cmdLists.reserve(threads);
-      _cmdLists.reserve(threads);
-      for (int i = 0; i < threads; i++)
+      cmdLists.reserve(Constants::MaxRecordChunks);
+      _cmdLists.reserve(Constants::MaxRecordChunks);
+      for (int i = 0; i < Constants::MaxRecordChunks; i++)
       {
          ComPtr<ICommandList> temp;
          CheckHResult(device->CreateCommandList1(0, D3D12_COMMAND_LIST_TYPE_DIRECT, D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&temp)));
          _cmdLists.push_back(temp.Get());
          cmdLists.push_back(std::move(temp));
       }
+      bundles.reserve(count);
+      bundleAllocators.reserve(count);
+      for (int i = 0; i < count; i++)
+      {
+         ComPtr<ID3D12CommandAllocator> allocator;
+         CheckHResult(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_BUNDLE, IID_PPV_ARGS(&allocator)));
+         bundleAllocators.push_back(std::move(allocator));
+         ComPtr<ICommandList> bundle;
+         CheckHResult(device->CreateCommandList1(0, D3D12_COMMAND_LIST_TYPE_BUNDLE, D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&bundle)));
+         bundles.push_back(std::move(bundle));
+      }
       // Others
       lateReleaseMgr = std::make_unique<LateReleaseManager>();
+      meshTable = std::make_unique<ResourceTable<std::unique_ptr<UnitedBuffer>>>(ResourceType::Mesh, Constants::MaxResourcesPerType);
+      textureTable = std::make_unique<ResourceTable<std::unique_ptr<UnitedBuffer>>>(ResourceType::Texture, Constants::MaxResourcesPerType);
+      constantBufferTable = std::make_unique<ResourceTable<std::unique_ptr<UnitedBuffer>>>(ResourceType::ConstantBuffer, Constants::MaxResourcesPerType);
+      pipelineStateTable = std::make_unique<ResourceTable<ComPtr<ID3D12PipelineState>>>(ResourceType::PiplelineState, Constants::MaxResourcesPerType);
    }
 
    void CreateHeapsAndPSOs()
@@ -1266,6 +1746,102 @@ namespace
       CreateFrames();
    }
 
+   UnitedBuffer& GetMemoryResource(ResourceHandle handle)
+   {
+      switch (GetResourceType(handle))
+      {
+      case ResourceType::Mesh:
+         return *meshTable->Get(handle);
+      case ResourceType::Texture:
+         return *textureTable->Get(handle);
+      case ResourceType::ConstantBuffer:
+         return *constantBufferTable->Get(handle);
+      default:
+         throw std::runtime_error("Invalid resource handle.");
+      }
+   }
+
+   // Write a frame's elements to the upload buffer of its frame array index. Returns true if the buffer was recreated.
+   bool WriteFrameBuffer(std::unique_ptr<UnitedBuffer>& buffer, const void* data, int32_t elementSize, int32_t count)
+   {
+      if (count == 0) return false;
+      bool isRecreated = !buffer || buffer->ElementCount < count;
+      if (isRecreated)
+      {
+         // Grow by half, so a slowly growing scene doesn't reallocate every frame.
+         if (buffer) lateReleaseMgr->Enqueue(std::move(buffer));
+         buffer = std::make_unique<UnitedBuffer>(UnitedBuffer::Upload, UnitedBuffer::VertexOrIdxBuffer, elementSize, count + count / 2);
+      }
+      buffer->WriteNumericData((const uint8_t*)data, 0, count);
+      return isRecreated;
+   }
+
+   // Replay a command stream into a command list or a bundle. Bundles can't hold barriers or copies, see CommandStream::HasTransfers(),
+   // nor constants, which are written to this frame's memory by the translating worker.
+   // Consecutive barriers are batched by the tracker, which is flushed before each copy and draw.
+   void TranslateCommands(ComPtr<ICommandList>& cmdList, const CommandStream& stream, int32_t workerIndex, int32_t frameIdx, ResourceStateTracker& tracker)
+   {
+      // Instances are a per-instance vertex stream in slot 1, indexed by Draw's FirstInstance.
+      UnitedBuffer& instances = *instanceBuffers[frameIdx];
+      D3D12_VERTEX_BUFFER_VIEW instanceView{ instances.GetGPUAddress(), uint32_t(instances.TotalSize), uint32_t(instances.RawElementSize) };
+      cmdList->IASetVertexBuffers(1, 1, &instanceView);
+      cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+      uint32_t vertexCount = 0;
+      CommandReader reader(stream);
+      Command command;
+      while (reader.Next(command))
+      {
+         const uint32_t* arguments = command.Arguments;
+         switch (command.Type)
+         {
+         case CommandType::BindPipelineState:
+            // Nothing creates pipeline states yet, so no handle is alive. Fail loudly instead of binding a null one.
+            if (!pipelineStateTable->IsAlive(arguments[0])) throw std::runtime_error("D3D12Renderer cannot create pipeline states yet.");
+            cmdList->SetPipelineState(pipelineStateTable->Get(arguments[0]).Get());
+            break;
+         case CommandType::BindMesh:
+         {
+            // Meshes have no index buffers yet, so their vertices are drawn as a triangle list.
+            UnitedBuffer& mesh = *meshTable->Get(arguments[0]);
+            D3D12_VERTEX_BUFFER_VIEW view{ mesh.GetGPUAddress(), uint32_t(mesh.TotalSize), uint32_t(mesh.RawElementSize) };
+            cmdList->IASetVertexBuffers(0, 1, &view);
+            vertexCount = uint32_t(mesh.ElementCount);
+            break;
+         }
+         case CommandType::BindConstantBuffer:
+            cmdList->SetGraphicsRootConstantBufferView(arguments[0], constantBufferTable->Get(arguments[1])->GetGPUAddress());
+            break;
+         case CommandType::Draw:
+            tracker.Flush(cmdList);
+            cmdList->DrawInstanced(vertexCount, arguments[0], 0, arguments[1]);
+            break;
+         case CommandType::Barrier:
+            tracker.Transition(GetMemoryResource(arguments[0]).GetResource().Get(), D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
+               NativeResourceStates[arguments[1]], NativeResourceStates[arguments[2]]);
+            break;
+         case CommandType::Copy:
+         {
+            tracker.Flush(cmdList);
+            // Offsets are within the buffers, which may be ranges of a shared resource.
+            UnitedBuffer& destination = GetMemoryResource(arguments[0]);
+            UnitedBuffer& source = GetMemoryResource(arguments[2]);
+            cmdList->CopyBufferRegion(destination.GetResource().Get(), destination.GetResourceOffset() + arguments[1],
+               source.GetResource().Get(), source.GetResourceOffset() + arguments[3], arguments[4]);
+            break;
+         }
+         case CommandType::SetConstants:
+         {
+            uint64_t offset = frameConstants->Allocate(workerIndex, arguments[2]);
+            memcpy(frameConstantBuffer->GetCPUPointer() + offset, (const uint8_t*)stream.GetConstants().data() + arguments[1], arguments[2]);
+            cmdList->SetGraphicsRootConstantBufferView(arguments[0], frameConstantBuffer->GetGPUAddress() + offset);
+            break;
+         }
+         default:
+            break;
+         }
+      }
+   }
+
    void BlockCompressionEncode()
    {
 
@@ -1291,11 +1867,16 @@ D3D12Renderer::D3D12Renderer(HWND windowHandle, int32_t threadCount) : GenericRe
 {
    SingletonCheck();
    hwnd = windowHandle;
-   threads = threadCount;
    GetClientSize();
    CreateBase();
+   CreateHeapAllocators();
    CreateHeapsAndPSOs();
    CreateFrames();
+   CreateFrameGraph();
+   stateTrackers = std::make_unique<ResourceStateTracker[]>(Constants::MaxRecordChunks);
+   CreateTimestampQueries();
+   CreateUploadRing();
+   CreateFrameConstants(threadCount);
    RendererTestZone();
 }
 
@@ -1308,29 +1889,131 @@ uint64_t D3D12Renderer::GetFrameIndex()
    return fenceSync->GetFrameIndex();
 }
 
+HeapAllocatorStats D3D12Renderer::GetHeapStats(bool textures)
+{
+   std::lock_guard<std::mutex> lock(heapMutex);
+   return (textures ? textureHeapAllocator : bufferHeapAllocator)->GetStats();
+}
+
+UploadRingStats D3D12Renderer::GetUploadStats()
+{
+   std::lock_guard<std::mutex> lock(uploadMutex);
+   return uploadRing->GetStats();
+}
+
+FrameAllocatorStats D3D12Renderer::GetFrameConstantStats()
+{
+   return frameConstants->GetStats();
+}
+
+CopyQueueStats D3D12Renderer::GetCopyStats()
+{
+   std::lock_guard<std::mutex> lock(uploadMutex);
+   return copyQueue->GetStats();
+}
+
+ResourceHandle D3D12Renderer::CreateMesh(const void* vertices, int32_t vertexSize, int32_t vertexCount)
+{
+   auto mesh = std::make_unique<UnitedBuffer>(UnitedBuffer::Default, UnitedBuffer::VertexOrIdxBuffer, vertexSize, vertexCount);
+   mesh->WriteNumericData((const uint8_t*)vertices, 0, vertexCount);
+   return meshTable->Create(std::move(mesh));
+}
+
+ResourceHandle D3D12Renderer::CreateTexture(const uint8_t* data, const GenericTextureInfo& info)
+{
+   auto texture = std::make_unique<UnitedBuffer>(UnitedBuffer::Default, UnitedBuffer::Texture, info);
+   for (int32_t slice = 0; slice < info.GetArrayCount(); slice++) data = texture->WriteTexture(data, info, slice);
+   return textureTable->Create(std::move(texture));
+}
+
+ResourceHandle D3D12Renderer::CreateConstantBuffer(const void* data, int32_t size)
+{
+   auto buffer = std::make_unique<UnitedBuffer>(UnitedBuffer::Default, UnitedBuffer::ConstBuffer, size, 1);
+   buffer->WriteNumericData((const uint8_t*)data);
+   return constantBufferTable->Create(std::move(buffer));
+}
+
 void D3D12Renderer::ReleaseResource(uint32_t handle)
 {
+   switch (GetResourceType(handle))
+   {
+   case ResourceType::Mesh:
+      meshTable->Release(handle);
+      break;
+   case ResourceType::Texture:
+      textureTable->Release(handle);
+      break;
+   case ResourceType::PiplelineState:
+      pipelineStateTable->Release(handle);
+      break;
+   case ResourceType::ConstantBuffer:
+      constantBufferTable->Release(handle);
+      break;
+   default:
+      throw std::runtime_error("Invalid resource handle.");
+   }
 }
 
-void D3D12Renderer::Worker(int32_t workerIndex)
+void D3D12Renderer::Record(int32_t workerIndex, const RecordChunk& chunk)
 {
    int32_t frameIdx = fenceSync->GetFrameArrayIdx();
-   ComPtr<ICommandList>& cmdList = cmdLists[workerIndex];
-   ID3D12CommandAllocator* allocator = cmdAllocators[frameIdx * threads + workerIndex].Get();
+   ComPtr<ICommandList>& cmdList = cmdLists[chunk.Index];
+   ID3D12CommandAllocator* allocator = cmdAllocators[frameIdx * Constants::MaxRecordChunks + chunk.Index].Get();
    CheckHResult(allocator->Reset());
    CheckHResult(cmdList->Reset(allocator, nullptr));
-   if (workerIndex == 0) UnitedBuffer::GPUCopy(cmdList); // Copy all dirty buffers to default heaps.
+   ResourceStateTracker& tracker = stateTrackers[chunk.Index];
+   tracker.Reset();
    // Do actual work.
-   if (workerIndex == 0)
+   switch (chunk.ChunkType)
+   {
+   case RecordChunk::Prologue:
    {
-      ApplyBarrier(cmdList, backbuffers[frameIdx], D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+      cmdList->EndQuery(timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * frameIdx);
+      ApplyGraphBarriers(tracker, GetPassBarriers(clearPass), frameIdx);
+      tracker.Flush(cmdList);
       XMVECTOR _color = XMVectorReplicate(TEMP_GetLastingTime());
       _color = XMVectorAdd(_color, XMVectorSet(0, XM_PI * 0.66f, XM_PI * 1.33f, 0));
       _color = XMVectorMultiplyAdd(XMVectorSin(_color), XMVectorReplicate(0.5f), XMVectorReplicate(0.5f));
       XMFLOAT4 color;
       XMStoreFloat4(&color, _color);
       cmdList->ClearRenderTargetView(descriptorMgr->GetCPUHandle(tempRTVs[frameIdx]), (float*)(&color), 0, nullptr);
-      ApplyBarrier(cmdList, backbuffers[frameIdx], D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+      // The scene's drawcalls are spread over chunks, its barriers go before the first one.
+      ApplyGraphBarriers(tracker, GetPassBarriers(scenePass), frameIdx);
+      break;
+   }
+   case RecordChunk::Drawcalls:
+   {
+      const CommandStream& stream = GetCommandStream(chunk.Index);
+      if (stream.HasTransfers() || stream.HasConstants())
+      {
+         TranslateCommands(cmdList, stream, workerIndex, frameIdx, tracker);
+         break;
+      }
+      // Streams without transfers are translated into bundles, which are replayed as is while their streams are cached.
+      // The GPU is done with the bundle of this frame array index, like the allocators.
+      int32_t bundleIdx = frameIdx * Constants::MaxRecordChunks + chunk.Index;
+      ComPtr<ICommandList>& bundle = bundles[bundleIdx];
+      if (!IsCommandStreamCached(chunk.Index))
+      {
+         CheckHResult(bundleAllocators[bundleIdx]->Reset());
+         CheckHResult(bundle->Reset(bundleAllocators[bundleIdx].Get(), nullptr));
+         TranslateCommands(bundle, stream, workerIndex, frameIdx, tracker);
+         CheckHResult(bundle->Close());
+      }
+      cmdList->ExecuteBundle(bundle.Get());
+      break;
+   }
+   case RecordChunk::Epilogue:
+      ApplyGraphBarriers(tracker, frameGraph.GetFinalBarriers(), frameIdx);
+      break;
+   }
+   tracker.Flush(cmdList);
+   CountBarriers(tracker.GetIssuedBarriers(), tracker.GetFlushes());
+   if (chunk.ChunkType == RecordChunk::Epilogue)
+   {
+      cmdList->EndQuery(timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * frameIdx + 1);
+      cmdList->ResolveQueryData(timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 2 * frameIdx, 2, timestampReadback->GetResource().Get(),
+         2 * frameIdx * sizeof(uint64_t));
    }
    CheckHResult(cmdList->Close());
 }
@@ -1338,13 +2021,53 @@ void D3D12Renderer::Worker(int32_t workerIndex)
 void Pillow::Graphics::D3D12Renderer::Pioneer()
 {
    TryResizingSwapchain();
+   // Start the copies early, the copy engine runs them while the frame is recorded once the frames before it are done.
+   UnitedBuffer::SubmitUploads();
+   // The GPU is done with the last frame of this frame array index, so its timestamps are resolved.
+   int32_t frameIdx = fenceSync->GetFrameArrayIdx();
+   if (hasTimestamps[frameIdx])
+   {
+      timestampReadback->ReadBack(timestampData, int32_t(2 * Constants::SwapChainSize * sizeof(uint64_t)));
+      const uint64_t* timestamps = (const uint64_t*)timestampData.get() + 2 * frameIdx;
+      if (timestamps[1] > timestamps[0]) ReportGPUFrameTime(double(timestamps[1] - timestamps[0]) * timestampPeriod);
+   }
+   hasTimestamps[frameIdx] = true;
+   frameConstants->BeginFrame(frameIdx);
+   // Upload the instances of all batches and the lights. The GPU is done with the buffers of this frame array index, like the allocators.
+   const std::vector<InstanceData>& instances = GetInstances();
+   // Bundles of this frame array index refer to the old instance buffer.
+   if (WriteFrameBuffer(instanceBuffers[frameIdx], instances.data(), int32_t(sizeof(InstanceData)), int32_t(instances.size()))) InvalidateCommandStreams();
+   const LightClusters& clusters = GetLightClusters();
+   if (clusters.GetLightIndices().empty()) return;
+   const std::vector<Light>& lights = GetLights();
+   WriteFrameBuffer(lightBuffers[frameIdx], lights.data(), int32_t(sizeof(Light)), int32_t(lights.size()));
+   WriteFrameBuffer(clusterBuffers[frameIdx], clusters.GetClusters().data(), int32_t(sizeof(LightCluster)), LightClusters::Count);
+   WriteFrameBuffer(lightIndexBuffers[frameIdx], clusters.GetLightIndices().data(), int32_t(sizeof(uint32_t)),
+      int32_t(clusters.GetLightIndices().size()));
 }
 
 void D3D12Renderer::Assembler()
 {
    lateReleaseMgr->ReleaseGarbage(); // Place it here, so it works not in the main thread.
-   cmdQueue->ExecuteCommandLists(threads, _cmdLists.data());
+   {
+      // Resources uploaded so far are usable by the frame once their copies complete.
+      std::lock_guard<std::mutex> lock(uploadMutex);
+      copyQueue->SyncQueue(cmdQueue);
+   }
+   cmdQueue->ExecuteCommandLists(GetRecordChunkCount(), _cmdLists.data()); // In chunk order.
+   MarkFrameStage(FrameStage::ExecuteEnd);
    CheckHResult(swapChain->Present(verticalBlanks, (allowTearing && verticalBlanks == 0) ? DXGI_PRESENT_ALLOW_TEARING : 0));
-   fenceSync->NextFrame();
+   MarkFrameStage(FrameStage::PresentEnd);
+   fenceSync->NextFrame(GetFramesInFlight());
+   MarkFrameStage(FrameStage::SyncEnd);
+   // The game may be ticking concurrently, so handles released so far may still be used by the next frame.
+   uint64_t pendingFence = fenceSync->GetTargetFence();
+   uint64_t completedFence = fenceSync->GetCompletedFence();
+   meshTable->Reclaim(pendingFence, completedFence);
+   textureTable->Reclaim(pendingFence, completedFence);
+   pipelineStateTable->Reclaim(pendingFence, completedFence);
+   constantBufferTable->Reclaim(pendingFence, completedFence);
+   std::lock_guard<std::mutex> lock(uploadMutex);
+   uploadRing->Reclaim(copyQueue->Reclaim());
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,301 @@
+#include "Renderer.h"
+#include <cstring>
+#include <bit>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   // A thread's private drawcall buffer.
+   // Buffers live until exit, so a finished thread doesn't leave a dangling pointer in the list.
+   struct ThreadBuffer
+   {
+      std::vector<Drawcall> drawcalls;
+      BoundsArray bounds;
+      std::vector<LodItem> lodItems; // Indexed into this buffer's drawcalls until collected.
+      std::vector<XMFLOAT3> occluders;
+      std::vector<Light> lights;
+      ThreadBuffer* next;
+   };
+
+   // A lock-free singly linked list. Threads only push, and only once.
+   class ThreadBufferList
+   {
+   public:
+      ~ThreadBufferList()
+      {
+         ThreadBuffer* buffer = head.load(std::memory_order::acquire);
+         while (buffer)
+         {
+            ThreadBuffer* next = buffer->next;
+            delete buffer;
+            buffer = next;
+         }
+      }
+
+      ThreadBuffer* Register()
+      {
+         ThreadBuffer* buffer = new ThreadBuffer{};
+         buffer->next = head.load(std::memory_order::relaxed);
+         while (!head.compare_exchange_weak(buffer->next, buffer, std::memory_order::release, std::memory_order::relaxed));
+         return buffer;
+      }
+
+      ThreadBuffer* GetHead() { return head.load(std::memory_order::acquire); }
+
+   private:
+      std::atomic<ThreadBuffer*> head{};
+   };
+
+   ThreadBufferList threadBuffers;
+   thread_local ThreadBuffer* localBuffer = nullptr;
+
+   // LSD radix sort with digits of at most 11 bits, so a 2048-entry histogram stays in L1.
+   // 1.Drawcalls never move, their indices are sorted, and BatchDrawcalls() reads the drawcalls through them once.
+   // 2.Only the key bits that differ between drawcalls are sorted. They are compacted in order, which keeps the order of keys,
+   // so a scene whose keys share layers and high state bits needs fewer passes.
+   // 3.If the compacted key and the index fit in 64 bits, they are packed into one word, so passes move 8 bytes per item instead of 16.
+   const int32_t RadixBits = 11;
+   const int32_t RadixSize = 1 << RadixBits;
+   const int32_t MaxRadixPasses = (64 + RadixBits - 1) / RadixBits;
+
+   struct SortItem
+   {
+      uint64_t key;
+      uint32_t index;
+   };
+
+   // A run of differing key bits: (key >> Shift) & Mask is the run at its place in the compacted key.
+   struct BitRun
+   {
+      int32_t Shift;
+      uint64_t Mask;
+   };
+
+   // Only Commit() sorts, so the buffers are reused across frames without synchronization.
+   std::vector<uint64_t> sortWords; // Keys, then compacted keys packed with indices.
+   std::vector<uint64_t> sortWordScratch;
+   std::vector<SortItem> sortItems;
+   std::vector<SortItem> sortItemScratch;
+   uint32_t histograms[MaxRadixPasses][RadixSize];
+   BitRun bitRuns[64];
+   int32_t bitRunCount;
+
+   ForceInline uint64_t CompactKey(uint64_t key)
+   {
+      uint64_t compacted = 0;
+      for (int32_t r = 0; r < bitRunCount; r++) compacted |= (key >> bitRuns[r].Shift) & bitRuns[r].Mask;
+      return compacted;
+   }
+
+   ForceInline void CountDigits(uint64_t key, int32_t passes, int32_t digitBits)
+   {
+      uint32_t digitMask = (1u << digitBits) - 1;
+      for (int32_t pass = 0; pass < passes; pass++) histograms[pass][(key >> (pass * digitBits)) & digitMask]++;
+   }
+
+   // Scatter by each digit of GetKey(item) >> firstBit, from the least significant one. The histograms must be counted.
+   // Returns the buffer holding the sorted items.
+   template<typename T, typename GetKey>
+   T* RadixSort(T* from, T* to, uint32_t count, int32_t passes, int32_t firstBit, int32_t digitBits, GetKey getKey)
+   {
+      uint32_t digitMask = (1u << digitBits) - 1;
+      for (int32_t pass = 0; pass < passes; pass++)
+      {
+         int32_t shift = firstBit + pass * digitBits;
+         uint32_t* histogram = histograms[pass];
+         // All keys share this digit, the pass changes nothing.
+         if (histogram[(getKey(from[0]) >> shift) & digitMask] == count) continue;
+         uint32_t offset = 0;
+         for (uint32_t digit = 0; digit <= digitMask; digit++)
+         {
+            uint32_t size = histogram[digit];
+            histogram[digit] = offset;
+            offset += size;
+         }
+         for (uint32_t i = 0; i < count; i++)
+         {
+            to[histogram[(getKey(from[i]) >> shift) & digitMask]++] = from[i];
+         }
+         std::swap(from, to);
+      }
+      return from;
+   }
+}
+
+void Pillow::Graphics::SubmitDrawcall(const Drawcall& drawcall, const BoundingBox& bounds)
+{
+   if (!localBuffer) localBuffer = threadBuffers.Register();
+   localBuffer->drawcalls.push_back(drawcall);
+   localBuffer->bounds.Push(bounds);
+}
+
+void Pillow::Graphics::SubmitDrawcall(const Drawcall& drawcall, const BoundingBox& bounds, const LodChain& lods, uint8_t& lodLevel, bool backToFront)
+{
+   if (lods.Levels.empty()) throw std::runtime_error("A LOD chain has no level.");
+   if (!localBuffer) localBuffer = threadBuffers.Register();
+   localBuffer->lodItems.push_back(LodItem{ int32_t(localBuffer->drawcalls.size()), backToFront, &lods, &lodLevel });
+   localBuffer->drawcalls.push_back(drawcall);
+   localBuffer->bounds.Push(bounds);
+}
+
+void Pillow::Graphics::CollectDrawcalls(std::vector<Drawcall>& drawcalls, BoundsArray& bounds, std::vector<LodItem>& lodItems)
+{
+   drawcalls.clear();
+   bounds.Clear();
+   lodItems.clear();
+   for (ThreadBuffer* buffer = threadBuffers.GetHead(); buffer; buffer = buffer->next)
+   {
+      // LOD items stay in drawcall order, which culling relies on to compact them together.
+      int32_t offset = int32_t(drawcalls.size());
+      for (LodItem item : buffer->lodItems)
+      {
+         item.Drawcall += offset;
+         lodItems.push_back(item);
+      }
+      drawcalls.insert(drawcalls.end(), buffer->drawcalls.begin(), buffer->drawcalls.end());
+      bounds.Append(buffer->bounds);
+      // Keep the capacity for the next tick.
+      buffer->drawcalls.clear();
+      buffer->bounds.Clear();
+      buffer->lodItems.clear();
+   }
+}
+
+void Pillow::Graphics::SubmitOccluder(const XMFLOAT3* vertices, int32_t triangleCount)
+{
+   if (!localBuffer) localBuffer = threadBuffers.Register();
+   localBuffer->occluders.insert(localBuffer->occluders.end(), vertices, vertices + triangleCount * 3);
+}
+
+void Pillow::Graphics::CollectOccluders(std::vector<XMFLOAT3>& vertices)
+{
+   vertices.clear();
+   for (ThreadBuffer* buffer = threadBuffers.GetHead(); buffer; buffer = buffer->next)
+   {
+      vertices.insert(vertices.end(), buffer->occluders.begin(), buffer->occluders.end());
+      buffer->occluders.clear();
+   }
+}
+
+void Pillow::Graphics::SubmitLight(const Light& light)
+{
+   if (!localBuffer) localBuffer = threadBuffers.Register();
+   localBuffer->lights.push_back(light);
+}
+
+void Pillow::Graphics::CollectLights(std::vector<Light>& lights)
+{
+   lights.clear();
+   for (ThreadBuffer* buffer = threadBuffers.GetHead(); buffer; buffer = buffer->next)
+   {
+      lights.insert(lights.end(), buffer->lights.begin(), buffer->lights.end());
+      buffer->lights.clear();
+   }
+}
+
+void Pillow::Graphics::SortDrawcalls(const std::vector<Drawcall>& drawcalls, std::vector<uint32_t>& order)
+{
+   uint32_t count = uint32_t(drawcalls.size());
+   order.resize(count);
+   // 1 Find the key bits that differ between drawcalls.
+   sortWords.resize(count);
+   uint64_t allOnes = ~uint64_t(0), anyOnes = 0;
+   for (uint32_t i = 0; i < count; i++)
+   {
+      uint64_t key = drawcalls[i].SortKey;
+      sortWords[i] = key;
+      allOnes &= key;
+      anyOnes |= key;
+   }
+   // Without drawcalls, allOnes would differ from anyOnes in every bit.
+   uint64_t differing = count > 0 ? allOnes ^ anyOnes : 0;
+   int32_t keyBits = std::popcount(differing);
+   if (keyBits == 0)
+   {
+      // All keys are equal (or there is at most one), the order is the submission order.
+      for (uint32_t i = 0; i < count; i++) order[i] = i;
+      return;
+   }
+   bitRunCount = 0;
+   for (int32_t compactedBits = 0; differing != 0;)
+   {
+      int32_t start = std::countr_zero(differing);
+      int32_t width = std::countr_one(differing >> start);
+      uint64_t run = width == 64 ? ~uint64_t(0) : (uint64_t(1) << width) - 1;
+      bitRuns[bitRunCount++] = BitRun{ start - compactedBits, run << compactedBits };
+      differing &= ~(run << start);
+      compactedBits += width;
+   }
+   // Spread the bits evenly over the fewest passes.
+   int32_t passes = (keyBits + RadixBits - 1) / RadixBits;
+   int32_t digitBits = (keyBits + passes - 1) / passes;
+   int32_t indexBits = std::bit_width(count - 1);
+   std::memset(histograms, 0, sizeof(histograms));
+   if (keyBits + indexBits <= 64)
+   {
+      // 2 Pack | compacted key | index |. Equal keys stay in submission order, as the sort is stable.
+      sortWordScratch.resize(count);
+      for (uint32_t i = 0; i < count; i++)
+      {
+         uint64_t key = CompactKey(sortWords[i]);
+         CountDigits(key, passes, digitBits);
+         sortWords[i] = key << indexBits | i;
+      }
+      const uint64_t* sorted = RadixSort(sortWords.data(), sortWordScratch.data(), count, passes, indexBits, digitBits, [](uint64_t word) { return word; });
+      uint64_t indexMask = (uint64_t(1) << indexBits) - 1;
+      for (uint32_t i = 0; i < count; i++) order[i] = uint32_t(sorted[i] & indexMask);
+   }
+   else
+   {
+      // 2 Too many bits differ, sort (key, index) pairs.
+      sortItems.resize(count);
+      sortItemScratch.resize(count);
+      for (uint32_t i = 0; i < count; i++)
+      {
+         uint64_t key = CompactKey(sortWords[i]);
+         CountDigits(key, passes, digitBits);
+         sortItems[i] = SortItem{ key, i };
+      }
+      const SortItem* sorted = RadixSort(sortItems.data(), sortItemScratch.data(), count, passes, 0, digitBits, [](const SortItem& item) { return item.key; });
+      for (uint32_t i = 0; i < count; i++) order[i] = sorted[i].index;
+   }
+}
+
+void Pillow::Graphics::BatchDrawcalls(const std::vector<Drawcall>& drawcalls, const std::vector<uint32_t>& order, std::vector<DrawBatch>& batches,
+   std::vector<InstanceData>& instances)
+{
+   int32_t count = int32_t(order.size());
+   batches.clear();
+   instances.resize(count);
+   for (int32_t i = 0; i < count; i++)
+   {
+      const Drawcall& drawcall = drawcalls[order[i]];
+      instances[i] = drawcall.Instance;
+      if (!batches.empty())
+      {
+         DrawBatch& batch = batches.back();
+         if (drawcall.Mesh == batch.Mesh && drawcall.PipelineState == batch.PipelineState && drawcall.Material == batch.Material)
+         {
+            batch.InstanceCount++;
+            continue;
+         }
+      }
+      batches.push_back(DrawBatch{ drawcall.Mesh, drawcall.Material, drawcall.PipelineState, i, 1 });
+   }
+}
+
+void Pillow::Graphics::RecordDrawBatches(const std::vector<DrawBatch>& batches, int32_t first, int32_t count, const CameraConstants* camera,
+   CommandStream& stream)
+{
+   if (camera) stream.SetConstants(CameraConstantsSlot, camera, sizeof(CameraConstants));
+   for (int32_t i = first; i < first + count; i++)
+   {
+      const DrawBatch& batch = batches[i];
+      stream.BindPipelineState(batch.PipelineState);
+      stream.BindMesh(batch.Mesh);
+      stream.BindConstantBuffer(0, batch.Material);
+      stream.Draw(uint32_t(batch.InstanceCount), uint32_t(batch.FirstInstance));
+   }
+}
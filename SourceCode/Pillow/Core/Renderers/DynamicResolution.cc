@@ -0,0 +1,78 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+DynamicResolution::DynamicResolution(const DynamicResolutionSettings& _settings, int32_t refreshRate) :
+   settings(_settings)
+{
+   if (settings.MinScale <= 0 || settings.MinScale > settings.MaxScale || settings.ScaleStep <= 0 || settings.RaiseDelay < 0)
+   {
+      throw std::runtime_error("Invalid dynamic resolution settings.");
+   }
+   if (settings.TargetFrameTime <= 0 && refreshRate <= 0) throw std::runtime_error("A frame time target or a refresh rate is needed.");
+   targetFrameTime = settings.TargetFrameTime > 0 ? settings.TargetFrameTime : 1000.0 / refreshRate;
+   Reset();
+}
+
+void DynamicResolution::Reset()
+{
+   filteredTime = 0;
+   recentTimes[0] = recentTimes[1] = 0;
+   lastError = olderError = 0;
+   scale = settings.MaxScale;
+   pixels = double(scale) * scale;
+   raiseFrames = 0;
+}
+
+float DynamicResolution::Update(double cpuTime, double gpuTime)
+{
+   double frameTime = gpuTime > 0 ? gpuTime : std::max(cpuTime, 0.0);
+   // The median of the last 3 frames drops single spikes, like a shader compilation or a page fault.
+   double median = recentTimes[1] == 0 ? frameTime :
+      std::max(std::min(frameTime, recentTimes[0]), std::min(std::max(frameTime, recentTimes[0]), recentTimes[1]));
+   recentTimes[1] = recentTimes[0];
+   recentTimes[0] = frameTime;
+   filteredTime = filteredTime == 0 ? median : filteredTime + (median - filteredTime) * Smoothing;
+   double aim = targetFrameTime * (1 - settings.Headroom);
+   double error = (aim - filteredTime) / aim; // Positive if there is time to spare.
+   if (std::abs(error) < settings.Deadband) error = 0;
+   double delta = settings.Proportional * (error - lastError) + settings.Integral * error +
+      settings.Derivative * (error - 2 * lastError + olderError);
+   olderError = lastError;
+   lastError = error;
+   bool isCPUBound = gpuTime > 0 && cpuTime > gpuTime && cpuTime > aim;
+   if (isCPUBound) delta = std::max(delta, 0.0);
+   double minPixels = double(settings.MinScale) * settings.MinScale;
+   // Rising one step at a time keeps the output from running ahead while a raise waits, which would overshoot.
+   double nextStep = std::min(double(scale + settings.ScaleStep), double(settings.MaxScale));
+   pixels = std::clamp(pixels + delta, minPixels, std::max(nextStep * nextStep, minPixels));
+   float wanted = std::round(float(std::sqrt(pixels)) / settings.ScaleStep) * settings.ScaleStep;
+   wanted = std::clamp(wanted, settings.MinScale, settings.MaxScale);
+   if (wanted < scale && !isCPUBound)
+   {
+      scale = wanted;
+      raiseFrames = 0;
+   }
+   else if (wanted > scale)
+   {
+      if (++raiseFrames >= settings.RaiseDelay)
+      {
+         scale = wanted;
+         raiseFrames = 0;
+      }
+   }
+   else
+   {
+      raiseFrames = 0;
+   }
+   return scale;
+}
+
+XMINT2 DynamicResolution::GetRenderSize(XMINT2 outputSize) const
+{
+   auto Scale = [this](int32_t size) { return std::max(int32_t(size * scale) & ~7, 8); };
+   return XMINT2{ Scale(outputSize.x), Scale(outputSize.y) };
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "../Auxiliaries.h"
+
+using namespace DirectX;
+
+namespace Pillow::Graphics
+{
+   struct DynamicResolutionSettings
+   {
+      double TargetFrameTime = 0; // Milliseconds, 0 takes a refresh interval.
+      double Headroom = 0.1;      // Aim this fraction below the target, so noise doesn't push frames over it.
+      float MinScale = 0.5f;      // Per axis, of the output size.
+      float MaxScale = 1;
+      float ScaleStep = 1.f / 32; // Scales are multiples of it, so render targets don't change size every frame.
+      double Deadband = 0.05;     // Errors within it are taken as 0.
+      int32_t RaiseDelay = 8;     // Frames a higher scale must be asked for in a row before it's taken. Lower ones are taken at once.
+      // Gains of the PID terms. The error is the frame time's distance from the aim, as a fraction of the aim,
+      // and the controller's output is the fraction of the output's pixels.
+      double Proportional = 0.4;
+      double Integral = 0.15;
+      double Derivative = 0.05;
+   };
+
+   // Picks the render resolution from frame times, portable CPU logic.
+   // 1.The GPU time of a frame is about proportional to its pixels, so the controller drives the pixel fraction (the squared scale),
+   // which keeps the loop gain about the same at any scale.
+   // 2.The PID is in velocity form: each frame moves the output by the change of the P and D terms and by the I term.
+   // So clamping the output needs no anti-windup.
+   // 3.Frames bound by the CPU never lower the scale, fewer pixels wouldn't make them faster.
+   // 4.The chosen scale is quantized by ScaleStep. It drops at once, but rises a step at a time, after RaiseDelay frames asking for it.
+   // Frame times pass a median of 3 frames and an exponential moving average first.
+   class DynamicResolution
+   {
+   public:
+      DynamicResolution(const DynamicResolutionSettings& settings = {}, int32_t refreshRate = 60);
+      // Feed a finished frame's times in milliseconds, and return the scale of the next one.
+      // gpuTime: 0 if unknown, then the larger of the two is taken as the GPU's.
+      float Update(double cpuTime, double gpuTime);
+      // Back to MaxScale, forgetting the history.
+      void Reset();
+      ForceInline float GetScale() const { return scale; }
+      ForceInline double GetTargetFrameTime() const { return targetFrameTime; }
+      ForceInline const DynamicResolutionSettings& GetSettings() const { return settings; }
+      // The output size at the current scale, each axis a multiple of 8 and at least 8.
+      XMINT2 GetRenderSize(XMINT2 outputSize) const;
+
+   private:
+      // Frame times are smoothed before they are compared, a single spike shouldn't move the scale much.
+      static constexpr double Smoothing = 0.3;
+
+      DynamicResolutionSettings settings;
+      double targetFrameTime;
+      double recentTimes[2]; // The last 2 frame times, the newest first.
+      double filteredTime;
+      double lastError;
+      double olderError;
+      double pixels; // The controller's output, the fraction of the output's pixels.
+      float scale;
+      int32_t raiseFrames;
+   };
+}
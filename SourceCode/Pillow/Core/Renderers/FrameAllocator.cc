@@ -0,0 +1,59 @@
+#include "FrameAllocator.h"
+#include <algorithm>
+#include <bit>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+FrameAllocator::FrameAllocator(uint64_t regionSize, int32_t regionCount, int32_t threadCount, uint64_t pageSize, uint64_t alignment) :
+   regionSize(regionSize),
+   regionCount(regionCount),
+   threadCount(threadCount),
+   pageSize(pageSize),
+   alignment(alignment),
+   pages(std::make_unique<Page[]>(std::max(threadCount, 1)))
+{
+   if (!std::has_single_bit(pageSize) || !std::has_single_bit(alignment) || alignment > pageSize || regionSize == 0 || regionSize % pageSize != 0)
+      throw std::runtime_error("The frame allocator's page size and alignment must be powers of two dividing its region size.");
+   if (regionCount <= 0 || threadCount <= 0) throw std::runtime_error("The frame allocator needs regions and threads.");
+   stats.Capacity = regionSize;
+}
+
+void FrameAllocator::BeginFrame(int32_t frameIdx)
+{
+   if (frameIdx < 0 || frameIdx >= regionCount) throw std::runtime_error("Invalid frame allocator region.");
+   // Sum up the frame allocated since the last call.
+   stats.UsedBytes = std::min(regionUsed.load(std::memory_order::relaxed), regionSize);
+   stats.PeakUsedBytes = std::max(stats.PeakUsedBytes, stats.UsedBytes);
+   stats.AllocatedBytes = 0;
+   stats.Allocations = 0;
+   for (int32_t i = 0; i < threadCount; i++)
+   {
+      stats.AllocatedBytes += pages[i].AllocatedBytes;
+      stats.Allocations += pages[i].Allocations;
+      // An empty page makes the first allocation take a new one.
+      pages[i] = Page{};
+   }
+   regionStart = uint64_t(frameIdx) * regionSize;
+   regionUsed.store(0, std::memory_order::relaxed);
+}
+
+uint64_t FrameAllocator::Allocate(int32_t threadIndex, uint64_t size)
+{
+   Page& page = pages[threadIndex];
+   size = (std::max(size, uint64_t(1)) + alignment - 1) & ~(alignment - 1);
+   if (size > page.End - page.Position)
+   {
+      // The rest of the old page is left unused.
+      uint64_t taken = (size + pageSize - 1) & ~(pageSize - 1);
+      uint64_t start = regionUsed.fetch_add(taken, std::memory_order::relaxed);
+      if (start + taken > regionSize) throw std::runtime_error("The frame's allocations don't fit in its region.");
+      page.Position = regionStart + start;
+      page.End = page.Position + taken;
+   }
+   uint64_t offset = page.Position;
+   page.Position += size;
+   page.AllocatedBytes += size;
+   page.Allocations++;
+   return offset;
+}
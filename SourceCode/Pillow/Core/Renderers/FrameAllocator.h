@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include "../Auxiliaries.h"
+
+namespace Pillow::Graphics
+{
+   // Of the last finished frame, except the peak.
+   struct FrameAllocatorStats
+   {
+      uint64_t Capacity;       // Of a frame's region.
+      uint64_t UsedBytes;      // Pages the threads took, the unused ends included.
+      uint64_t PeakUsedBytes;  // Over all frames.
+      uint64_t AllocatedBytes; // Rounded up to the alignment.
+      uint64_t Allocations;
+   };
+
+   // Transient per-frame memory, like per-draw constants, in a persistently mapped buffer with a region per frame array index.
+   // It knows no GPU API, allocations are offsets into the buffer.
+   //
+   // 1.A thread bump-allocates from its own page without locks, a page is taken from the frame's region with one atomic add.
+   // 2.An allocation larger than a page takes a run of pages of its own.
+   // 3.BeginFrame() resets a region wholesale, once the GPU is done with the frame that last used it.
+   class FrameAllocator
+   {
+   public:
+      // "pageSize" and "alignment" must be powers of two, the alignment at most the page size, and "regionSize" a multiple of the page size.
+      FrameAllocator(uint64_t regionSize, int32_t regionCount, int32_t threadCount, uint64_t pageSize, uint64_t alignment);
+
+      // Allocate from the region of "frameIdx" from now on, forgetting its old allocations. Not thread-safe, invoke it while no thread allocates.
+      void BeginFrame(int32_t frameIdx);
+      // Lock-free, a thread index must be used by one thread at a time. Return the offset in the buffer.
+      // Throws if the frame's region is exhausted.
+      uint64_t Allocate(int32_t threadIndex, uint64_t size);
+
+      // Not thread-safe, like BeginFrame().
+      ForceInline const FrameAllocatorStats& GetStats() const { return stats; }
+
+   private:
+      // A cache line per thread, so threads don't share the lines they write.
+      struct alignas(64) Page
+      {
+         uint64_t Position;
+         uint64_t End;
+         uint64_t AllocatedBytes;
+         uint64_t Allocations;
+      };
+
+      const uint64_t regionSize;
+      const int32_t regionCount;
+      const int32_t threadCount;
+      const uint64_t pageSize;
+      const uint64_t alignment;
+      uint64_t regionStart = 0;
+      std::atomic<uint64_t> regionUsed{ 0 };
+      std::unique_ptr<Page[]> pages;
+      FrameAllocatorStats stats{};
+   };
+}
@@ -0,0 +1,284 @@
+#include "HeapAllocator.h"
+#include <algorithm>
+#include <bit>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   // Round up to the smallest size of the next subclass, so every range listed there is at least "units".
+   uint64_t RoundUpToSubClass(uint64_t units, int32_t subClassBits)
+   {
+      int32_t power = int32_t(std::bit_width(units)) - 1;
+      if (power < subClassBits) return units;
+      uint64_t step = uint64_t(1) << (power - subClassBits);
+      return (units + step - 1) & ~(step - 1);
+   }
+}
+
+HeapAllocator::HeapAllocator(uint64_t blockSize, uint64_t granularity) :
+   blockUnits(granularity == 0 ? 0 : blockSize / granularity),
+   granularityShift(int32_t(std::countr_zero(granularity)))
+{
+   if (granularity == 0 || !std::has_single_bit(granularity) || blockSize == 0 || blockSize % granularity != 0)
+      throw std::runtime_error("The heap granularity must be a power of two dividing the block size.");
+   for (auto& lists : freeLists) std::fill(std::begin(lists), std::end(lists), None);
+}
+
+HeapAllocation HeapAllocator::Allocate(uint64_t size)
+{
+   if (size == 0) throw std::runtime_error("Cannot allocate 0 bytes from a heap.");
+   uint64_t units = ((size - 1) >> granularityShift) + 1;
+   uint32_t index = FindFreeRange(units);
+   if (index == None)
+   {
+      CreateBlock(units);
+      index = FindFreeRange(units);
+   }
+   UnlistFreeRange(index);
+   // List the rest of the range again.
+   if (ranges[index].Size > units)
+   {
+      uint32_t rest = NewRange();
+      Range& taken = ranges[index];
+      ranges[rest] = Range{ taken.Offset + units, taken.Size - units, taken.Block, true, index, taken.NextInBlock, None, None };
+      if (taken.NextInBlock != None) ranges[taken.NextInBlock].PreviousInBlock = rest;
+      taken.NextInBlock = rest;
+      taken.Size = units;
+      ListFreeRange(rest);
+   }
+   Range& taken = ranges[index];
+   taken.IsFree = false;
+   if (blocks[taken.Block].Allocations++ == 0) emptyBlocks--;
+   allocations++;
+   liveUnits += units;
+   return HeapAllocation{ taken.Block, index, taken.Offset << granularityShift, units << granularityShift };
+}
+
+int32_t HeapAllocator::Free(const HeapAllocation& allocation)
+{
+   uint32_t index = allocation.Range;
+   if (allocation.Block < 0 || index >= ranges.size() || ranges[index].IsFree || ranges[index].Block != allocation.Block ||
+      (ranges[index].Offset << granularityShift) != allocation.Offset)
+   {
+      throw std::runtime_error("The heap allocation is not live.");
+   }
+   liveUnits -= ranges[index].Size;
+   allocations--;
+   ranges[index].IsFree = true;
+   // Merge a range into the one before it in the block, which survives.
+   auto MergeIntoPrevious = [this](uint32_t merged)
+      {
+         Range& range = ranges[merged];
+         ranges[range.PreviousInBlock].Size += range.Size;
+         ranges[range.PreviousInBlock].NextInBlock = range.NextInBlock;
+         if (range.NextInBlock != None) ranges[range.NextInBlock].PreviousInBlock = range.PreviousInBlock;
+         spareRanges.push_back(merged);
+      };
+   uint32_t next = ranges[index].NextInBlock;
+   if (next != None && ranges[next].IsFree)
+   {
+      UnlistFreeRange(next);
+      MergeIntoPrevious(next);
+   }
+   uint32_t previous = ranges[index].PreviousInBlock;
+   if (previous != None && ranges[previous].IsFree)
+   {
+      UnlistFreeRange(previous);
+      MergeIntoPrevious(index);
+      index = previous;
+   }
+   int32_t blockIndex = allocation.Block;
+   Block& block = blocks[blockIndex];
+   if (--block.Allocations > 0 || (block.Size == blockUnits && emptyBlocks == 0))
+   {
+      emptyBlocks += block.Allocations == 0;
+      ListFreeRange(index);
+      return -1;
+   }
+   // The block is one free range now.
+   block.IsLive = false;
+   reservedUnits -= block.Size;
+   spareRanges.push_back(index);
+   spareBlocks.push_back(blockIndex);
+   return blockIndex;
+}
+
+HeapAllocatorStats HeapAllocator::GetStats() const
+{
+   HeapAllocatorStats stats{};
+   for (const Block& block : blocks) stats.Blocks += block.IsLive;
+   stats.Allocations = allocations;
+   stats.FreeRanges = freeRanges;
+   stats.ReservedBytes = reservedUnits << granularityShift;
+   stats.LiveBytes = liveUnits << granularityShift;
+   // The largest free range is in the highest non-empty list.
+   if (classBits != 0)
+   {
+      int32_t sizeClass = 63 - std::countl_zero(classBits);
+      int32_t subClass = 31 - std::countl_zero(subClassBits[sizeClass]);
+      uint64_t largest = 0;
+      for (uint32_t i = freeLists[sizeClass][subClass]; i != None; i = ranges[i].NextFree) largest = std::max(largest, ranges[i].Size);
+      stats.LargestFreeRange = largest << granularityShift;
+   }
+   uint64_t freeBytes = stats.ReservedBytes - stats.LiveBytes;
+   stats.Fragmentation = freeBytes > 0 ? 1 - float(double(stats.LargestFreeRange) / double(freeBytes)) : 0;
+   return stats;
+}
+
+void HeapAllocator::Validate() const
+{
+   auto Check = [](bool condition, const char* message)
+      {
+         if (!condition) throw std::runtime_error(string("Invalid heap allocator: ") + message);
+      };
+   uint64_t live = 0, reserved = 0, freeUnits = 0;
+   int32_t liveAllocations = 0, listedRanges = 0, empty = 0;
+   for (int32_t b = 0; b < int32_t(blocks.size()); b++)
+   {
+      const Block& block = blocks[b];
+      if (!block.IsLive) continue;
+      reserved += block.Size;
+      uint64_t offset = 0;
+      int32_t blockAllocations = 0;
+      bool wasFree = false;
+      uint32_t previous = None;
+      for (uint32_t i = block.FirstRange; i != None; i = ranges[i].NextInBlock)
+      {
+         const Range& range = ranges[i];
+         Check(range.Block == b && range.Offset == offset && range.Size > 0, "a range is out of place in its block.");
+         Check(range.PreviousInBlock == previous, "a range's links don't match.");
+         Check(!(range.IsFree && wasFree), "two free ranges are adjacent.");
+         if (range.IsFree) freeUnits += range.Size;
+         else
+         {
+            live += range.Size;
+            blockAllocations++;
+         }
+         offset += range.Size;
+         wasFree = range.IsFree;
+         previous = i;
+      }
+      Check(offset == block.Size, "the ranges don't cover their block.");
+      Check(blockAllocations == block.Allocations, "a block miscounts its allocations.");
+      liveAllocations += blockAllocations;
+      empty += blockAllocations == 0;
+   }
+   for (int32_t c = 0; c < ClassCount; c++)
+   {
+      Check(((classBits >> c) & 1) == (subClassBits[c] != 0), "the class bitmap doesn't match.");
+      for (int32_t s = 0; s < SubClassCount; s++)
+      {
+         Check(((subClassBits[c] >> s) & 1) == (freeLists[c][s] != None), "the subclass bitmap doesn't match.");
+         uint32_t previous = None;
+         for (uint32_t i = freeLists[c][s]; i != None; i = ranges[i].NextFree)
+         {
+            int32_t sizeClass, subClass;
+            GetClass(ranges[i].Size, sizeClass, subClass);
+            Check(ranges[i].IsFree && blocks[ranges[i].Block].IsLive, "a listed range isn't free.");
+            Check(sizeClass == c && subClass == s && ranges[i].PreviousFree == previous, "a range is in the wrong list.");
+            previous = i;
+            listedRanges++;
+         }
+      }
+   }
+   Check(listedRanges == freeRanges && live == liveUnits && reserved == reservedUnits && liveAllocations == allocations &&
+      empty == emptyBlocks && live + freeUnits == reserved, "the totals don't match.");
+}
+
+void HeapAllocator::GetClass(uint64_t units, int32_t& sizeClass, int32_t& subClass)
+{
+   int32_t power = int32_t(std::bit_width(units)) - 1;
+   if (power < SubClassBits)
+   {
+      sizeClass = 0;
+      subClass = int32_t(units);
+      return;
+   }
+   sizeClass = power - SubClassBits + 1;
+   subClass = int32_t(units >> (power - SubClassBits)) - SubClassCount;
+}
+
+uint32_t HeapAllocator::FindFreeRange(uint64_t units) const
+{
+   int32_t sizeClass, subClass;
+   GetClass(RoundUpToSubClass(units, SubClassBits), sizeClass, subClass);
+   uint32_t subClasses = subClassBits[sizeClass] & (~0u << subClass);
+   if (subClasses == 0)
+   {
+      uint64_t classes = sizeClass + 1 < ClassCount ? classBits & (~uint64_t(0) << (sizeClass + 1)) : 0;
+      if (classes == 0) return None;
+      sizeClass = std::countr_zero(classes);
+      subClasses = subClassBits[sizeClass];
+   }
+   return freeLists[sizeClass][std::countr_zero(subClasses)];
+}
+
+uint32_t HeapAllocator::NewRange()
+{
+   if (spareRanges.empty())
+   {
+      ranges.emplace_back();
+      return uint32_t(ranges.size() - 1);
+   }
+   uint32_t index = spareRanges.back();
+   spareRanges.pop_back();
+   return index;
+}
+
+void HeapAllocator::ListFreeRange(uint32_t index)
+{
+   int32_t sizeClass, subClass;
+   GetClass(ranges[index].Size, sizeClass, subClass);
+   uint32_t& head = freeLists[sizeClass][subClass];
+   ranges[index].PreviousFree = None;
+   ranges[index].NextFree = head;
+   if (head != None) ranges[head].PreviousFree = index;
+   head = index;
+   subClassBits[sizeClass] |= 1u << subClass;
+   classBits |= uint64_t(1) << sizeClass;
+   freeRanges++;
+}
+
+void HeapAllocator::UnlistFreeRange(uint32_t index)
+{
+   const Range& range = ranges[index];
+   if (range.NextFree != None) ranges[range.NextFree].PreviousFree = range.PreviousFree;
+   if (range.PreviousFree != None) ranges[range.PreviousFree].NextFree = range.NextFree;
+   else
+   {
+      int32_t sizeClass, subClass;
+      GetClass(range.Size, sizeClass, subClass);
+      freeLists[sizeClass][subClass] = range.NextFree;
+      if (range.NextFree == None)
+      {
+         subClassBits[sizeClass] &= ~(1u << subClass);
+         if (subClassBits[sizeClass] == 0) classBits &= ~(uint64_t(1) << sizeClass);
+      }
+   }
+   freeRanges--;
+}
+
+void HeapAllocator::CreateBlock(uint64_t units)
+{
+   // A bigger block is rounded like the search, so its range is in a list the search looks at.
+   uint64_t size = std::max(blockUnits, RoundUpToSubClass(units, SubClassBits));
+   int32_t index;
+   if (spareBlocks.empty())
+   {
+      index = int32_t(blocks.size());
+      blocks.emplace_back();
+   }
+   else
+   {
+      index = spareBlocks.back();
+      spareBlocks.pop_back();
+   }
+   uint32_t range = NewRange();
+   ranges[range] = Range{ 0, size, index, true, None, None, None, None };
+   blocks[index] = Block{ size, range, 0, true };
+   emptyBlocks++;
+   reservedUnits += size;
+   ListFreeRange(range);
+}
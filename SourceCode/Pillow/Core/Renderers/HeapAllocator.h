@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include "../Auxiliaries.h"
+
+namespace Pillow::Graphics
+{
+   // A range of a block, see HeapAllocator.
+   struct HeapAllocation
+   {
+      int32_t Block = -1;  // -1 for none.
+      uint32_t Range = 0;  // Bookkeeping of the allocator.
+      uint64_t Offset = 0; // In the block.
+      uint64_t Size = 0;   // Rounded up to the granularity.
+   };
+
+   struct HeapAllocatorStats
+   {
+      int32_t Blocks;
+      int32_t Allocations;      // Live ones.
+      int32_t FreeRanges;
+      uint64_t ReservedBytes;   // Of all blocks.
+      uint64_t LiveBytes;
+      uint64_t LargestFreeRange;
+      // 1 - LargestFreeRange / free bytes. 0 if the free memory is one range, towards 1 as it scatters into small ones.
+      float Fragmentation;
+   };
+
+   // Suballocates blocks of GPU memory, like D3D12 heaps, with a two-level segregated fit (TLSF) allocator.
+   // It knows no GPU API, the backend creates a block's memory the first time an allocation lands in it.
+   //
+   // 1.Free ranges are listed by size class: the power of two of the size, split into SubClassCount subclasses.
+   // Bitmaps of the non-empty lists find the smallest list whose ranges all fit in constant time.
+   // 2.An allocation takes the head of that list, and lists the rest of the range again.
+   // 3.Freeing merges a range with its free neighbours in the block, so no two free ranges are adjacent.
+   // Sizes are rounded up to the granularity, so every offset is aligned to it. A block is created when no free range fits,
+   // as big as the allocation if it's beyond the block size. Empty blocks are released, except for one of the block size.
+   class HeapAllocator
+   {
+   public:
+      // "granularity" must be a power of two dividing "blockSize".
+      HeapAllocator(uint64_t blockSize, uint64_t granularity);
+      HeapAllocation Allocate(uint64_t size);
+      // Return the block if it became empty and was released, otherwise -1. New blocks may reuse the indices of released ones.
+      int32_t Free(const HeapAllocation& allocation);
+      ForceInline uint64_t GetBlockSize(int32_t block) const { return blocks[block].Size << granularityShift; }
+      HeapAllocatorStats GetStats() const;
+      // Check every block and list, for debug builds and stress tests. Throws describing the first inconsistency.
+      void Validate() const;
+
+   private:
+      static const int32_t SubClassBits = 4, SubClassCount = 1 << SubClassBits;
+      static const int32_t ClassCount = 64 - SubClassBits + 1;
+      static constexpr uint32_t None = UINT32_MAX;
+
+      struct Range
+      {
+         uint64_t Offset;
+         uint64_t Size;
+         int32_t Block;
+         bool IsFree;
+         uint32_t PreviousInBlock, NextInBlock;
+         uint32_t PreviousFree, NextFree; // In the list of its size class.
+      };
+
+      struct Block
+      {
+         uint64_t Size;
+         uint32_t FirstRange; // The range at offset 0 is never merged away, so it stays the first one.
+         int32_t Allocations;
+         bool IsLive;
+      };
+
+      // Units are granules. The list a free range of "units" goes into.
+      static void GetClass(uint64_t units, int32_t& sizeClass, int32_t& subClass);
+      uint32_t FindFreeRange(uint64_t units) const;
+      uint32_t NewRange();
+      void ListFreeRange(uint32_t range);
+      void UnlistFreeRange(uint32_t range);
+      void CreateBlock(uint64_t units);
+
+      const uint64_t blockUnits;
+      const int32_t granularityShift;
+      std::vector<Range> ranges;
+      std::vector<uint32_t> spareRanges;
+      std::vector<Block> blocks;
+      std::vector<int32_t> spareBlocks;
+      uint64_t classBits = 0;                 // Bit c is set if subClassBits[c] is not 0.
+      uint32_t subClassBits[ClassCount]{};    // Bit s is set if freeLists[c][s] is not empty.
+      uint32_t freeLists[ClassCount][SubClassCount];
+      int32_t emptyBlocks = 0;                // Live blocks without allocations.
+      int32_t allocations = 0;
+      int32_t freeRanges = 0;
+      uint64_t liveUnits = 0;
+      uint64_t reservedUnits = 0;
+   };
+}
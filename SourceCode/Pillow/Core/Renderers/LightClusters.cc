@@ -0,0 +1,223 @@
+#include "LightClusters.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   ForceInline int32_t FloorToInt(float value)
+   {
+      return int32_t(std::floor(value));
+   }
+
+   // A bit per lane of a comparison result, lane 0 the lowest.
+   ForceInline uint32_t LaneMask(FXMVECTOR comparison)
+   {
+      uint32_t lanes[4];
+      XMStoreInt4(lanes, comparison);
+      return (lanes[0] & 1) | (lanes[1] & 2) | (lanes[2] & 4) | (lanes[3] & 8);
+   }
+}
+
+void LightClusters::Begin(const std::vector<Light>& _lights, FXMMATRIX view, CXMMATRIX projection)
+{
+   if (_lights.size() > MaxLights) throw std::runtime_error("Too many lights for clustering.");
+   // A left-handed perspective projection: P22 = f / (f - n), P32 = -n * f / (f - n).
+   float p22 = XMVectorGetZ(projection.r[2]), p32 = XMVectorGetZ(projection.r[3]);
+   // An infinite projection has P22 = 1, then the slices end 1e4 times farther than the near plane.
+   float nearZ = -p32 / p22, farZ = p22 > 1 ? p32 / (1 - p22) : nearZ * 1e4f;
+   XMFLOAT4 params(XMVectorGetX(projection.r[0]), XMVectorGetY(projection.r[1]), nearZ, farZ);
+   if (std::memcmp(&params, &projectionParams, sizeof(XMFLOAT4)) != 0)
+   {
+      projectionParams = params;
+      BuildFroxels();
+   }
+   std::fill(clusterCounts.begin(), clusterCounts.end(), 0);
+   int32_t count = int32_t(_lights.size());
+   viewLights.resize(count);
+   sliceLightHits.assign(size_t(CountZ) * count, 0);
+   for (int32_t i = 0; i < count; i++)
+   {
+      const Light& light = _lights[i];
+      ViewLight& viewLight = viewLights[i];
+      XMStoreFloat3(&viewLight.Position, XMVector3TransformCoord(XMLoadFloat3(&light.Position), view));
+      XMStoreFloat3(&viewLight.Direction, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&light.Direction), view)));
+      viewLight.Range = light.Range;
+      bool isSpot = light.SpotAngle > 0 && light.SpotAngle < XM_PIDIV2;
+      viewLight.SpotCos = isSpot ? std::cos(light.SpotAngle) : 1;
+      viewLight.SpotSin = isSpot ? std::sin(light.SpotAngle) : 0;
+      float z0 = viewLight.Position.z - light.Range, z1 = viewLight.Position.z + light.Range;
+      if (light.Range <= 0 || z1 < nearZ || z0 > farZ)
+      {
+         viewLight.FirstSlice = 1;
+         viewLight.LastSlice = 0;
+         continue;
+      }
+      viewLight.FirstSlice = std::clamp(FloorToInt(std::log(std::max(z0, nearZ)) * sliceScale + sliceBias), 0, CountZ - 1);
+      viewLight.LastSlice = std::clamp(FloorToInt(std::log(std::min(z1, farZ)) * sliceScale + sliceBias), 0, CountZ - 1);
+   }
+}
+
+void LightClusters::BuildFroxels()
+{
+   float p00 = projectionParams.x, p11 = projectionParams.y, nearZ = projectionParams.z, farZ = projectionParams.w;
+   sliceScale = float(CountZ) / std::log(farZ / nearZ);
+   sliceBias = -float(CountZ) * std::log(nearZ) / std::log(farZ / nearZ);
+   for (int32_t k = 0; k <= CountZ; k++) sliceDepths[k] = nearZ * std::pow(farZ / nearZ, float(k) / CountZ);
+   for (std::vector<float>* array : { &froxels.MinX, &froxels.MinY, &froxels.MinZ, &froxels.MaxX, &froxels.MaxY, &froxels.MaxZ,
+      &froxels.CenterX, &froxels.CenterY, &froxels.CenterZ, &froxels.Radius })
+   {
+      array->resize(Count);
+   }
+   for (int32_t k = 0; k < CountZ; k++)
+   {
+      float z0 = sliceDepths[k], z1 = sliceDepths[k + 1];
+      for (int32_t j = 0; j < CountY; j++)
+      {
+         // Tile row 0 is the top one, at NDC y = 1.
+         float ndcY0 = 1 - 2 * float(j + 1) / CountY, ndcY1 = 1 - 2 * float(j) / CountY;
+         for (int32_t i = 0; i < CountX; i++)
+         {
+            float ndcX0 = -1 + 2 * float(i) / CountX, ndcX1 = -1 + 2 * float(i + 1) / CountX;
+            int32_t index = (k * CountY + j) * CountX + i;
+            // View-space x is ndcX * z / P00, so the extremes are at either depth.
+            froxels.MinX[index] = std::min(ndcX0 * z0, ndcX0 * z1) / p00;
+            froxels.MaxX[index] = std::max(ndcX1 * z0, ndcX1 * z1) / p00;
+            froxels.MinY[index] = std::min(ndcY0 * z0, ndcY0 * z1) / p11;
+            froxels.MaxY[index] = std::max(ndcY1 * z0, ndcY1 * z1) / p11;
+            froxels.MinZ[index] = z0;
+            froxels.MaxZ[index] = z1;
+            float halfX = (froxels.MaxX[index] - froxels.MinX[index]) * 0.5f;
+            float halfY = (froxels.MaxY[index] - froxels.MinY[index]) * 0.5f;
+            float halfZ = (z1 - z0) * 0.5f;
+            froxels.CenterX[index] = froxels.MinX[index] + halfX;
+            froxels.CenterY[index] = froxels.MinY[index] + halfY;
+            froxels.CenterZ[index] = z0 + halfZ;
+            froxels.Radius[index] = std::sqrt(halfX * halfX + halfY * halfY + halfZ * halfZ);
+         }
+      }
+   }
+}
+
+void LightClusters::AssignSlices(int32_t firstSlice, int32_t endSlice)
+{
+   float p00 = projectionParams.x, p11 = projectionParams.y;
+   XMVECTOR zero = XMVectorZero();
+   int32_t count = int32_t(viewLights.size());
+   for (int32_t k = firstSlice; k < endSlice; k++)
+   {
+      float sliceNear = sliceDepths[k], sliceFar = sliceDepths[k + 1];
+      uint8_t* sliceHits = sliceLightHits.data() + size_t(k) * count;
+      for (int32_t l = 0; l < count; l++)
+      {
+         const ViewLight& light = viewLights[l];
+         if (k < light.FirstSlice || k > light.LastSlice) continue;
+         // The light's box within the slice. Its extreme x / z and y / z slopes bound the tiles it covers.
+         float r = light.Range;
+         float z0 = std::max(light.Position.z - r, sliceNear), z1 = std::min(light.Position.z + r, sliceFar);
+         if (z0 > z1) continue;
+         float x0 = light.Position.x - r, x1 = light.Position.x + r, y0 = light.Position.y - r, y1 = light.Position.y + r;
+         float minSlopeX = x0 / (x0 < 0 ? z0 : z1), maxSlopeX = x1 / (x1 > 0 ? z0 : z1);
+         float minSlopeY = y0 / (y0 < 0 ? z0 : z1), maxSlopeY = y1 / (y1 > 0 ? z0 : z1);
+         int32_t i0 = FloorToInt((minSlopeX * p00 + 1) * 0.5f * CountX), i1 = FloorToInt((maxSlopeX * p00 + 1) * 0.5f * CountX);
+         int32_t j0 = FloorToInt((1 - maxSlopeY * p11) * 0.5f * CountY), j1 = FloorToInt((1 - minSlopeY * p11) * 0.5f * CountY);
+         if (i1 < 0 || i0 >= CountX || j1 < 0 || j0 >= CountY) continue;
+         i0 = std::max(i0, 0);
+         i1 = std::min(i1, CountX - 1);
+         j0 = std::max(j0, 0);
+         j1 = std::min(j1, CountY - 1);
+         uint32_t columns = ((2u << i1) - 1) & ~((1u << i0) - 1);
+         // Boxes of a slice share their x bounds by column and their y bounds by row, so the sphere test separates:
+         // the squared x distances of the columns 4 at a time, then one y distance per row.
+         int32_t sliceBase = k * CountY * CountX;
+         XMVECTOR centerX = XMVectorReplicate(light.Position.x);
+         XMFLOAT4A columnDistanceSq[CountX / 4];
+         for (int32_t i = i0 & ~3; i <= i1; i += 4)
+         {
+            XMVECTOR dx = XMVectorAdd(XMVectorMax(XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)&froxels.MinX[sliceBase + i]), centerX), zero),
+               XMVectorMax(XMVectorSubtract(centerX, XMLoadFloat4((const XMFLOAT4*)&froxels.MaxX[sliceBase + i])), zero));
+            XMStoreFloat4A(&columnDistanceSq[i / 4], XMVectorMultiply(dx, dx));
+         }
+         float dz = std::max(sliceNear - light.Position.z, 0.f) + std::max(light.Position.z - sliceFar, 0.f);
+         bool isSpot = light.SpotSin > 0;
+         XMVECTOR centerY = XMVectorReplicate(light.Position.y), centerZ = XMVectorReplicate(light.Position.z);
+         XMVECTOR directionX = XMVectorReplicate(light.Direction.x), directionY = XMVectorReplicate(light.Direction.y);
+         XMVECTOR directionZ = XMVectorReplicate(light.Direction.z);
+         XMVECTOR spotCos = XMVectorReplicate(light.SpotCos), spotSin = XMVectorReplicate(light.SpotSin), range = XMVectorReplicate(r);
+         for (int32_t j = j0; j <= j1; j++)
+         {
+            int32_t rowBase = sliceBase + j * CountX;
+            float dy = std::max(froxels.MinY[rowBase] - light.Position.y, 0.f) + std::max(light.Position.y - froxels.MaxY[rowBase], 0.f);
+            float remainingSq = r * r - dy * dy - dz * dz;
+            if (remainingSq < 0) continue;
+            XMVECTOR rowRangeSq = XMVectorReplicate(remainingSq);
+            // Hits of the row as bits, so lists are appended without a branch per froxel.
+            uint32_t rowHits = 0;
+            for (int32_t i = i0 & ~3; i <= i1; i += 4)
+            {
+               int32_t index = rowBase + i;
+               XMVECTOR hit = XMVectorLessOrEqual(XMLoadFloat4A(&columnDistanceSq[i / 4]), rowRangeSq);
+               if (isSpot)
+               {
+                  // Cone against the froxel's bounding sphere: culled if the sphere is off the cone's side, beyond its range or behind it.
+                  XMVECTOR radius = XMLoadFloat4((const XMFLOAT4*)&froxels.Radius[index]);
+                  XMVECTOR vx = XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)&froxels.CenterX[index]), centerX);
+                  XMVECTOR vy = XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)&froxels.CenterY[index]), centerY);
+                  XMVECTOR vz = XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)&froxels.CenterZ[index]), centerZ);
+                  XMVECTOR lengthSq = XMVectorMultiplyAdd(vz, vz, XMVectorMultiplyAdd(vy, vy, XMVectorMultiply(vx, vx)));
+                  XMVECTOR axial = XMVectorMultiplyAdd(vz, directionZ, XMVectorMultiplyAdd(vy, directionY, XMVectorMultiply(vx, directionX)));
+                  XMVECTOR lateral = XMVectorSqrt(XMVectorMax(XMVectorNegativeMultiplySubtract(axial, axial, lengthSq), zero));
+                  XMVECTOR closest = XMVectorNegativeMultiplySubtract(axial, spotSin, XMVectorMultiply(spotCos, lateral));
+                  XMVECTOR culled = XMVectorOrInt(XMVectorGreater(closest, radius), XMVectorGreater(axial, XMVectorAdd(radius, range)));
+                  culled = XMVectorOrInt(culled, XMVectorLess(axial, XMVectorNegate(radius)));
+                  hit = XMVectorAndCInt(hit, culled);
+               }
+               rowHits |= LaneMask(hit) << i;
+            }
+            rowHits &= columns;
+            sliceHits[l] |= uint8_t(rowHits != 0);
+            while (rowHits)
+            {
+               int32_t cluster = rowBase + std::countr_zero(rowHits);
+               uint32_t& lightCount = clusterCounts[cluster];
+               clusterLights[cluster * ClusterCapacity + std::min(lightCount, uint32_t(MaxClusterLights))] = uint16_t(l);
+               lightCount++;
+               rowHits &= rowHits - 1;
+            }
+         }
+      }
+   }
+}
+
+void LightClusters::Finish()
+{
+   uint32_t offset = 0;
+   maxClusterLightCount = 0;
+   droppedLightCount = 0;
+   for (int32_t i = 0; i < Count; i++)
+   {
+      uint32_t lightCount = std::min(clusterCounts[i], uint32_t(MaxClusterLights));
+      clusters[i] = LightCluster{ offset, lightCount };
+      offset += lightCount;
+      maxClusterLightCount = std::max(maxClusterLightCount, int32_t(lightCount));
+      droppedLightCount += int32_t(clusterCounts[i] - lightCount);
+   }
+   lightIndices.resize(offset);
+   for (int32_t i = 0; i < Count; i++)
+   {
+      const uint16_t* list = &clusterLights[i * ClusterCapacity];
+      std::copy(list, list + clusters[i].Count, lightIndices.begin() + clusters[i].Offset);
+   }
+   size_t lightCount = viewLights.size();
+   isLightVisible.assign(lightCount, 0);
+   for (int32_t k = 0; k < CountZ; k++)
+   {
+      const uint8_t* sliceHits = sliceLightHits.data() + k * lightCount;
+      for (size_t l = 0; l < lightCount; l++) isLightVisible[l] |= sliceHits[l];
+   }
+   visibleLightCount = int32_t(std::count(isLightVisible.begin(), isLightVisible.end(), uint8_t(1)));
+}
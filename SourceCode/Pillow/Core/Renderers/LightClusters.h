@@ -0,0 +1,99 @@
+#pragma once
+#include <vector>
+#include "../Auxiliaries.h"
+
+using namespace DirectX;
+
+namespace Pillow::Graphics
+{
+   // Uploaded as is, so shaders read the same layout.
+   struct Light
+   {
+      XMFLOAT3 Position;  // World space.
+      float Range;
+      XMFLOAT3 Direction; // World space and normalized, spot lights only.
+      float SpotAngle;    // Half of the cone's angle in radians, 0 for point lights. Angles from pi / 2 on are taken as point lights.
+      XMFLOAT3 Color;
+      float Intensity;
+   };
+   static_assert(sizeof(Light) == 48, "Lights are uploaded as raw memory.");
+
+   // A cluster's lights are LightIndices[Offset, Offset + Count).
+   struct LightCluster
+   {
+      uint32_t Offset;
+      uint32_t Count;
+   };
+
+   // Assigns lights to clusters, the froxels of the view frustum: CountX x CountY screen tiles, and CountZ depth slices.
+   // Slices are spaced exponentially from the near plane to the far plane, so froxels are about as deep as they are wide.
+   // A shader finds its slice as floor(log(viewZ) * SliceScale + SliceBias), see GetSliceScaleBias(). Tile row 0 is the top one.
+   //
+   // 1.Begin() moves the lights into view space, and finds the slices each one may touch.
+   // 2.AssignSlices() visits the lights of each slice. A light's view-space box is projected to a rectangle of tiles,
+   // then the froxels in it are tested 4 at a time: spheres against froxel boxes, and cones against froxel bounding spheres.
+   // Slices are independent, so threads may assign any ranges of them. The range [firstSlice, endSlice) excludes endSlice.
+   // 3.Finish() packs the per-cluster lists into one index list.
+   class LightClusters
+   {
+   public:
+      static const int32_t CountX = 16, CountY = 9, CountZ = 24;
+      static const int32_t Count = CountX * CountY * CountZ;
+      // Lists are fixed slots of 16-bit light indices. Lights beyond a cluster's slots are dropped from it, see GetDroppedLightCount().
+      static const int32_t MaxLights = 1 << 16;
+      static const int32_t MaxClusterLights = 255;
+
+      // "projection" must be a perspective one without other transforms. Froxel bounds are rebuilt only when it changes.
+      // "lights" may hold at most MaxLights.
+      void Begin(const std::vector<Light>& lights, FXMMATRIX view, CXMMATRIX projection);
+      void AssignSlices(int32_t firstSlice, int32_t endSlice);
+      void Finish();
+
+      // Indexed by (slice * CountY + tileY) * CountX + tileX.
+      ForceInline const std::vector<LightCluster>& GetClusters() const { return clusters; }
+      ForceInline const std::vector<uint32_t>& GetLightIndices() const { return lightIndices; }
+      ForceInline XMFLOAT2 GetSliceScaleBias() const { return XMFLOAT2(sliceScale, sliceBias); }
+      // Lights in at least one cluster.
+      ForceInline int32_t GetVisibleLightCount() const { return visibleLightCount; }
+      ForceInline int32_t GetMaxClusterLightCount() const { return maxClusterLightCount; }
+      // Cluster entries beyond MaxClusterLights.
+      ForceInline int32_t GetDroppedLightCount() const { return droppedLightCount; }
+
+   private:
+      void BuildFroxels();
+
+      // Froxels as a structure of arrays, so a row of them is CountX / 4 SIMD loads.
+      struct FroxelArray
+      {
+         std::vector<float> MinX, MinY, MinZ, MaxX, MaxY, MaxZ;
+         std::vector<float> CenterX, CenterY, CenterZ, Radius; // Bounding spheres.
+      };
+
+      // A light in view space, with the range of slices its box overlaps.
+      struct ViewLight
+      {
+         XMFLOAT3 Position;
+         float Range;
+         XMFLOAT3 Direction;
+         float SpotCos, SpotSin; // 1 and 0 for point lights.
+         int32_t FirstSlice, LastSlice; // Inclusive, FirstSlice > LastSlice if the light is out of the depth range.
+      };
+
+      XMFLOAT4 projectionParams{}; // P00, P11, near, far of the froxels built.
+      float sliceScale = 0, sliceBias = 0;
+      std::vector<float> sliceDepths = std::vector<float>(CountZ + 1);
+      FroxelArray froxels;
+      std::vector<ViewLight> viewLights;
+      // ClusterCapacity slots per cluster, the last one takes the lights beyond MaxClusterLights, so appending needs no branch.
+      static const int32_t ClusterCapacity = MaxClusterLights + 1;
+      std::vector<uint16_t> clusterLights = std::vector<uint16_t>(Count * ClusterCapacity);
+      std::vector<uint32_t> clusterCounts = std::vector<uint32_t>(Count); // Lights hit, may be beyond MaxClusterLights.
+      std::vector<LightCluster> clusters = std::vector<LightCluster>(Count);
+      std::vector<uint32_t> lightIndices;
+      std::vector<uint8_t> sliceLightHits; // CountZ rows of a flag per light, so slices don't share what they write.
+      std::vector<uint8_t> isLightVisible;
+      int32_t visibleLightCount = 0;
+      int32_t maxClusterLightCount = 0;
+      int32_t droppedLightCount = 0;
+   };
+}
@@ -0,0 +1,178 @@
+#include "Renderer.h"
+#include "ResourceTable.h"
+#include <queue>
+#include <chrono>
+
+using namespace Pillow;
+using namespace std::chrono;
+
+// Static variables
+namespace
+{
+   class FenceSync;
+   std::unique_ptr<FenceSync> fenceSync;
+
+   steady_clock::duration gpuFrameTime;
+   int32_t verticalBlanks;
+   steady_clock::time_point gpuIdlePoint; // When the fake GPU finishes all submitted work.
+   std::atomic<uint64_t> decodedDraws; // Keeps the decoding in Record() from being optimized away.
+
+   // One table per ResourceType, indexed by (type >> 28) - 1. There is nothing to store, so slots are just bytes.
+   const int32_t ResourceTypeCount = 4;
+   std::unique_ptr<ResourceTable<uint8_t>> resourceTables[ResourceTypeCount];
+
+   ResourceTable<uint8_t>& GetResourceTable(ResourceType type)
+   {
+      uint32_t slot = (uint32_t(type) >> 28) - 1;
+      if (slot >= ResourceTypeCount) throw std::runtime_error("Invalid resource type.");
+      return *resourceTables[slot];
+   }
+}
+
+// Types
+namespace
+{
+   // The same interface as the D3D12 fence synchronization wrapper, but the "GPU" is a timeline.
+   // A signaled value completes when the steady clock passes its completion point.
+   class FenceSync
+   {
+      ReadonlyProperty(uint64_t, FrameIndex)
+
+   public:
+      uint64_t GetTargetFence() { return f_FrameIndex + 1; }
+      int32_t GetFrameArrayIdx() { return f_FrameIndex % Constants::SwapChainSize; }
+
+      uint64_t GetCompletedFence()
+      {
+         auto now = steady_clock::now();
+         while (!pending.empty() && pending.front().completionPoint <= now)
+         {
+            completedFence = pending.front().fence;
+            pending.pop();
+         }
+         return completedFence;
+      }
+
+      // Get the next frame, and let at most "framesInFlight" submitted frames remain on the fake GPU.
+      // ***WARNING***
+      // Invoke this AFTER the fake GPU work of current frame is scheduled.
+      void NextFrame(steady_clock::time_point completionPoint, int32_t framesInFlight)
+      {
+         f_FrameIndex++;
+         pending.push(Item{ f_FrameIndex, completionPoint });
+         framesInFlight = std::clamp(framesInFlight, 1, Constants::SwapChainSize);
+         uint64_t minFence = (f_FrameIndex < uint64_t(framesInFlight)) ? 0 : (f_FrameIndex - framesInFlight + 1);
+         Synchronize(minFence);
+      }
+
+      // Get all fake GPU work done.
+      void FlushQueue()
+      {
+         Synchronize(f_FrameIndex);
+      }
+
+   private:
+      void Synchronize(uint64_t targetFence)
+      {
+         while (GetCompletedFence() < targetFence)
+         {
+            // FIFO, the front item completes first.
+            std::this_thread::sleep_until(pending.front().completionPoint);
+         }
+      }
+
+   private:
+      struct Item
+      {
+         uint64_t fence;
+         steady_clock::time_point completionPoint;
+      };
+
+      std::queue<Item> pending;
+      uint64_t completedFence{};
+   };
+}
+
+NullRenderer::NullRenderer(int32_t threadCount, double gpuLatency, int32_t _verticalBlanks) : GenericRenderer(threadCount, "NullRenderer")
+{
+   SingletonCheck();
+   if (gpuLatency < 0) throw std::runtime_error("The fake GPU latency cannot be negative.");
+   gpuFrameTime = duration_cast<steady_clock::duration>(duration<double, std::milli>(gpuLatency));
+   verticalBlanks = _verticalBlanks;
+   gpuIdlePoint = steady_clock::now();
+   fenceSync = std::make_unique<FenceSync>();
+   for (int32_t i = 0; i < ResourceTypeCount; i++)
+   {
+      resourceTables[i] = std::make_unique<ResourceTable<uint8_t>>(ResourceType(uint32_t(i + 1) << 28), Constants::MaxResourcesPerType);
+   }
+}
+
+NullRenderer::~NullRenderer()
+{
+   if (fenceSync) fenceSync->FlushQueue();
+   fenceSync.reset();
+}
+
+uint64_t NullRenderer::GetFrameIndex()
+{
+   return fenceSync->GetFrameIndex();
+}
+
+ResourceHandle NullRenderer::CreateResource(ResourceType type)
+{
+   return GetResourceTable(type).Create(1);
+}
+
+void NullRenderer::ReleaseResource(uint32_t handle)
+{
+   GetResourceTable(GetResourceType(handle)).Release(handle);
+}
+
+void NullRenderer::Record(int32_t, const RecordChunk& chunk)
+{
+   // Decode streams that aren't cached like a backend translating them, so headless benchmarks include the decoding.
+   if (chunk.ChunkType != RecordChunk::Drawcalls || IsCommandStreamCached(chunk.Index)) return;
+   CommandReader reader(GetCommandStream(chunk.Index));
+   Command command;
+   uint64_t draws = 0;
+   int32_t barriers = 0, batches = 0;
+   bool isBatching = false;
+   while (reader.Next(command))
+   {
+      draws += command.Type == CommandType::Draw;
+      // Consecutive barriers are issued together, like D3D12's state tracker does.
+      bool isBarrier = command.Type == CommandType::Barrier;
+      barriers += isBarrier;
+      batches += isBarrier && !isBatching;
+      isBatching = isBarrier;
+   }
+   decodedDraws.fetch_add(draws, std::memory_order::relaxed);
+   if (barriers > 0) CountBarriers(barriers, batches);
+}
+
+void NullRenderer::Pioneer()
+{
+}
+
+void NullRenderer::Assembler()
+{
+   // "Execute" the frame: the fake GPU picks it up once it finishes the previous ones. Its time follows the rendered pixels.
+   float scale = GetRenderScale();
+   auto frameTime = duration_cast<steady_clock::duration>(gpuFrameTime * (double(scale) * scale));
+   gpuIdlePoint = std::max(gpuIdlePoint, steady_clock::now()) + frameTime;
+   ReportGPUFrameTime(duration<double, std::milli>(frameTime).count());
+   MarkFrameStage(FrameStage::ExecuteEnd);
+   // "Present": with V-Sync, the frame is flipped at the next vertical blank.
+   if (verticalBlanks > 0 && RefreshRate > 0)
+   {
+      auto interval = duration_cast<steady_clock::duration>(duration<double>(double(verticalBlanks) / RefreshRate));
+      gpuIdlePoint = steady_clock::time_point((gpuIdlePoint.time_since_epoch() / interval + 1) * interval);
+   }
+   MarkFrameStage(FrameStage::PresentEnd);
+   fenceSync->NextFrame(gpuIdlePoint, GetFramesInFlight());
+   MarkFrameStage(FrameStage::SyncEnd);
+   // The game may be ticking concurrently, so handles released so far may still be used by the next frame.
+   uint64_t pendingFence = fenceSync->GetTargetFence();
+   uint64_t completedFence = fenceSync->GetCompletedFence();
+   for (auto& table : resourceTables) table->Reclaim(pendingFence, completedFence);
+}
@@ -0,0 +1,176 @@
+#include "Occlusion.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   // Vertices closer than this (in clip space w) are treated as crossing the near plane.
+   const float MinClipW = 1e-3f;
+
+   // Clip space to the buffer's pixels, y points down. Returns false if the point crosses the near plane.
+   ForceInline bool ProjectToScreen(FXMVECTOR position, FXMMATRIX viewProjection, XMFLOAT3& screen)
+   {
+      XMFLOAT4 clip;
+      XMStoreFloat4(&clip, XMVector3Transform(position, viewProjection));
+      if (clip.w < MinClipW) return false;
+      screen.x = (clip.x / clip.w * 0.5f + 0.5f) * OcclusionBuffer::Width;
+      screen.y = (0.5f - clip.y / clip.w * 0.5f) * OcclusionBuffer::Height;
+      screen.z = clip.z / clip.w;
+      return true;
+   }
+}
+
+void OcclusionBuffer::Begin(const std::vector<XMFLOAT3>& _vertices, FXMMATRIX _viewProjection)
+{
+   vertices = &_vertices;
+   XMStoreFloat4x4(&viewProjection, _viewProjection);
+   triangles.resize(_vertices.size() / 3);
+}
+
+void OcclusionBuffer::SetupTriangles(int32_t begin, int32_t end)
+{
+   XMMATRIX matrix = XMLoadFloat4x4(&viewProjection);
+   for (int32_t t = begin; t < end; t++)
+   {
+      TriangleSetup& triangle = triangles[t];
+      triangle.MinX = -1;
+      XMFLOAT3 s[3];
+      if (!ProjectToScreen(XMLoadFloat3(&(*vertices)[t * 3]), matrix, s[0]) ||
+         !ProjectToScreen(XMLoadFloat3(&(*vertices)[t * 3 + 1]), matrix, s[1]) ||
+         !ProjectToScreen(XMLoadFloat3(&(*vertices)[t * 3 + 2]), matrix, s[2])) continue;
+      float area = (s[1].x - s[0].x) * (s[2].y - s[0].y) - (s[2].x - s[0].x) * (s[1].y - s[0].y);
+      if (std::abs(area) < FLT_EPSILON) continue;
+      // Pixels are sampled at their centers.
+      int32_t minX = std::max(int32_t(std::ceil(std::min({ s[0].x, s[1].x, s[2].x }) - 0.5f)), 0);
+      int32_t maxX = std::min(int32_t(std::floor(std::max({ s[0].x, s[1].x, s[2].x }) - 0.5f)), Width - 1);
+      int32_t minY = std::max(int32_t(std::ceil(std::min({ s[0].y, s[1].y, s[2].y }) - 0.5f)), 0);
+      int32_t maxY = std::min(int32_t(std::floor(std::max({ s[0].y, s[1].y, s[2].y }) - 0.5f)), Height - 1);
+      if (minX > maxX || minY > maxY) continue;
+      for (int32_t k = 0; k < 3; k++)
+      {
+         const XMFLOAT3& a = s[k];
+         const XMFLOAT3& b = s[(k + 1) % 3];
+         const XMFLOAT3& c = s[(k + 2) % 3];
+         float edgeA = a.y - b.y, edgeB = b.x - a.x, edgeC = a.x * b.y - a.y * b.x;
+         // Either winding, the opposite vertex is inside.
+         float sign = edgeA * c.x + edgeB * c.y + edgeC < 0 ? -1.f : 1.f;
+         triangle.A[k] = edgeA * sign;
+         triangle.B[k] = edgeB * sign;
+         triangle.C[k] = edgeC * sign;
+      }
+      triangle.ZA = ((s[1].z - s[0].z) * (s[2].y - s[0].y) - (s[2].z - s[0].z) * (s[1].y - s[0].y)) / area;
+      triangle.ZB = ((s[1].x - s[0].x) * (s[2].z - s[0].z) - (s[2].x - s[0].x) * (s[1].z - s[0].z)) / area;
+      triangle.ZC = s[0].z - triangle.ZA * s[0].x - triangle.ZB * s[0].y;
+      triangle.MinX = minX;
+      triangle.MaxX = maxX;
+      triangle.MinY = minY;
+      triangle.MaxY = maxY;
+   }
+}
+
+void OcclusionBuffer::Rasterize(int32_t firstRow, int32_t lastRow)
+{
+   std::fill(depth.begin() + firstRow * Width, depth.begin() + lastRow * Width, 1.f);
+   const XMVECTOR offsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+   const XMVECTOR zero = XMVectorZero();
+   const XMVECTOR one = XMVectorSplatOne();
+   for (const TriangleSetup& triangle : triangles)
+   {
+      if (triangle.MinX < 0) continue;
+      int32_t y0 = std::max(triangle.MinY, firstRow);
+      int32_t y1 = std::min(triangle.MaxY, lastRow - 1);
+      if (y0 > y1) continue;
+      XMVECTOR a0 = XMVectorReplicate(triangle.A[0]);
+      XMVECTOR a1 = XMVectorReplicate(triangle.A[1]);
+      XMVECTOR a2 = XMVectorReplicate(triangle.A[2]);
+      XMVECTOR za = XMVectorReplicate(triangle.ZA);
+      // Width is a multiple of 4, so aligned groups of 4 pixels never cross a row.
+      int32_t x0 = triangle.MinX & ~3;
+      for (int32_t y = y0; y <= y1; y++)
+      {
+         float py = float(y) + 0.5f;
+         XMVECTOR e0Row = XMVectorReplicate(triangle.B[0] * py + triangle.C[0]);
+         XMVECTOR e1Row = XMVectorReplicate(triangle.B[1] * py + triangle.C[1]);
+         XMVECTOR e2Row = XMVectorReplicate(triangle.B[2] * py + triangle.C[2]);
+         XMVECTOR zRow = XMVectorReplicate(triangle.ZB * py + triangle.ZC);
+         float* row = &depth[y * Width];
+         for (int32_t x = x0; x <= triangle.MaxX; x += 4)
+         {
+            XMVECTOR px = XMVectorAdd(XMVectorReplicate(float(x)), offsets);
+            XMVECTOR inside = XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a0, px, e0Row), zero);
+            inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a1, px, e1Row), zero));
+            inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(a2, px, e2Row), zero));
+            XMVECTOR z = XMVectorClamp(XMVectorMultiplyAdd(za, px, zRow), zero, one);
+            XMVECTOR current = XMLoadFloat4((const XMFLOAT4*)&row[x]);
+            XMStoreFloat4((XMFLOAT4*)&row[x], XMVectorSelect(current, XMVectorMin(current, z), inside));
+         }
+      }
+   }
+   // Each tile keeps its farthest depth, so anything behind it is behind every pixel of it.
+   for (int32_t tileY = firstRow / TileSize; tileY < lastRow / TileSize; tileY++)
+   {
+      for (int32_t tileX = 0; tileX < TileCountX; tileX++)
+      {
+         float farthest = 0;
+         for (int32_t y = tileY * TileSize; y < (tileY + 1) * TileSize; y++)
+         {
+            const float* row = &depth[y * Width + tileX * TileSize];
+            for (int32_t x = 0; x < TileSize; x++) farthest = std::max(farthest, row[x]);
+         }
+         tileDepth[tileY * TileCountX + tileX] = farthest;
+      }
+   }
+}
+
+void OcclusionBuffer::TestOccludees(const BoundsArray& bounds, int32_t begin, int32_t end, uint8_t* visibility) const
+{
+   XMMATRIX matrix = XMLoadFloat4x4(&viewProjection);
+   for (int32_t i = begin; i < end; i++)
+   {
+      if (!visibility[i]) continue;
+      // The projection is linear before the division, so corners are the clip-space center plus or minus the clip-space axes.
+      XMVECTOR center = XMVector3Transform(XMVectorSet(bounds.CenterX[i], bounds.CenterY[i], bounds.CenterZ[i], 1), matrix);
+      XMVECTOR axisX = XMVectorScale(matrix.r[0], bounds.ExtentX[i]);
+      XMVECTOR axisY = XMVectorScale(matrix.r[1], bounds.ExtentY[i]);
+      XMVECTOR axisZ = XMVectorScale(matrix.r[2], bounds.ExtentZ[i]);
+      // Boxes crossing the near plane surround the camera, they are always visible.
+      XMVECTOR nearestW = XMVectorSubtract(center, XMVectorAdd(XMVectorAdd(XMVectorAbs(axisX), XMVectorAbs(axisY)), XMVectorAbs(axisZ)));
+      if (XMVectorGetW(nearestW) < MinClipW) continue;
+      XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+      XMVECTOR maximum = XMVectorReplicate(-FLT_MAX);
+      for (int32_t corner = 0; corner < 8; corner++)
+      {
+         XMVECTOR clip = center;
+         clip = corner & 1 ? XMVectorAdd(clip, axisX) : XMVectorSubtract(clip, axisX);
+         clip = corner & 2 ? XMVectorAdd(clip, axisY) : XMVectorSubtract(clip, axisY);
+         clip = corner & 4 ? XMVectorAdd(clip, axisZ) : XMVectorSubtract(clip, axisZ);
+         XMVECTOR ndc = XMVectorDivide(clip, XMVectorSplatW(clip));
+         minimum = XMVectorMin(minimum, ndc);
+         maximum = XMVectorMax(maximum, ndc);
+      }
+      XMFLOAT3 ndcMin, ndcMax;
+      XMStoreFloat3(&ndcMin, minimum);
+      XMStoreFloat3(&ndcMax, maximum);
+      // NDC to pixels, y points down.
+      float minX = (ndcMin.x * 0.5f + 0.5f) * Width, maxX = (ndcMax.x * 0.5f + 0.5f) * Width;
+      float minY = (0.5f - ndcMax.y * 0.5f) * Height, maxY = (0.5f - ndcMin.y * 0.5f) * Height;
+      // The frustum has culled boxes off screen.
+      if (maxX < 0 || maxY < 0 || minX >= Width || minY >= Height) continue;
+      // Clamp before converting, huge boxes near the camera can overflow an integer.
+      int32_t tileX0 = int32_t(std::max(minX, 0.f)) / TileSize, tileX1 = int32_t(std::min(maxX, Width - 1.f)) / TileSize;
+      int32_t tileY0 = int32_t(std::max(minY, 0.f)) / TileSize, tileY1 = int32_t(std::min(maxY, Height - 1.f)) / TileSize;
+      bool occluded = true;
+      for (int32_t tileY = tileY0; tileY <= tileY1 && occluded; tileY++)
+      {
+         for (int32_t tileX = tileX0; tileX <= tileX1 && occluded; tileX++)
+         {
+            occluded = ndcMin.z > tileDepth[tileY * TileCountX + tileX];
+         }
+      }
+      if (occluded) visibility[i] = 0;
+   }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include "../Auxiliaries.h"
+#include "Culling.h"
+
+using namespace DirectX;
+
+namespace Pillow::Graphics
+{
+   // A CPU occlusion culler for devices where GPU queries are too slow or missing.
+   //
+   // 1.Occluder triangles are rasterized into a low-resolution depth buffer, 4 pixels at a time.
+   // The buffer is split into bands of TileSize rows, and each band is rasterized by one thread. Threads never share
+   // pixels, so the result is the same for any thread count and order.
+   // 2.Each tile keeps the farthest occluder depth over its pixels (a one-level hierarchical Z).
+   // 3.An occludee's box is projected to a screen rectangle and its nearest depth. It's occluded if that depth is
+   // farther than every tile it covers.
+   //
+   // Depth follows D3D: 0 is the near plane, 1 is the far plane.
+   class OcclusionBuffer
+   {
+   public:
+      static const int32_t Width = 256, Height = 128, TileSize = 8;
+      static const int32_t TileCountX = Width / TileSize, TileCountY = Height / TileSize;
+
+      // Clear the buffer and prepare the setup storage for the triangle list "vertices" (3 vertices per triangle).
+      void Begin(const std::vector<XMFLOAT3>& vertices, FXMMATRIX viewProjection);
+      // Project and set up triangles in [begin, end). Triangles crossing the near plane are dropped, which is conservative.
+      void SetupTriangles(int32_t begin, int32_t end);
+      // Rasterize all triangles into the rows [firstRow, lastRow), which must be multiples of TileSize, then build their tiles.
+      void Rasterize(int32_t firstRow, int32_t lastRow);
+      // Clear visibility[i] of occluded items in [begin, end). Items already invisible are skipped.
+      void TestOccludees(const BoundsArray& bounds, int32_t begin, int32_t end, uint8_t* visibility) const;
+
+      ForceInline int32_t GetTriangleCount() const { return int32_t(triangles.size()); }
+
+   private:
+      // Edges are "A * x + B * y + C", positive inside. Depth is "ZA * x + ZB * y + ZC".
+      struct TriangleSetup
+      {
+         float A[3], B[3], C[3];
+         float ZA, ZB, ZC;
+         int32_t MinX, MaxX, MinY, MaxY; // Inclusive pixel bounds, MinX < 0 if the triangle is dropped.
+      };
+
+      const std::vector<XMFLOAT3>* vertices = nullptr;
+      XMFLOAT4X4 viewProjection{};
+      std::vector<TriangleSetup> triangles;
+      std::vector<float> depth = std::vector<float>(Width * Height);
+      std::vector<float> tileDepth = std::vector<float>(TileCountX * TileCountY);
+   };
+}
@@ -0,0 +1,221 @@
+#include "RenderGraph.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   const TransientPlacement Unplaced{ -1, 0 };
+}
+
+void RenderGraph::Reset()
+{
+   passes.clear();
+   resources.clear();
+   compiledPasses.clear();
+   finalBarriers.clear();
+   placements.clear();
+   stats = RenderGraphStats{};
+   isCompiled = false;
+}
+
+int32_t RenderGraph::ImportResource(const string& name, ResourceState initialState, ResourceState finalState, bool output)
+{
+   isCompiled = false;
+   resources.push_back(Resource{ name, false, output, initialState, finalState, 0 });
+   return int32_t(resources.size()) - 1;
+}
+
+int32_t RenderGraph::CreateTexture(const string& name, const TransientTextureDesc& desc)
+{
+   if (desc.Width <= 0 || desc.Height <= 0 || desc.PixelSize <= 0 || desc.Samples <= 0) throw std::runtime_error("Invalid transient texture.");
+   isCompiled = false;
+   int64_t size = desc.Size > 0 ? desc.Size : int64_t(desc.Width) * desc.Height * desc.PixelSize * desc.Samples;
+   size = (size + PlacementAlignment - 1) / PlacementAlignment * PlacementAlignment;
+   resources.push_back(Resource{ name, true, false, ResourceState::Common, ResourceState::Common, size });
+   return int32_t(resources.size()) - 1;
+}
+
+int32_t RenderGraph::AddPass(const string& name, bool sideEffects)
+{
+   isCompiled = false;
+   passes.push_back(Pass{ name, sideEffects, {} });
+   return int32_t(passes.size()) - 1;
+}
+
+void RenderGraph::Read(int32_t pass, int32_t resource, ResourceState state)
+{
+   Declare(pass, resource, state, false, false);
+}
+
+void RenderGraph::Write(int32_t pass, int32_t resource, ResourceState state, bool discard)
+{
+   Declare(pass, resource, state, true, discard);
+}
+
+void RenderGraph::Declare(int32_t pass, int32_t resource, ResourceState state, bool isWrite, bool discards)
+{
+   if (pass < 0 || pass >= int32_t(passes.size())) throw std::runtime_error("Invalid render graph pass.");
+   if (resource < 0 || resource >= int32_t(resources.size())) throw std::runtime_error("Invalid render graph resource.");
+   isCompiled = false;
+   for (Access& access : passes[pass].Accesses)
+   {
+      if (access.Resource != resource) continue;
+      if (access.State != state)
+      {
+         throw std::runtime_error("Render graph pass \"" + passes[pass].Name + "\" uses \"" + resources[resource].Name + "\" in two states.");
+      }
+      // A pass reading what it writes needs the earlier contents.
+      access.Discards = access.Discards && isWrite && discards;
+      access.IsWrite = access.IsWrite || isWrite;
+      return;
+   }
+   passes[pass].Accesses.push_back(Access{ resource, state, isWrite, discards && isWrite });
+}
+
+void RenderGraph::Compile()
+{
+   auto startPoint = std::chrono::steady_clock::now();
+   int32_t passCount = int32_t(passes.size()), resourceCount = int32_t(resources.size());
+   compiledPasses.clear();
+   finalBarriers.clear();
+   stats = RenderGraphStats{};
+   stats.Passes = passCount;
+   // 1.Culling, backwards.
+   std::vector<uint8_t> isLive(passCount), isNeeded(resourceCount);
+   for (int32_t i = 0; i < resourceCount; i++) isNeeded[i] = resources[i].IsOutput;
+   for (int32_t p = passCount - 1; p >= 0; p--)
+   {
+      const Pass& pass = passes[p];
+      bool live = pass.HasSideEffects;
+      for (const Access& access : pass.Accesses) live = live || (access.IsWrite && isNeeded[access.Resource]);
+      if (!live) continue;
+      isLive[p] = 1;
+      // Reads and partial writes need the earlier contents, discarding writes don't.
+      for (const Access& access : pass.Accesses) isNeeded[access.Resource] = !access.Discards;
+   }
+   // 2.Lifetimes and validation, forwards over the live passes.
+   std::vector<int32_t> firstUse(resourceCount, -1), lastUse(resourceCount, -1);
+   for (int32_t p = 0; p < passCount; p++)
+   {
+      if (!isLive[p])
+      {
+         stats.CulledPasses++;
+         continue;
+      }
+      int32_t order = int32_t(compiledPasses.size());
+      compiledPasses.push_back(CompiledPass{ p, {}, {} });
+      for (const Access& access : passes[p].Accesses)
+      {
+         const Resource& resource = resources[access.Resource];
+         if (resource.IsTransient && firstUse[access.Resource] < 0 && !access.Discards)
+         {
+            throw std::runtime_error("Render graph pass \"" + passes[p].Name + "\" uses transient \"" + resource.Name +
+               "\" before any pass writes all of it.");
+         }
+         if (firstUse[access.Resource] < 0) firstUse[access.Resource] = order;
+         lastUse[access.Resource] = order;
+      }
+   }
+   // 3.Aliasing.
+   PlaceTransients(firstUse, lastUse);
+   // 4.Barriers. Transient resources are created in, or aliased into, the state of their first use.
+   std::vector<ResourceState> states(resourceCount);
+   for (int32_t i = 0; i < resourceCount; i++) states[i] = resources[i].InitialState;
+   for (int32_t order = 0; order < int32_t(compiledPasses.size()); order++)
+   {
+      CompiledPass& compiled = compiledPasses[order];
+      for (const Access& access : passes[compiled.Pass].Accesses)
+      {
+         if (resources[access.Resource].IsTransient && firstUse[access.Resource] == order) states[access.Resource] = access.State;
+         if (states[access.Resource] == access.State) continue;
+         compiled.Barriers.push_back(RenderGraphBarrier{ access.Resource, states[access.Resource], access.State });
+         states[access.Resource] = access.State;
+      }
+      stats.Barriers += int32_t(compiled.Barriers.size());
+   }
+   for (int32_t i = 0; i < resourceCount; i++)
+   {
+      if (resources[i].IsTransient || states[i] == resources[i].FinalState) continue;
+      finalBarriers.push_back(RenderGraphBarrier{ i, states[i], resources[i].FinalState });
+   }
+   stats.Barriers += int32_t(finalBarriers.size());
+   stats.CompileTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startPoint).count();
+   isCompiled = true;
+}
+
+void RenderGraph::PlaceTransients(const std::vector<int32_t>& firstUse, const std::vector<int32_t>& lastUse)
+{
+   int32_t resourceCount = int32_t(resources.size());
+   placements.assign(resourceCount, Unplaced);
+   std::vector<int32_t> order;
+   for (int32_t i = 0; i < resourceCount; i++)
+   {
+      if (!resources[i].IsTransient || firstUse[i] < 0) continue;
+      order.push_back(i);
+      stats.TransientResources++;
+      stats.TransientMemory += resources[i].Size;
+   }
+   // Largest first packs tighter, ties keep the declaration order so the layout is deterministic.
+   std::stable_sort(order.begin(), order.end(), [this](int32_t a, int32_t b) { return resources[a].Size > resources[b].Size; });
+   struct Range
+   {
+      int64_t Begin, End;
+   };
+   std::vector<int32_t> placed;
+   std::vector<Range> occupied;
+   for (int32_t resource : order)
+   {
+      // Ranges of placed resources alive at the same time, the resource goes into the lowest gap between them.
+      occupied.clear();
+      for (int32_t other : placed)
+      {
+         if (firstUse[other] > lastUse[resource] || lastUse[other] < firstUse[resource]) continue;
+         occupied.push_back(Range{ placements[other].Offset, placements[other].Offset + placements[other].Size });
+      }
+      std::sort(occupied.begin(), occupied.end(), [](const Range& a, const Range& b) { return a.Begin < b.Begin; });
+      int64_t size = resources[resource].Size, offset = 0;
+      for (const Range& range : occupied)
+      {
+         if (offset + size <= range.Begin) break;
+         offset = std::max(offset, range.End);
+      }
+      placements[resource] = TransientPlacement{ offset, size };
+      placed.push_back(resource);
+      stats.AliasedTransientMemory = std::max(stats.AliasedTransientMemory, offset + size);
+   }
+   // A resource whose memory an earlier one used needs an aliasing barrier at its first use.
+   for (int32_t resource : placed)
+   {
+      const TransientPlacement& placement = placements[resource];
+      for (int32_t other : placed)
+      {
+         const TransientPlacement& otherPlacement = placements[other];
+         if (lastUse[other] >= firstUse[resource]) continue;
+         if (otherPlacement.Offset >= placement.Offset + placement.Size || placement.Offset >= otherPlacement.Offset + otherPlacement.Size) continue;
+         compiledPasses[firstUse[resource]].Activations.push_back(resource);
+         break;
+      }
+   }
+}
+
+const TransientPlacement& RenderGraph::GetPlacement(int32_t resource) const
+{
+   if (!isCompiled) throw std::runtime_error("The render graph isn't compiled.");
+   if (resource < 0 || resource >= int32_t(resources.size())) throw std::runtime_error("Invalid render graph resource.");
+   return placements[resource];
+}
+
+const string& RenderGraph::GetPassName(int32_t pass) const
+{
+   if (pass < 0 || pass >= int32_t(passes.size())) throw std::runtime_error("Invalid render graph pass.");
+   return passes[pass].Name;
+}
+
+const string& RenderGraph::GetResourceName(int32_t resource) const
+{
+   if (resource < 0 || resource >= int32_t(resources.size())) throw std::runtime_error("Invalid render graph resource.");
+   return resources[resource].Name;
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <vector>
+#include "../Auxiliaries.h"
+#include "CommandStream.h"
+
+namespace Pillow::Graphics
+{
+   // A texture owned by the graph, alive only between its first and last use in a frame.
+   struct TransientTextureDesc
+   {
+      int32_t Width;
+      int32_t Height;
+      int32_t PixelSize; // Bytes per pixel.
+      int32_t Samples = 1;
+      int64_t Size = 0;  // Bytes of heap memory, 0 estimates it from the above. Backends pass what the device reports.
+   };
+
+   struct RenderGraphBarrier
+   {
+      int32_t Resource;
+      ResourceState Before;
+      ResourceState After;
+   };
+
+   // A live pass in execution order, with the barriers to record before it.
+   struct CompiledPass
+   {
+      int32_t Pass;
+      std::vector<RenderGraphBarrier> Barriers;
+      // Transient resources first used here, whose memory was used by others before. They need an aliasing barrier and
+      // must be fully written (cleared or discarded) before they are read.
+      std::vector<int32_t> Activations;
+   };
+
+   struct TransientPlacement
+   {
+      int64_t Offset; // In the transient heap, -1 if the resource is unused after culling.
+      int64_t Size;
+   };
+
+   // Results of the last RenderGraph::Compile(), memory in bytes.
+   struct RenderGraphStats
+   {
+      int32_t Passes;
+      int32_t CulledPasses;
+      int32_t TransientResources; // Used by live passes.
+      int32_t Barriers;
+      int64_t TransientMemory;    // Every transient resource with its own memory.
+      int64_t AliasedTransientMemory; // The heap size when resources never alive together share memory.
+      double CompileTime;         // Milliseconds.
+   };
+
+   // A declarative frame: passes declare the resources they read and write, in the state they need them in.
+   // Compile() is pure CPU logic:
+   // 1.Culling. Walking backwards, a pass is live if it has side effects, or writes an output or something a live pass reads or partly writes.
+   // A discarding write doesn't need the resource's earlier contents, so passes writing it before are not kept alive by it.
+   // 2.Lifetimes. A transient resource lives from its first to its last use by a live pass.
+   // 3.Aliasing. Transient resources are placed into one heap, largest first, at the lowest offset that overlaps nothing
+   // alive at the same time.
+   // 4.Barriers. Each live pass gets the transitions from the states resources were left in.
+   // Passes execute in declaration order, so declare them as the frame runs.
+   class RenderGraph
+   {
+   public:
+      // Heap placement alignment, D3D12's default for textures and buffers.
+      static const int64_t PlacementAlignment = 1 << 16;
+
+      // Remove all passes and resources.
+      void Reset();
+      // An external resource, like a backbuffer. It starts in "initialState" and is returned to "finalState" after the last pass.
+      // output: Passes writing it are live, like the ones drawing a backbuffer.
+      int32_t ImportResource(const string& name, ResourceState initialState, ResourceState finalState, bool output);
+      int32_t CreateTexture(const string& name, const TransientTextureDesc& desc);
+      // sideEffects: The pass is never culled, like readbacks and presents.
+      int32_t AddPass(const string& name, bool sideEffects = false);
+      // Throw if the pass already declared the resource in another state.
+      void Read(int32_t pass, int32_t resource, ResourceState state);
+      // discard: The pass overwrites all of the resource, so its earlier contents are not needed.
+      void Write(int32_t pass, int32_t resource, ResourceState state, bool discard = false);
+      // Throw if a live pass uses a transient resource before a discarding write, its memory may hold another resource's data.
+      void Compile();
+
+      ForceInline const std::vector<CompiledPass>& GetCompiledPasses() const { return compiledPasses; }
+      // Barriers returning imported resources to their final states, recorded after the last pass.
+      ForceInline const std::vector<RenderGraphBarrier>& GetFinalBarriers() const { return finalBarriers; }
+      ForceInline const RenderGraphStats& GetStats() const { return stats; }
+      const TransientPlacement& GetPlacement(int32_t resource) const;
+      const string& GetPassName(int32_t pass) const;
+      const string& GetResourceName(int32_t resource) const;
+      ForceInline bool IsCompiled() const { return isCompiled; }
+
+   private:
+      struct Access
+      {
+         int32_t Resource;
+         ResourceState State;
+         bool IsWrite;
+         bool Discards;
+      };
+
+      struct Pass
+      {
+         string Name;
+         bool HasSideEffects;
+         std::vector<Access> Accesses;
+      };
+
+      struct Resource
+      {
+         string Name;
+         bool IsTransient;
+         bool IsOutput;
+         ResourceState InitialState;
+         ResourceState FinalState;
+         int64_t Size;
+      };
+
+      void Declare(int32_t pass, int32_t resource, ResourceState state, bool isWrite, bool discards);
+      void PlaceTransients(const std::vector<int32_t>& firstUse, const std::vector<int32_t>& lastUse);
+
+      std::vector<Pass> passes;
+      std::vector<Resource> resources;
+      std::vector<CompiledPass> compiledPasses;
+      std::vector<RenderGraphBarrier> finalBarriers;
+      std::vector<TransientPlacement> placements;
+      RenderGraphStats stats{};
+      bool isCompiled = false;
+   };
+}
@@ -0,0 +1,142 @@
+#include "RenderProxy.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+ProxyScene::ProxyScene(int32_t capacity) :
+   writeIndex(0),
+   readIndex(2)
+{
+   middle.store(1);
+   acquisitions.store(0);
+   droppedSnapshots.store(0);
+   for (ProxySnapshot& buffer : buffers)
+   {
+      buffer.Proxies.reserve(capacity);
+      buffer.Sequence = 0;
+   }
+   changedIn.reserve(capacity);
+   copiedIn.reserve(capacity);
+   isAlive.reserve(capacity);
+}
+
+ProxyId ProxyScene::Create(const RenderProxy& proxy)
+{
+   ProxyId id;
+   if (freeIds.empty())
+   {
+      id = ProxyId(isAlive.size());
+      buffers[writeIndex].Proxies.push_back(proxy);
+      changedIn.push_back(0);
+      copiedIn.push_back(0);
+      isAlive.push_back(1);
+   }
+   else
+   {
+      id = freeIds.back();
+      freeIds.pop_back();
+      isAlive[id] = 1;
+   }
+   Write(id) = proxy;
+   stats.Proxies++;
+   return id;
+}
+
+void ProxyScene::Destroy(ProxyId id)
+{
+   Write(id).IsVisible = false;
+   isAlive[id] = 0;
+   freeIds.push_back(id);
+   stats.Proxies--;
+}
+
+void ProxyScene::SetTransform(ProxyId id, const XMFLOAT3X4& world, const BoundingBox& bounds)
+{
+   RenderProxy& proxy = Write(id);
+   proxy.Draw.Instance.World = world;
+   proxy.Bounds = bounds;
+}
+
+void ProxyScene::SetMaterial(ProxyId id, ResourceHandle material, uint64_t sortKey)
+{
+   RenderProxy& proxy = Write(id);
+   proxy.Draw.Material = material;
+   proxy.Draw.SortKey = sortKey;
+}
+
+void ProxyScene::SetVisible(ProxyId id, bool visible)
+{
+   Write(id).IsVisible = visible;
+}
+
+const RenderProxy& ProxyScene::Get(ProxyId id) const
+{
+   if (id < 0 || id >= ProxyId(isAlive.size()) || !isAlive[id]) throw std::runtime_error("Invalid render proxy.");
+   return buffers[writeIndex].Proxies[id];
+}
+
+RenderProxy& ProxyScene::Write(ProxyId id)
+{
+   if (id < 0 || id >= ProxyId(isAlive.size()) || !isAlive[id]) throw std::runtime_error("Invalid render proxy.");
+   if (changedIn[id] != sequence + 1)
+   {
+      changedIn[id] = sequence + 1;
+      changed.push_back(id);
+   }
+   return buffers[writeIndex].Proxies[id];
+}
+
+void ProxyScene::Publish()
+{
+   ProxySnapshot& published = buffers[writeIndex];
+   published.Sequence = ++sequence;
+   stats.ChangedProxies = int32_t(changed.size());
+   stats.Publishes = sequence;
+   changeLog[sequence % ChangeLogSize].swap(changed);
+   changed.clear();
+   uint32_t old = middle.exchange(writeIndex | FreshBit, std::memory_order::acq_rel);
+   if (old & FreshBit) droppedSnapshots.fetch_add(1, std::memory_order::relaxed);
+   writeIndex = old & IndexMask;
+   // Bring the game's new buffer up to date. The published one may be read by the renderer meanwhile, but nobody writes it.
+   ProxySnapshot& next = buffers[writeIndex];
+   int32_t copied = 0;
+   if (sequence - next.Sequence > ChangeLogSize)
+   {
+      next.Proxies = published.Proxies;
+      copied = int32_t(next.Proxies.size());
+   }
+   else
+   {
+      next.Proxies.resize(published.Proxies.size());
+      for (uint64_t s = next.Sequence + 1; s <= sequence; s++)
+      {
+         for (ProxyId id : changeLog[s % ChangeLogSize])
+         {
+            if (copiedIn[id] == sequence) continue;
+            copiedIn[id] = sequence;
+            next.Proxies[id] = published.Proxies[id];
+            copied++;
+         }
+      }
+   }
+   next.Sequence = sequence;
+   stats.CopiedProxies = copied;
+}
+
+const ProxySnapshot* ProxyScene::Acquire()
+{
+   if (middle.load(std::memory_order::relaxed) & FreshBit)
+   {
+      readIndex = middle.exchange(readIndex, std::memory_order::acq_rel) & IndexMask;
+      acquisitions.fetch_add(1, std::memory_order::relaxed);
+   }
+   return buffers[readIndex].Sequence > 0 ? &buffers[readIndex] : nullptr;
+}
+
+ProxyStats ProxyScene::GetStats() const
+{
+   ProxyStats result = stats;
+   result.Acquisitions = acquisitions.load(std::memory_order::relaxed);
+   result.DroppedSnapshots = droppedSnapshots.load(std::memory_order::relaxed);
+   return result;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include "Renderer.h"
+
+namespace Pillow::Graphics
+{
+   typedef int32_t ProxyId;
+
+   // What the renderer sees of a game object.
+   struct RenderProxy
+   {
+      Drawcall Draw;      // Draw.Instance.World is the transform.
+      BoundingBox Bounds; // World space, used by culling.
+      bool IsVisible;
+   };
+
+   // The game's state at a Publish(). It never changes while the renderer holds it.
+   struct ProxySnapshot
+   {
+      std::vector<RenderProxy> Proxies; // Indexed by ProxyId, destroyed proxies are invisible.
+      uint64_t Sequence;                // The Publish() that produced it, 1 for the first.
+   };
+
+   struct ProxyStats
+   {
+      int32_t Proxies;          // Alive.
+      int32_t ChangedProxies;   // Written since the previous Publish(), counted by the last one.
+      int32_t CopiedProxies;    // Copied by the last Publish() to bring the game's next buffer up to date.
+      uint64_t Publishes;
+      uint64_t Acquisitions;    // Snapshots taken by the renderer.
+      uint64_t DroppedSnapshots; // Replaced by a newer one before the renderer took them.
+   };
+
+   // Game objects mirrored for the renderer in three buffers, so neither the game nor the renderer waits for the other.
+   // The game writes one, the latest published one waits in the middle, and the renderer reads the third.
+   // 1.Publish() swaps the game's buffer with the middle one, and Acquire() swaps the renderer's with the middle one if it's newer.
+   // Both are a single atomic exchange.
+   // 2.The buffer the game gets back is a few publishes old. Only the proxies changed since then are copied into it, from the one
+   // just published. Each publish logs what changed, and a buffer older than the log is copied whole.
+   // Methods other than Acquire() are for a single game thread, Acquire() is for a single renderer thread.
+   class ProxyScene
+   {
+      DeleteDefautedMethods(ProxyScene)
+
+   public:
+      // Publishes whose changes are logged. The renderer rarely holds a snapshot longer than a frame.
+      static const int32_t ChangeLogSize = 8;
+
+      ProxyScene(int32_t capacity);
+      ProxyId Create(const RenderProxy& proxy);
+      void Destroy(ProxyId id);
+      // The bounds must enclose the mesh under the new transform.
+      void SetTransform(ProxyId id, const XMFLOAT3X4& world, const BoundingBox& bounds);
+      // The sort key usually encodes the material, see MakeSortKey().
+      void SetMaterial(ProxyId id, ResourceHandle material, uint64_t sortKey);
+      void SetVisible(ProxyId id, bool visible);
+      // The game's own, unpublished state.
+      const RenderProxy& Get(ProxyId id) const;
+      // Make the changes visible to the next Acquire().
+      void Publish();
+      // The latest published snapshot, kept until the next Acquire(). nullptr before the first Publish().
+      const ProxySnapshot* Acquire();
+      // Call it from the game thread.
+      ProxyStats GetStats() const;
+
+   private:
+      RenderProxy& Write(ProxyId id);
+
+      // | fresh 1 | buffer index 2 |. Fresh means the middle buffer was published and not acquired yet.
+      static const uint32_t FreshBit = 4;
+      static const uint32_t IndexMask = 3;
+
+      ProxySnapshot buffers[3];
+      std::atomic<uint32_t> middle;
+      uint32_t writeIndex;   // The game's.
+      uint32_t readIndex;    // The renderer's.
+      uint64_t sequence = 0; // Of the last Publish().
+      std::vector<uint64_t> changedIn; // Per proxy, the Publish() that will carry its latest change.
+      std::vector<ProxyId> changed;
+      std::vector<ProxyId> changeLog[ChangeLogSize]; // Changes of Publish() s are in changeLog[s % ChangeLogSize].
+      std::vector<uint64_t> copiedIn; // Per proxy, so a proxy changed in several logged publishes is copied once.
+      std::vector<uint8_t> isAlive;
+      std::vector<ProxyId> freeIds;
+      ProxyStats stats{};
+      std::atomic<uint64_t> acquisitions;
+      std::atomic<uint64_t> droppedSnapshots;
+   };
+}
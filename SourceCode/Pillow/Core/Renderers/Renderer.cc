@@ -1,6 +1,11 @@
 #include "Renderer.h"
+#include "RenderProxy.h"
 #include <ranges>
 #include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
 
 using namespace Pillow;
 using namespace Pillow::Graphics;
@@ -22,15 +27,239 @@ namespace
    // On the other hand, a sync method generates a lower framerate, but provides a better delay.
    // The maximum span is Tt + Tg, if we don't take into account the GPU.
    //
-   // We choose the first method for a better performance.
+   // The GPU adds another choice: how many submitted frames it may queue. More frames smooth out spikes,
+   // but each one adds a frame of latency.
+   //
+   // The async method with SwapChainSize frames in flight is the default for a better performance.
+   // Competitive titles may switch to the sync method, see PipeliningMode.
 
+   // The game fills per-thread buffers during a tick (see SubmitDrawcall), while the workers record the last frame.
+   // Commit() collects them into the cached buffer and sorts their indices, when no worker is running.
    std::vector<Drawcall> cachedDrawcalls;
-   std::vector<Drawcall> submittedDrawcalls;
+   BoundsArray cachedBounds;
+   std::vector<uint8_t> visibility;
+   std::vector<uint32_t> drawOrder; // Indices of cachedDrawcalls sorted by key.
+   std::vector<DrawBatch> drawBatches;
+   std::vector<InstanceData> instances;
+   ProxyScene* proxyScene = nullptr;
+
+   // Culling.
+   BoundingFrustum viewFrustum;
+   BoundingFrustum requestedFrustum;
+   XMFLOAT4X4 viewProjection;
+   XMFLOAT4X4 requestedViewProjection;
+   bool hasCamera = false;
+   std::vector<XMFLOAT3> occluderVertices;
+   OcclusionBuffer occlusionBuffer;
+   VisibilityStats visibilityStats{};
+   const int32_t CullingGrain = 1024; // Items per ParallelFor range, a multiple of 4.
+   const int32_t OccluderGrain = 256; // Triangles per ParallelFor range.
+
+   // Levels of detail.
+   std::vector<LodItem> lodItems;
+   std::vector<float> lodScales; // Pixels covered by a unit of world-space error at each item's distance.
+   XMFLOAT3 cameraPosition;
+   XMFLOAT3 requestedCameraPosition;
+   float projectionScale; // cot(fovY / 2), the projection's scale of view-space y.
+   float requestedProjectionScale;
+   float lodErrorThreshold = 1;
+   float lodHysteresis = 0.25f;
+   int64_t lodTriangleBudget = 0;
+   LodStats lodStats{};
+   const int32_t LodGrain = 1024;
+   const float MinLodDistance = 1e-3f; // Items around the camera get their finest level.
+
+   // Clustered lighting.
+   std::vector<Light> submittedLights;
+   LightClusters lightClusters;
+   XMFLOAT4X4 cameraView;
+   XMFLOAT4X4 requestedView;
+   XMFLOAT4X4 cameraProjection;
+   XMFLOAT4X4 requestedProjection;
+   CameraConstants cameraConstants; // Of the frame being recorded, if there is a camera.
+   LightingStats lightingStats{};
+   const int32_t LightSliceGrain = 1; // Slices per ParallelFor range. A slice costs about the same as the others, so ranges stay small.
+
+   // Shadows.
+   ShadowCascades shadowCascades;
+   bool isCastingShadows = false;
+   XMFLOAT3 shadowLightDirection;
+   std::vector<uint8_t> casterMasks; // Per item, see ShadowCascades::CullCasters().
+   std::vector<Drawcall> shadowCasters[ShadowCascades::MaxCascades];
+   ShadowStats shadowStats{};
+
+   // Dynamic resolution.
+   DynamicResolution resolutionController;
+   bool isScalingResolution = false;
+   float renderScale = 1;
+   std::atomic<double> reportedGPUTime;
+
+   PipeliningMode pipeliningMode = PipeliningMode::FramesInFlight;
+   PipeliningMode requestedMode = PipeliningMode::FramesInFlight;
+   int32_t framesInFlight = Constants::SwapChainSize;
+   int32_t requestedFramesInFlight = Constants::SwapChainSize;
+
+   // Frame pacing measurements.
+   std::chrono::steady_clock::time_point lastCommitPoint;
+   std::chrono::steady_clock::time_point tickStartPoint; // When the main thread leaves Commit() and starts ticking.
+   std::chrono::steady_clock::time_point frameInputPoint; // The tick start of the frame being recorded.
+   std::atomic<double> statCPUFrameSpan;
+   std::atomic<double> statInputToSubmit;
+   const double StatSmoothing = 0.1;
+
+   // Work stealing. Each worker owns a contiguous range of chunks and claims them from the front.
+   // Thieves claim from the same front, so a claim is a single fetch_add and no chunk is recorded twice.
+   // Chunks are all known before the workers wake up, so no queue grows during a frame.
+   struct alignas(CacheLine) ChunkQueue
+   {
+      std::atomic<int32_t> next;
+      int32_t end;
+   };
+
+   struct alignas(CacheLine) WorkerCounters
+   {
+      std::atomic<double> busyTime;
+      std::atomic<double> barrierWaitTime;
+      std::atomic<uint64_t> recordedChunks;
+      std::atomic<uint64_t> stolenChunks;
+      std::atomic<int32_t> cpu{ -1 };
+   };
+
+   std::vector<RecordChunk> chunks;
+   // Command streams of the chunks. A stream is cached per frame array index, since backends keep their native
+   // commands per frame array index too, and the GPU is done with them once that index comes around again.
+   // A chunk's stream only depends on its batches and the camera, so a chunk whose batches and camera equal the cached ones
+   // isn't recorded again.
+   const CommandStream* commandStreams[Constants::MaxRecordChunks];
+   CommandStream cachedStreams[Constants::SwapChainSize][Constants::MaxRecordChunks];
+   std::vector<DrawBatch> cachedBatches[Constants::SwapChainSize][Constants::MaxRecordChunks];
+   bool isStreamCached[Constants::MaxRecordChunks];
+   CommandStats commandStats{};
+   std::unique_ptr<ChunkQueue[]> chunkQueues;
+   std::unique_ptr<WorkerCounters[]> workerCounters;
+
+   // Frame timeline. Stages are written by the threads running them, and a frame is read only after it finishes.
+   // A frame's slot is reused FrameTimelineSize frames later, so finished frames stay stable for the game thread.
+   std::chrono::steady_clock::time_point timelineOrigin;
+   std::unique_ptr<FrameTimeline[]> timelines;
+   FrameTimeline* currentTimeline; // The frame being recorded, published to the workers with the frame sequence.
+   std::atomic<uint64_t> finishedFrames; // The index of the last finished frame + 1.
+   std::atomic<int32_t> frameBarriers;
+   std::atomic<int32_t> frameBarrierBatches;
+   const char* const FrameStageNames[] =
+   {
+      "CommitBegin", "WaitEnd", "CullEnd", "LodEnd", "SortEnd", "PioneerEnd", "BarrierEnd", "ExecuteEnd", "PresentEnd", "SyncEnd", "AssemblerEnd"
+   };
+   static_assert(std::size(FrameStageNames) == size_t(FrameStage::Count));
 
    std::vector<std::thread> workers;
-   std::optional<std::barrier<void(*)() noexcept>> frameBarrier;
+   std::vector<ThreadPlacement> workerPlacements; // Applied by each worker when it starts.
+   // The frame barrier. std::barrier can't take back a thread once it drops, but the active workers vary.
+   // The last arrival runs BarrierCompletionAction(), which releases the others by bumping the phase.
+   std::atomic<int32_t> barrier_Pending;
+   std::atomic<uint32_t> barrier_Phase;
    std::atomic<bool> signal_IsActive;
    std::atomic<bool> signal_IsComputing;
+   std::atomic<uint32_t> signal_FrameSequence; // Bumped once per kicked frame or job, workers park on it.
+   std::atomic<uint32_t> kickedFrames; // Bumped before the sequence when a frame is kicked, so workers can tell frames from jobs.
+   int32_t commitSpinBudget;
+
+   // Workers [0, activeWorkers) take part in frames and jobs, the others park on activationEpoch.
+   // The count only changes in Commit() while no frame is running, and each change bumps the epoch.
+   std::atomic<int32_t> activeWorkers;
+   std::atomic<uint32_t> activationEpoch;
+   uint32_t activationSequence; // The frame sequence and kicked frames at the last change, where reactivated workers resume.
+   uint32_t activationKicks;
+   int32_t requestedWorkers = 0; // 0 keeps the current count.
+
+   // Worker autotuning, see GenericRenderer::SetWorkerAutotuning().
+   struct TuningWindow
+   {
+      int32_t frames;
+      double recordSpan;
+      double utilization;
+      double barrierWaitTime;
+   };
+
+   bool isAutotuning = true;
+   TuningWindow tuningWindow{};
+   WorkerTuner workerTuner;
+   const char* const TuningReasonNames[] = { "Grow", "Shrink", "Revert" };
+
+   ForceInline double MillisecondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+   {
+      return std::chrono::duration<double, std::milli>(to - from).count();
+   }
+
+   ForceInline double TimelineTime(std::chrono::steady_clock::time_point point)
+   {
+      return MillisecondsBetween(timelineOrigin, point);
+   }
+
+   // The first sample (a zero average) is taken as is.
+   ForceInline void Accumulate(std::atomic<double>& average, double sample)
+   {
+      double old = average.load(std::memory_order::relaxed);
+      average.store(old == 0 ? sample : old + (sample - old) * StatSmoothing, std::memory_order::relaxed);
+   }
+
+   // A ParallelFor() job. Workers join it whenever they wake up, and claim ranges with fetch_add.
+   // job_Helpers counts the workers inside the job, so its fields are not rewritten while one still reads them.
+   std::atomic<bool> job_IsActive;
+   std::atomic<int32_t> job_Next;
+   std::atomic<int32_t> job_Done;
+   std::atomic<int32_t> job_Helpers;
+   int32_t job_Count;
+   int32_t job_Grain;
+   const std::function<void(int32_t, int32_t)>* job_Body;
+
+   void HelpWithJob()
+   {
+      // Sequentially consistent: either ParallelFor() sees this helper, or this helper sees the job inactive.
+      job_Helpers.fetch_add(1);
+      if (job_IsActive.load())
+      {
+         for (int32_t begin = job_Next.fetch_add(job_Grain, std::memory_order::relaxed); begin < job_Count;
+            begin = job_Next.fetch_add(job_Grain, std::memory_order::relaxed))
+         {
+            int32_t end = std::min(begin + job_Grain, job_Count);
+            (*job_Body)(begin, end);
+            job_Done.fetch_add(end - begin, std::memory_order::release);
+         }
+      }
+      job_Helpers.fetch_sub(1, std::memory_order::release);
+   }
+
+   // For short waits on other threads' work. Yield after a while, in case they were preempted.
+   template<typename Predicate>
+   void SpinUntil(Predicate predicate)
+   {
+      for (int32_t i = 0; !predicate(); i++)
+      {
+         if (i < MaxSpinCount) CpuRelax();
+         else std::this_thread::yield();
+      }
+   }
+
+   // Proxies go after the submitted drawcalls, so the indices of LOD items stay valid.
+   void GatherProxies(const ProxySnapshot& snapshot)
+   {
+      for (const RenderProxy& proxy : snapshot.Proxies)
+      {
+         if (!proxy.IsVisible) continue;
+         cachedDrawcalls.push_back(proxy.Draw);
+         cachedBounds.Push(proxy.Bounds);
+      }
+   }
+
+   // Return -1 if the queue is drained.
+   ForceInline int32_t ClaimChunk(ChunkQueue& queue)
+   {
+      // Check first, so that drained queues are not hammered by fetch_add from thieves.
+      if (queue.next.load(std::memory_order::relaxed) >= queue.end) return -1;
+      int32_t index = queue.next.fetch_add(1, std::memory_order::relaxed);
+      return index < queue.end ? index : -1;
+   }
 
    ForceInline std::vector<KeyValuePair> Sort(const std::vector<KeyValuePair>& macros)
    {
@@ -82,10 +311,19 @@ bool GenericPipelineConfig::EqualTo(const GenericPipelineConfig& right) const
    return this->ConfigName == right.ConfigName;
 }
 
-static void Pillow::Graphics::BarrierCompletionAction() noexcept
+void Pillow::Graphics::BarrierCompletionAction() noexcept
 {
+   auto barrierPoint = std::chrono::steady_clock::now();
+   currentTimeline->Stages[size_t(FrameStage::BarrierEnd)] = TimelineTime(barrierPoint);
+   Accumulate(statInputToSubmit, MillisecondsBetween(frameInputPoint, barrierPoint));
    if(Instance) Instance->Assembler();
+   currentTimeline->Stages[size_t(FrameStage::AssemblerEnd)] = TimelineTime(std::chrono::steady_clock::now());
+   finishedFrames.store(currentTimeline->FrameIndex + 1, std::memory_order::release);
+   // Release the waiting workers before Commit() may kick the next frame, so a late waiter never sees the next phase's arrivals.
+   barrier_Phase.fetch_add(1, std::memory_order::release);
+   barrier_Phase.notify_all();
    signal_IsComputing.store(false, std::memory_order::release);
+   signal_IsComputing.notify_one(); // Only the main thread waits on it.
 }
 
 GenericRenderer::GenericRenderer(int32_t threadCount, std::string name) :
@@ -93,15 +331,35 @@ GenericRenderer::GenericRenderer(int32_t threadCount, std::string name) :
    f_ThreadCount(threadCount)
 {
    workers.reserve(threadCount);
-   frameBarrier.emplace(threadCount, BarrierCompletionAction);
+   barrier_Pending.store(0);
+   barrier_Phase.store(0);
+   activeWorkers.store(threadCount);
+   activationEpoch.store(0);
+   activationSequence = activationKicks = 0;
+   chunks.reserve(Constants::MaxRecordChunks);
+   chunkQueues = std::make_unique<ChunkQueue[]>(threadCount);
+   workerCounters = std::make_unique<WorkerCounters[]>(threadCount);
    signal_IsActive.store(true);
    signal_IsComputing.store(false);
+   signal_FrameSequence.store(0);
+   kickedFrames.store(0);
+   job_IsActive.store(false);
+   job_Helpers.store(0);
+   commitSpinBudget = MinSpinCount;
+   tickStartPoint = lastCommitPoint = timelineOrigin = std::chrono::steady_clock::now();
+   timelines = std::make_unique<FrameTimeline[]>(Constants::FrameTimelineSize);
+   finishedFrames.store(0);
 }
 
 GenericRenderer::~GenericRenderer()
 {
    workers.clear();
-   frameBarrier.reset();
+}
+
+void GenericRenderer::SetWorkerPlacements(const std::vector<ThreadPlacement>& placements)
+{
+   if (!workers.empty()) throw std::runtime_error("Workers are placed when they start, set their placements before Launch().");
+   workerPlacements = placements;
 }
 
 void GenericRenderer::Launch()
@@ -114,7 +372,13 @@ void GenericRenderer::Launch()
 
 void GenericRenderer::Terminate()
 {
+   // Let the frame in flight finish, then wake all parked workers to let them quit.
+   SpinThenWait(signal_IsComputing, true, commitSpinBudget);
    signal_IsActive.store(false, std::memory_order::release);
+   signal_FrameSequence.fetch_add(1, std::memory_order::release);
+   signal_FrameSequence.notify_all();
+   activationEpoch.fetch_add(1, std::memory_order::release);
+   activationEpoch.notify_all();
    for (auto& thread : workers)
    {
       if (thread.joinable()) thread.join();
@@ -123,24 +387,781 @@ void GenericRenderer::Terminate()
 
 void GenericRenderer::Commit()
 {
-   while (signal_IsComputing.load(std::memory_order::acquire)) std::this_thread::yield();
+   auto commitPoint = std::chrono::steady_clock::now();
+   SpinThenWait(signal_IsComputing, true, commitSpinBudget);
+   // No worker is running, so it's safe to switch modes and buffers.
+   commandStats = CommandStats{};
+   for (const RecordChunk& chunk : chunks)
+   {
+      if (chunk.ChunkType != RecordChunk::Drawcalls) continue;
+      const CommandStream& stream = *commandStreams[chunk.Index];
+      commandStats.Commands += stream.GetCommandCount();
+      commandStats.StreamBytes += int32_t((stream.GetWords().size() + stream.GetConstants().size()) * sizeof(uint32_t));
+      (isStreamCached[chunk.Index] ? commandStats.ReusedStreams : commandStats.RecordedStreams)++;
+   }
+   commandStats.Barriers = frameBarriers.exchange(0, std::memory_order::relaxed);
+   commandStats.BarrierBatches = frameBarrierBatches.exchange(0, std::memory_order::relaxed);
+   TuneWorkers();
+   if (requestedMode != pipeliningMode || requestedFramesInFlight != framesInFlight)
+   {
+      pipeliningMode = requestedMode;
+      framesInFlight = requestedFramesInFlight;
+      statCPUFrameSpan.store(0, std::memory_order::relaxed);
+      statInputToSubmit.store(0, std::memory_order::relaxed);
+   }
+   else
+   {
+      Accumulate(statCPUFrameSpan, MillisecondsBetween(lastCommitPoint, commitPoint));
+   }
+   lastCommitPoint = commitPoint;
+   // The last frame has left the workers, so its timeline is complete up to the barrier.
+   double gpuTime = reportedGPUTime.load(std::memory_order::relaxed);
+   renderScale = 1;
+   if (isScalingResolution)
+   {
+      double tickTime = MillisecondsBetween(tickStartPoint, commitPoint);
+      double renderTime = currentTimeline ? currentTimeline->Stages[size_t(FrameStage::BarrierEnd)] - currentTimeline->Stages[size_t(FrameStage::WaitEnd)] : 0;
+      renderScale = resolutionController.Update(std::max(tickTime, renderTime), gpuTime);
+   }
+   uint64_t frameIndex = this->GetFrameIndex();
+   currentTimeline = &timelines[frameIndex % Constants::FrameTimelineSize];
+   *currentTimeline = FrameTimeline{};
+   currentTimeline->FrameIndex = frameIndex;
+   currentTimeline->Stages[size_t(FrameStage::CommitBegin)] = TimelineTime(commitPoint);
+   currentTimeline->RenderScale = renderScale;
+   currentTimeline->GPUTime = gpuTime;
+   MarkFrameStage(FrameStage::WaitEnd);
+   // Culling and sorting here keep them off the recording critical path, and the game thread is idle anyway.
+   CollectDrawcalls(cachedDrawcalls, cachedBounds, lodItems);
+   const ProxySnapshot* snapshot = proxyScene ? proxyScene->Acquire() : nullptr;
+   if (snapshot) GatherProxies(*snapshot);
+   if (hasCamera)
+   {
+      viewFrustum = requestedFrustum;
+      viewProjection = requestedViewProjection;
+      cameraPosition = requestedCameraPosition;
+      projectionScale = requestedProjectionScale;
+      cameraView = requestedView;
+      cameraProjection = requestedProjection;
+      cameraConstants.ViewProjection = viewProjection;
+      cameraConstants.Position = XMFLOAT4(cameraPosition.x, cameraPosition.y, cameraPosition.z, renderScale);
+   }
+   // Before culling, which drops the casters outside the view.
+   CullShadowCasters();
+   CullDrawcalls();
+   MarkFrameStage(FrameStage::CullEnd);
+   SelectLods();
+   AssignLights();
+   MarkFrameStage(FrameStage::LodEnd);
+   SortDrawcalls(cachedDrawcalls, drawOrder);
+   BatchDrawcalls(cachedDrawcalls, drawOrder, drawBatches, instances);
+   MarkFrameStage(FrameStage::SortEnd);
+   frameInputPoint = tickStartPoint;
    this->Pioneer();
+   ScheduleChunks();
+   MarkFrameStage(FrameStage::PioneerEnd);
    signal_IsComputing.store(true, std::memory_order::release);
+   barrier_Pending.store(activeWorkers.load(std::memory_order::relaxed), std::memory_order::relaxed);
+   kickedFrames.fetch_add(1, std::memory_order::release);
+   signal_FrameSequence.fetch_add(1, std::memory_order::release);
+   signal_FrameSequence.notify_all();
+   // The sync method doesn't overlap the next tick.
+   if (pipeliningMode == PipeliningMode::Synchronous) SpinThenWait(signal_IsComputing, true, commitSpinBudget);
+   tickStartPoint = std::chrono::steady_clock::now();
+}
+
+void GenericRenderer::SetPipelining(PipeliningMode mode, int32_t _framesInFlight)
+{
+   requestedMode = mode;
+   requestedFramesInFlight = std::clamp(_framesInFlight, 2, Constants::SwapChainSize);
+}
+
+PipeliningMode GenericRenderer::GetPipeliningMode() const
+{
+   return pipeliningMode;
+}
+
+int32_t GenericRenderer::GetFramesInFlight() const
+{
+   return pipeliningMode == PipeliningMode::FramesInFlight ? framesInFlight : 1;
+}
+
+FramePacingStats GenericRenderer::GetFramePacingStats() const
+{
+   return FramePacingStats{ statCPUFrameSpan.load(std::memory_order::relaxed), statInputToSubmit.load(std::memory_order::relaxed) };
+}
+
+BatchingStats GenericRenderer::GetBatchingStats() const
+{
+   int32_t drawcallCount = int32_t(drawOrder.size());
+   int32_t batchCount = int32_t(drawBatches.size());
+   return BatchingStats{ drawcallCount, batchCount, drawcallCount - batchCount };
+}
+
+VisibilityStats GenericRenderer::GetVisibilityStats() const
+{
+   return visibilityStats;
+}
+
+LodStats GenericRenderer::GetLodStats() const
+{
+   return lodStats;
+}
+
+LightingStats GenericRenderer::GetLightingStats() const
+{
+   return lightingStats;
+}
+
+ShadowStats GenericRenderer::GetShadowStats() const
+{
+   return shadowStats;
+}
+
+void GenericRenderer::CountBarriers(int32_t barriers, int32_t batches)
+{
+   frameBarriers.fetch_add(barriers, std::memory_order::relaxed);
+   frameBarrierBatches.fetch_add(batches, std::memory_order::relaxed);
+}
+
+CommandStats GenericRenderer::GetCommandStats() const
+{
+   return commandStats;
+}
+
+void GenericRenderer::SetDynamicResolution(bool enabled, const DynamicResolutionSettings& settings)
+{
+   resolutionController = DynamicResolution(settings, RefreshRate);
+   isScalingResolution = enabled;
+}
+
+float GenericRenderer::GetRenderScale() const
+{
+   return renderScale;
+}
+
+void GenericRenderer::ReportGPUFrameTime(double milliseconds)
+{
+   reportedGPUTime.store(milliseconds, std::memory_order::relaxed);
+}
+
+void GenericRenderer::SetProxyScene(ProxyScene* scene)
+{
+   proxyScene = scene;
+}
+
+void GenericRenderer::SetCamera(FXMMATRIX view, CXMMATRIX projection)
+{
+   // The frustum is built in view space, then moved to world space.
+   BoundingFrustum frustum;
+   BoundingFrustum::CreateFromMatrix(frustum, projection);
+   frustum.Transform(requestedFrustum, XMMatrixInverse(nullptr, view));
+   XMStoreFloat4x4(&requestedViewProjection, XMMatrixMultiply(view, projection));
+   XMStoreFloat3(&requestedCameraPosition, XMMatrixInverse(nullptr, view).r[3]);
+   requestedProjectionScale = XMVectorGetY(projection.r[1]);
+   XMStoreFloat4x4(&requestedView, view);
+   XMStoreFloat4x4(&requestedProjection, projection);
+   hasCamera = true;
+}
+
+void GenericRenderer::SetShadows(bool enabled, const XMFLOAT3& lightDirection, const ShadowSettings& settings)
+{
+   if (enabled && XMVector3Equal(XMLoadFloat3(&lightDirection), XMVectorZero())) throw std::runtime_error("A shadow light needs a direction.");
+   shadowCascades.SetSettings(settings);
+   shadowLightDirection = lightDirection;
+   isCastingShadows = enabled;
+}
+
+void GenericRenderer::SetLodPolicy(float errorThreshold, float hysteresis, int64_t triangleBudget)
+{
+   lodErrorThreshold = std::max(errorThreshold, FLT_EPSILON);
+   lodHysteresis = std::clamp(hysteresis, 0.f, 0.9f);
+   lodTriangleBudget = std::max(triangleBudget, int64_t(0));
+}
+
+void GenericRenderer::SetActiveWorkerCount(int32_t count)
+{
+   requestedWorkers = std::clamp(count, 1, f_ThreadCount);
+}
+
+int32_t GenericRenderer::GetActiveWorkerCount() const
+{
+   return activeWorkers.load(std::memory_order::relaxed);
+}
+
+void GenericRenderer::SetWorkerAutotuning(bool enabled)
+{
+   isAutotuning = enabled;
+   tuningWindow = TuningWindow{};
+   workerTuner.Reset();
+}
+
+const std::vector<WorkerTuningDecision>& GenericRenderer::GetWorkerTuningDecisions() const
+{
+   return workerTuner.GetDecisions();
+}
+
+void GenericRenderer::ExportWorkerTuning(const string& path) const
+{
+   std::ofstream file(path, std::ios::out | std::ios::trunc);
+   if (!file) throw std::runtime_error("Failed to open " + path + ".");
+   file << std::fixed << std::setprecision(4);
+   file << "HardwareThreads,PoolSize,Frame,Reason,FromWorkers,ToWorkers,Utilization,RecordSpan,BarrierWaitTime\n";
+   for (const WorkerTuningDecision& decision : workerTuner.GetDecisions())
+   {
+      file << std::thread::hardware_concurrency() << ',' << f_ThreadCount << ',' << decision.FrameIndex << ',' << TuningReasonNames[decision.ChangeReason]
+         << ',' << decision.FromWorkers << ',' << decision.ToWorkers << ',' << decision.Utilization << ',' << decision.RecordSpan
+         << ',' << decision.BarrierWaitTime << '\n';
+   }
+   if (!file) throw std::runtime_error("Failed to write " + path + ".");
+}
+
+void GenericRenderer::ParallelFor(int32_t count, int32_t grain, const std::function<void(int32_t begin, int32_t end)>& body)
+{
+   if (count <= 0) return;
+   grain = std::max(grain, 1);
+   if (count <= grain)
+   {
+      body(0, count);
+      return;
+   }
+   job_Body = &body;
+   job_Count = count;
+   job_Grain = grain;
+   job_Next.store(0, std::memory_order::relaxed);
+   job_Done.store(0, std::memory_order::relaxed);
+   job_IsActive.store(true);
+   signal_FrameSequence.fetch_add(1, std::memory_order::release);
+   signal_FrameSequence.notify_all();
+   HelpWithJob();
+   // Ranges claimed by workers may still be running.
+   SpinUntil([count]() { return job_Done.load(std::memory_order::acquire) >= count; });
+   job_IsActive.store(false);
+   SpinUntil([]() { return job_Helpers.load(std::memory_order::acquire) == 0; });
+}
+
+WorkerStats GenericRenderer::GetWorkerStats(int32_t workerIndex) const
+{
+   if (workerIndex < 0 || workerIndex >= f_ThreadCount) throw std::runtime_error("Invalid worker index.");
+   const WorkerCounters& counters = workerCounters[workerIndex];
+   return WorkerStats
+   {
+      counters.busyTime.load(std::memory_order::relaxed),
+      counters.barrierWaitTime.load(std::memory_order::relaxed),
+      counters.recordedChunks.load(std::memory_order::relaxed),
+      counters.stolenChunks.load(std::memory_order::relaxed),
+      counters.cpu.load(std::memory_order::relaxed)
+   };
+}
+
+bool GenericRenderer::GetFrameTimeline(uint64_t frameIndex, FrameTimeline& timeline) const
+{
+   // The slot of the oldest kept frame may be reused by the frame in flight.
+   uint64_t finished = finishedFrames.load(std::memory_order::acquire);
+   if (frameIndex >= finished || finished - frameIndex >= uint64_t(Constants::FrameTimelineSize)) return false;
+   timeline = timelines[frameIndex % Constants::FrameTimelineSize];
+   return timeline.FrameIndex == frameIndex;
+}
+
+void GenericRenderer::ExportFrameTimelines(const string& path, TimelineFormat format) const
+{
+   std::ofstream file(path, std::ios::out | std::ios::trunc);
+   if (!file) throw std::runtime_error("Failed to open " + path + ".");
+   file << std::fixed << std::setprecision(4);
+   uint64_t finished = finishedFrames.load(std::memory_order::acquire);
+   uint64_t first = finished > uint64_t(Constants::FrameTimelineSize - 1) ? finished - Constants::FrameTimelineSize + 1 : 0;
+   int32_t workerCount = std::min(f_ThreadCount, Constants::MaxThreadNumRenderer);
+   if (format == TimelineFormat::CSV)
+   {
+      file << "Frame";
+      for (const char* name : FrameStageNames) file << ',' << name;
+      file << ",RenderScale,GPUTime";
+      for (int32_t i = 0; i < workerCount; i++) file << ",RecordBegin" << i << ",RecordEnd" << i;
+      file << '\n';
+   }
+   else
+   {
+      file << "[";
+   }
+   FrameTimeline timeline;
+   bool isFirst = true;
+   for (uint64_t frameIndex = first; frameIndex < finished; frameIndex++)
+   {
+      if (!GetFrameTimeline(frameIndex, timeline)) continue;
+      if (format == TimelineFormat::CSV)
+      {
+         file << timeline.FrameIndex;
+         for (double stage : timeline.Stages) file << ',' << stage;
+         file << ',' << timeline.RenderScale << ',' << timeline.GPUTime;
+         for (int32_t i = 0; i < workerCount; i++) file << ',' << timeline.RecordBegin[i] << ',' << timeline.RecordEnd[i];
+         file << '\n';
+      }
+      else
+      {
+         file << (isFirst ? "\n" : ",\n") << "{\"Frame\":" << timeline.FrameIndex << ",\"Stages\":{";
+         for (size_t i = 0; i < size_t(FrameStage::Count); i++)
+         {
+            file << (i ? "," : "") << '"' << FrameStageNames[i] << "\":" << timeline.Stages[i];
+         }
+         file << "},\"RenderScale\":" << timeline.RenderScale << ",\"GPUTime\":" << timeline.GPUTime << ",\"Workers\":[";
+         for (int32_t i = 0; i < workerCount; i++)
+         {
+            file << (i ? "," : "") << "{\"RecordBegin\":" << timeline.RecordBegin[i] << ",\"RecordEnd\":" << timeline.RecordEnd[i] << '}';
+         }
+         file << "]}";
+      }
+      isFirst = false;
+   }
+   if (format == TimelineFormat::JSON) file << "\n]\n";
+   if (!file) throw std::runtime_error("Failed to write " + path + ".");
+}
+
+int32_t GenericRenderer::GetRecordChunkCount() const
+{
+   return int32_t(chunks.size());
+}
+
+const std::vector<Drawcall>& GenericRenderer::GetDrawcalls() const
+{
+   return cachedDrawcalls;
+}
+
+const std::vector<uint32_t>& GenericRenderer::GetDrawOrder() const
+{
+   return drawOrder;
+}
+
+const std::vector<DrawBatch>& GenericRenderer::GetDrawBatches() const
+{
+   return drawBatches;
+}
+
+const std::vector<InstanceData>& GenericRenderer::GetInstances() const
+{
+   return instances;
+}
+
+const std::vector<Light>& GenericRenderer::GetLights() const
+{
+   return submittedLights;
+}
+
+const LightClusters& GenericRenderer::GetLightClusters() const
+{
+   return lightClusters;
+}
+
+const ShadowCascades& GenericRenderer::GetShadowCascades() const
+{
+   return shadowCascades;
+}
+
+const std::vector<Drawcall>& GenericRenderer::GetShadowCasters(int32_t cascade) const
+{
+   return shadowCasters[cascade];
+}
+
+void GenericRenderer::MarkFrameStage(FrameStage stage)
+{
+   currentTimeline->Stages[size_t(stage)] = TimelineTime(std::chrono::steady_clock::now());
+}
+
+const CommandStream& GenericRenderer::GetCommandStream(int32_t chunkIndex) const
+{
+   return *commandStreams[chunkIndex];
+}
+
+bool GenericRenderer::IsCommandStreamCached(int32_t chunkIndex) const
+{
+   return isStreamCached[chunkIndex];
+}
+
+void GenericRenderer::InvalidateCommandStreams()
+{
+   int32_t frameIdx = GetFrameArrayIdx();
+   for (int32_t i = 0; i < Constants::MaxRecordChunks; i++)
+   {
+      cachedStreams[frameIdx][i].Reset();
+      cachedBatches[frameIdx][i].clear();
+   }
+}
+
+void GenericRenderer::RecordCommands(const RecordChunk& chunk)
+{
+   // Comparing the batches is cheaper than recording and comparing the stream, which has up to 4 commands per batch.
+   // The camera constants are the only constants of the stream, so they are compared as they are. An empty cache never matches
+   // a chunk with batches.
+   int32_t frameIdx = GetFrameArrayIdx();
+   CommandStream& stream = cachedStreams[frameIdx][chunk.Index];
+   std::vector<DrawBatch>& batches = cachedBatches[frameIdx][chunk.Index];
+   const DrawBatch* first = drawBatches.data() + chunk.FirstBatch;
+   const CameraConstants* camera = hasCamera ? &cameraConstants : nullptr;
+   const std::vector<uint32_t>& constants = stream.GetConstants();
+   bool isSameCamera = camera ? constants.size() * sizeof(uint32_t) == sizeof(CameraConstants) &&
+      std::memcmp(constants.data(), camera, sizeof(CameraConstants)) == 0 : constants.empty();
+   commandStreams[chunk.Index] = &stream;
+   isStreamCached[chunk.Index] = isSameCamera && batches.size() == size_t(chunk.BatchCount) &&
+      std::equal(batches.begin(), batches.end(), first, [](const DrawBatch& a, const DrawBatch& b)
+      {
+         return a.Mesh == b.Mesh && a.Material == b.Material && a.PipelineState == b.PipelineState && a.FirstInstance == b.FirstInstance &&
+            a.InstanceCount == b.InstanceCount;
+      });
+   if (isStreamCached[chunk.Index]) return;
+   batches.assign(first, first + chunk.BatchCount);
+   stream.Reset();
+   RecordDrawBatches(drawBatches, chunk.FirstBatch, chunk.BatchCount, camera, stream);
+#ifdef PILLOW_DEBUG
+   string message;
+   if (!ValidateCommandStream(stream, message)) throw std::runtime_error("Invalid command stream: " + message);
+#endif
+}
+
+void GenericRenderer::CullShadowCasters()
+{
+   for (std::vector<Drawcall>& casters : shadowCasters) casters.clear();
+   shadowStats = ShadowStats{};
+   if (!isCastingShadows || !hasCamera)
+   {
+      shadowCascades.Clear();
+      return;
+   }
+   auto cullPoint = std::chrono::steady_clock::now();
+   shadowCascades.Fit(XMLoadFloat4x4(&cameraView), XMLoadFloat4x4(&cameraProjection), XMLoadFloat3(&shadowLightDirection));
+   int32_t cascadeCount = shadowCascades.GetCascadeCount();
+   shadowStats.CascadeCount = cascadeCount;
+   for (int32_t c = 0; c < cascadeCount; c++) shadowStats.SplitDistances[c] = shadowCascades.GetCascade(c).SplitFar;
+   // Cascades share light space, so each range is tested against all of them at once.
+   int32_t count = int32_t(cachedDrawcalls.size());
+   cachedBounds.Pad();
+   casterMasks.resize(cachedBounds.GetCount());
+   ParallelFor(cachedBounds.GetCount(), CullingGrain, [](int32_t begin, int32_t end)
+      {
+         shadowCascades.CullCasters(cachedBounds, begin, end, casterMasks.data());
+      });
+   for (int32_t i = 0; i < count; i++)
+   {
+      uint32_t mask = casterMasks[i];
+      if (mask == 0) continue;
+      for (int32_t c = 0; c < cascadeCount; c++)
+      {
+         if (mask & (1u << c)) shadowCasters[c].push_back(cachedDrawcalls[i]);
+         shadowStats.SkippedCasters[c] += (mask >> (c + ShadowCascades::MaxCascades)) & 1;
+      }
+   }
+   for (int32_t c = 0; c < cascadeCount; c++) shadowStats.Casters[c] = int32_t(shadowCasters[c].size());
+   shadowStats.CasterCullTime = MillisecondsBetween(cullPoint, std::chrono::steady_clock::now());
+}
+
+void GenericRenderer::CullDrawcalls()
+{
+   CollectOccluders(occluderVertices);
+   int32_t count = int32_t(cachedDrawcalls.size());
+   int32_t triangleCount = int32_t(occluderVertices.size() / 3);
+   visibilityStats = VisibilityStats{};
+   visibilityStats.SubmittedItems = count;
+   if (!hasCamera || count == 0) return;
+   // 1 Frustum.
+   auto frustumPoint = std::chrono::steady_clock::now();
+   cachedBounds.Pad();
+   visibility.resize(cachedBounds.GetCount());
+   ParallelFor(cachedBounds.GetCount(), CullingGrain, [](int32_t begin, int32_t end)
+      {
+         CullByFrustum(cachedBounds, viewFrustum, begin, end, visibility.data());
+      });
+   int32_t frustumVisibleCount = int32_t(std::count(visibility.begin(), visibility.begin() + count, uint8_t(1)));
+   visibilityStats.FrustumCulled = count - frustumVisibleCount;
+   auto occlusionPoint = std::chrono::steady_clock::now();
+   visibilityStats.FrustumCullTime = MillisecondsBetween(frustumPoint, occlusionPoint);
+   // 2 Occlusion, only for the items passing the frustum.
+   if (triangleCount > 0)
+   {
+      occlusionBuffer.Begin(occluderVertices, XMLoadFloat4x4(&viewProjection));
+      ParallelFor(triangleCount, OccluderGrain, [](int32_t begin, int32_t end) { occlusionBuffer.SetupTriangles(begin, end); });
+      ParallelFor(OcclusionBuffer::Height, OcclusionBuffer::TileSize, [](int32_t begin, int32_t end) { occlusionBuffer.Rasterize(begin, end); });
+      ParallelFor(count, CullingGrain, [](int32_t begin, int32_t end)
+         {
+            occlusionBuffer.TestOccludees(cachedBounds, begin, end, visibility.data());
+         });
+   }
+   auto compactPoint = std::chrono::steady_clock::now();
+   // Compact in place, which keeps the submission order. Bounds and LOD items are compacted along, LOD items are in drawcall order.
+   int32_t visibleCount = 0;
+   size_t lodIndex = 0, visibleLodCount = 0;
+   for (int32_t i = 0; i < count; i++)
+   {
+      bool isLodItem = lodIndex < lodItems.size() && lodItems[lodIndex].Drawcall == i;
+      if (visibility[i])
+      {
+         if (isLodItem)
+         {
+            lodItems[visibleLodCount] = lodItems[lodIndex];
+            lodItems[visibleLodCount++].Drawcall = visibleCount;
+         }
+         cachedBounds.Move(i, visibleCount);
+         cachedDrawcalls[visibleCount++] = cachedDrawcalls[i];
+      }
+      if (isLodItem) lodIndex++;
+   }
+   cachedDrawcalls.resize(visibleCount);
+   cachedBounds.Resize(visibleCount);
+   lodItems.resize(visibleLodCount);
+   if (triangleCount > 0)
+   {
+      visibilityStats.OccluderTriangles = triangleCount;
+      visibilityStats.OcclusionCulled = frustumVisibleCount - visibleCount;
+      visibilityStats.OcclusionCullTime = MillisecondsBetween(occlusionPoint, compactPoint);
+   }
+}
+
+void GenericRenderer::SelectLods()
+{
+   int32_t count = int32_t(lodItems.size());
+   lodStats = LodStats{ count, 0, lodErrorThreshold, 0 };
+   if (count == 0) return;
+   auto selectPoint = std::chrono::steady_clock::now();
+   std::atomic<int64_t> triangles = 0;
+   float threshold = lodErrorThreshold;
+   // Without a camera, items keep their levels.
+   if (hasCamera)
+   {
+      // A world-space error "e" at distance "d" covers e * cot(fovY / 2) * screenHeight / (2 * d) pixels.
+      float pixelScale = projectionScale * float(std::max(ScreenSize.y, 1)) * 0.5f;
+      lodScales.resize(count);
+      ParallelFor(count, LodGrain, [&triangles, threshold, pixelScale](int32_t begin, int32_t end)
+         {
+            XMVECTOR eye = XMLoadFloat3(&cameraPosition);
+            float refineAbove = threshold * (1 + lodHysteresis), coarsenBelow = threshold * (1 - lodHysteresis);
+            int64_t sum = 0;
+            for (int32_t i = begin; i < end; i++)
+            {
+               const LodItem& item = lodItems[i];
+               int32_t d = item.Drawcall;
+               // The distance to the bounding sphere, so large items are refined before the camera gets into them.
+               XMVECTOR center = XMVectorSet(cachedBounds.CenterX[d], cachedBounds.CenterY[d], cachedBounds.CenterZ[d], 0);
+               XMVECTOR extent = XMVectorSet(cachedBounds.ExtentX[d], cachedBounds.ExtentY[d], cachedBounds.ExtentZ[d], 0);
+               float distance = XMVectorGetX(XMVectorSubtract(XMVector3Length(XMVectorSubtract(center, eye)), XMVector3Length(extent)));
+               float scale = pixelScale / std::max(distance, MinLodDistance);
+               lodScales[i] = scale;
+               const std::vector<MeshLod>& levels = item.Chain->Levels;
+               int32_t last = int32_t(levels.size()) - 1;
+               int32_t level = std::min(int32_t(*item.Level), last);
+               // Only leave the current level when its error leaves the band around the threshold.
+               if (levels[level].GeometricError * scale > refineAbove)
+               {
+                  while (level > 0 && levels[level].GeometricError * scale > threshold) level--;
+               }
+               else
+               {
+                  while (level < last && levels[level + 1].GeometricError * scale <= coarsenBelow) level++;
+               }
+               *item.Level = uint8_t(level);
+               sum += levels[level].TriangleCount;
+            }
+            triangles.fetch_add(sum, std::memory_order::relaxed);
+         });
+      // Over the budget, coarsen everything with a doubled threshold, which keeps the relative quality of items.
+      // It stops once every item is at its coarsest level, since the errors are finite.
+      bool canCoarsen = true;
+      while (lodTriangleBudget > 0 && triangles.load(std::memory_order::relaxed) > lodTriangleBudget && canCoarsen)
+      {
+         threshold *= 2;
+         triangles.store(0, std::memory_order::relaxed);
+         std::atomic<bool> coarsenable = false;
+         ParallelFor(count, LodGrain, [&triangles, &coarsenable, threshold](int32_t begin, int32_t end)
+            {
+               int64_t sum = 0;
+               bool isCoarsenable = false;
+               for (int32_t i = begin; i < end; i++)
+               {
+                  const LodItem& item = lodItems[i];
+                  const std::vector<MeshLod>& levels = item.Chain->Levels;
+                  int32_t last = int32_t(levels.size()) - 1;
+                  int32_t level = *item.Level;
+                  while (level < last && levels[level + 1].GeometricError * lodScales[i] <= threshold) level++;
+                  *item.Level = uint8_t(level);
+                  sum += levels[level].TriangleCount;
+                  isCoarsenable |= level < last;
+               }
+               triangles.fetch_add(sum, std::memory_order::relaxed);
+               if (isCoarsenable) coarsenable.store(true, std::memory_order::relaxed);
+            });
+         canCoarsen = coarsenable.load(std::memory_order::relaxed);
+      }
+   }
+   // Apply the levels. Front-to-back keys get the level's mesh, so instances of a level are batched together.
+   triangles.store(0, std::memory_order::relaxed);
+   ParallelFor(count, LodGrain, [&triangles](int32_t begin, int32_t end)
+      {
+         int64_t sum = 0;
+         for (int32_t i = begin; i < end; i++)
+         {
+            const LodItem& item = lodItems[i];
+            const std::vector<MeshLod>& levels = item.Chain->Levels;
+            int32_t level = std::min(int32_t(*item.Level), int32_t(levels.size()) - 1);
+            *item.Level = uint8_t(level);
+            Drawcall& drawcall = cachedDrawcalls[item.Drawcall];
+            drawcall.Mesh = levels[level].Mesh;
+            if (!item.BackToFront) drawcall.SortKey = SetSortKeyMesh(drawcall.SortKey, drawcall.Mesh);
+            sum += levels[level].TriangleCount;
+         }
+         triangles.fetch_add(sum, std::memory_order::relaxed);
+      });
+   lodStats.SubmittedTriangles = triangles.load(std::memory_order::relaxed);
+   lodStats.ErrorThreshold = threshold;
+   lodStats.LodSelectTime = MillisecondsBetween(selectPoint, std::chrono::steady_clock::now());
+}
+
+void GenericRenderer::AssignLights()
+{
+   CollectLights(submittedLights);
+   lightingStats = LightingStats{};
+   lightingStats.SubmittedLights = int32_t(submittedLights.size());
+   if (!hasCamera) return;
+   auto assignPoint = std::chrono::steady_clock::now();
+   // Slices own their clusters, so workers assign them without synchronization. The froxels persist while the projection doesn't change.
+   lightClusters.Begin(submittedLights, XMLoadFloat4x4(&cameraView), XMLoadFloat4x4(&cameraProjection));
+   ParallelFor(LightClusters::CountZ, LightSliceGrain, [](int32_t begin, int32_t end) { lightClusters.AssignSlices(begin, end); });
+   lightClusters.Finish();
+   lightingStats.VisibleLights = lightClusters.GetVisibleLightCount();
+   lightingStats.LightIndices = int32_t(lightClusters.GetLightIndices().size());
+   lightingStats.MaxClusterLights = lightClusters.GetMaxClusterLightCount();
+   lightingStats.DroppedLights = lightClusters.GetDroppedLightCount();
+   lightingStats.AssignTime = MillisecondsBetween(assignPoint, std::chrono::steady_clock::now());
+}
+
+void GenericRenderer::TuneWorkers()
+{
+   int32_t active = activeWorkers.load(std::memory_order::relaxed);
+   int32_t target = active;
+   // Sample the frame that just finished. Its workers are known, since the count only changes here.
+   const FrameTimeline* timeline = currentTimeline;
+   double kickTime = timeline ? timeline->Stages[size_t(FrameStage::PioneerEnd)] : 0;
+   double barrierTime = timeline ? timeline->Stages[size_t(FrameStage::BarrierEnd)] : 0;
+   if (isAutotuning && barrierTime > kickTime && kickTime > 0 && active <= Constants::MaxThreadNumRenderer)
+   {
+      double span = barrierTime - kickTime;
+      double busy = 0, wait = 0;
+      for (int32_t i = 0; i < active; i++)
+      {
+         busy += timeline->RecordEnd[i] - timeline->RecordBegin[i];
+         wait += barrierTime - timeline->RecordEnd[i];
+      }
+      tuningWindow.frames++;
+      tuningWindow.recordSpan += span;
+      tuningWindow.utilization += busy / (span * active);
+      tuningWindow.barrierWaitTime += wait / active;
+   }
+   if (tuningWindow.frames >= WorkerTuner::WindowFrames)
+   {
+      double frames = tuningWindow.frames;
+      WorkerTuningWindow window{ tuningWindow.utilization / frames, tuningWindow.recordSpan / frames, tuningWindow.barrierWaitTime / frames };
+      tuningWindow = TuningWindow{};
+      target = workerTuner.Update(window, active, f_ThreadCount, this->GetFrameIndex());
+   }
+   if (requestedWorkers != 0)
+   {
+      target = requestedWorkers;
+      requestedWorkers = 0;
+   }
+   if (target == active) return;
+   // No frame is running, so the workers are parked or waiting for the next kick.
+   activationSequence = signal_FrameSequence.load(std::memory_order::relaxed);
+   activationKicks = kickedFrames.load(std::memory_order::relaxed);
+   activeWorkers.store(target, std::memory_order::release);
+   activationEpoch.fetch_add(1, std::memory_order::release);
+   activationEpoch.notify_all();
+}
+
+void GenericRenderer::ScheduleChunks()
+{
+   // Large frames are split into bigger chunks rather than more command lists. Each batch is one draw.
+   int32_t batchCount = int32_t(drawBatches.size());
+   int32_t maxBatchChunks = Constants::MaxRecordChunks - 2;
+   int32_t chunkSize = std::max(Constants::MinDrawcallsPerChunk, (batchCount + maxBatchChunks - 1) / maxBatchChunks);
+   chunks.clear();
+   chunks.push_back(RecordChunk{ RecordChunk::Prologue, 0, 0, 0 });
+   for (int32_t first = 0; first < batchCount; first += chunkSize)
+   {
+      chunks.push_back(RecordChunk{ RecordChunk::Drawcalls, int32_t(chunks.size()), first, std::min(chunkSize, batchCount - first) });
+   }
+   chunks.push_back(RecordChunk{ RecordChunk::Epilogue, int32_t(chunks.size()), 0, 0 });
+   // Contiguous ranges keep neighbouring drawcalls, which tend to share states, on one worker.
+   int32_t count = int32_t(chunks.size());
+   int32_t active = activeWorkers.load(std::memory_order::relaxed);
+   for (int32_t i = 0; i < active; i++)
+   {
+      chunkQueues[i].next.store(count * i / active, std::memory_order::relaxed);
+      chunkQueues[i].end = count * (i + 1) / active;
+   }
 }
 
 //#include <Windows.h>
 //#include <format>
 void GenericRenderer::BaseWorker(int32_t workerIndex)
 {
+   // Start from 0 rather than the current value, or a frame kicked before this thread starts would be lost.
+   uint32_t sequence = 0;
+   uint32_t frames = 0;
+   int32_t spinBudget = MinSpinCount;
+   if (workerIndex < int32_t(workerPlacements.size()) && !ApplyThreadPlacement(workerPlacements[workerIndex]))
+   {
+      LogSystem("Renderer worker " + std::to_string(workerIndex) + " was not fully placed, the OS refused its affinity or priority.");
+   }
    while(true)
    {
-      while (!signal_IsComputing.load(std::memory_order::acquire))
+      SpinThenWait(signal_FrameSequence, sequence, spinBudget);
+      sequence = signal_FrameSequence.load(std::memory_order::acquire);
+      if (!signal_IsActive.load(std::memory_order::acquire)) return;
+      if (workerIndex >= activeWorkers.load(std::memory_order::acquire))
       {
-         if (!signal_IsActive.load(std::memory_order::acquire)) return;
-         std::this_thread::yield();
+         // Parked until the autotuner activates it. Frames and jobs before that are not its business.
+         uint32_t epoch = activationEpoch.load(std::memory_order::acquire);
+         while (workerIndex >= activeWorkers.load(std::memory_order::acquire) && signal_IsActive.load(std::memory_order::acquire))
+         {
+            activationEpoch.wait(epoch, std::memory_order::acquire);
+            epoch = activationEpoch.load(std::memory_order::acquire);
+         }
+         sequence = activationSequence;
+         frames = activationKicks;
+         continue;
       }
+      HelpWithJob();
+      // Woken by a job, or by a frame already handled.
+      uint32_t kicked = kickedFrames.load(std::memory_order::acquire);
+      if (kicked == frames) continue;
+      frames = kicked;
       //OutputDebugString(std::format(L"Frame={} Worker={}\n", this->GetFrameIndex(), workerIndex).c_str());
-      this->Worker(workerIndex);
-      frameBarrier->arrive_and_wait();
+      auto busyPoint = std::chrono::steady_clock::now();
+      FrameTimeline* timeline = currentTimeline;
+      uint64_t recorded = 0, stolen = 0;
+      // Drain the own queue first, then steal from the others. No new chunks appear during a frame, so one pass is enough.
+      int32_t active = activeWorkers.load(std::memory_order::relaxed);
+      for (int32_t i = 0; i < active; i++)
+      {
+         ChunkQueue& queue = chunkQueues[(workerIndex + i) % active];
+         for (int32_t index = ClaimChunk(queue); index >= 0; index = ClaimChunk(queue))
+         {
+            if (chunks[index].ChunkType == RecordChunk::Drawcalls) RecordCommands(chunks[index]);
+            this->Record(workerIndex, chunks[index]);
+            recorded++;
+            if (i != 0) stolen++;
+         }
+      }
+      auto waitPoint = std::chrono::steady_clock::now();
+      if (workerIndex < Constants::MaxThreadNumRenderer)
+      {
+         timeline->RecordBegin[workerIndex] = TimelineTime(busyPoint);
+         timeline->RecordEnd[workerIndex] = TimelineTime(waitPoint);
+      }
+      // Read the phase before arriving, the last arrival may bump it right after.
+      uint32_t phase = barrier_Phase.load(std::memory_order::acquire);
+      if (barrier_Pending.fetch_sub(1, std::memory_order::acq_rel) == 1) BarrierCompletionAction();
+      else SpinThenWait(barrier_Phase, phase, spinBudget);
+      WorkerCounters& counters = workerCounters[workerIndex];
+      Accumulate(counters.busyTime, MillisecondsBetween(busyPoint, waitPoint));
+      Accumulate(counters.barrierWaitTime, MillisecondsBetween(waitPoint, std::chrono::steady_clock::now()));
+      counters.recordedChunks.fetch_add(recorded, std::memory_order::relaxed);
+      counters.stolenChunks.fetch_add(stolen, std::memory_order::relaxed);
+      counters.cpu.store(GetCurrentCpu(), std::memory_order::relaxed);
    }
 }
\ No newline at end of file
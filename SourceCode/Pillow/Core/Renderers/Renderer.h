@@ -1,12 +1,23 @@
 #pragma once
 #include <thread>
-#include <barrier>
 #include <atomic>
 #include <vector>
 #include <functional>
+#include <bit>
 #include "../Auxiliaries.h"
 #include "../Constants.h"
 #include "../Texture.h"
+#include "../Topology.h"
+#include "Culling.h"
+#include "Occlusion.h"
+#include "CommandStream.h"
+#include "DynamicResolution.h"
+#include "WorkerTuner.h"
+#include "LightClusters.h"
+#include "ShadowCascades.h"
+#include "UploadRing.h"
+#include "FrameAllocator.h"
+#include "HeapAllocator.h"
 #include "../Mesh.h"
 
 using namespace Pillow::Graphics;
@@ -21,9 +32,16 @@ namespace Pillow::Graphics
    extern int32_t RefreshRate;
    extern XMINT2 ScreenSize;
    class GenericRenderer;
+   class ProxyScene;
    extern std::unique_ptr<GenericRenderer> Instance;
+   // Run by the last worker to arrive at the frame barrier.
+   void BarrierCompletionAction() noexcept;
 
+   // | unused 1 | type 3 | generation 8 | index 20 |, see ResourceTable.
    typedef uint32_t ResourceHandle;
+   const uint32_t HandleTypeMask = 7 << 28;
+   const uint32_t HandleGenerationShift = 20;
+   const uint32_t HandleIndexMask = (1 << HandleGenerationShift) - 1;
 
    enum class ResourceType : uint32_t
    {
@@ -34,9 +52,243 @@ namespace Pillow::Graphics
       ConstantBuffer = 4 << 28,
    };
 
+   // Per-instance data, packed into the frame's instance buffer and read by the vertex shader.
+   struct InstanceData
+   {
+      XMFLOAT3X4 World; // The transposed upper 3 rows of the world matrix, its last column is (0, 0, 0, 1).
+      XMFLOAT4 Params;  // Free for materials, e.g. a tint color.
+   };
+   static_assert(sizeof(InstanceData) == 64, "Instances are uploaded as raw memory.");
+
+   // Drawcalls are sorted by a 64-bit key, see MakeSortKey().
+   // So the workers see drawcalls grouped by layer first, then by states, which minimizes state switches.
    struct Drawcall
    {
-      void* sth;
+      uint64_t SortKey;
+      ResourceHandle Mesh;
+      ResourceHandle Material;
+      ResourceHandle PipelineState;
+      InstanceData Instance;
+   };
+   static_assert(std::is_trivially_copyable_v<Drawcall>, "Drawcalls are copied as raw memory.");
+
+   // Only the low bits of the IDs are kept, and "depth" must be positive. From the most significant bit:
+   // Front to back: | layer 4 | pipeline state 12 | material 16 | texture array 8 | mesh 12 | depth 12 |
+   // Back to front: | layer 4 | inverted depth 24 | pipeline state 12 | material 16 | texture array 8 |
+   // Opaque layers put the mesh above depth, so instances of a mesh become neighbours and can be batched.
+   // Transparent layers (backToFront) must keep the depth order, so depth comes first.
+   ForceInline uint64_t MakeSortKey(uint32_t layer, uint32_t pipelineState, uint32_t material, uint32_t textureArray, uint32_t mesh,
+      float depth, bool backToFront = false)
+   {
+      // The bit pattern of a positive float increases monotonically with its value, so the high bits can be used directly.
+      uint32_t depthBits = (std::bit_cast<uint32_t>(std::max(depth, 0.f)) >> 7) & 0xFFFFFF;
+      uint64_t states = uint64_t(pipelineState & 0xFFF) << 24 | uint64_t(material & 0xFFFF) << 8 | uint64_t(textureArray & 0xFF);
+      if (backToFront) return uint64_t(layer & 0xF) << 60 | uint64_t(0xFFFFFF - depthBits) << 36 | states;
+      return uint64_t(layer & 0xF) << 60 | states << 24 | uint64_t(mesh & 0xFFF) << 12 | depthBits >> 12;
+   }
+
+   // Replace the mesh bits of a front-to-back key, see MakeSortKey().
+   ForceInline uint64_t SetSortKeyMesh(uint64_t sortKey, uint32_t mesh)
+   {
+      return (sortKey & ~(uint64_t(0xFFF) << 12)) | uint64_t(mesh & 0xFFF) << 12;
+   }
+
+   // A run of sorted drawcalls sharing mesh, pipeline state and material, recorded as one instanced draw.
+   // Instances are packed in sorted order, so the batch's instances start at FirstInstance in the instance buffer.
+   struct DrawBatch
+   {
+      ResourceHandle Mesh;
+      ResourceHandle Material;
+      ResourceHandle PipelineState;
+      int32_t FirstInstance;
+      int32_t InstanceCount;
+   };
+
+   // The camera of a frame, set to CameraConstantsSlot at the start of every chunk of drawcalls, see RecordDrawBatches().
+   // Matrices are row-major, as DirectXMath stores them.
+   struct CameraConstants
+   {
+      XMFLOAT4X4 ViewProjection;
+      XMFLOAT4 Position; // w is the render scale.
+   };
+   const uint32_t CameraConstantsSlot = 1;
+
+   // Counts of the last committed frame.
+   struct BatchingStats
+   {
+      int32_t Drawcalls;      // Submitted by the game.
+      int32_t DrawBatches;    // Recorded draws.
+      int32_t SavedDrawcalls; // Drawcalls - DrawBatches.
+   };
+
+   // Counts and times of the last committed frame.
+   struct VisibilityStats
+   {
+      int32_t SubmittedItems;
+      int32_t FrustumCulled;
+      double FrustumCullTime;   // Milliseconds, 0 if no camera is set.
+      int32_t OccluderTriangles;
+      int32_t OcclusionCulled;  // Out of the items passing the frustum.
+      double OcclusionCullTime; // Milliseconds, rasterization and tests. 0 if no occluder is submitted.
+   };
+
+   // A drawcall whose mesh is chosen from a LodChain, see SubmitDrawcall().
+   struct LodItem
+   {
+      int32_t Drawcall; // The index in the collected drawcalls.
+      bool BackToFront;
+      const LodChain* Chain;
+      uint8_t* Level;
+   };
+
+   // Counts and time of the last committed frame, see GenericRenderer::SetLodPolicy().
+   struct LodStats
+   {
+      int32_t LodItems;           // Visible items with a LodChain.
+      int64_t SubmittedTriangles; // Triangles of the levels selected for them.
+      float ErrorThreshold;       // Pixels, above the policy's one if the triangle budget was exceeded.
+      double LodSelectTime;       // Milliseconds.
+   };
+
+   // Counts and time of the last committed frame, see SubmitLight().
+   struct LightingStats
+   {
+      int32_t SubmittedLights;
+      int32_t VisibleLights;    // In at least one cluster.
+      int32_t LightIndices;     // Entries of all cluster lists.
+      int32_t MaxClusterLights; // The longest cluster list.
+      int32_t DroppedLights;    // Entries beyond LightClusters::MaxClusterLights.
+      double AssignTime;        // Milliseconds, 0 if no camera is set.
+   };
+
+   // Counts and time of the last committed frame, see GenericRenderer::SetShadows().
+   struct ShadowStats
+   {
+      int32_t CascadeCount;                                // 0 if shadows are off or no camera is set.
+      float SplitDistances[ShadowCascades::MaxCascades];   // View-space depths where the cascades end.
+      int32_t Casters[ShadowCascades::MaxCascades];        // Drawcalls rendered into each cascade.
+      int32_t SkippedCasters[ShadowCascades::MaxCascades]; // Overlapping a cascade, but inside a nearer one.
+      double CasterCullTime;                               // Milliseconds, fitting included.
+   };
+
+   // Lock-free for the game: each thread appends to its own buffer.
+   // Call it during the tick only, the buffers are collected in GenericRenderer::Commit().
+   // bounds: The world-space bounds of the item, used by culling.
+   void SubmitDrawcall(const Drawcall& drawcall, const BoundingBox& bounds);
+   // Like the one above, but drawcall.Mesh is replaced by a level of "lods" in Commit(), see GenericRenderer::SetLodPolicy().
+   // lodLevel: The item's level, kept by the game across frames for hysteresis, and updated by Commit().
+   // backToFront: The same as MakeSortKey(), front-to-back keys get the mesh bits of the selected level.
+   // Both references must stay valid until the next Commit() returns.
+   void SubmitDrawcall(const Drawcall& drawcall, const BoundingBox& bounds, const LodChain& lods, uint8_t& lodLevel, bool backToFront = false);
+   // Move the drawcalls, bounds and LOD items of all threads to the destinations. No thread may submit meanwhile.
+   void CollectDrawcalls(std::vector<Drawcall>& drawcalls, BoundsArray& bounds, std::vector<LodItem>& lodItems);
+   // Lock-free like SubmitDrawcall(). "vertices" is a world-space triangle list, 3 vertices per triangle.
+   // Occluders hide drawcalls behind them for the next frame only, so static ones are submitted every tick.
+   void SubmitOccluder(const XMFLOAT3* vertices, int32_t triangleCount);
+   void CollectOccluders(std::vector<XMFLOAT3>& vertices);
+   // Lock-free like SubmitDrawcall(). Lights are dynamic, so they are submitted every tick, and assigned to clusters in Commit().
+   void SubmitLight(const Light& light);
+   void CollectLights(std::vector<Light>& lights);
+   // Sort the indices of "drawcalls" by SortKey into "order" with a stable LSD radix sort. The drawcalls don't move.
+   void SortDrawcalls(const std::vector<Drawcall>& drawcalls, std::vector<uint32_t>& order);
+   // Merge neighbouring drawcalls in "order" into batches, and pack their instances in the same order.
+   void BatchDrawcalls(const std::vector<Drawcall>& drawcalls, const std::vector<uint32_t>& order, std::vector<DrawBatch>& batches,
+      std::vector<InstanceData>& instances);
+   // Append the draws of batches [first, first + count) to "stream". The material is bound to constant buffer slot 0.
+   // "camera" is set first if it isn't null. Its memory is per frame, so the stream differs whenever the camera moves.
+   void RecordDrawBatches(const std::vector<DrawBatch>& batches, int32_t first, int32_t count, const CameraConstants* camera,
+      CommandStream& stream);
+
+   // How far rendering runs behind the game tick, see the comment block at the top of Renderer.cc.
+   enum class PipeliningMode : uint8_t
+   {
+      // Commit() returns after the frame is recorded and the GPU finishes it. The lowest latency.
+      Synchronous,
+      // Recording overlaps the next tick, but the GPU finishes a frame before the next one is recorded.
+      AsyncSingleBuffer,
+      // Recording overlaps the next tick, and up to N frames are queued on the GPU. The highest throughput.
+      FramesInFlight
+   };
+
+   // A unit of recording work, recorded into its own command list.
+   // Chunks are submitted by Index, no matter which worker records them.
+   struct RecordChunk
+   {
+      enum Type : uint8_t
+      {
+         Prologue, // Uploads and render target preparation, always the first one.
+         Drawcalls,
+         Epilogue  // Presentation preparation, always the last one.
+      };
+
+      Type ChunkType;
+      int32_t Index;
+      int32_t FirstBatch;
+      int32_t BatchCount;
+   };
+
+   // Counts of the last recorded frame. Streams are counted over its Drawcalls chunks, barriers over all of its chunks.
+   struct CommandStats
+   {
+      int32_t Commands;
+      int32_t StreamBytes;     // Constants included.
+      int32_t RecordedStreams; // Translated into native commands.
+      int32_t ReusedStreams;   // Equal to the cached ones, see GenericRenderer::IsCommandStreamCached().
+      int32_t Barriers;        // Reported by the backend, see GenericRenderer::CountBarriers().
+      int32_t BarrierBatches;  // Native calls the barriers were issued with.
+   };
+
+   // Times are exponential moving averages in milliseconds per frame, counts are totals since launch.
+   struct WorkerStats
+   {
+      double BusyTime;        // Recording chunks.
+      double BarrierWaitTime; // From finishing the last chunk to the frame barrier being released.
+      uint64_t RecordedChunks;
+      uint64_t StolenChunks;  // Recorded chunks that were scheduled to another worker.
+      int32_t Cpu;            // The CPU that recorded the worker's last frame, -1 before its first one.
+   };
+
+   // Exponential moving averages in milliseconds, reset when the pipelining mode changes.
+   struct FramePacingStats
+   {
+      // The interval between two Commit() calls, which is the CPU frame time seen by the game.
+      double CPUFrameSpan;
+      // From the start of the tick producing a frame to its command lists being handed to the Assembler.
+      double InputToSubmitLatency;
+   };
+
+   // Stages of a frame in time order. Backends mark ExecuteEnd, PresentEnd and SyncEnd, GenericRenderer marks the rest.
+   enum class FrameStage : uint8_t
+   {
+      CommitBegin,  // The game tick ends.
+      WaitEnd,      // The previous frame leaves the workers.
+      CullEnd,      // Shadow casters are found, and invisible drawcalls are removed.
+      LodEnd,       // Levels of detail are selected, and lights are assigned to clusters.
+      SortEnd,      // Drawcalls are collected and sorted.
+      PioneerEnd,   // Workers are kicked right after it.
+      BarrierEnd,   // The last worker arrives, and Assembler() begins.
+      ExecuteEnd,   // Command lists are handed to the GPU queue.
+      PresentEnd,
+      SyncEnd,      // Fence synchronization returns.
+      AssemblerEnd,
+      Count
+   };
+
+   // Timestamps in milliseconds since the renderer was created, 0 if a stage isn't reached.
+   struct FrameTimeline
+   {
+      uint64_t FrameIndex;
+      double Stages[size_t(FrameStage::Count)];
+      float RenderScale; // Chosen for the frame, see GenericRenderer::SetDynamicResolution().
+      double GPUTime;    // The latest GPU frame time reported when the frame was committed, 0 if none.
+      double RecordBegin[Constants::MaxThreadNumRenderer]; // Per worker: woken up.
+      double RecordEnd[Constants::MaxThreadNumRenderer];   // Per worker: arrives at the frame barrier.
+   };
+
+   enum class TimelineFormat : uint8_t
+   {
+      CSV, // One row per frame.
+      JSON // An array of frames.
    };
 
    class GenericPipelineConfig
@@ -70,22 +322,154 @@ namespace Pillow::Graphics
       virtual uint64_t GetFrameIndex() = 0;
       ForceInline int32_t GetFrameArrayIdx() { return GetFrameIndex() % Constants::SwapChainSize; }
       virtual void ReleaseResource(uint32_t handle) = 0;
+      // Worker i applies placements[i] when it starts, see ThreadPlacementPolicy. Workers without one are left to the OS.
+      void SetWorkerPlacements(const std::vector<ThreadPlacement>& placements);
       void Launch();
       void Terminate();
       void Commit();
+      // Takes effect at the next Commit(). "framesInFlight" only matters to FramesInFlight, and is clamped to [2, SwapChainSize].
+      void SetPipelining(PipeliningMode mode, int32_t framesInFlight = Constants::SwapChainSize);
+      PipeliningMode GetPipeliningMode() const;
+      // The number of submitted frames the GPU may be working on, used by the backend's fence synchronization.
+      int32_t GetFramesInFlight() const;
+      FramePacingStats GetFramePacingStats() const;
+      WorkerStats GetWorkerStats(int32_t workerIndex) const;
+      BatchingStats GetBatchingStats() const;
+      VisibilityStats GetVisibilityStats() const;
+      LodStats GetLodStats() const;
+      LightingStats GetLightingStats() const;
+      ShadowStats GetShadowStats() const;
+      CommandStats GetCommandStats() const;
+      // From the next Commit() on, each Commit() acquires the scene's latest snapshot and draws its visible proxies along with
+      // the submitted drawcalls. So the game may tick on another thread, writing proxies while a frame is prepared.
+      // The scene must outlive the renderer, or be detached with nullptr.
+      void SetProxyScene(ProxyScene* scene);
+      // Takes effect at the next Commit(). Drawcalls outside the view frustum or hidden by occluders are dropped,
+      // and lights are assigned to the view's clusters. Nothing is culled or assigned before a camera is set. "projection" must be a perspective one without other transforms.
+      void SetCamera(FXMMATRIX view, CXMMATRIX projection);
+      // Takes effect at the next Commit(), call it from the thread calling Commit(). Cascades of a directional light are fitted to
+      // the camera, and each gets the drawcalls casting into it, including ones outside the view. Shadows need a camera.
+      // lightDirection: Where the light goes, in world space.
+      void SetShadows(bool enabled, const XMFLOAT3& lightDirection, const ShadowSettings& settings = {});
+      // Takes effect at the next Commit(). Each LOD item gets its coarsest level whose error projects to at most "errorThreshold" pixels.
+      // hysteresis: A fraction of the threshold. Levels only change once the error leaves the band around the threshold,
+      // so items near a switching distance don't pop back and forth.
+      // triangleBudget: The most triangles of LOD items per frame, 0 for no limit. Above it, the threshold is doubled until
+      // the selection fits or every item is at its coarsest level.
+      void SetLodPolicy(float errorThreshold = 1, float hysteresis = 0.25f, int64_t triangleBudget = 0);
+      // Takes effect at the next Commit(), call it from the thread calling Commit(). Each Commit() feeds the last frame's CPU time
+      // (the longer of the tick and the renderer's preparation and recording) and the latest reported GPU time to a
+      // DynamicResolution controller, which picks the frame's render scale. The target frame time defaults to RefreshRate's interval.
+      void SetDynamicResolution(bool enabled, const DynamicResolutionSettings& settings = {});
+      // Per axis of the output size, for the frame being recorded or the last one. 1 while dynamic resolution is disabled.
+      float GetRenderScale() const;
+      // Takes effect at the next Commit(). Workers beyond "count" park without being destroyed.
+      // The autotuner may change the count later, disable it to pin the count.
+      void SetActiveWorkerCount(int32_t count);
+      int32_t GetActiveWorkerCount() const;
+      // Enabled by default. Over windows of frames, the autotuner measures how busy the active workers are, and activates one more
+      // worker if they are busy, or parks one if they mostly wait at the frame barrier. A change that makes recording slower is
+      // reverted, and that direction is held back for a while.
+      void SetWorkerAutotuning(bool enabled);
+      // The latest decisions, oldest first. Call it from the game thread.
+      const std::vector<WorkerTuningDecision>& GetWorkerTuningDecisions() const;
+      // Write the decisions as CSV, along with the hardware thread count and the pool size, to pin defaults per device class.
+      void ExportWorkerTuning(const string& path) const;
+      // Run "body" over [0, count) in ranges of "grain" items, on the workers and the calling thread.
+      // Invoke it from the game thread only. Workers help once they finish recording, so it's safe during a frame.
+      void ParallelFor(int32_t count, int32_t grain, const std::function<void(int32_t begin, int32_t end)>& body);
+      // Only the last FrameTimelineSize - 1 finished frames are kept, the frame in flight takes the other slot. Call it from the game thread.
+      bool GetFrameTimeline(uint64_t frameIndex, FrameTimeline& timeline) const;
+      // Write the kept frames, oldest first. Call it from the game thread.
+      void ExportFrameTimelines(const string& path, TimelineFormat format) const;
 
    protected:
       GenericRenderer(int32_t threadCount, string name);
-      virtual void Worker(int32_t workerIndex) = 0;
+      // Invoked by any worker for each chunk of the frame. Chunks of one frame are recorded concurrently.
+      virtual void Record(int32_t workerIndex, const RecordChunk& chunk) = 0;
       virtual void Pioneer() = 0;
       virtual void Assembler() = 0;
+      // Valid from the end of Pioneer() to the end of Assembler().
+      int32_t GetRecordChunkCount() const;
+      // Visible drawcalls of the frame being recorded, in submission order. GetDrawOrder() lists their indices sorted by key,
+      // and DrawBatch::FirstInstance indexes it.
+      const std::vector<Drawcall>& GetDrawcalls() const;
+      const std::vector<uint32_t>& GetDrawOrder() const;
+      // Batches of the frame being recorded, indexed by RecordChunk::FirstBatch.
+      const std::vector<DrawBatch>& GetDrawBatches() const;
+      // Instances of the frame being recorded, to be uploaded in Pioneer().
+      const std::vector<InstanceData>& GetInstances() const;
+      // Lights of the frame being recorded, indexed by the clusters' light indices, to be uploaded in Pioneer() along with the clusters.
+      // The clusters are empty before a camera is set.
+      const std::vector<Light>& GetLights() const;
+      const LightClusters& GetLightClusters() const;
+      // Cascades of the frame being recorded, and the drawcalls casting into each one, unsorted and with their submitted meshes.
+      // GetShadowCascades().GetCascadeCount() is 0 while shadows are off.
+      const ShadowCascades& GetShadowCascades() const;
+      const std::vector<Drawcall>& GetShadowCasters(int32_t cascade) const;
+      // Invoked by backends in Assembler().
+      void MarkFrameStage(FrameStage stage);
+      // The commands of a Drawcalls chunk, recorded right before Record() is invoked for it. Debug builds validate them.
+      const CommandStream& GetCommandStream(int32_t chunkIndex) const;
+      // True if the chunk's batches and camera, and so its commands, equal the ones of the same chunk SwapChainSize frames ago (the
+      // same frame array index). Then the stream wasn't recorded again, and the backend may replay the native commands it translated
+      // back then, apart from constants, see CommandStream::HasConstants().
+      bool IsCommandStreamCached(int32_t chunkIndex) const;
+      // Forget the cached streams of the current frame array index, e.g. when a buffer referenced by them is recreated.
+      // Invoke it in Pioneer().
+      void InvalidateCommandStreams();
+      // Invoked by backends from any thread, once they know how long the GPU took for a frame. Feeds dynamic resolution.
+      void ReportGPUFrameTime(double milliseconds);
+      // Invoked by backends in Record(), to add to the frame's CommandStats.
+      void CountBarriers(int32_t barriers, int32_t batches);
 
    private:
       void BaseWorker(int32_t workerIndex);
-      friend static void BarrierCompletionAction() noexcept;
+      void CullShadowCasters();
+      void CullDrawcalls();
+      void SelectLods();
+      void AssignLights();
+      void ScheduleChunks();
+      void RecordCommands(const RecordChunk& chunk);
+      void TuneWorkers();
+      friend void BarrierCompletionAction() noexcept;
+   };
+
+   // A headless CPU-only backend. It drives the whole Pioneer -> Worker -> Assembler pipeline without a GPU,
+   // simulating fences and presentation with a fake GPU timeline, so the frame pipeline can be profiled anywhere.
+   class NullRenderer final : public GenericRenderer
+   {
+      DeleteDefautedMethods(NullRenderer)
+
+   public:
+      // gpuLatency: The fake GPU time of a frame in milliseconds. The fake GPU executes frames one by one.
+      // verticalBlanks: 0 presents immediately, otherwise presentation is paced by RefreshRate like V-Sync.
+      NullRenderer(int32_t threadCount, double gpuLatency = 0, int32_t verticalBlanks = 0);
+      ~NullRenderer();
+      uint64_t GetFrameIndex();
+      // Thread-safe. Allocates a handle without any backing object, which exercises handle lifetimes headlessly.
+      ResourceHandle CreateResource(ResourceType type);
+      void ReleaseResource(uint32_t handle);
+
+   private:
+      void Record(int32_t workerIndex, const RecordChunk& chunk);
+      void Pioneer();
+      void Assembler();
    };
 
 #if defined(_WIN64)
+   // Totals since the renderer was created, see D3D12Renderer::GetCopyStats().
+   struct CopyQueueStats
+   {
+      uint64_t Batches;       // Submissions to the copy queue, at most one per frame.
+      uint64_t Bytes;         // Uploaded by them.
+      double CopyTime;        // Milliseconds the copy queue spent on them, 0 if the device can't time copy queues.
+      double Bandwidth;       // Megabytes per second over CopyTime.
+      double WaitTime;        // Milliseconds the CPU blocked on the copy fence, for batch allocators or upload ring space.
+      uint64_t GraphicsWaits; // Frames handed to the graphics queue while the copies they wait for were still running.
+      uint64_t CopyWaits;     // Batches handed to the copy queue while the frames they wait for were still rendering.
+   };
+
    class D3D12Renderer final: public GenericRenderer
    {
       DeleteDefautedMethods(D3D12Renderer)
@@ -94,10 +478,25 @@ namespace Pillow::Graphics
       D3D12Renderer(HWND windowHandle, int32_t threadCount);
       ~D3D12Renderer();
       uint64_t GetFrameIndex();
+      // Thread-safe. Buffers and textures in default heaps are suballocated from separate pools of heaps, see HeapAllocator.
+      HeapAllocatorStats GetHeapStats(bool textures);
+      // Thread-safe. Uploads to default heaps are staged in one ring, see UploadRing.
+      UploadRingStats GetUploadStats();
+      // Thread-safe. Uploads are copied on a dedicated queue, the graphics queue waits for them on the GPU.
+      CopyQueueStats GetCopyStats();
+      // Of the transient constants, see CommandStream::SetConstants(). Call it from the game thread, like Commit().
+      FrameAllocatorStats GetFrameConstantStats();
+      // Thread-safe. Resources live in default heaps, their data is staged in the upload ring and copied before the next recorded frame.
+      // Pipeline states can't be created yet, the backend has no root signature or shaders. Recording a stream that binds one throws.
+      // vertices: "vertexCount" vertices of "vertexSize" bytes, drawn as a triangle list.
+      ResourceHandle CreateMesh(const void* vertices, int32_t vertexSize, int32_t vertexCount);
+      // data: The mips of array slice 0, then of slice 1, and so on, see GenericTextureInfo.
+      ResourceHandle CreateTexture(const uint8_t* data, const GenericTextureInfo& info);
+      ResourceHandle CreateConstantBuffer(const void* data, int32_t size);
       void ReleaseResource(uint32_t handle);
 
    private:
-      void Worker(int32_t workerIndex);
+      void Record(int32_t workerIndex, const RecordChunk& chunk);
       void Pioneer();
       void Assembler();
    };
@@ -119,9 +518,10 @@ namespace Pillow::Graphics
 
 #endif
 
-   ForceInline ResourceType GetResourceType(ResourceHandle handle) { return ResourceType(handle & (7 << 28)); }
+   ForceInline ResourceType GetResourceType(ResourceHandle handle) { return ResourceType(handle & HandleTypeMask); }
 
-   ForceInline bool IsValidHandle(ResourceHandle handle) { return (handle & !(7 << 28)) != 0; }
+   // Only checks the format, use ResourceTable::IsAlive() to catch stale handles.
+   ForceInline bool IsValidHandle(ResourceHandle handle) { return (handle & ~HandleTypeMask) != 0; }
 
    ForceInline void InitializeRenderer(int32_t threadCount, const void* parameter)
    {
@@ -131,6 +531,10 @@ namespace Pillow::Graphics
       Instance = std::make_unique<Graphics::D3D12Renderer>(hwnd, threadCount);
 #elif defined(__ANDROID__)
       //RendererInstance = std::make_unique<Pillow::GLES32Renderer>(Hwnd, 2);
+#elif defined(__linux__)
+      // Headless, the parameter is the fake GPU latency in milliseconds.
+      double gpuLatency = parameter ? *(const double*)parameter : 0;
+      Instance = std::make_unique<Graphics::NullRenderer>(threadCount, gpuLatency);
 #endif
    }
 }
@@ -0,0 +1,154 @@
+#pragma once
+#include <mutex>
+#include <queue>
+#include <algorithm>
+#include "Renderer.h"
+
+namespace Pillow::Graphics
+{
+   // Maps handles of one ResourceType to backend objects.
+   //
+   // 1.Slots are stored as dense arrays (payloads, generations, free links), and a handle's index bits address
+   // them directly, so Get() is a single indexed load on the render hot path.
+   // 2.Each slot has a generation, which is bumped on release. A stale handle carries an old generation, IsAlive()
+   // catches it, and so does Get() in debug builds.
+   // 3.Free slots form a lock-free stack (Treiber stack). The head is tagged with a counter to avoid ABA, so loader
+   // threads can create resources concurrently.
+   // 4.The GPU may still use a released resource, so its slot returns to the free stack only after the fence of the
+   // last frame that may reference it completes, see Reclaim().
+   template<typename T>
+   class ResourceTable
+   {
+      DeleteDefautedMethods(ResourceTable)
+
+   public:
+      // The capacity is clamped by the index bits of a handle.
+      ResourceTable(ResourceType _type, int32_t _capacity) :
+         type(_type),
+         capacity(uint32_t(std::clamp(_capacity, 1, int32_t(HandleIndexMask + 1)))),
+         payloads(std::make_unique<T[]>(capacity)),
+         generations(std::make_unique<std::atomic<uint8_t>[]>(capacity)),
+         nextFree(std::make_unique<std::atomic<uint32_t>[]>(capacity))
+      {
+         // Generation 0 is never used, so valid handles are never equal to their bare types.
+         for (uint32_t i = 0; i < capacity; i++) generations[i].store(1, std::memory_order::relaxed);
+      }
+
+      // Thread-safe. The handle must be passed to the render thread through a synchronization, e.g. Commit().
+      ResourceHandle Create(T&& payload)
+      {
+         uint32_t index = PopFreeSlot();
+         if (index == EmptySlot)
+         {
+            index = highWater.fetch_add(1, std::memory_order::relaxed);
+            if (index >= capacity)
+            {
+               highWater.fetch_sub(1, std::memory_order::relaxed);
+               throw std::runtime_error("The resource table is full.");
+            }
+         }
+         payloads[index] = std::move(payload);
+         uint32_t generation = generations[index].load(std::memory_order::relaxed);
+         return uint32_t(type) | generation << HandleGenerationShift | index;
+      }
+
+      // Thread-safe. The handle becomes stale immediately, while the payload lives until Reclaim() frees the slot.
+      void Release(ResourceHandle handle)
+      {
+         if (GetResourceType(handle) != type) throw std::runtime_error("The resource handle has a wrong type.");
+         uint32_t index = handle & HandleIndexMask;
+         uint8_t generation = uint8_t(handle >> HandleGenerationShift);
+         // 255 wraps to 1, skipping 0.
+         uint8_t nextGeneration = generation % 255 + 1;
+         if (index >= capacity || !generations[index].compare_exchange_strong(generation, nextGeneration, std::memory_order::relaxed))
+         {
+            throw std::runtime_error("The resource handle has been released.");
+         }
+         std::lock_guard<std::mutex> lock(releaseMutex);
+         released.push_back(index);
+      }
+
+      // Invoked by the render thread once per frame.
+      // pendingFence: The fence of the first frame that cannot reference handles released so far.
+      // completedFence: The last fence completed by the GPU.
+      void Reclaim(uint64_t pendingFence, uint64_t completedFence)
+      {
+         {
+            std::lock_guard<std::mutex> lock(releaseMutex);
+            std::swap(released, reclaiming);
+         }
+         for (uint32_t index : reclaiming) retiring.push(Retiring{ index, pendingFence });
+         reclaiming.clear();
+         // FIFO indicates that if one slot is still in use, so are the remnants.
+         while (!retiring.empty() && retiring.front().fence <= completedFence)
+         {
+            uint32_t index = retiring.front().index;
+            payloads[index] = T{};
+            PushFreeSlot(index);
+            retiring.pop();
+         }
+      }
+
+      ForceInline T& Get(ResourceHandle handle)
+      {
+#ifdef PILLOW_DEBUG
+         if (!IsAlive(handle)) throw std::runtime_error("The resource handle is stale.");
+#endif
+         return payloads[handle & HandleIndexMask];
+      }
+
+      ForceInline bool IsAlive(ResourceHandle handle) const
+      {
+         uint32_t index = handle & HandleIndexMask;
+         return GetResourceType(handle) == type && index < capacity &&
+            generations[index].load(std::memory_order::relaxed) == uint8_t(handle >> HandleGenerationShift);
+      }
+
+   private:
+      static const uint32_t EmptySlot = UINT32_MAX;
+
+      // The head packs | tag 32 | index 32 |, the tag increases on every change.
+      uint32_t PopFreeSlot()
+      {
+         uint64_t head = freeHead.load(std::memory_order::acquire);
+         while (uint32_t(head) != EmptySlot)
+         {
+            // The link may be stale if another thread pops the slot meanwhile, but then the tag fails the CAS.
+            uint64_t next = ((head >> 32) + 1) << 32 | nextFree[uint32_t(head)].load(std::memory_order::relaxed);
+            if (freeHead.compare_exchange_weak(head, next, std::memory_order::acquire, std::memory_order::acquire)) return uint32_t(head);
+         }
+         return EmptySlot;
+      }
+
+      void PushFreeSlot(uint32_t index)
+      {
+         uint64_t head = freeHead.load(std::memory_order::relaxed);
+         uint64_t next;
+         do
+         {
+            nextFree[index].store(uint32_t(head), std::memory_order::relaxed);
+            next = ((head >> 32) + 1) << 32 | index;
+         } while (!freeHead.compare_exchange_weak(head, next, std::memory_order::release, std::memory_order::relaxed));
+      }
+
+   private:
+      struct Retiring
+      {
+         uint32_t index;
+         uint64_t fence;
+      };
+
+      const ResourceType type;
+      const uint32_t capacity;
+      std::unique_ptr<T[]> payloads;
+      std::unique_ptr<std::atomic<uint8_t>[]> generations;
+      std::unique_ptr<std::atomic<uint32_t>[]> nextFree;
+      std::atomic<uint64_t> freeHead{ EmptySlot };
+      std::atomic<uint32_t> highWater{};
+
+      std::mutex releaseMutex; // Releasing is rare, a lock keeps Release() simple.
+      std::vector<uint32_t> released;
+      std::vector<uint32_t> reclaiming; // Owned by the render thread.
+      std::queue<Retiring> retiring;    // Owned by the render thread.
+   };
+}
@@ -0,0 +1,139 @@
+#include "ShadowCascades.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+void ShadowCascades::SetSettings(const ShadowSettings& _settings)
+{
+   if (_settings.CascadeCount < 1 || _settings.CascadeCount > MaxCascades || _settings.Resolution < 1 || _settings.Distance <= 0 ||
+      _settings.SplitBlend < 0 || _settings.SplitBlend > 1 || _settings.CasterDistance < 0)
+   {
+      throw std::runtime_error("Invalid shadow settings.");
+   }
+   settings = _settings;
+}
+
+void ShadowCascades::Fit(FXMMATRIX view, CXMMATRIX projection, FXMVECTOR lightDirection)
+{
+   // A left-handed perspective projection: P22 = f / (f - n), P32 = -n * f / (f - n), and P22 = 1 if the far plane is infinite.
+   float p00 = XMVectorGetX(projection.r[0]), p11 = XMVectorGetY(projection.r[1]);
+   float p22 = XMVectorGetZ(projection.r[2]), p32 = XMVectorGetZ(projection.r[3]);
+   float nearZ = -p32 / p22, farZ = p22 > 1 ? p32 / (1 - p22) : FLT_MAX;
+   float shadowFar = std::max(std::min(settings.Distance, farZ), nearZ * 2); // Cascades can't be empty.
+   // Half of the frustum's diagonal at a unit depth.
+   float diagonal = std::sqrt(1 / (p00 * p00) + 1 / (p11 * p11));
+   // Light space is a rotation only, so it doesn't move with the camera and snapping stays on the same grid.
+   XMVECTOR direction = XMVector3Normalize(lightDirection);
+   XMVECTOR up = std::abs(XMVectorGetY(direction)) > 0.99f ? XMVectorSet(0, 0, 1, 0) : XMVectorSet(0, 1, 0, 0);
+   XMMATRIX light = XMMatrixLookToLH(XMVectorZero(), direction, up);
+   XMMATRIX inverseLight = XMMatrixTranspose(light);
+   XMStoreFloat3x3(&lightRotation, light);
+   XMVECTOR orientation = XMQuaternionRotationMatrix(inverseLight);
+   XMMATRIX inverseView = XMMatrixInverse(nullptr, view);
+   cascadeCount = settings.CascadeCount;
+   float splitNear = nearZ;
+   for (int32_t c = 0; c < cascadeCount; c++)
+   {
+      float t = float(c + 1) / cascadeCount;
+      float splitFar = c == cascadeCount - 1 ? shadowFar :
+         settings.SplitBlend * nearZ * std::pow(shadowFar / nearZ, t) + (1 - settings.SplitBlend) * (nearZ + (shadowFar - nearZ) * t);
+      // The slice's bounding sphere is centered on the view axis, as far from the near corners as from the far ones,
+      // unless that's beyond the far plane. It only depends on the projection, so its size is the same every frame.
+      float nearRadius = splitNear * diagonal, farRadius = splitFar * diagonal;
+      float centerZ = (splitFar * splitFar + farRadius * farRadius - splitNear * splitNear - nearRadius * nearRadius) / (2 * (splitFar - splitNear));
+      centerZ = std::min(centerZ, splitFar);
+      float radius = std::max(std::sqrt((centerZ - splitNear) * (centerZ - splitNear) + nearRadius * nearRadius),
+         std::sqrt((splitFar - centerZ) * (splitFar - centerZ) + farRadius * farRadius));
+      float texelSize = 2 * radius / settings.Resolution;
+      // Snap the center to whole texels across the light, so the map slides by whole texels as the camera moves.
+      XMFLOAT3 center;
+      XMStoreFloat3(&center, XMVector3TransformNormal(XMVector3TransformCoord(XMVectorSet(0, 0, centerZ, 1), inverseView), light));
+      center.x = std::floor(center.x / texelSize) * texelSize;
+      center.y = std::floor(center.y / texelSize) * texelSize;
+      boxMin[c] = XMFLOAT3(center.x - radius, center.y - radius, center.z - radius - settings.CasterDistance);
+      boxMax[c] = XMFLOAT3(center.x + radius, center.y + radius, center.z + radius);
+      ShadowCascade& cascade = cascades[c];
+      XMMATRIX crop = XMMatrixOrthographicOffCenterLH(boxMin[c].x, boxMax[c].x, boxMin[c].y, boxMax[c].y, boxMin[c].z, boxMax[c].z);
+      XMStoreFloat4x4(&cascade.ViewProjection, XMMatrixMultiply(light, crop));
+      XMVECTOR minimum = XMLoadFloat3(&boxMin[c]), maximum = XMLoadFloat3(&boxMax[c]);
+      XMStoreFloat3(&cascade.Volume.Center, XMVector3TransformNormal(XMVectorScale(XMVectorAdd(minimum, maximum), 0.5f), inverseLight));
+      XMStoreFloat3(&cascade.Volume.Extents, XMVectorScale(XMVectorSubtract(maximum, minimum), 0.5f));
+      XMStoreFloat4(&cascade.Volume.Orientation, orientation);
+      cascade.SplitNear = splitNear;
+      cascade.SplitFar = splitFar;
+      cascade.TexelSize = texelSize;
+      splitNear = splitFar;
+   }
+}
+
+void ShadowCascades::CullCasters(const BoundsArray& bounds, int32_t begin, int32_t end, uint8_t* cascadeMasks) const
+{
+   // A world box in light space: its center is rotated, and its extents grow to bound the rotated box.
+   XMVECTOR rotation[3][3], absRotation[3][3];
+   for (int32_t row = 0; row < 3; row++)
+   {
+      for (int32_t column = 0; column < 3; column++)
+      {
+         rotation[row][column] = XMVectorReplicate(lightRotation.m[row][column]);
+         absRotation[row][column] = XMVectorAbs(rotation[row][column]);
+      }
+   }
+   XMVECTOR minX[MaxCascades], minY[MaxCascades], minZ[MaxCascades];
+   XMVECTOR maxX[MaxCascades], maxY[MaxCascades], maxZ[MaxCascades];
+   XMVECTOR bits[MaxCascades], skippedBits[MaxCascades];
+   for (int32_t c = 0; c < cascadeCount; c++)
+   {
+      minX[c] = XMVectorReplicate(boxMin[c].x);
+      minY[c] = XMVectorReplicate(boxMin[c].y);
+      minZ[c] = XMVectorReplicate(boxMin[c].z);
+      maxX[c] = XMVectorReplicate(boxMax[c].x);
+      maxY[c] = XMVectorReplicate(boxMax[c].y);
+      maxZ[c] = XMVectorReplicate(boxMax[c].z);
+      bits[c] = XMVectorReplicateInt(1u << c);
+      skippedBits[c] = XMVectorReplicateInt(1u << (c + MaxCascades));
+   }
+   for (int32_t i = begin; i < end; i += 4)
+   {
+      XMVECTOR center[3], extent[3];
+      center[0] = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterX[i]);
+      center[1] = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterY[i]);
+      center[2] = XMLoadFloat4((const XMFLOAT4*)&bounds.CenterZ[i]);
+      extent[0] = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentX[i]);
+      extent[1] = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentY[i]);
+      extent[2] = XMLoadFloat4((const XMFLOAT4*)&bounds.ExtentZ[i]);
+      // Row vectors: light[column] = sum over rows of world[row] * rotation[row][column].
+      XMVECTOR low[3], high[3];
+      for (int32_t column = 0; column < 3; column++)
+      {
+         XMVECTOR lightCenter = XMVectorMultiplyAdd(center[2], rotation[2][column],
+            XMVectorMultiplyAdd(center[1], rotation[1][column], XMVectorMultiply(center[0], rotation[0][column])));
+         XMVECTOR lightExtent = XMVectorMultiplyAdd(extent[2], absRotation[2][column],
+            XMVectorMultiplyAdd(extent[1], absRotation[1][column], XMVectorMultiply(extent[0], absRotation[0][column])));
+         low[column] = XMVectorSubtract(lightCenter, lightExtent);
+         high[column] = XMVectorAdd(lightCenter, lightExtent);
+      }
+      XMVECTOR covered = XMVectorFalseInt();
+      XMVECTOR masks = XMVectorZero();
+      for (int32_t c = 0; c < cascadeCount; c++)
+      {
+         XMVECTOR overlaps = XMVectorAndInt(XMVectorLessOrEqual(low[0], maxX[c]), XMVectorGreaterOrEqual(high[0], minX[c]));
+         overlaps = XMVectorAndInt(overlaps, XMVectorAndInt(XMVectorLessOrEqual(low[1], maxY[c]), XMVectorGreaterOrEqual(high[1], minY[c])));
+         overlaps = XMVectorAndInt(overlaps, XMVectorAndInt(XMVectorLessOrEqual(low[2], maxZ[c]), XMVectorGreaterOrEqual(high[2], minZ[c])));
+         XMVECTOR inside = XMVectorAndInt(XMVectorGreaterOrEqual(low[0], minX[c]), XMVectorLessOrEqual(high[0], maxX[c]));
+         inside = XMVectorAndInt(inside, XMVectorAndInt(XMVectorGreaterOrEqual(low[1], minY[c]), XMVectorLessOrEqual(high[1], maxY[c])));
+         inside = XMVectorAndInt(inside, XMVectorAndInt(XMVectorGreaterOrEqual(low[2], minZ[c]), XMVectorLessOrEqual(high[2], maxZ[c])));
+         masks = XMVectorOrInt(masks, XMVectorAndInt(XMVectorAndCInt(overlaps, covered), bits[c]));
+         masks = XMVectorOrInt(masks, XMVectorAndInt(XMVectorAndInt(overlaps, covered), skippedBits[c]));
+         covered = XMVectorOrInt(covered, inside);
+      }
+      uint32_t lanes[4];
+      XMStoreInt4(lanes, masks);
+      cascadeMasks[i] = uint8_t(lanes[0]);
+      cascadeMasks[i + 1] = uint8_t(lanes[1]);
+      cascadeMasks[i + 2] = uint8_t(lanes[2]);
+      cascadeMasks[i + 3] = uint8_t(lanes[3]);
+   }
+}
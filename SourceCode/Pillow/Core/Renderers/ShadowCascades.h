@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include "../Auxiliaries.h"
+#include "Culling.h"
+
+using namespace DirectX;
+
+namespace Pillow::Graphics
+{
+   struct ShadowSettings
+   {
+      int32_t CascadeCount = 4;  // At most ShadowCascades::MaxCascades.
+      float Distance = 200;      // Shadows end here or at the far plane, whichever is nearer.
+      float SplitBlend = 0.75f;  // 0 spaces the splits uniformly, 1 logarithmically, which gives near cascades more texels.
+      int32_t Resolution = 2048; // Of each cascade's square shadow map.
+      float CasterDistance = 500; // How far casters may be from a cascade's volume towards the light.
+   };
+
+   // A cascade's light-space volume, fitted to a slice of the view frustum.
+   struct ShadowCascade
+   {
+      XMFLOAT4X4 ViewProjection; // World to the shadow map's clip space, depth 0 towards the light.
+      BoundingOrientedBox Volume; // World space, including CasterDistance towards the light.
+      float SplitNear;           // View-space depths of the slice.
+      float SplitFar;
+      float TexelSize;           // World units per shadow map texel.
+   };
+
+   // Cascaded shadow maps of a directional light, the CPU side: fitting cascades and culling their casters.
+   //
+   // 1.Fit() splits the view frustum up to ShadowSettings::Distance, and fits each slice with its bounding sphere.
+   // The sphere only depends on the projection, so a cascade's size never changes while the camera moves or turns,
+   // and its center is snapped to whole texels in light space. So shadow edges don't shimmer.
+   // 2.CullCasters() tests caster bounds against every cascade's light-space box, 4 casters at a time.
+   // Light space is shared by the cascades, so a caster's light-space box is found once for all of them.
+   // A caster inside a nearer cascade's box is skipped by the farther ones. Receivers pick the first cascade whose map
+   // contains them, so such a caster's shadow is only looked up in the nearer cascade.
+   class ShadowCascades
+   {
+   public:
+      static const int32_t MaxCascades = 4;
+
+      void SetSettings(const ShadowSettings& settings);
+      // "projection" must be a perspective one without other transforms. lightDirection: World space, where the light goes.
+      void Fit(FXMMATRIX view, CXMMATRIX projection, FXMVECTOR lightDirection);
+      // No cascade until the next Fit().
+      ForceInline void Clear() { cascadeCount = 0; }
+      // For the items in [begin, end), both multiples of 4: bit c of cascadeMasks[i] is set if item i casts into cascade c,
+      // and bit c + MaxCascades if it overlaps cascade c but is skipped for a nearer one.
+      void CullCasters(const BoundsArray& bounds, int32_t begin, int32_t end, uint8_t* cascadeMasks) const;
+
+      ForceInline int32_t GetCascadeCount() const { return cascadeCount; }
+      ForceInline const ShadowCascade& GetCascade(int32_t index) const { return cascades[index]; }
+      ForceInline const ShadowSettings& GetSettings() const { return settings; }
+
+   private:
+      ShadowSettings settings;
+      int32_t cascadeCount = 0;
+      ShadowCascade cascades[MaxCascades];
+      XMFLOAT3X3 lightRotation;             // World to light space, whose +Z is the light direction.
+      XMFLOAT3 boxMin[MaxCascades];          // Light-space boxes of the cascades.
+      XMFLOAT3 boxMax[MaxCascades];
+   };
+}
@@ -0,0 +1,242 @@
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   // The front of a heap is its least valuable candidate.
+   template<typename Candidate>
+   bool IsMoreValuable(const Candidate& a, const Candidate& b)
+   {
+      return a.Value > b.Value;
+   }
+}
+
+TextureStreamer::TextureStreamer(const TextureStreamingPolicy& policy)
+{
+   SetPolicy(policy);
+}
+
+int32_t TextureStreamer::AddTexture(int32_t width, int32_t height, int32_t mipCount, float bytesPerPixel)
+{
+   int32_t size = std::max(width, height);
+   if (width <= 0 || height <= 0 || mipCount <= 0 || mipCount > int32_t(std::bit_width(uint32_t(size))) || !(bytesPerPixel > 0))
+      throw std::runtime_error("Invalid streamed texture.");
+   int32_t index;
+   if (spareTextures.empty())
+   {
+      index = int32_t(textures.size());
+      textures.emplace_back();
+   }
+   else
+   {
+      index = spareTextures.back();
+      spareTextures.pop_back();
+   }
+   // The tail starts at the first mip no wider or taller than TailWidth, or at the last mip.
+   int32_t tail = 0;
+   while (tail + 1 < mipCount && (size >> tail) > policy.TailWidth) tail++;
+   textures[index] = Texture{ width, height, mipCount, bytesPerPixel, tail, tail, -1, tail, 0, 0, 0, 0, false, true };
+   for (int32_t mip = tail; mip < mipCount; mip++) residentBytes += GetMipBytes(index, mip);
+   stats.Textures++;
+   return index;
+}
+
+void TextureStreamer::RemoveTexture(int32_t index)
+{
+   if (index < 0 || index >= int32_t(textures.size()) || !textures[index].IsLive) throw std::runtime_error("The streamed texture is not live.");
+   Texture& texture = textures[index];
+   uint64_t bytes = 0;
+   for (int32_t mip = texture.ResidentMip; mip < texture.MipCount; mip++) bytes += GetMipBytes(index, mip);
+   residentBytes -= bytes;
+   Retire(bytes);
+   texture.IsLive = false;
+   // A pending load still writes into the texture, so its bytes and its id stay taken until CompleteLoad().
+   if (texture.LoadingMip < 0) spareTextures.push_back(index);
+   stats.Textures--;
+}
+
+void TextureStreamer::ReportUse(int32_t index, float screenSize, float distance, uint64_t frame)
+{
+   Texture& texture = textures[index];
+   if (texture.IsUsed && frame == texture.LastUsedFrame)
+   {
+      texture.ScreenSize = std::max(texture.ScreenSize, screenSize);
+      texture.Distance = std::min(texture.Distance, distance);
+      return;
+   }
+   if (texture.IsUsed && frame < texture.LastUsedFrame) return;
+   texture.ScreenSize = screenSize;
+   texture.Distance = distance;
+   texture.LastUsedFrame = frame;
+   texture.IsUsed = true;
+}
+
+void TextureStreamer::Update(uint64_t frame)
+{
+   auto start = std::chrono::steady_clock::now();
+   lastFrame = frame;
+   loads.clear();
+   evictions.clear();
+   candidates.clear();
+   victims.clear();
+   hasVictims = false;
+   stats.WantedBytes = 0;
+   stats.MissingMips = 0;
+   // 1.Wanted mips and priorities. A texture wants the finest mip at least as wide as its screen size.
+   for (int32_t i = 0; i < int32_t(textures.size()); i++)
+   {
+      Texture& texture = textures[i];
+      if (!texture.IsLive) continue;
+      uint64_t age = frame > texture.LastUsedFrame ? frame - texture.LastUsedFrame : 0;
+      if (!texture.IsUsed || age > policy.UnusedFrames)
+      {
+         texture.WantedMip = texture.TailMip;
+         texture.Priority = 0;
+      }
+      else
+      {
+         float mip = std::log2(float(std::max(texture.Width, texture.Height)) / std::max(texture.ScreenSize, 1.f)) + policy.MipBias;
+         texture.WantedMip = std::clamp(int32_t(std::floor(mip)), 0, texture.TailMip);
+         texture.Priority = texture.ScreenSize / (1 + texture.Distance * policy.DistanceWeight) / float(1 + age);
+      }
+      for (int32_t mip = texture.WantedMip; mip < texture.MipCount; mip++) stats.WantedBytes += GetMipBytes(i, mip);
+      stats.MissingMips += std::max(texture.ResidentMip - texture.WantedMip, 0);
+      if (texture.LoadingMip < 0 && texture.ResidentMip > texture.WantedMip)
+      {
+         candidates.push_back(Candidate{ GetMipValue(texture, texture.ResidentMip - 1), i, texture.ResidentMip - 1 });
+      }
+   }
+   // 2.Over the budget, e.g. after it shrank: evict the least valuable mips.
+   while (residentBytes + loadingBytes > policy.Budget && EvictBelow(INFINITY));
+   // 3.Load the most valuable mips, making room from less valuable ones.
+   std::sort(candidates.begin(), candidates.end(), IsMoreValuable<Candidate>);
+   uint64_t requested = 0;
+   for (const Candidate& candidate : candidates)
+   {
+      Texture& texture = textures[candidate.Texture];
+      // Evicted for a more valuable load.
+      if (texture.ResidentMip - 1 != candidate.Mip) continue;
+      uint64_t bytes = GetMipBytes(candidate.Texture, candidate.Mip);
+      // A mip bigger than the bandwidth still loads, alone.
+      if (requested > 0 && requested + bytes > policy.MaxLoadBytes) break;
+      bool fits = true;
+      while (fits && residentBytes + loadingBytes + bytes > policy.Budget) fits = EvictBelow(candidate.Value);
+      if (!fits || residentBytes + loadingBytes + retiringBytes + bytes > policy.Budget) continue;
+      texture.LoadingMip = candidate.Mip;
+      loadingBytes += bytes;
+      requested += bytes;
+      loads.push_back(MipRequest{ candidate.Texture, candidate.Mip });
+   }
+   stats.ResidentBytes = residentBytes;
+   stats.LoadingBytes = loadingBytes;
+   stats.RetiringBytes = retiringBytes;
+   stats.Loads = int32_t(loads.size());
+   stats.Evictions = int32_t(evictions.size());
+   stats.TotalLoads += loads.size();
+   stats.TotalEvictions += evictions.size();
+   stats.UpdateTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void TextureStreamer::CompleteLoad(int32_t index)
+{
+   if (index < 0 || index >= int32_t(textures.size()) || textures[index].LoadingMip < 0)
+      throw std::runtime_error("The streamed texture has no pending load.");
+   Texture& texture = textures[index];
+   uint64_t bytes = GetMipBytes(index, texture.LoadingMip);
+   loadingBytes -= bytes;
+   if (!texture.IsLive)
+   {
+      // Removed while loading. Nothing drew the mip, so it's free at once.
+      texture.LoadingMip = -1;
+      spareTextures.push_back(index);
+      return;
+   }
+   residentBytes += bytes;
+   texture.ResidentMip = texture.LoadingMip;
+   texture.LoadingMip = -1;
+}
+
+void TextureStreamer::Reclaim(uint64_t completedFrame)
+{
+   while (!retired.empty() && retired.front().Frame <= completedFrame)
+   {
+      retiringBytes -= retired.front().Bytes;
+      retired.pop();
+   }
+}
+
+void TextureStreamer::SetPolicy(const TextureStreamingPolicy& _policy)
+{
+   if (_policy.TailWidth <= 0 || !(_policy.DistanceWeight >= 0)) throw std::runtime_error("Invalid texture streaming policy.");
+   policy = _policy;
+}
+
+uint64_t TextureStreamer::GetMipBytes(int32_t index, int32_t mip) const
+{
+   const Texture& texture = textures[index];
+   uint64_t width = uint64_t(std::max(texture.Width >> mip, 1)), height = uint64_t(std::max(texture.Height >> mip, 1));
+   return uint64_t(std::ceil(double(width * height) * texture.BytesPerPixel));
+}
+
+float TextureStreamer::GetMipValue(const Texture& texture, int32_t mip) const
+{
+   return mip < texture.WantedMip ? 0 : texture.Priority * std::exp2(float(mip - texture.WantedMip));
+}
+
+bool TextureStreamer::EvictBelow(float value)
+{
+   // Only the finest mip of a texture can go, and not while a finer one loads.
+   if (!hasVictims)
+   {
+      for (int32_t i = 0; i < int32_t(textures.size()); i++)
+      {
+         const Texture& texture = textures[i];
+         if (!texture.IsLive || texture.LoadingMip >= 0 || texture.ResidentMip >= texture.TailMip) continue;
+         victims.push_back(Candidate{ GetMipValue(texture, texture.ResidentMip), i, texture.ResidentMip });
+      }
+      std::make_heap(victims.begin(), victims.end(), IsMoreValuable<Candidate>);
+      hasVictims = true;
+   }
+   while (!victims.empty())
+   {
+      Candidate victim = victims.front();
+      Texture& texture = textures[victim.Texture];
+      // Started loading since the heap was built.
+      if (texture.LoadingMip >= 0)
+      {
+         std::pop_heap(victims.begin(), victims.end(), IsMoreValuable<Candidate>);
+         victims.pop_back();
+         continue;
+      }
+      if (victim.Value >= value) return false;
+      std::pop_heap(victims.begin(), victims.end(), IsMoreValuable<Candidate>);
+      victims.pop_back();
+      uint64_t bytes = GetMipBytes(victim.Texture, victim.Mip);
+      residentBytes -= bytes;
+      Retire(bytes);
+      texture.ResidentMip++;
+      evictions.push_back(MipRequest{ victim.Texture, victim.Mip });
+      // Its next mip may go too, unless it's the tail.
+      if (texture.ResidentMip < texture.TailMip)
+      {
+         victims.push_back(Candidate{ GetMipValue(texture, texture.ResidentMip), victim.Texture, texture.ResidentMip });
+         std::push_heap(victims.begin(), victims.end(), IsMoreValuable<Candidate>);
+      }
+      return true;
+   }
+   return false;
+}
+
+void TextureStreamer::Retire(uint64_t bytes)
+{
+   if (bytes == 0) return;
+   retiringBytes += bytes;
+   if (!retired.empty() && retired.back().Frame == lastFrame) retired.back().Bytes += bytes;
+   else retired.push(Retired{ lastFrame, bytes });
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <queue>
+#include <vector>
+#include "../Auxiliaries.h"
+
+namespace Pillow::Graphics
+{
+   struct TextureStreamingPolicy
+   {
+      uint64_t Budget = 512 << 20;        // Bytes of all resident, loading and retiring mips.
+      uint64_t MaxLoadBytes = 16 << 20;   // Requested per Update(), like the bandwidth of the disk and the copy queue.
+      int32_t TailWidth = 64;             // Mips no wider or taller are resident from AddTexture() to RemoveTexture().
+      float MipBias = 0;                  // Added to the wanted mip, positive streams less detail.
+      float DistanceWeight = 0.01f;       // Per unit of distance, see TextureStreamer.
+      uint32_t UnusedFrames = 120;        // A texture unused for longer wants its tail only.
+   };
+
+   // Of the last Update(), except the totals.
+   struct TextureStreamingStats
+   {
+      int32_t Textures;
+      uint64_t ResidentBytes;  // Tails included.
+      uint64_t LoadingBytes;   // Requested and not completed yet.
+      uint64_t RetiringBytes;  // Dropped, and maybe still read by the GPU, see TextureStreamer::Reclaim().
+      uint64_t WantedBytes;    // If every texture had the mips it wants.
+      int32_t MissingMips;     // Wanted and not resident, over all textures.
+      int32_t Loads;
+      int32_t Evictions;
+      uint64_t TotalLoads;
+      uint64_t TotalEvictions;
+      double UpdateTime;       // Milliseconds.
+   };
+
+   // A mip to upload, or to drop once the GPU is done with the frames using it.
+   struct MipRequest
+   {
+      int32_t Texture;
+      int32_t Mip;
+   };
+
+   // Decides which mips of streamed textures are resident under a memory budget. It knows no GPU API, frames are plain values:
+   // the backend uploads the mips of GetLoads() and reports them with CompleteLoad(). It drops the mips of GetEvictions() and of
+   // removed textures once the GPU completes the frame of the last Update(), and reports that frame with Reclaim().
+   //
+   // 1.A texture starts with its tail resident, the mips up to TailWidth wide. Resident mips are always a chain down to the tail.
+   // 2.Reported uses give the wanted mip, the one whose width matches the screen size, and a priority:
+   //   ScreenSize / (1 + Distance * DistanceWeight) / (1 + frames since the last use).
+   //   A mip that many levels below the wanted one is worth 2^levels times the priority, so blurry textures load first.
+   //   Mips finer than the wanted one are worth nothing.
+   // 3.Update() requests the next finer mip of the most valuable textures, one load per texture at a time.
+   //   While a load doesn't fit the budget, the least valuable finest mips are evicted for it, if they are worth less.
+   // 4.Dropped mips count towards the budget until they are reclaimed, as the GPU may still read them. A load that only fits
+   //   once they are waits for a later Update(), so memory is never in use twice.
+   // Not thread-safe, invoke it from one thread like the game's.
+   class TextureStreamer
+   {
+   public:
+      TextureStreamer(const TextureStreamingPolicy& policy);
+
+      // "bytesPerPixel" is 0.5 for BC1 and BC4, 1 for BC3 and BC5. Its tail counts towards the budget at once, even beyond it.
+      int32_t AddTexture(int32_t width, int32_t height, int32_t mipCount, float bytesPerPixel);
+      // Its mips retire like evictions. A pending load still ends with CompleteLoad(), and the id is reused only after it.
+      void RemoveTexture(int32_t texture);
+      // A use in "frame". "screenSize" is the pixels the texture spans on screen, several uses in a frame keep the largest.
+      void ReportUse(int32_t texture, float screenSize, float distance, uint64_t frame);
+      // Evict and request for "frame", replacing the last loads and evictions.
+      void Update(uint64_t frame);
+      // The backend uploaded the mip requested for the texture, so it's resident now, or freed if the texture was removed.
+      void CompleteLoad(int32_t texture);
+      // The GPU completed "frame", so the mips dropped up to the Update() of that frame are free.
+      void Reclaim(uint64_t completedFrame);
+      // The tail width applies to textures added afterwards.
+      void SetPolicy(const TextureStreamingPolicy& policy);
+
+      ForceInline int32_t GetResidentMip(int32_t texture) const { return textures[texture].ResidentMip; }
+      ForceInline int32_t GetWantedMip(int32_t texture) const { return textures[texture].WantedMip; }
+      ForceInline const std::vector<MipRequest>& GetLoads() const { return loads; }
+      ForceInline const std::vector<MipRequest>& GetEvictions() const { return evictions; }
+      ForceInline const TextureStreamingStats& GetStats() const { return stats; }
+      // Mips are at least a texel in each dimension, and block-compressed ones aren't rounded up to whole blocks.
+      uint64_t GetMipBytes(int32_t texture, int32_t mip) const;
+
+   private:
+      struct Texture
+      {
+         int32_t Width;
+         int32_t Height;
+         int32_t MipCount;
+         float BytesPerPixel;
+         int32_t TailMip;     // The finest mip of the tail.
+         int32_t ResidentMip; // The finest resident mip.
+         int32_t LoadingMip;  // -1 if none is loading.
+         int32_t WantedMip;
+         float Priority;
+         float ScreenSize;    // Of the uses in LastUsedFrame.
+         float Distance;
+         uint64_t LastUsedFrame;
+         bool IsUsed;         // Reported since it was added.
+         bool IsLive;
+      };
+
+      // Dropped mips of the Update() of "Frame", or of textures removed after it.
+      struct Retired
+      {
+         uint64_t Frame;
+         uint64_t Bytes;
+      };
+
+      // A finer mip to load, or a finest mip to evict.
+      struct Candidate
+      {
+         float Value;
+         int32_t Texture;
+         int32_t Mip;
+      };
+
+      // What "mip" is worth to the texture, see the class comment.
+      float GetMipValue(const Texture& texture, int32_t mip) const;
+      // Evict the least valuable finest mip worth less than "value". False if there is none.
+      bool EvictBelow(float value);
+      void Retire(uint64_t bytes);
+
+      TextureStreamingPolicy policy;
+      std::vector<Texture> textures;
+      std::vector<int32_t> spareTextures;
+      std::vector<MipRequest> loads;
+      std::vector<MipRequest> evictions;
+      // Kept to reuse their memory. Victims are a min-heap by value, built once an Update() needs to evict.
+      std::vector<Candidate> candidates;
+      std::vector<Candidate> victims;
+      bool hasVictims = false;
+      uint64_t residentBytes = 0;
+      uint64_t loadingBytes = 0;
+      uint64_t retiringBytes = 0;
+      uint64_t lastFrame = 0; // Of the last Update().
+      std::queue<Retired> retired;
+      TextureStreamingStats stats{};
+   };
+}
@@ -0,0 +1,49 @@
+#include "UploadRing.h"
+#include <algorithm>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+UploadRing::UploadRing(uint64_t capacity)
+{
+   if (capacity == 0) throw std::runtime_error("The upload ring cannot be empty.");
+   stats.Capacity = capacity;
+}
+
+bool UploadRing::TryAllocate(uint64_t size, uint64_t alignment, uint64_t& offset)
+{
+   uint64_t capacity = stats.Capacity;
+   if (alignment == 0 || (alignment & (alignment - 1)) != 0 || capacity % alignment != 0)
+      throw std::runtime_error("The upload alignment must be a power of two dividing the ring's capacity.");
+   if (size > capacity) throw std::runtime_error("The upload is larger than the upload ring.");
+   // The capacity is a multiple of the alignment, so aligning the position aligns the offset.
+   uint64_t start = (head + alignment - 1) & ~(alignment - 1);
+   // Wrap around if the allocation would cross the end of the buffer.
+   if (start / capacity != (start + size - 1) / capacity && size > 0) start = (start / capacity + 1) * capacity;
+   if (start + size - tail > capacity) return false;
+   offset = start % capacity;
+   head = start + size;
+   stats.UsedBytes = head - tail;
+   stats.PeakUsedBytes = std::max(stats.PeakUsedBytes, stats.UsedBytes);
+   stats.AllocatedBytes += size;
+   stats.Allocations++;
+   return true;
+}
+
+void UploadRing::FinishFrame(uint64_t fence)
+{
+   if (!frames.empty() && fence <= frames.back().Fence) throw std::runtime_error("Upload fences must increase.");
+   if (head == frameStart) return;
+   frames.push(Frame{ fence, head });
+   frameStart = head;
+}
+
+void UploadRing::Reclaim(uint64_t completedFence)
+{
+   while (!frames.empty() && frames.front().Fence <= completedFence)
+   {
+      tail = frames.front().End;
+      frames.pop();
+   }
+   stats.UsedBytes = head - tail;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <queue>
+#include "../Auxiliaries.h"
+
+namespace Pillow::Graphics
+{
+   // Totals are counted since the ring was created.
+   struct UploadRingStats
+   {
+      uint64_t Capacity;
+      uint64_t UsedBytes;      // Not reclaimed yet, alignment and wrap-around padding included.
+      uint64_t PeakUsedBytes;
+      uint64_t AllocatedBytes; // Requested sizes only.
+      uint64_t Allocations;
+      uint64_t Stalls;         // Allocations that waited for the GPU to release a frame's uploads.
+   };
+
+   // The bookkeeping of a persistent upload buffer that all uploads suballocate from. It knows no GPU API, fences are plain values.
+   //
+   // 1.Allocations are linear. One that doesn't fit before the end of the buffer wraps around to its start, skipping the tail.
+   // 2.FinishFrame() tags the allocations made since the last call with the fence the GPU signals after copying them.
+   // 3.Reclaim() frees the frames whose fences completed, oldest first, so used bytes are always one contiguous range.
+   // If the ring is full, Allocate() waits for the oldest frame's fence, which counts as a stall.
+   class UploadRing
+   {
+   public:
+      // "capacity" must be a multiple of every alignment allocated with.
+      UploadRing(uint64_t capacity);
+
+      // The offset, or false if the ring can't hold the allocation until older frames are reclaimed.
+      // "alignment" must be a power of two.
+      bool TryAllocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+      // Like TryAllocate(), but while the ring is full, waitForFence(fence) must block until the fence completes,
+      // and return the completed fence. Throws if the ring is full of uploads of no finished frame.
+      template<typename WaitForFence>
+      uint64_t Allocate(uint64_t size, uint64_t alignment, WaitForFence&& waitForFence)
+      {
+         uint64_t offset;
+         while (!TryAllocate(size, alignment, offset))
+         {
+            if (frames.empty()) throw std::runtime_error("The uploads of one frame don't fit in the upload ring.");
+            stats.Stalls++;
+            Reclaim(waitForFence(frames.front().Fence));
+         }
+         return offset;
+      }
+      // "fence" must be greater than the ones of the finished frames. A frame without allocations is dropped.
+      void FinishFrame(uint64_t fence);
+      void Reclaim(uint64_t completedFence);
+
+      ForceInline const UploadRingStats& GetStats() const { return stats; }
+
+   private:
+      struct Frame
+      {
+         uint64_t Fence;
+         uint64_t End; // Of the frame's allocations, in the monotonic positions "head" and "tail" count.
+      };
+
+      // Positions only grow, offsets are positions modulo the capacity. So head == tail is empty, and the difference is the bytes used.
+      uint64_t head = 0, tail = 0;
+      uint64_t frameStart = 0; // Where the allocations of the unfinished frame begin.
+      std::queue<Frame> frames;
+      UploadRingStats stats{};
+   };
+}
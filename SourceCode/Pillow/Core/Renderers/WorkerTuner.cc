@@ -0,0 +1,41 @@
+#include "WorkerTuner.h"
+#include <algorithm>
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+int32_t WorkerTuner::Update(const WorkerTuningWindow& window, int32_t active, int32_t poolSize, uint64_t frameIndex)
+{
+   growCooldown = std::max(growCooldown - 1, 0);
+   shrinkCooldown = std::max(shrinkCooldown - 1, 0);
+   int32_t target = active;
+   WorkerTuningDecision::Reason reason = WorkerTuningDecision::Revert;
+   if (lastStep != 0 && window.RecordSpan > lastSpan * (1 + RevertTolerance))
+   {
+      target = active - lastStep;
+      (lastStep > 0 ? growCooldown : shrinkCooldown) = RevertCooldownWindows;
+   }
+   else if (window.Utilization > GrowUtilization && active < poolSize && growCooldown == 0)
+   {
+      target = active + 1;
+      reason = WorkerTuningDecision::Grow;
+   }
+   else if (window.Utilization < ShrinkUtilization && active > 1 && shrinkCooldown == 0)
+   {
+      target = active - 1;
+      reason = WorkerTuningDecision::Shrink;
+   }
+   lastStep = reason == WorkerTuningDecision::Revert ? 0 : target - active;
+   lastSpan = window.RecordSpan;
+   if (target != active)
+   {
+      if (decisions.size() >= MaxDecisions) decisions.erase(decisions.begin());
+      decisions.push_back(WorkerTuningDecision{ frameIndex, reason, active, target, window.Utilization, window.RecordSpan, window.BarrierWaitTime });
+   }
+   return target;
+}
+
+void WorkerTuner::Reset()
+{
+   lastStep = 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include "../Auxiliaries.h"
+
+namespace Pillow::Graphics
+{
+   // A change of the active worker count made by the autotuner, see GenericRenderer::SetWorkerAutotuning().
+   // Measurements are means over the window of frames before the change, times are in milliseconds.
+   struct WorkerTuningDecision
+   {
+      enum Reason : uint8_t
+      {
+         Grow,   // Workers were busy most of the recording span.
+         Shrink, // Workers mostly waited at the frame barrier.
+         Revert  // The last change made the recording span longer.
+      };
+
+      uint64_t FrameIndex;
+      Reason ChangeReason;
+      int32_t FromWorkers;
+      int32_t ToWorkers;
+      double Utilization;     // Busy time of the active workers over the recording span.
+      double RecordSpan;      // From kicking the workers to the last one arriving at the frame barrier.
+      double BarrierWaitTime; // Per active worker.
+   };
+
+   // Means of a window of frames recorded by the same active workers.
+   struct WorkerTuningWindow
+   {
+      double Utilization;
+      double RecordSpan;
+      double BarrierWaitTime;
+   };
+
+   // Picks the active worker count from windows of frames, portable CPU logic.
+   // 1.Above GrowUtilization, the workers are busy most of the span, so one more is activated. Below ShrinkUtilization, they
+   // mostly wait at the frame barrier, so one is parked.
+   // 2.The window after a change checks it: if the span grew by more than RevertTolerance, the change is reverted, and that
+   // direction is held back for RevertCooldownWindows windows. A revert is final, it isn't checked again.
+   // 3.Changes are logged, the oldest are dropped past MaxDecisions.
+   class WorkerTuner
+   {
+   public:
+      static const int32_t WindowFrames = 64;
+      static const int32_t RevertCooldownWindows = 16;
+      static const size_t MaxDecisions = 1024;
+      static constexpr double GrowUtilization = 0.8;
+      static constexpr double ShrinkUtilization = 0.5;
+      static constexpr double RevertTolerance = 0.05;
+
+      // Take the window recorded by "active" of "poolSize" workers, and return the count for the next one.
+      // frameIndex: Logged with a change.
+      int32_t Update(const WorkerTuningWindow& window, int32_t active, int32_t poolSize, uint64_t frameIndex);
+      // Forget the last change, e.g. after the count was set by hand. Cooldowns and the log are kept.
+      void Reset();
+      ForceInline const std::vector<WorkerTuningDecision>& GetDecisions() const { return decisions; }
+
+   private:
+      int32_t lastStep = 0;   // +1 or -1 if the last window changed the count, checked by the next window.
+      double lastSpan = 0;    // The mean recording span before that change.
+      int32_t growCooldown = 0;
+      int32_t shrinkCooldown = 0;
+      std::vector<WorkerTuningDecision> decisions;
+   };
+}
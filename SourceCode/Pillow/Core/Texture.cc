@@ -110,7 +110,7 @@ GenericTextureInfo::GenericTextureInfo(GenericTexFmt format, int32_t width, bool
    f_IsCubemap(bCube),
    f_CompressionMode(compMode)
 {
-   if (width < 4 || (width & (width - 1))) throw std::exception("Texture width restriction: w=2^n and w>=4");
+   if (width < 4 || (width & (width - 1))) throw std::runtime_error("Texture width restriction: w=2^n and w>=4");
    int32_t power = std::log2f(width);
    // The lowest mipmap limit is 4x4, needed by block compression.
    f_MipCount = bMips ? power - 1 : 1;
@@ -137,8 +137,8 @@ void Pillow::Graphics::LoadTexture(const string& relativePath)
    //state.decoder.ignore_crc = 1;
    //state.decoder.zlibsettings.ignore_adler32 = 1;
    lodepng::decode(imageData, w, h, state, fileData);
-   if (state.info_raw.bitdepth != 8) throw std::exception("Bitdepth should be 8.");
-   if (w!=h) throw std::exception("The image should be square.");
+   if (state.info_raw.bitdepth != 8) throw std::runtime_error("Bitdepth should be 8.");
+   if (w!=h) throw std::runtime_error("The image should be square.");
    GenericTextureInfo texInfo;
    if (state.info_raw.colortype == LCT_GREY)
    {
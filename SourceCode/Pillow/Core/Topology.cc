@@ -0,0 +1,368 @@
+#include "Topology.h"
+#include <thread>
+#include <algorithm>
+#include <tuple>
+#include <map>
+#include <set>
+#if defined(_WIN64)
+#elif defined(__ANDROID__) || defined(__linux__)
+#include <fstream>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace Pillow;
+
+namespace
+{
+   // CPUs at or above 3/4 of the fastest one count as performance cores. Tri-cluster SoCs have their prime and big cores there.
+   const int32_t PerformanceCapacity = 768;
+
+   ForceInline bool IsPerformance(const LogicalCpu& cpu)
+   {
+      return cpu.Capacity >= PerformanceCapacity;
+   }
+
+#if defined(__ANDROID__) || defined(__linux__)
+   // Nice values of ThreadPriority. They are per thread on Linux, and raising one needs CAP_SYS_NICE or an RLIMIT_NICE allowance.
+   const int NiceValues[] = { 10, 0, -5 };
+
+   string ReadLine(const string& path)
+   {
+      std::ifstream file(path);
+      string line;
+      std::getline(file, line);
+      return line;
+   }
+
+   int64_t ReadInteger(const string& path, int64_t fallback)
+   {
+      string line = ReadLine(path);
+      if (line.empty()) return fallback;
+      try
+      {
+         return std::stoll(line);
+      }
+      catch (std::exception&)
+      {
+         return fallback;
+      }
+   }
+
+   // Lists like "0-3,6,8-9".
+   std::vector<int32_t> ParseCpuList(const string& list)
+   {
+      std::vector<int32_t> result;
+      size_t position = 0;
+      while (position < list.size())
+      {
+         size_t end = list.find(',', position);
+         if (end == string::npos) end = list.size();
+         string range = list.substr(position, end - position);
+         position = end + 1;
+         size_t dash = range.find('-');
+         try
+         {
+            int32_t first = std::stoi(range.substr(0, dash));
+            int32_t last = dash == string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int32_t cpu = first; cpu <= last; cpu++) result.push_back(cpu);
+         }
+         catch (std::exception&)
+         {
+            // Blank or malformed ranges are skipped.
+         }
+      }
+      return result;
+   }
+
+   ForceInline int32_t LowestCpu(const std::vector<int32_t>& list, int32_t fallback)
+   {
+      return list.empty() ? fallback : *std::min_element(list.begin(), list.end());
+   }
+#endif
+}
+
+CpuTopology CpuTopology::Discover()
+{
+   CpuTopology topology;
+#if defined(_WIN64)
+   // Only processor group 0 is read, which covers up to 64 logical processors.
+   DWORD length = 0;
+   GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+   std::vector<uint8_t> buffer(length);
+   auto* information = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data());
+   DWORD_PTR processMask = 0, systemMask = 0;
+   if (length > 0 && GetLogicalProcessorInformationEx(RelationAll, information, &length) && GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+   {
+      std::map<int32_t, LogicalCpu> cpus;
+      std::map<int32_t, int32_t> cacheLevels, cacheDomains;
+      for (DWORD offset = 0; offset < length;)
+      {
+         auto& item = *reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+         offset += item.Size;
+         if (item.Relationship == RelationProcessorCore && item.Processor.GroupMask[0].Group == 0)
+         {
+            KAFFINITY mask = item.Processor.GroupMask[0].Mask & processMask;
+            int32_t core = -1;
+            for (int32_t i = 0; i < 64; i++)
+            {
+               if (!(mask & (KAFFINITY(1) << i))) continue;
+               if (core < 0) core = i;
+               // Efficiency classes are ranks, higher is faster. They're turned into capacities below.
+               cpus[i] = LogicalCpu{ i, core, 0, item.Processor.EfficiencyClass };
+            }
+         }
+         else if (item.Relationship == RelationCache && item.Cache.Type != CacheInstruction && item.Cache.GroupMask.Group == 0)
+         {
+            KAFFINITY mask = item.Cache.GroupMask.Mask;
+            int32_t domain = -1;
+            for (int32_t i = 0; i < 64; i++)
+            {
+               if (!(mask & (KAFFINITY(1) << i))) continue;
+               if (domain < 0) domain = i;
+               if (item.Cache.Level > cacheLevels[i])
+               {
+                  cacheLevels[i] = item.Cache.Level;
+                  cacheDomains[i] = domain;
+               }
+            }
+         }
+      }
+      int32_t maxClass = 0;
+      for (auto& [index, cpu] : cpus) maxClass = std::max(maxClass, cpu.Capacity);
+      for (auto& [index, cpu] : cpus)
+      {
+         if (!(processMask & (KAFFINITY(1) << index))) continue;
+         cpu.Capacity = 1024 * (cpu.Capacity + 1) / (maxClass + 1);
+         cpu.CacheDomain = cacheDomains.contains(index) ? cacheDomains[index] : 0;
+         topology.cpus.push_back(cpu);
+      }
+   }
+#elif defined(__ANDROID__) || defined(__linux__)
+   topology = ParseSysfs("/sys/devices/system/cpu", GetThreadAffinity());
+#endif
+   if (topology.cpus.empty())
+   {
+      // Nothing to read, assume a homogeneous CPU without SMT.
+      int32_t count = std::max(int32_t(std::thread::hardware_concurrency()), 1);
+      for (int32_t i = 0; i < count; i++) topology.cpus.push_back(LogicalCpu{ i, i, 0, 1024 });
+   }
+   topology.Finish();
+   return topology;
+}
+
+#if defined(__ANDROID__) || defined(__linux__)
+CpuTopology CpuTopology::ParseSysfs(const string& root, const std::vector<int32_t>& allowedCpus)
+{
+   CpuTopology topology;
+   std::set<int32_t> allowed(allowedCpus.begin(), allowedCpus.end());
+   // Hybrid Intel parts list their efficiency cores under the cpu_atom PMU. Their maximum frequencies are too close to
+   // the performance cores' to tell them apart, so their capacities are halved.
+   std::vector<int32_t> atomList = ParseCpuList(ReadLine(root + "/../../cpu_atom/cpus"));
+   std::set<int32_t> atoms(atomList.begin(), atomList.end());
+   for (int32_t index : ParseCpuList(ReadLine(root + "/online")))
+   {
+      if (!allowed.empty() && !allowed.contains(index)) continue;
+      string base = root + "/cpu" + std::to_string(index);
+      LogicalCpu cpu{ index, LowestCpu(ParseCpuList(ReadLine(base + "/topology/thread_siblings_list")), index), -1, 0 };
+      // The highest data or unified cache level is the last-level cache.
+      int64_t lastLevel = 0;
+      for (int32_t i = 0;; i++)
+      {
+         string cache = base + "/cache/index" + std::to_string(i);
+         int64_t level = ReadInteger(cache + "/level", -1);
+         if (level < 0) break;
+         if (ReadLine(cache + "/type") == "Instruction" || level <= lastLevel) continue;
+         lastLevel = level;
+         cpu.CacheDomain = LowestCpu(ParseCpuList(ReadLine(cache + "/shared_cpu_list")), index);
+      }
+      // Without cache information, a cluster or a package is the closest guess.
+      if (cpu.CacheDomain < 0) cpu.CacheDomain = LowestCpu(ParseCpuList(ReadLine(base + "/topology/cluster_cpus_list")), -1);
+      if (cpu.CacheDomain < 0) cpu.CacheDomain = LowestCpu(ParseCpuList(ReadLine(base + "/topology/core_siblings_list")), 0);
+      // Arm kernels publish capacities. Elsewhere, hybrid cores differ in their maximum frequencies.
+      int64_t capacity = ReadInteger(base + "/cpu_capacity", 0);
+      if (capacity <= 0) capacity = ReadInteger(base + "/cpufreq/cpuinfo_max_freq", 0);
+      if (atoms.contains(index)) capacity /= 2;
+      cpu.Capacity = int32_t(std::min<int64_t>(capacity, INT32_MAX));
+      topology.cpus.push_back(cpu);
+   }
+   topology.Finish();
+   return topology;
+}
+#endif
+
+void CpuTopology::Finish()
+{
+   std::sort(cpus.begin(), cpus.end(), [](const LogicalCpu& a, const LogicalCpu& b) { return a.Index < b.Index; });
+   int64_t maxCapacity = 0;
+   for (const LogicalCpu& cpu : cpus) maxCapacity = std::max<int64_t>(maxCapacity, cpu.Capacity);
+   for (LogicalCpu& cpu : cpus)
+   {
+      cpu.Capacity = maxCapacity > 0 ? int32_t(std::max<int64_t>(int64_t(cpu.Capacity) * 1024 / maxCapacity, 1)) : 1024;
+   }
+}
+
+bool CpuTopology::IsHybrid() const
+{
+   return std::any_of(cpus.begin(), cpus.end(), [](const LogicalCpu& cpu) { return !IsPerformance(cpu); });
+}
+
+int32_t CpuTopology::GetCoreCount() const
+{
+   return int32_t(std::count_if(cpus.begin(), cpus.end(), [](const LogicalCpu& cpu) { return cpu.Index == cpu.Core; }));
+}
+
+int32_t CpuTopology::GetCacheDomainCount() const
+{
+   std::set<int32_t> domains;
+   for (const LogicalCpu& cpu : cpus) domains.insert(cpu.CacheDomain);
+   return int32_t(domains.size());
+}
+
+ThreadPlacementPolicy::ThreadPlacementPolicy(const CpuTopology& topology, AffinityMode mode, int32_t rendererThreads, int32_t tickThreads, int32_t physicsThreads)
+{
+   const std::vector<LogicalCpu>& cpus = topology.GetCpus();
+   // The primary domain has the most performance cores by capacity.
+   std::map<int32_t, int64_t> domainCapacities;
+   for (const LogicalCpu& cpu : cpus)
+   {
+      if (cpu.Index == cpu.Core && IsPerformance(cpu)) domainCapacities[cpu.CacheDomain] += cpu.Capacity;
+   }
+   int32_t primary = -1;
+   int64_t primaryCapacity = 0;
+   for (const auto& [domain, capacity] : domainCapacities)
+   {
+      if (capacity > primaryCapacity)
+      {
+         primary = domain;
+         primaryCapacity = capacity;
+      }
+   }
+   // Physical cores before SMT siblings, performance cores before efficiency ones, the primary domain first, then faster ones.
+   std::vector<const LogicalCpu*> ranked;
+   for (const LogicalCpu& cpu : cpus) ranked.push_back(&cpu);
+   std::stable_sort(ranked.begin(), ranked.end(), [primary](const LogicalCpu* a, const LogicalCpu* b)
+      {
+         return std::make_tuple(a->Index != a->Core, !IsPerformance(*a), a->CacheDomain != primary, -a->Capacity) <
+            std::make_tuple(b->Index != b->Core, !IsPerformance(*b), b->CacheDomain != primary, -b->Capacity);
+      });
+
+   auto Place = [&](const LogicalCpu* cpu, ThreadPriority priority)
+      {
+         ThreadPlacement placement{ cpu ? cpu->Index : -1, {}, priority };
+         if (!cpu || mode == AffinityMode::None) return placement;
+         if (mode == AffinityMode::Pinned)
+         {
+            placement.Cpus.push_back(cpu->Index);
+            return placement;
+         }
+         for (const LogicalCpu& other : cpus)
+         {
+            if (other.CacheDomain == cpu->CacheDomain && IsPerformance(other) == IsPerformance(*cpu)) placement.Cpus.push_back(other.Index);
+         }
+         return placement;
+      };
+   // The game thread keeps ranked[0], the others wrap around the rest once CPUs run out.
+   int32_t cursor = 1;
+   auto Next = [&]() -> const LogicalCpu*
+      {
+         if (ranked.empty()) return nullptr;
+         if (ranked.size() == 1) return ranked[0];
+         const LogicalCpu* cpu = ranked[1 + (cursor - 1) % (ranked.size() - 1)];
+         cursor++;
+         return cpu;
+      };
+   placements[size_t(ThreadRole::Game)].push_back(Place(ranked.empty() ? nullptr : ranked[0], ThreadPriority::High));
+   for (int32_t i = 0; i < rendererThreads; i++) placements[size_t(ThreadRole::Renderer)].push_back(Place(Next(), ThreadPriority::High));
+   for (int32_t i = 0; i < tickThreads; i++) placements[size_t(ThreadRole::Tick)].push_back(Place(Next(), ThreadPriority::Normal));
+   for (int32_t i = 0; i < physicsThreads; i++) placements[size_t(ThreadRole::Physics)].push_back(Place(Next(), ThreadPriority::Normal));
+   // Background threads take all efficiency cores of hybrid CPUs, and anything elsewhere.
+   ThreadPlacement background{ ranked.empty() ? -1 : ranked.back()->Index, {}, ThreadPriority::Low };
+   if (mode != AffinityMode::None && topology.IsHybrid())
+   {
+      for (const LogicalCpu& cpu : cpus)
+      {
+         if (!IsPerformance(cpu)) background.Cpus.push_back(cpu.Index);
+      }
+      background.Cpu = background.Cpus.front();
+   }
+   placements[size_t(ThreadRole::Background)].push_back(background);
+}
+
+const ThreadPlacement& ThreadPlacementPolicy::Get(ThreadRole role, int32_t index) const
+{
+   const std::vector<ThreadPlacement>& rolePlacements = placements[size_t(role)];
+   if (index < 0 || index >= int32_t(rolePlacements.size())) throw std::runtime_error("Invalid thread index for the role.");
+   return rolePlacements[index];
+}
+
+bool Pillow::ApplyThreadPlacement(const ThreadPlacement& placement)
+{
+   bool succeeded = true;
+#if defined(_WIN64)
+   if (!placement.Cpus.empty())
+   {
+      DWORD_PTR mask = 0;
+      for (int32_t cpu : placement.Cpus)
+      {
+         if (cpu < 64) mask |= DWORD_PTR(1) << cpu;
+      }
+      if (SetThreadAffinityMask(GetCurrentThread(), mask) == 0) succeeded = false;
+   }
+   const int priorities[] = { THREAD_PRIORITY_BELOW_NORMAL, THREAD_PRIORITY_NORMAL, THREAD_PRIORITY_ABOVE_NORMAL };
+   if (!SetThreadPriority(GetCurrentThread(), priorities[size_t(placement.Priority)])) succeeded = false;
+#elif defined(__ANDROID__) || defined(__linux__)
+   if (!placement.Cpus.empty())
+   {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      for (int32_t cpu : placement.Cpus)
+      {
+         if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+      }
+      // Pid 0 is the calling thread.
+      if (sched_setaffinity(0, sizeof(set), &set) != 0) succeeded = false;
+   }
+   if (setpriority(PRIO_PROCESS, id_t(syscall(SYS_gettid)), NiceValues[size_t(placement.Priority)]) != 0) succeeded = false;
+#endif
+   return succeeded;
+}
+
+std::vector<int32_t> Pillow::GetThreadAffinity()
+{
+   std::vector<int32_t> result;
+#if defined(_WIN64)
+   GROUP_AFFINITY affinity{};
+   if (GetThreadGroupAffinity(GetCurrentThread(), &affinity) && affinity.Group == 0)
+   {
+      for (int32_t i = 0; i < 64; i++)
+      {
+         if (affinity.Mask & (KAFFINITY(1) << i)) result.push_back(i);
+      }
+   }
+#elif defined(__ANDROID__) || defined(__linux__)
+   cpu_set_t set;
+   CPU_ZERO(&set);
+   if (sched_getaffinity(0, sizeof(set), &set) == 0)
+   {
+      for (int32_t i = 0; i < CPU_SETSIZE; i++)
+      {
+         if (CPU_ISSET(i, &set)) result.push_back(i);
+      }
+   }
+#endif
+   return result;
+}
+
+int32_t Pillow::GetCurrentCpu()
+{
+#if defined(_WIN64)
+   return int32_t(GetCurrentProcessorNumber());
+#elif defined(__ANDROID__) || defined(__linux__)
+   return sched_getcpu();
+#else
+   return -1;
+#endif
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include "Auxiliaries.h"
+
+namespace Pillow
+{
+   // A logical processor the process may run on.
+   struct LogicalCpu
+   {
+      int32_t Index;       // The OS's CPU number, as used by affinity masks.
+      int32_t Core;        // The lowest CPU of its physical core, SMT siblings share it.
+      int32_t CacheDomain; // The lowest CPU sharing its last-level cache.
+      int32_t Capacity;    // Relative performance, the fastest CPU is 1024. Efficiency cores are lower.
+   };
+
+   // Linux and Android read /sys/devices/system/cpu, Windows asks GetLogicalProcessorInformationEx().
+   class CpuTopology
+   {
+   public:
+      // The CPUs in the calling thread's affinity set, so containers and taskset limits are respected.
+      static CpuTopology Discover();
+#if defined(__ANDROID__) || defined(__linux__)
+      // Parse a sysfs CPU directory, "root" is usually /sys/devices/system/cpu. An empty "allowedCpus" allows all online CPUs.
+      static CpuTopology ParseSysfs(const string& root, const std::vector<int32_t>& allowedCpus);
+#endif
+
+      ForceInline const std::vector<LogicalCpu>& GetCpus() const { return cpus; }
+      // Performance and efficiency cores are mixed, like big.LITTLE SoCs and hybrid Intel parts.
+      bool IsHybrid() const;
+      int32_t GetCoreCount() const;
+      int32_t GetCacheDomainCount() const;
+
+   private:
+      // Sort by index and normalize capacities, so the fastest one is 1024.
+      void Finish();
+
+      std::vector<LogicalCpu> cpus;
+   };
+
+   enum class ThreadRole : uint8_t
+   {
+      Game,
+      Renderer,
+      Tick,
+      Physics,
+      Background,
+      Count
+   };
+
+   enum class ThreadPriority : uint8_t
+   {
+      Low,
+      Normal,
+      High
+   };
+
+   enum class AffinityMode : uint8_t
+   {
+      None,    // Priorities only, the OS places threads.
+      Cluster, // Threads float over the cores like their preferred one that share its cache.
+      Pinned   // Each thread stays on its preferred CPU.
+   };
+
+   struct ThreadPlacement
+   {
+      int32_t Cpu;              // The preferred CPU, -1 if there is no topology.
+      std::vector<int32_t> Cpus; // The affinity set, empty means any CPU.
+      ThreadPriority Priority;
+   };
+
+   // Assigns CPUs to the engine's threads by role. Cores are ranked by capacity, and the fastest cache domain comes first:
+   // 1.The game thread takes the best core.
+   // 2.Renderer workers follow on the next physical cores. They read what the game thread submits, so they share its cache
+   // as long as the domain has cores. Worker 0 gets the best one, since the autotuner activates workers in index order.
+   // 3.Tick and physics threads take the cores left, then efficiency cores, then SMT siblings. They wrap around if CPUs run out.
+   // 4.Background threads prefer efficiency cores, and never compete with the above on hybrid CPUs.
+   class ThreadPlacementPolicy
+   {
+   public:
+      ThreadPlacementPolicy(const CpuTopology& topology, AffinityMode mode, int32_t rendererThreads, int32_t tickThreads, int32_t physicsThreads);
+      // "index" is the thread's index within its role, Game and Background only have 0.
+      const ThreadPlacement& Get(ThreadRole role, int32_t index = 0) const;
+      ForceInline const std::vector<ThreadPlacement>& GetAll(ThreadRole role) const { return placements[size_t(role)]; }
+
+   private:
+      std::vector<ThreadPlacement> placements[size_t(ThreadRole::Count)];
+   };
+
+   // Apply a placement to the calling thread. Return false if the OS refused a part of it, e.g. raising the priority
+   // without privileges. Both parts are always attempted.
+   bool ApplyThreadPlacement(const ThreadPlacement& placement);
+   // The calling thread's affinity set.
+   std::vector<int32_t> GetThreadAffinity();
+   // The CPU the calling thread runs on, -1 if unknown.
+   int32_t GetCurrentCpu();
+}
@@ -1,16 +1,24 @@
+#include <charconv>
 #include <iostream>
 #include <thread>
 #include "DirectXMath-apr2025/DirectXMath.h"
 #include "Core/Constants.h"
 #include "Core/Renderers/Renderer.h"
+#include "Core/Renderers/RenderProxy.h"
 #include "Core/Input.h"
 #include "Core/Auxiliaries.h"
+#include "Core/Topology.h"
 #if defined(_WIN64)
 #define NOMINMAX
 #include <Windows.h>
 #include <WinUser.h>
 #undef NOMINMAX
 #elif defined(__ANDROID__)
+#elif defined(__linux__)
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
 #endif
 
 extern void TempCode();
@@ -26,6 +34,9 @@ namespace
    void EngineTerminate();
 
    GameClock GlobalClock;
+   CpuTopology Topology;
+   AffinityMode Affinity = AffinityMode::Cluster;
+   ThreadPlacement TickPlacement; // For a game tick running on its own thread.
 
 #if defined(_WIN64)
    HWND hwnd;
@@ -208,18 +219,325 @@ namespace
       isFullscreen = fullScreen;
    }
 #elif defined(__ANDROID__)
+#elif defined(__linux__)
+   // Headless: there is no window, the engine runs until the frame limit is reached or SIGINT/SIGTERM arrives.
+   volatile std::sig_atomic_t quitRequested = 0;
+   uint64_t maxFrames = 0; // 0 means unlimited.
+   double gpuLatency = 0;  // Fake GPU time per frame in milliseconds, consumed by the NullRenderer.
+   double tickTime = 0;    // Fake game tick time per frame in milliseconds.
+   int32_t drawcallCount = 0; // Synthetic drawcalls submitted per tick, with random sort keys.
+   bool occluders = false; // Submit a wall in front of the camera, hiding part of the synthetic items.
+   bool lods = false;      // Give the synthetic meshes 4 levels of detail.
+   int64_t triangleBudget = 0;
+   bool proxies = false;     // Keep the synthetic items as render proxies, moving a 16th of them per tick, instead of submitting them.
+   bool tickThread = false;  // Tick the proxies on their own thread, overlapping the renderer's Commit().
+   bool dynamicResolution = false; // Scale the fake GPU time by the chosen render scale, aiming at the refresh interval.
+   bool shadows = false;     // Cast shadows of a sun from the synthetic items, and report casters per cascade.
+   int32_t lightCount = 0;   // Synthetic lights submitted per tick in front of the camera, a quarter of them spot lights.
+   int32_t pinnedWorkers = 0; // 0 lets the autotuner choose.
+   const char* tuningPath = nullptr; // Export the worker autotuning decisions on exit as CSV.
+   const char* timelinePath = nullptr; // Export the frame timeline on exit, JSON if it ends with ".json", otherwise CSV.
+   PipeliningMode pipelining = PipeliningMode::FramesInFlight;
+   int32_t framesInFlight = Constants::SwapChainSize;
+
+   void ParseArguments(int argc, char** argv);
+   void GameLoop();
+
+   void ParseArguments(int argc, char** argv)
+   {
+      auto Usage = [argv]()
+      {
+         std::fprintf(stderr, "Usage: %s [--frames N] [--gpu-latency MS] [--tick-time MS] [--drawcalls N] [--lights N] [--occluders] [--lods] [--triangle-budget N] [--dynamic-resolution] [--shadows] [--proxies] [--tick-thread] [--pipelining sync|async|N] [--workers N] [--affinity none|cluster|pinned] [--timeline PATH] [--tuning PATH]\n"
+            "  --pipelining N: 1 to %d frames in flight, 1 is async.\n", argv[0], Constants::SwapChainSize);
+         exit(EXIT_FAILURE);
+      };
+      for (int i = 1; i < argc; i++)
+      {
+         bool hasValue = i + 1 < argc;
+         if (hasValue && std::strcmp(argv[i], "--frames") == 0) maxFrames = std::strtoull(argv[++i], nullptr, 10);
+         else if (hasValue && std::strcmp(argv[i], "--gpu-latency") == 0) gpuLatency = std::strtod(argv[++i], nullptr);
+         else if (hasValue && std::strcmp(argv[i], "--tick-time") == 0) tickTime = std::strtod(argv[++i], nullptr);
+         else if (hasValue && std::strcmp(argv[i], "--drawcalls") == 0) drawcallCount = std::atoi(argv[++i]);
+         else if (hasValue && std::strcmp(argv[i], "--lights") == 0) lightCount = std::atoi(argv[++i]);
+         else if (hasValue && std::strcmp(argv[i], "--timeline") == 0) timelinePath = argv[++i];
+         else if (hasValue && std::strcmp(argv[i], "--workers") == 0) pinnedWorkers = std::atoi(argv[++i]);
+         else if (hasValue && std::strcmp(argv[i], "--tuning") == 0) tuningPath = argv[++i];
+         else if (hasValue && std::strcmp(argv[i], "--affinity") == 0)
+         {
+            const char* mode = argv[++i];
+            if (std::strcmp(mode, "none") == 0) Affinity = AffinityMode::None;
+            else if (std::strcmp(mode, "pinned") == 0) Affinity = AffinityMode::Pinned;
+            else if (std::strcmp(mode, "cluster") == 0) Affinity = AffinityMode::Cluster;
+            else Usage();
+         }
+         else if (std::strcmp(argv[i], "--occluders") == 0) occluders = true;
+         else if (std::strcmp(argv[i], "--lods") == 0) lods = true;
+         else if (std::strcmp(argv[i], "--dynamic-resolution") == 0) dynamicResolution = true;
+         else if (std::strcmp(argv[i], "--shadows") == 0) shadows = true;
+         else if (std::strcmp(argv[i], "--proxies") == 0) proxies = true;
+         else if (std::strcmp(argv[i], "--tick-thread") == 0) proxies = tickThread = true;
+         else if (hasValue && std::strcmp(argv[i], "--triangle-budget") == 0) triangleBudget = std::strtoll(argv[++i], nullptr, 10);
+         else if (hasValue && std::strcmp(argv[i], "--pipelining") == 0)
+         {
+            // "sync", "async" or the number of frames in flight.
+            const char* mode = argv[++i];
+            if (std::strcmp(mode, "sync") == 0) pipelining = PipeliningMode::Synchronous;
+            else if (std::strcmp(mode, "async") == 0) pipelining = PipeliningMode::AsyncSingleBuffer;
+            else
+            {
+               // A typo must not silently measure another mode.
+               const char* end = mode + std::strlen(mode);
+               auto [parsed, error] = std::from_chars(mode, end, framesInFlight);
+               if (error != std::errc() || parsed != end || framesInFlight < 1 || framesInFlight > Constants::SwapChainSize) Usage();
+               pipelining = framesInFlight == 1 ? PipeliningMode::AsyncSingleBuffer : PipeliningMode::FramesInFlight;
+            }
+         }
+         else Usage();
+      }
+      // A headless renderer has no monitor, assume a common one.
+      RefreshRate = 60;
+      ScreenSize = XMINT2{ 1920, 1080 };
+   }
+
+   void GameLoop()
+   {
+      auto OnSignal = [](int) { quitRequested = 1; };
+      std::signal(SIGINT, OnSignal);
+      std::signal(SIGTERM, OnSignal);
+      try
+      {
+         EngineLaunch();
+#ifdef PILLOW_DEBUG
+         TempCode();
+#endif
+         Graphics::Instance->SetPipelining(pipelining, framesInFlight);
+         if (pinnedWorkers > 0)
+         {
+            Graphics::Instance->SetWorkerAutotuning(false);
+            Graphics::Instance->SetActiveWorkerCount(pinnedWorkers);
+         }
+         // A camera at the origin looking at +Z, while the synthetic items fill a cube around it.
+         Graphics::Instance->SetCamera(XMMatrixIdentity(), XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.f / 9.f, 0.1f, 1000.f));
+         Graphics::Instance->SetLodPolicy(1, 0.25f, triangleBudget);
+         Graphics::Instance->SetDynamicResolution(dynamicResolution);
+         Graphics::Instance->SetShadows(shadows, XMFLOAT3(0.3f, -1, 0.4f));
+         const XMFLOAT3 wall[6] = { {-60, -40, 100}, {60, -40, 100}, {60, 40, 100}, {-60, -40, 100}, {60, 40, 100}, {-60, 40, 100} };
+         // Real handles, so debug builds can validate the recorded command streams.
+         NullRenderer& renderer = static_cast<NullRenderer&>(*Graphics::Instance);
+         ResourceHandle pipelineState = renderer.CreateResource(ResourceType::PiplelineState);
+         ResourceHandle meshes[64], materials[4];
+         for (ResourceHandle& mesh : meshes) mesh = renderer.CreateResource(ResourceType::Mesh);
+         for (ResourceHandle& material : materials) material = renderer.CreateResource(ResourceType::ConstantBuffer);
+         // Level l of mesh m is meshes[m + 16 * l], with a quarter of the triangles and 5x the error of the previous one.
+         LodChain lodChains[16];
+         for (uint32_t mesh = 0; mesh < 16; mesh++)
+         {
+            lodChains[mesh].AddLevel(meshes[mesh], 4096, 0);
+            for (uint32_t level = 1; level < 4; level++)
+            {
+               lodChains[mesh].AddLevel(meshes[mesh + 16 * level], 4096 >> (2 * level), 0.02f * std::pow(5.f, float(level - 1)));
+            }
+         }
+         std::vector<uint8_t> lodLevels(drawcallCount);
+         // A static scene of 16 meshes x 4 materials, so the batching stage has instances to merge. Return the mesh index.
+         auto MakeItem = [&](int32_t i, Drawcall& drawcall, XMFLOAT3& position)
+            {
+               uint32_t random = uint32_t(i) * 2654435761u;
+               uint32_t mesh = random >> 28, material = (random >> 24) & 3;
+               drawcall = Drawcall{ MakeSortKey(0, pipelineState, materials[material], 0, meshes[mesh], float(random & 0xFFFF)), meshes[mesh],
+                  materials[material], pipelineState, InstanceData{} };
+               position = XMFLOAT3(float(random % 1000) - 500.f, float(random / 1000 % 1000) - 500.f, float(random / 1000000 % 1000) - 500.f);
+               drawcall.Instance.World = XMFLOAT3X4(1, 0, 0, position.x, 0, 1, 0, position.y, 0, 0, 1, position.z);
+               return mesh;
+            };
+         ProxyScene scene(proxies ? drawcallCount : 0);
+         std::vector<ProxyId> proxyIds;
+         if (proxies)
+         {
+            for (int32_t i = 0; i < drawcallCount; i++)
+            {
+               RenderProxy proxy{};
+               XMFLOAT3 position;
+               MakeItem(i, proxy.Draw, position);
+               proxy.Bounds = BoundingBox(position, XMFLOAT3(1, 1, 1));
+               proxy.IsVisible = true;
+               proxyIds.push_back(scene.Create(proxy));
+            }
+            Graphics::Instance->SetProxyScene(&scene);
+         }
+         // Every tick, a 16th of the proxies bob up or down, the rest is left alone.
+         auto TickProxies = [&](uint64_t tick)
+            {
+               if (tickTime > 0) std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(tickTime));
+               float offset = tick / 16 % 2 ? -1.f : 1.f;
+               for (size_t i = tick % 16; i < proxyIds.size(); i += 16)
+               {
+                  RenderProxy proxy = scene.Get(proxyIds[i]);
+                  proxy.Draw.Instance.World._24 += offset;
+                  proxy.Bounds.Center.y += offset;
+                  scene.SetTransform(proxyIds[i], proxy.Draw.Instance.World, proxy.Bounds);
+               }
+               scene.Publish();
+            };
+         uint64_t ticks = 0;
+         std::jthread ticker; // Declared after what it uses, so it's joined first if the loop throws.
+         if (tickThread)
+         {
+            ticker = std::jthread([&](std::stop_token stop)
+               {
+                  if (!ApplyThreadPlacement(TickPlacement)) LogSystem("The tick thread was not fully placed, the OS refused its affinity or priority.");
+                  while (!stop.stop_requested()) TickProxies(ticks++);
+               });
+         }
+         // Lights scattered through the first 300 units of the view, drifting sideways every tick so they stay dynamic.
+         auto SubmitLights = [&](uint64_t frame)
+            {
+               float drift = std::sin(float(frame) * 0.05f) * 10;
+               for (int32_t i = 0; i < lightCount; i++)
+               {
+                  uint32_t random = uint32_t(i + 1) * 2246822519u;
+                  float z = float(random % 300) + 1;
+                  Light light{};
+                  light.Position = XMFLOAT3((float(random / 300 % 1000) / 500 - 1) * z * 0.6f + drift, (float(random / 300000 % 1000) / 500 - 1) * z * 0.4f, z);
+                  light.Range = 5 + float(random >> 27);
+                  light.Color = XMFLOAT3(1, 1, 1);
+                  light.Intensity = 1;
+                  if (i % 4 == 0)
+                  {
+                     light.Direction = XMFLOAT3(0, -1, 0);
+                     light.SpotAngle = XM_PI / 8;
+                  }
+                  SubmitLight(light);
+               }
+            };
+         double cullTime = 0, occlusionTime = 0, lodTime = 0, lightTime = 0, shadowTime = 0;
+         double scaleSum = 0;
+         float lastScale = 1, minScale = 1;
+         int32_t scaleChanges = 0;
+         uint64_t frames = 0;
+         while (!quitRequested && (maxFrames == 0 || frames < maxFrames))
+         {
+            if (proxies && !tickThread) TickProxies(ticks++);
+            else if (!proxies && tickTime > 0) std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(tickTime));
+            for (int32_t i = 0; i < drawcallCount && !proxies; i++)
+            {
+               Drawcall drawcall;
+               XMFLOAT3 position;
+               uint32_t mesh = MakeItem(i, drawcall, position);
+               if (lods) SubmitDrawcall(drawcall, BoundingBox(position, XMFLOAT3(1, 1, 1)), lodChains[mesh], lodLevels[i]);
+               else SubmitDrawcall(drawcall, BoundingBox(position, XMFLOAT3(1, 1, 1)));
+            }
+            // The renderer collects occluders in Commit(), so they are submitted by the thread calling it.
+            if (occluders) SubmitOccluder(wall, 2);
+            SubmitLights(frames);
+            EngineTick();
+            cullTime += Graphics::Instance->GetVisibilityStats().FrustumCullTime;
+            occlusionTime += Graphics::Instance->GetVisibilityStats().OcclusionCullTime;
+            lodTime += Graphics::Instance->GetLodStats().LodSelectTime;
+            lightTime += Graphics::Instance->GetLightingStats().AssignTime;
+            shadowTime += Graphics::Instance->GetShadowStats().CasterCullTime;
+            float scale = Graphics::Instance->GetRenderScale();
+            scaleChanges += scale != lastScale;
+            lastScale = scale;
+            minScale = std::min(minScale, scale);
+            scaleSum += scale;
+            frames++;
+         }
+         ticker.request_stop();
+         if (ticker.joinable()) ticker.join();
+         double seconds = GlobalClock.GetLastingTime();
+         FramePacingStats pacing = Graphics::Instance->GetFramePacingStats();
+         BatchingStats batching = Graphics::Instance->GetBatchingStats();
+         VisibilityStats visibility = Graphics::Instance->GetVisibilityStats();
+         LodStats lodStats = Graphics::Instance->GetLodStats();
+         LightingStats lightingStats = Graphics::Instance->GetLightingStats();
+         ShadowStats shadowStats = Graphics::Instance->GetShadowStats();
+         CommandStats commandStats = Graphics::Instance->GetCommandStats();
+         std::vector<WorkerStats> workerStats;
+         for (int32_t i = 0; i < Graphics::Instance->GetThreadCount(); i++) workerStats.push_back(Graphics::Instance->GetWorkerStats(i));
+         if (timelinePath)
+         {
+            bool isJSON = std::strlen(timelinePath) >= 5 && std::strcmp(timelinePath + std::strlen(timelinePath) - 5, ".json") == 0;
+            Graphics::Instance->ExportFrameTimelines(timelinePath, isJSON ? TimelineFormat::JSON : TimelineFormat::CSV);
+         }
+         if (tuningPath) Graphics::Instance->ExportWorkerTuning(tuningPath);
+         ProxyStats proxyStats = scene.GetStats();
+         int32_t activeWorkers = Graphics::Instance->GetActiveWorkerCount();
+         size_t tuningDecisions = Graphics::Instance->GetWorkerTuningDecisions().size();
+         EngineTerminate();
+         std::printf("%s: %llu frames in %.3f s, %.1f FPS\n", "NullRenderer", (unsigned long long)frames, seconds, seconds > 0 ? frames / seconds : 0.0);
+         std::printf("CPU frame span %.3f ms, input-to-submit latency %.3f ms\n", pacing.CPUFrameSpan, pacing.InputToSubmitLatency);
+         std::printf("Last frame: %d items, %d frustum culled; frustum culling %.3f ms per frame on average\n", visibility.SubmittedItems,
+            visibility.FrustumCulled, frames > 0 ? cullTime / frames : 0.0);
+         std::printf("Last frame: %d occluder triangles, %d occluded; occlusion culling %.3f ms per frame on average\n",
+            visibility.OccluderTriangles, visibility.OcclusionCulled, frames > 0 ? occlusionTime / frames : 0.0);
+         std::printf("Last frame: %d LOD items, %lld triangles at a %.2f px error; LOD selection %.3f ms per frame on average\n", lodStats.LodItems,
+            (long long)lodStats.SubmittedTriangles, lodStats.ErrorThreshold, frames > 0 ? lodTime / frames : 0.0);
+         std::printf("Last frame: %d lights, %d visible, %d cluster entries, %d in the fullest cluster, %d dropped; light assignment %.3f ms per frame on average\n",
+            lightingStats.SubmittedLights, lightingStats.VisibleLights, lightingStats.LightIndices, lightingStats.MaxClusterLights,
+            lightingStats.DroppedLights, frames > 0 ? lightTime / frames : 0.0);
+         if (shadows)
+         {
+            std::printf("Shadows:");
+            for (int32_t c = 0; c < shadowStats.CascadeCount; c++)
+            {
+               std::printf(" cascade %d to %.1f m with %d casters (%d skipped)%s", c, shadowStats.SplitDistances[c], shadowStats.Casters[c],
+                  shadowStats.SkippedCasters[c], c + 1 < shadowStats.CascadeCount ? "," : "");
+            }
+            std::printf("; caster culling %.3f ms per frame on average\n", frames > 0 ? shadowTime / frames : 0.0);
+         }
+         if (proxies)
+         {
+            std::printf("Proxies: %d, %d changed and %d copied by the last of %llu ticks; %llu snapshots rendered, %llu dropped\n",
+               proxyStats.Proxies, proxyStats.ChangedProxies, proxyStats.CopiedProxies, (unsigned long long)proxyStats.Publishes,
+               (unsigned long long)proxyStats.Acquisitions, (unsigned long long)proxyStats.DroppedSnapshots);
+         }
+         if (dynamicResolution)
+         {
+            std::printf("Render scale: %.3f on average, %.3f at least, %.3f last (%dx%d); %d changes\n", frames > 0 ? scaleSum / frames : 1.0,
+               minScale, lastScale, int32_t(ScreenSize.x * lastScale) & ~7, int32_t(ScreenSize.y * lastScale) & ~7, scaleChanges);
+         }
+         std::printf("Last frame: %d drawcalls in %d draws, %d saved by instancing\n", batching.Drawcalls, batching.DrawBatches, batching.SavedDrawcalls);
+         std::printf("Last frame: %d commands in %d bytes, %d streams recorded, %d reused; %d barriers in %d batches\n", commandStats.Commands,
+            commandStats.StreamBytes, commandStats.RecordedStreams, commandStats.ReusedStreams, commandStats.Barriers, commandStats.BarrierBatches);
+         std::printf("CPU topology: %zu CPUs, %d cores, %d cache domains%s; the game thread ran on CPU %d\n", Topology.GetCpus().size(),
+            Topology.GetCoreCount(), Topology.GetCacheDomainCount(), Topology.IsHybrid() ? ", hybrid" : "", GetCurrentCpu());
+         std::printf("%d of %zu workers active after %zu autotuning decisions\n", activeWorkers, workerStats.size(), tuningDecisions);
+         for (size_t i = 0; i < workerStats.size(); i++)
+         {
+            const WorkerStats& stats = workerStats[i];
+            std::printf("Worker %zu: busy %.3f ms, barrier wait %.3f ms, %llu chunks (%llu stolen), last on CPU %d\n", i, stats.BusyTime,
+               stats.BarrierWaitTime, (unsigned long long)stats.RecordedChunks, (unsigned long long)stats.StolenChunks, stats.Cpu);
+         }
+      }
+      catch (std::exception& e)
+      {
+         EngineTerminate();
+         std::fprintf(stderr, "%s\n", e.what());
+         exit(EXIT_FAILURE);
+      }
+   }
 #endif
 
    void EngineLaunch()
    {
       GlobalClock.Start();
-      Constants::SetThreadNumbers();
+      // The game thread is the calling one. Tick and physics placements are planned, to keep the renderer's cores free of them.
+      Topology = CpuTopology::Discover();
+      Constants::SetThreadNumbers(int32_t(Topology.GetCpus().size()));
+      ThreadPlacementPolicy placement(Topology, Affinity, Constants::ThreadNumRenderer, Constants::ThreadNumTick, Constants::ThreadNumPhysics);
+      if (!ApplyThreadPlacement(placement.Get(ThreadRole::Game))) LogSystem("The game thread was not fully placed, the OS refused its affinity or priority.");
    #if defined(_WIN64)
       Graphics::InitializeRenderer(Constants::ThreadNumRenderer, (void*)&hwnd);
    #elif defined(__ANDROID__)
       //...
+   #elif defined(__linux__)
+      Graphics::InitializeRenderer(Constants::ThreadNumRenderer, (void*)&gpuLatency);
    #endif
+      TickPlacement = placement.Get(ThreadRole::Tick);
+      Graphics::Instance->SetWorkerPlacements(placement.GetAll(ThreadRole::Renderer));
       Graphics::Instance->Launch();
+      Graphics::Instance->SetActiveWorkerCount(Constants::ThreadNumRendererActive);
       return;
    }
    
@@ -232,6 +550,7 @@ namespace
    
    void EngineTerminate()
    {
+      if (!Graphics::Instance) return;
       Graphics::Instance->Terminate();
       Graphics::Instance.reset();
    }
@@ -256,4 +575,12 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
    return EXIT_SUCCESS;
 }
 #elif defined(__ANDROID__)
+#elif defined(__linux__)
+// Program Entry Point
+int main(int argc, char** argv)
+{
+   ParseArguments(argc, argv);
+   GameLoop();
+   return EXIT_SUCCESS;
+}
 #endif
\ No newline at end of file
@@ -5,8 +5,9 @@
 
 #include "OpenAL-1.24.3/al.h"
 #include "OpenAL-1.24.3/alc.h"
-#include "PhysX-4.1/PxPhysicsAPI.h"
 #include <iostream>
+#if defined(_WIN64) || defined(__ANDROID__) // No prebuilt PhysX for Linux.
+#include "PhysX-4.1/PxPhysicsAPI.h"
 using namespace physx;
 
 // 简单的错误回调类
@@ -16,6 +17,7 @@ public:
       std::cerr << "PhysX Error: " << message << " in " << file << " at line " << line << std::endl;
    }
 };
+#endif
 
 void TempCode()
 {
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+// Tests are plain executables. A failed check throws where it failed, and main() returns 1 from the catch, which fails the test.
+#define CHECK(condition) \
+   do \
+   { \
+      if (!(condition)) throw std::runtime_error(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": CHECK(" #condition ") failed."); \
+   } while (false)
@@ -0,0 +1,208 @@
+// CommandStream recording and decoding, ValidateCommandStream(), and the renderer's stream cache over a static scene and camera.
+#include "Check.h"
+#include "Core/Renderers/Renderer.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   void TestRecording(NullRenderer& renderer)
+   {
+      ResourceHandle pipelineState = renderer.CreateResource(ResourceType::PiplelineState);
+      ResourceHandle mesh = renderer.CreateResource(ResourceType::Mesh);
+      ResourceHandle material = renderer.CreateResource(ResourceType::ConstantBuffer);
+      CommandStream stream;
+      // Binding what is already bound is skipped.
+      for (int32_t i = 0; i < 3; i++)
+      {
+         stream.BindPipelineState(pipelineState);
+         stream.BindMesh(mesh);
+         stream.BindConstantBuffer(0, material);
+         stream.Draw(2, uint32_t(i * 2));
+      }
+      CHECK(stream.GetCommandCount() == 6);
+      CHECK(stream.GetWords().size() == 2 + 2 + 3 + 3 * 3);
+      CHECK(!stream.HasTransfers() && !stream.HasConstants());
+      const CommandType types[] = { CommandType::BindPipelineState, CommandType::BindMesh, CommandType::BindConstantBuffer,
+         CommandType::Draw, CommandType::Draw, CommandType::Draw };
+      CommandReader reader(stream);
+      Command command;
+      for (CommandType type : types)
+      {
+         CHECK(reader.Next(command));
+         CHECK(command.Type == type);
+      }
+      CHECK(!reader.Next(command));
+      // Constants unbind their slot, so the constant buffer is bound again.
+      float constants[3] = { 1, 2, 3 };
+      stream.SetConstants(0, constants, sizeof(constants));
+      stream.BindConstantBuffer(0, material);
+      CHECK(stream.GetCommandCount() == 8);
+      CHECK(stream.HasConstants());
+      CHECK(stream.GetConstants().size() == 3);
+      // Equal recordings are equal streams, which is what the renderer's cache relies on.
+      CommandStream copy = stream;
+      CHECK(copy.Equals(stream));
+      copy.Draw(1, 0);
+      CHECK(!copy.Equals(stream));
+      stream.Reset();
+      CHECK(stream.GetCommandCount() == 0 && stream.GetWords().empty() && !stream.HasConstants());
+      stream.BindMesh(mesh);
+      CHECK(stream.GetCommandCount() == 1);
+   }
+
+   void TestValidation(NullRenderer& renderer)
+   {
+      ResourceHandle pipelineState = renderer.CreateResource(ResourceType::PiplelineState);
+      ResourceHandle mesh = renderer.CreateResource(ResourceType::Mesh);
+      ResourceHandle buffer = renderer.CreateResource(ResourceType::ConstantBuffer);
+      ResourceHandle texture = renderer.CreateResource(ResourceType::Texture);
+      string message;
+      CommandStream stream;
+      stream.BindPipelineState(pipelineState);
+      stream.BindMesh(mesh);
+      stream.BindConstantBuffer(1, buffer);
+      stream.Draw(1, 0);
+      stream.Barrier(texture, ResourceState::ShaderResource, ResourceState::CopyDestination);
+      stream.Barrier(buffer, ResourceState::VertexAndConstantBuffer, ResourceState::CopySource);
+      stream.Copy(texture, 0, buffer, 0, 256);
+      stream.Barrier(texture, ResourceState::CopyDestination, ResourceState::ShaderResource);
+      CHECK(ValidateCommandStream(stream, message));
+      CHECK(stream.HasTransfers());
+      // Drawing without a pipeline state.
+      stream.Reset();
+      stream.BindMesh(mesh);
+      stream.Draw(1, 0);
+      CHECK(!ValidateCommandStream(stream, message));
+      CHECK(message.find("Draw") != string::npos);
+      // A handle of the wrong type.
+      stream.Reset();
+      stream.BindMesh(texture);
+      CHECK(!ValidateCommandStream(stream, message));
+      // Transitions that don't chain.
+      stream.Reset();
+      stream.Barrier(texture, ResourceState::ShaderResource, ResourceState::CopyDestination);
+      stream.Barrier(texture, ResourceState::ShaderResource, ResourceState::RenderTarget);
+      CHECK(!ValidateCommandStream(stream, message));
+      // Copying into a resource the stream moved out of the copy destination state.
+      stream.Reset();
+      stream.Barrier(texture, ResourceState::Common, ResourceState::ShaderResource);
+      stream.Copy(texture, 0, buffer, 0, 256);
+      CHECK(!ValidateCommandStream(stream, message));
+      // Pipeline states have no memory to transition.
+      stream.Reset();
+      stream.Barrier(pipelineState, ResourceState::Common, ResourceState::CopySource);
+      CHECK(!ValidateCommandStream(stream, message));
+   }
+
+   // Without a camera nothing is culled, so the same drawcalls make the same batches every frame, and each chunk's stream is
+   // recorded once per frame array index. 4 instances of 256 meshes are 256 batches, in 4 chunks of MinDrawcallsPerChunk batches.
+   void TestCache(NullRenderer& renderer)
+   {
+      ResourceHandle pipelineState = renderer.CreateResource(ResourceType::PiplelineState);
+      ResourceHandle material = renderer.CreateResource(ResourceType::ConstantBuffer);
+      ResourceHandle meshes[257];
+      for (ResourceHandle& mesh : meshes) mesh = renderer.CreateResource(ResourceType::Mesh);
+      const int32_t DrawcallCount = 256 * 4;
+      ResourceHandle lastMesh = meshes[255];
+      auto SubmitAndCommit = [&]()
+         {
+            for (int32_t i = 0; i < DrawcallCount; i++)
+            {
+               ResourceHandle mesh = i + 1 == DrawcallCount ? lastMesh : meshes[i % 256];
+               SubmitDrawcall(Drawcall{ MakeSortKey(0, pipelineState, material, 0, mesh, float(i)), mesh, material, pipelineState, InstanceData{} },
+                  BoundingBox(XMFLOAT3(0, 0, float(i)), XMFLOAT3(1, 1, 1)));
+            }
+            renderer.Commit();
+         };
+      // Stats are counted at the start of a Commit(), over the frame before.
+      for (int32_t frame = 0; frame <= Constants::SwapChainSize; frame++) SubmitAndCommit();
+      CommandStats stats = renderer.GetCommandStats();
+      CHECK(stats.RecordedStreams == 4 && stats.ReusedStreams == 0);
+      for (int32_t frame = 0; frame < Constants::SwapChainSize; frame++)
+      {
+         SubmitAndCommit();
+         stats = renderer.GetCommandStats();
+         CHECK(stats.ReusedStreams == 4 && stats.RecordedStreams == 0);
+      }
+      // The last drawcall in sorted order gets a mesh of its own. Its old batch in the last chunk loses an instance, and its
+      // new batch makes a fifth chunk. The other chunks are reused.
+      lastMesh = meshes[256];
+      SubmitAndCommit();
+      SubmitAndCommit();
+      stats = renderer.GetCommandStats();
+      CHECK(stats.RecordedStreams == 2 && stats.ReusedStreams == 3);
+      // The change is cached once every frame array index has seen it.
+      for (int32_t frame = 0; frame < Constants::SwapChainSize; frame++) SubmitAndCommit();
+      stats = renderer.GetCommandStats();
+      CHECK(stats.ReusedStreams == 5 && stats.RecordedStreams == 0);
+   }
+
+   // With a camera, every chunk starts by setting its constants. The streams are reused while it stays, and all recorded again
+   // when it moves. Run it last, the camera can't be unset.
+   void TestCamera(NullRenderer& renderer)
+   {
+      ResourceHandle pipelineState = renderer.CreateResource(ResourceType::PiplelineState);
+      ResourceHandle material = renderer.CreateResource(ResourceType::ConstantBuffer);
+      ResourceHandle meshes[256];
+      for (ResourceHandle& mesh : meshes) mesh = renderer.CreateResource(ResourceType::Mesh);
+      auto SubmitAndCommit = [&]()
+         {
+            for (int32_t i = 0; i < 256 * 4; i++)
+            {
+               ResourceHandle mesh = meshes[i % 256];
+               SubmitDrawcall(Drawcall{ MakeSortKey(0, pipelineState, material, 0, mesh, float(i)), mesh, material, pipelineState, InstanceData{} },
+                  BoundingBox(XMFLOAT3(0, 0, float(i)), XMFLOAT3(1, 1, 1)));
+            }
+            renderer.Commit();
+         };
+      for (int32_t frame = 0; frame <= Constants::SwapChainSize; frame++) SubmitAndCommit();
+      int32_t bytes = renderer.GetCommandStats().StreamBytes;
+      // 10 units behind the first drawcall, and far enough to see all of them.
+      XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV2, 1, 0.1f, 2000);
+      renderer.SetCamera(XMMatrixTranslation(0, 0, 10), projection);
+      for (int32_t frame = 0; frame <= Constants::SwapChainSize; frame++) SubmitAndCommit();
+      CommandStats stats = renderer.GetCommandStats();
+      CHECK(stats.RecordedStreams == 4 && stats.ReusedStreams == 0);
+      // A SetConstants command of 4 words, and the constants.
+      CHECK(stats.StreamBytes == bytes + 4 * int32_t(4 * sizeof(uint32_t) + sizeof(CameraConstants)));
+      for (int32_t frame = 0; frame < Constants::SwapChainSize; frame++)
+      {
+         SubmitAndCommit();
+         stats = renderer.GetCommandStats();
+         CHECK(stats.ReusedStreams == 4 && stats.RecordedStreams == 0);
+      }
+      renderer.SetCamera(XMMatrixTranslation(0, 0, 11), projection);
+      SubmitAndCommit();
+      SubmitAndCommit();
+      stats = renderer.GetCommandStats();
+      CHECK(stats.RecordedStreams == 4 && stats.ReusedStreams == 0);
+   }
+}
+
+int main()
+{
+   InitializeRenderer(2, nullptr);
+   NullRenderer& renderer = static_cast<NullRenderer&>(*Instance);
+   renderer.SetWorkerAutotuning(false);
+   renderer.Launch();
+   try
+   {
+      TestRecording(renderer);
+      TestValidation(renderer);
+      TestCache(renderer);
+      TestCamera(renderer);
+   }
+   catch (std::exception& e)
+   {
+      renderer.Terminate();
+      Instance.reset();
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   renderer.Terminate();
+   Instance.reset();
+   std::printf("CommandStream tests passed.\n");
+   return 0;
+}
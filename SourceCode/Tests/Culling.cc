@@ -0,0 +1,127 @@
+// CullByFrustum() against BoundingFrustum::Contains() per box, on random boxes under rotated cameras and on padded tails.
+#include <algorithm>
+#include <vector>
+#include "Check.h"
+#include "Core/Renderers/Culling.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   const uint8_t Untouched = 0xAA;
+
+   BoundingFrustum MakeFrustum(float yaw, float pitch, XMFLOAT3 position)
+   {
+      BoundingFrustum local(XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.f / 9.f, 0.1f, 200.f)), frustum;
+      local.Transform(frustum, XMMatrixRotationRollPitchYaw(pitch, yaw, 0) * XMMatrixTranslation(position.x, position.y, position.z));
+      return frustum;
+   }
+
+   BoundingBox GetBox(const BoundsArray& bounds, int32_t i)
+   {
+      return BoundingBox(XMFLOAT3(bounds.CenterX[i], bounds.CenterY[i], bounds.CenterZ[i]), XMFLOAT3(bounds.ExtentX[i], bounds.ExtentY[i], bounds.ExtentZ[i]));
+   }
+
+   // The plane tests are conservative: a box is culled only if it's outside one plane, so it never culls a box the exact test keeps.
+   // Boxes beside an edge or a corner of the frustum may be outside it without being outside any plane, and are kept.
+   void TestRandomBoxes()
+   {
+      BoundsArray bounds;
+      for (int32_t i = 0; i < 20000; i++)
+      {
+         uint32_t random = uint32_t(i + 1) * 2654435761u, other = uint32_t(i + 1) * 2246822519u;
+         XMFLOAT3 center(float(random % 500) - 250, float(random / 500 % 500) - 250, float(other % 500) - 250);
+         XMFLOAT3 extents(0.1f + float(other >> 28), 0.1f + float(other >> 24 & 15), 0.1f + float(random >> 28));
+         bounds.Push(BoundingBox(center, extents));
+      }
+      const BoundingFrustum frustums[] = { MakeFrustum(0, 0, XMFLOAT3(0, 0, 0)), MakeFrustum(1, 0.3f, XMFLOAT3(20, -10, 5)),
+         MakeFrustum(-2.5f, -1.2f, XMFLOAT3(-100, 50, 80)), MakeFrustum(3.1f, 1.5f, XMFLOAT3(0, -200, 0)) };
+      for (const BoundingFrustum& frustum : frustums)
+      {
+         std::vector<uint8_t> visibility(bounds.GetCount());
+         CullByFrustum(bounds, frustum, 0, bounds.GetCount(), visibility.data());
+         int32_t inside = 0, kept = 0;
+         for (int32_t i = 0; i < bounds.GetCount(); i++)
+         {
+            bool isInside = frustum.Contains(GetBox(bounds, i)) != DISJOINT;
+            CHECK(visibility[i] == 0 || visibility[i] == 1);
+            if (isInside) CHECK(visibility[i] == 1);
+            inside += isInside;
+            kept += visibility[i];
+         }
+         // The scene has boxes on both sides, and the plane tests keep few more than the exact ones.
+         CHECK(inside > 0 && kept < bounds.GetCount());
+         CHECK(kept - inside <= bounds.GetCount() / 100);
+      }
+   }
+
+   // Boxes at known places against the default frustum, which looks down +z from the origin.
+   void TestKnownBoxes()
+   {
+      BoundsArray bounds;
+      bounds.Push(BoundingBox(XMFLOAT3(0, 0, 50), XMFLOAT3(1, 1, 1)));     // In front.
+      bounds.Push(BoundingBox(XMFLOAT3(0, 0, -50), XMFLOAT3(1, 1, 1)));    // Behind.
+      bounds.Push(BoundingBox(XMFLOAT3(0, 0, 300), XMFLOAT3(1, 1, 1)));    // Beyond the far plane.
+      bounds.Push(BoundingBox(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1)));      // Across the near plane.
+      bounds.Push(BoundingBox(XMFLOAT3(100, 0, 50), XMFLOAT3(1, 1, 1)));   // Right of the view.
+      bounds.Push(BoundingBox(XMFLOAT3(100, 0, 50), XMFLOAT3(90, 1, 1)));  // Reaching into it from the right.
+      bounds.Push(BoundingBox(XMFLOAT3(0, 60, 50), XMFLOAT3(1, 1, 1)));    // Above.
+      bounds.Push(BoundingBox(XMFLOAT3(0, 0, 199), XMFLOAT3(1, 1, 1)));    // Across the far plane.
+      const uint8_t expected[] = { 1, 0, 0, 1, 0, 1, 0, 1 };
+      std::vector<uint8_t> visibility(bounds.GetCount());
+      BoundingFrustum frustum = MakeFrustum(0, 0, XMFLOAT3(0, 0, 0));
+      CullByFrustum(bounds, frustum, 0, bounds.GetCount(), visibility.data());
+      for (int32_t i = 0; i < bounds.GetCount(); i++) CHECK(visibility[i] == expected[i]);
+   }
+
+   // Counts that aren't multiples of 4 are padded with empty boxes. Only the padded range is written, and the items before the
+   // padding get the same results as the exact test.
+   void TestPadding()
+   {
+      BoundingFrustum frustum = MakeFrustum(0.5f, 0, XMFLOAT3(0, 0, 0));
+      for (int32_t count = 1; count <= 11; count++)
+      {
+         BoundsArray bounds;
+         for (int32_t i = 0; i < count; i++) bounds.Push(BoundingBox(XMFLOAT3(float(i * 7 % 60) - 30, 0, float(i * 13 % 80)), XMFLOAT3(1, 1, 1)));
+         bounds.Pad();
+         int32_t padded = bounds.GetCount();
+         CHECK(padded % 4 == 0 && padded >= count && padded < count + 4);
+         for (int32_t i = count; i < padded; i++) CHECK(bounds.ExtentX[i] == 0 && bounds.ExtentY[i] == 0 && bounds.ExtentZ[i] == 0);
+         std::vector<uint8_t> visibility(padded + 4, Untouched);
+         CullByFrustum(bounds, frustum, 0, padded, visibility.data());
+         for (int32_t i = 0; i < count; i++) CHECK(visibility[i] == (frustum.Contains(GetBox(bounds, i)) != DISJOINT));
+         for (int32_t i = count; i < padded; i++) CHECK(visibility[i] == 0 || visibility[i] == 1);
+         for (int32_t i = padded; i < padded + 4; i++) CHECK(visibility[i] == Untouched);
+         // A range in the middle, as ParallelFor() hands out, leaves the others alone.
+         if (padded < 8) continue;
+         std::fill(visibility.begin(), visibility.end(), Untouched);
+         CullByFrustum(bounds, frustum, 4, 8, visibility.data());
+         for (int32_t i = 0; i < int32_t(visibility.size()); i++) CHECK((visibility[i] == Untouched) == (i < 4 || i >= 8));
+      }
+      // An empty range writes nothing.
+      BoundsArray bounds;
+      bounds.Pad();
+      CHECK(bounds.GetCount() == 0);
+      uint8_t visibility = Untouched;
+      CullByFrustum(bounds, frustum, 0, 0, &visibility);
+      CHECK(visibility == Untouched);
+   }
+}
+
+int main()
+{
+   try
+   {
+      TestRandomBoxes();
+      TestKnownBoxes();
+      TestPadding();
+   }
+   catch (std::exception& e)
+   {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   std::printf("Culling tests passed.\n");
+   return 0;
+}
@@ -0,0 +1,204 @@
+// DynamicResolution over recorded frame-time traces, in a closed loop: a trace gives each frame's cost at full resolution,
+// and the GPU time fed back is that cost times the pixel fraction of the scale the controller chose for the frame.
+// The traces are CPU frame spans of the headless renderer, with the jitter and spikes of a real machine, scaled to a load.
+#include <algorithm>
+#include <fstream>
+#include <vector>
+#include "Check.h"
+#include "Core/Renderers/DynamicResolution.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   const double Target = 1000.0 / 60;
+
+   struct Run
+   {
+      std::vector<float> Scales;  // Chosen for each frame.
+      std::vector<double> Times;  // The frame time, the longer of the CPU and GPU times.
+   };
+
+   // Lines starting with '#' and the header are skipped.
+   std::vector<double> LoadTrace(const string& path)
+   {
+      std::ifstream file(path);
+      if (!file) throw std::runtime_error("Cannot open " + path + ", run the test from SourceCode/Tests.");
+      std::vector<double> times;
+      string line;
+      while (std::getline(file, line))
+      {
+         if (line.empty() || line[0] == '#' || line == "FrameTime") continue;
+         times.push_back(std::stod(line));
+      }
+      return times;
+   }
+
+   double Median(std::vector<double> values)
+   {
+      std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+      return values[values.size() / 2];
+   }
+
+   // gpuLoads and cpuLoads: per frame, the cost at full resolution as a multiple of the target frame time.
+   Run Simulate(DynamicResolution& controller, const std::vector<double>& gpuLoads, const std::vector<double>& cpuLoads)
+   {
+      Run run;
+      float scale = controller.GetScale();
+      for (size_t i = 0; i < gpuLoads.size(); i++)
+      {
+         double gpuTime = gpuLoads[i] * Target * scale * scale, cpuTime = cpuLoads[i] * Target;
+         run.Scales.push_back(scale);
+         run.Times.push_back(std::max(gpuTime, cpuTime));
+         scale = controller.Update(cpuTime, gpuTime);
+      }
+      return run;
+   }
+
+   // The trace over "frames" frames, looping, normalized so its median is "load".
+   std::vector<double> Load(const std::vector<double>& trace, double load, size_t frames)
+   {
+      double median = Median(trace);
+      std::vector<double> loads;
+      for (size_t i = 0; i < frames; i++) loads.push_back(trace[i % trace.size()] / median * load);
+      return loads;
+   }
+
+   std::vector<double> Concatenate(std::initializer_list<std::vector<double>> parts)
+   {
+      std::vector<double> result;
+      for (const std::vector<double>& part : parts) result.insert(result.end(), part.begin(), part.end());
+      return result;
+   }
+
+   // The fraction of frames in [first, last) over the target.
+   double MissRate(const Run& run, size_t first, size_t last)
+   {
+      size_t misses = 0;
+      for (size_t i = first; i < last; i++) misses += run.Times[i] > Target;
+      return double(misses) / double(last - first);
+   }
+
+   // The fraction of frames a fixed scale would miss, if it put the trace's median exactly at the controller's aim.
+   // The controller follows smoothed frame times, so it shouldn't miss more often than that.
+   double FixedScaleMissRate(const std::vector<double>& trace, const DynamicResolution& controller)
+   {
+      double limit = Median(trace) / (1 - controller.GetSettings().Headroom);
+      return double(std::count_if(trace.begin(), trace.end(), [limit](double time) { return time > limit; })) / double(trace.size());
+   }
+
+   int32_t ScaleChanges(const Run& run, size_t first, size_t last)
+   {
+      int32_t changes = 0;
+      for (size_t i = first + 1; i < last; i++) changes += run.Scales[i] != run.Scales[i - 1];
+      return changes;
+   }
+
+   // A GPU-bound scene 40% over budget at full resolution settles at a lower scale. Noise moves it a step now and then, but not
+   // every few frames.
+   void TestGpuBound(const std::vector<double>& trace)
+   {
+      DynamicResolution controller;
+      size_t frames = trace.size() * 2;
+      Run run = Simulate(controller, Load(trace, 1.4, frames), std::vector<double>(frames, 0.2));
+      std::printf("GPU-bound: %.3f missed after settling (%.3f at a fixed scale), %d scale changes, scale %.3f to %.3f\n",
+         MissRate(run, 60, frames), FixedScaleMissRate(trace, controller), ScaleChanges(run, 60, frames),
+         *std::min_element(run.Scales.begin() + 60, run.Scales.end()), *std::max_element(run.Scales.begin() + 60, run.Scales.end()));
+      CHECK(MissRate(run, 60, frames) <= FixedScaleMissRate(trace, controller));
+      CHECK(ScaleChanges(run, 60, frames) < int32_t(frames - 60) / 5);
+      for (size_t i = 60; i < frames; i++) CHECK(run.Scales[i] < 1 && run.Scales[i] >= controller.GetSettings().MinScale);
+   }
+
+   // Half the budget: the spikes of the trace never lower the scale much.
+   void TestLight(const std::vector<double>& trace)
+   {
+      DynamicResolution controller;
+      size_t frames = trace.size() * 2;
+      Run run = Simulate(controller, Load(trace, 0.5, frames), std::vector<double>(frames, 0.2));
+      float lowest = *std::min_element(run.Scales.begin(), run.Scales.end());
+      std::printf("Light: %.3f missed, %d scale changes, lowest scale %.3f\n", MissRate(run, 0, frames), ScaleChanges(run, 0, frames), lowest);
+      CHECK(lowest >= 0.9f);
+      CHECK(ScaleChanges(run, 0, frames) <= 4);
+   }
+
+   // The CPU is over budget and the GPU isn't: fewer pixels wouldn't help, so the scale stays.
+   void TestCpuBound(const std::vector<double>& trace)
+   {
+      DynamicResolution controller;
+      size_t frames = trace.size() * 2;
+      Run run = Simulate(controller, std::vector<double>(frames, 0.5), Load(trace, 1.3, frames));
+      std::printf("CPU-bound: lowest scale %.3f\n", *std::min_element(run.Scales.begin(), run.Scales.end()));
+      for (float scale : run.Scales) CHECK(scale == 1);
+   }
+
+   // Light, then 50% over budget, then light again: the scale drops within a few frames of the step, and comes back once the load goes.
+   void TestStep(const std::vector<double>& trace)
+   {
+      DynamicResolution controller;
+      size_t part = trace.size();
+      std::vector<double> gpuLoads = Concatenate({ Load(trace, 0.5, part), Load(trace, 1.5, part), Load(trace, 0.5, part) });
+      Run run = Simulate(controller, gpuLoads, std::vector<double>(gpuLoads.size(), 0.2));
+      size_t drop = part, recovery = 2 * part;
+      while (drop < 2 * part && run.Scales[drop] == 1) drop++;
+      while (recovery < 3 * part && run.Scales[recovery] < 1) recovery++;
+      std::printf("Step: dropped %zu frames after the step up, %.3f missed after 30 frames, back to 1 %zu frames after the step down\n",
+         drop - part, MissRate(run, part + 30, 2 * part), recovery - 2 * part);
+      CHECK(drop - part <= 5);
+      CHECK(MissRate(run, part + 30, 2 * part) <= FixedScaleMissRate(trace, controller));
+      CHECK(recovery - 2 * part <= 120);
+      CHECK(run.Scales.back() == 1);
+   }
+
+   void TestSettings()
+   {
+      DynamicResolutionSettings settings;
+      settings.MinScale = 0.6f;
+      settings.TargetFrameTime = 10;
+      DynamicResolution controller(settings, 0);
+      CHECK(controller.GetTargetFrameTime() == 10);
+      // Far over budget: the scale stops at the minimum, and render sizes stay multiples of 8.
+      for (int32_t i = 0; i < 100; i++) controller.Update(1, 100);
+      CHECK(controller.GetScale() == 0.6f);
+      XMINT2 size = controller.GetRenderSize(XMINT2{ 1920, 1080 });
+      CHECK(size.x == 1152 && size.y == 648);
+      controller.Reset();
+      CHECK(controller.GetScale() == 1);
+      settings.MinScale = 2;
+      bool threw = false;
+      try
+      {
+         DynamicResolution invalid(settings);
+      }
+      catch (std::runtime_error&)
+      {
+         threw = true;
+      }
+      CHECK(threw);
+   }
+}
+
+int main()
+{
+   try
+   {
+      for (const char* path : { "Data/FrameTimesScene.csv", "Data/FrameTimesProxies.csv" })
+      {
+         std::vector<double> trace = LoadTrace(path);
+         CHECK(trace.size() >= 200);
+         std::printf("%s\n", path);
+         TestGpuBound(trace);
+         TestLight(trace);
+         TestCpuBound(trace);
+         TestStep(trace);
+      }
+      TestSettings();
+   }
+   catch (std::exception& e)
+   {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   std::printf("DynamicResolution tests passed.\n");
+   return 0;
+}
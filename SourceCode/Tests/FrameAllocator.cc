@@ -0,0 +1,212 @@
+// FrameAllocator: aligned offsets, per-thread pages and their handoff, page runs for oversized allocations, running out of a region,
+// and BeginFrame() moving to its frame's region only.
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "Check.h"
+#include "Core/Renderers/FrameAllocator.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   const uint64_t PageSize = 4096;
+   const uint64_t Alignment = 256;
+   const uint64_t RegionSize = 64 * PageSize;
+
+   template<typename Function>
+   bool Throws(Function function)
+   {
+      try
+      {
+         function();
+      }
+      catch (std::runtime_error&)
+      {
+         return true;
+      }
+      return false;
+   }
+
+   struct Range
+   {
+      uint64_t Offset;
+      uint64_t Size;
+   };
+
+   // Ranges are aligned, within the region of "frameIdx", and don't overlap.
+   void CheckRanges(std::vector<Range> ranges, int32_t frameIdx)
+   {
+      std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.Offset < b.Offset; });
+      for (size_t i = 0; i < ranges.size(); i++)
+      {
+         CHECK(ranges[i].Offset % Alignment == 0);
+         CHECK(ranges[i].Offset >= frameIdx * RegionSize && ranges[i].Offset + ranges[i].Size <= (frameIdx + 1) * RegionSize);
+         if (i > 0) CHECK(ranges[i - 1].Offset + ranges[i - 1].Size <= ranges[i].Offset);
+      }
+   }
+
+   // Sizes round up to the alignment, a zero size included, and allocations follow each other in the thread's page.
+   void TestAlignment()
+   {
+      FrameAllocator allocator(RegionSize, 2, 1, PageSize, Alignment);
+      allocator.BeginFrame(0);
+      CHECK(allocator.Allocate(0, 1) == 0);
+      CHECK(allocator.Allocate(0, 0) == Alignment);
+      CHECK(allocator.Allocate(0, Alignment) == 2 * Alignment);
+      CHECK(allocator.Allocate(0, Alignment + 1) == 3 * Alignment);
+      CHECK(allocator.Allocate(0, 3) == 5 * Alignment);
+      std::vector<Range> ranges;
+      for (uint64_t size = 1; size < 2000; size += 37) ranges.push_back(Range{ allocator.Allocate(0, size), size });
+      CheckRanges(ranges, 0);
+      allocator.BeginFrame(1);
+      const FrameAllocatorStats& stats = allocator.GetStats();
+      CHECK(stats.Allocations == 5 + ranges.size() && stats.Capacity == RegionSize);
+      uint64_t allocated = 6 * Alignment;
+      for (const Range& range : ranges) allocated += (range.Size + Alignment - 1) / Alignment * Alignment;
+      CHECK(stats.AllocatedBytes == allocated);
+      // No size is over half a page, so a page is handed off more than half full.
+      CHECK(stats.UsedBytes % PageSize == 0 && stats.UsedBytes >= allocated && stats.UsedBytes < 2 * allocated + PageSize);
+      CHECK(Throws([]() { FrameAllocator allocator(RegionSize, 2, 1, 3000, Alignment); }));
+      CHECK(Throws([]() { FrameAllocator allocator(RegionSize, 2, 1, PageSize, 3 * 64); }));
+      CHECK(Throws([]() { FrameAllocator allocator(RegionSize, 2, 1, PageSize, 2 * PageSize); }));
+      CHECK(Throws([]() { FrameAllocator allocator(RegionSize + 1024, 2, 1, PageSize, Alignment); }));
+      CHECK(Throws([]() { FrameAllocator allocator(RegionSize, 0, 1, PageSize, Alignment); }));
+      CHECK(Throws([]() { FrameAllocator allocator(RegionSize, 2, 0, PageSize, Alignment); }));
+   }
+
+   // Each thread takes pages of its own in the order it needs them. A full page hands off to a new one, leaving its end unused,
+   // and an allocation larger than a page takes a run of whole pages, whose end the thread uses next.
+   void TestPages()
+   {
+      FrameAllocator allocator(RegionSize, 1, 2, PageSize, Alignment);
+      allocator.BeginFrame(0);
+      CHECK(allocator.Allocate(0, 100) == 0);
+      CHECK(allocator.Allocate(1, 100) == PageSize);
+      CHECK(allocator.Allocate(0, 100) == Alignment);
+      CHECK(allocator.Allocate(1, 100) == PageSize + Alignment);
+      // Thread 0 has PageSize - 2 * Alignment left, a larger allocation takes the next page.
+      CHECK(allocator.Allocate(0, PageSize - Alignment) == 2 * PageSize);
+      CHECK(allocator.Allocate(0, Alignment) == 3 * PageSize - Alignment);
+      CHECK(allocator.Allocate(0, 1) == 3 * PageSize);
+      // 2.5 pages take a run of 3, and the rest of the run serves the thread's next allocations.
+      uint64_t large = allocator.Allocate(1, 2 * PageSize + PageSize / 2);
+      CHECK(large == 4 * PageSize);
+      CHECK(allocator.Allocate(1, 100) == 6 * PageSize + PageSize / 2);
+      // A whole page takes a new one.
+      CHECK(allocator.Allocate(0, PageSize) == 7 * PageSize);
+      CHECK(allocator.Allocate(0, 1) == 8 * PageSize);
+      allocator.BeginFrame(0);
+      const FrameAllocatorStats& stats = allocator.GetStats();
+      CHECK(stats.UsedBytes == 9 * PageSize && stats.Allocations == 11);
+      CHECK(stats.AllocatedBytes == 8 * Alignment + (PageSize - Alignment) + (2 * PageSize + PageSize / 2) + PageSize);
+      // The frame starts over from the region's start.
+      CHECK(allocator.Allocate(1, 1) == 0 && allocator.Allocate(0, 1) == PageSize);
+   }
+
+   // A frame running out of its region throws, for any size, until BeginFrame().
+   void TestExhaustion()
+   {
+      FrameAllocator allocator(RegionSize, 2, 2, PageSize, Alignment);
+      allocator.BeginFrame(1);
+      CHECK(allocator.Allocate(0, RegionSize) == RegionSize);
+      CHECK(Throws([&]() { allocator.Allocate(1, 1); }));
+      CHECK(Throws([&]() { allocator.Allocate(0, 1); }));
+      allocator.BeginFrame(1);
+      CHECK(allocator.GetStats().UsedBytes == RegionSize && allocator.GetStats().PeakUsedBytes == RegionSize);
+      std::vector<Range> ranges;
+      for (int32_t i = 0; i < 64; i++) ranges.push_back(Range{ allocator.Allocate(i % 2, PageSize), PageSize });
+      CheckRanges(ranges, 1);
+      CHECK(Throws([&]() { allocator.Allocate(0, 1); }));
+      allocator.BeginFrame(1);
+      CHECK(Throws([&]() { allocator.Allocate(1, RegionSize + 1); }));
+      allocator.BeginFrame(0);
+      CHECK(allocator.Allocate(0, 1) == 0);
+      CHECK(Throws([&]() { allocator.BeginFrame(2); }));
+      CHECK(Throws([&]() { allocator.BeginFrame(-1); }));
+   }
+
+   // Each frame index has its region: a frame allocates only in its own, so the regions of the frames in flight are left alone,
+   // and reusing an index starts its region over.
+   void TestRegions()
+   {
+      const int32_t RegionCount = 3;
+      FrameAllocator allocator(RegionSize, RegionCount, 2, PageSize, Alignment);
+      std::vector<Range> frames[RegionCount];
+      for (int32_t frame = 0; frame < 2 * RegionCount; frame++)
+      {
+         int32_t frameIdx = frame % RegionCount;
+         allocator.BeginFrame(frameIdx);
+         std::vector<Range> ranges;
+         for (int32_t i = 0; i < 40 + frame * 10; i++)
+         {
+            uint64_t size = 64 + uint64_t(i * 997 % 3000);
+            ranges.push_back(Range{ allocator.Allocate(i % 2, size), size });
+         }
+         CheckRanges(ranges, frameIdx);
+         // The same requests in a reused region get the same offsets, as it started over.
+         if (frame >= RegionCount)
+         {
+            for (size_t i = 0; i < frames[frameIdx].size(); i++) CHECK(ranges[i].Offset == frames[frameIdx][i].Offset);
+         }
+         frames[frameIdx] = ranges;
+      }
+   }
+
+   // Threads allocating at once never get overlapping ranges, and the stats sum up all of them.
+   void TestThreads()
+   {
+      const int32_t ThreadCount = 4, Allocations = 2000;
+      FrameAllocator allocator(1024 * PageSize, 1, ThreadCount, PageSize, Alignment);
+      allocator.BeginFrame(0);
+      std::vector<Range> ranges[ThreadCount];
+      std::vector<std::thread> threads;
+      for (int32_t t = 0; t < ThreadCount; t++)
+      {
+         threads.emplace_back([&, t]()
+            {
+               for (int32_t i = 0; i < Allocations; i++)
+               {
+                  uint64_t size = 1 + uint64_t((i * 7919 + t * 131) % 300);
+                  if (i % 500 == 0) size = PageSize * 2;
+                  ranges[t].push_back(Range{ allocator.Allocate(t, size), size });
+               }
+            });
+      }
+      for (std::thread& thread : threads) thread.join();
+      std::vector<Range> all;
+      uint64_t allocated = 0;
+      for (const std::vector<Range>& thread : ranges)
+      {
+         for (const Range& range : thread)
+         {
+            all.push_back(range);
+            allocated += (range.Size + Alignment - 1) / Alignment * Alignment;
+         }
+      }
+      std::sort(all.begin(), all.end(), [](const Range& a, const Range& b) { return a.Offset < b.Offset; });
+      for (size_t i = 1; i < all.size(); i++) CHECK(all[i - 1].Offset + all[i - 1].Size <= all[i].Offset);
+      allocator.BeginFrame(0);
+      CHECK(allocator.GetStats().Allocations == uint64_t(ThreadCount * Allocations) && allocator.GetStats().AllocatedBytes == allocated);
+   }
+}
+
+int main()
+{
+   try
+   {
+      TestAlignment();
+      TestPages();
+      TestExhaustion();
+      TestRegions();
+      TestThreads();
+   }
+   catch (std::exception& e)
+   {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   std::printf("FrameAllocator tests passed.\n");
+   return 0;
+}
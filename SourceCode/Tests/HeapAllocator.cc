@@ -0,0 +1,146 @@
+// HeapAllocator: placement and merging in a block, blocks for oversized allocations, which empty blocks are kept, and random churn
+// checked with Validate().
+#include <algorithm>
+#include <random>
+#include "Check.h"
+#include "Core/Renderers/HeapAllocator.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   const uint64_t Mib = 1 << 20;
+
+   void TestBlock()
+   {
+      HeapAllocator heaps(Mib, 256);
+      // Sizes round up to the granularity, and allocations follow each other in the first block.
+      HeapAllocation a = heaps.Allocate(100), b = heaps.Allocate(300), c = heaps.Allocate(256);
+      CHECK(a.Block == 0 && a.Offset == 0 && a.Size == 256);
+      CHECK(b.Block == 0 && b.Offset == 256 && b.Size == 512);
+      CHECK(c.Block == 0 && c.Offset == 768 && c.Size == 256);
+      HeapAllocatorStats stats = heaps.GetStats();
+      CHECK(stats.Blocks == 1 && stats.Allocations == 3 && stats.FreeRanges == 1);
+      CHECK(stats.LiveBytes == 1024 && stats.ReservedBytes == Mib && stats.LargestFreeRange == Mib - 1024);
+      // A hole in the middle fragments the free memory, and freeing its neighbours merges it back.
+      CHECK(heaps.Free(b) == -1);
+      stats = heaps.GetStats();
+      CHECK(stats.FreeRanges == 2 && stats.Fragmentation > 0);
+      heaps.Free(a);
+      CHECK(heaps.GetStats().FreeRanges == 2);
+      heaps.Free(c);
+      stats = heaps.GetStats();
+      CHECK(stats.FreeRanges == 1 && stats.Allocations == 0 && stats.Fragmentation == 0);
+      // The last empty block of the block size is kept.
+      CHECK(stats.Blocks == 1 && stats.ReservedBytes == Mib);
+      heaps.Validate();
+   }
+
+   void TestBlocks()
+   {
+      HeapAllocator heaps(Mib, 256);
+      // Beyond the block size, an allocation gets a block of its own, released with it.
+      HeapAllocation big = heaps.Allocate(3 * Mib);
+      CHECK(big.Offset == 0 && big.Size == 3 * Mib);
+      CHECK(heaps.GetBlockSize(big.Block) == 3 * Mib);
+      CHECK(heaps.Free(big) == big.Block);
+      // Two full blocks. Freeing the first leaves it as the one empty block kept, so the second is released.
+      HeapAllocation first = heaps.Allocate(Mib), second = heaps.Allocate(Mib);
+      CHECK(first.Block != second.Block);
+      CHECK(heaps.GetStats().Blocks == 2 && heaps.GetStats().FreeRanges == 0);
+      CHECK(heaps.Free(first) == -1);
+      CHECK(heaps.Free(second) == second.Block);
+      HeapAllocatorStats stats = heaps.GetStats();
+      CHECK(stats.Blocks == 1 && stats.ReservedBytes == Mib && stats.Allocations == 0);
+      heaps.Validate();
+   }
+
+   // Allocations of random sizes and lifetimes, at the texture placement alignment. Live ones never overlap.
+   void TestChurn()
+   {
+      const uint64_t Granularity = 1 << 16;
+      HeapAllocator heaps(64 * Mib, Granularity);
+      std::mt19937_64 random(1);
+      std::vector<std::pair<HeapAllocation, uint64_t>> live; // With the requested size.
+      for (int32_t step = 0; step < 20000; step++)
+      {
+         if (!live.empty() && random() % 2 == 0)
+         {
+            size_t index = random() % live.size();
+            heaps.Free(live[index].first);
+            live[index] = live.back();
+            live.pop_back();
+            continue;
+         }
+         uint64_t size = (uint64_t(1) << (random() % 25)) + random() % 4096;
+         HeapAllocation allocation = heaps.Allocate(size);
+         CHECK(allocation.Offset % Granularity == 0 && allocation.Size >= size && allocation.Size - size < Granularity);
+         CHECK(allocation.Offset + allocation.Size <= heaps.GetBlockSize(allocation.Block));
+         live.emplace_back(allocation, size);
+         if (step % 500 != 0) continue;
+         heaps.Validate();
+         std::vector<HeapAllocation> sorted;
+         for (const auto& item : live) sorted.push_back(item.first);
+         std::sort(sorted.begin(), sorted.end(), [](const HeapAllocation& a, const HeapAllocation& b)
+            {
+               return a.Block < b.Block || (a.Block == b.Block && a.Offset < b.Offset);
+            });
+         for (size_t i = 1; i < sorted.size(); i++)
+         {
+            CHECK(sorted[i - 1].Block != sorted[i].Block || sorted[i - 1].Offset + sorted[i - 1].Size <= sorted[i].Offset);
+         }
+      }
+      HeapAllocatorStats stats = heaps.GetStats();
+      CHECK(stats.Allocations == int32_t(live.size()));
+      for (const auto& item : live) heaps.Free(item.first);
+      heaps.Validate();
+      stats = heaps.GetStats();
+      CHECK(stats.Allocations == 0 && stats.LiveBytes == 0 && stats.Blocks <= 1);
+   }
+
+   template<typename Function>
+   bool Throws(Function function)
+   {
+      try
+      {
+         function();
+      }
+      catch (std::runtime_error&)
+      {
+         return true;
+      }
+      return false;
+   }
+
+   void TestErrors()
+   {
+      CHECK(Throws([]() { HeapAllocator heaps(1000, 256); }));
+      CHECK(Throws([]() { HeapAllocator heaps(1024, 3); }));
+      CHECK(Throws([]() { HeapAllocator heaps(1024, 0); }));
+      HeapAllocator heaps(Mib, 256);
+      CHECK(Throws([&]() { heaps.Allocate(0); }));
+      HeapAllocation allocation = heaps.Allocate(1000);
+      heaps.Free(allocation);
+      CHECK(Throws([&]() { heaps.Free(allocation); }));
+      CHECK(Throws([&]() { heaps.Free(HeapAllocation{}); }));
+   }
+}
+
+int main()
+{
+   try
+   {
+      TestBlock();
+      TestBlocks();
+      TestChurn();
+      TestErrors();
+   }
+   catch (std::exception& e)
+   {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   std::printf("HeapAllocator tests passed.\n");
+   return 0;
+}
@@ -0,0 +1,233 @@
+// LightClusters against a brute-force assignment of spheres and cones to every froxel, across slice splits, and without lights.
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "Check.h"
+#include "Core/Renderers/LightClusters.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   const float NearZ = 0.5f, FarZ = 200;
+   const int32_t Samples = 4; // Per froxel axis.
+
+   // Random point and spot lights in and around the view, given in view space and moved to world space.
+   std::vector<Light> MakeLights(int32_t count, CXMMATRIX viewToWorld)
+   {
+      std::mt19937 random(7);
+      std::uniform_real_distribution<float> unit(0, 1);
+      std::vector<Light> lights(count);
+      for (int32_t i = 0; i < count; i++)
+      {
+         Light& light = lights[i];
+         float z = -10 + unit(random) * 220;
+         XMFLOAT3 position((unit(random) * 2 - 1) * (std::abs(z) * 0.5f + 10), (unit(random) * 2 - 1) * (std::abs(z) * 0.3f + 10), z);
+         XMStoreFloat3(&light.Position, XMVector3TransformCoord(XMLoadFloat3(&position), viewToWorld));
+         light.Range = 0.3f + unit(random) * 12;
+         XMFLOAT3 direction(unit(random) * 2 - 1, unit(random) * 2 - 1, unit(random) * 2 - 1);
+         XMStoreFloat3(&light.Direction, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&direction), viewToWorld)));
+         light.SpotAngle = i % 3 == 0 ? 0.1f + unit(random) * 1.3f : 0;
+         light.Color = XMFLOAT3(1, 1, 1);
+         light.Intensity = 1;
+      }
+      // Edge cases: no range, a spot angle taken as a point light, and a light behind the camera.
+      lights[1].Range = 0;
+      lights[3].SpotAngle = XM_PIDIV2;
+      XMStoreFloat3(&lights[4].Position, XMVector3TransformCoord(XMVectorSet(0, 0, -20, 1), viewToWorld));
+      return lights;
+   }
+
+   struct Froxel
+   {
+      float Z0, Z1;
+      float NdcX0, NdcX1, NdcY0, NdcY1; // NdcY0 is the bottom.
+   };
+
+   Froxel GetFroxel(int32_t i, int32_t j, int32_t k)
+   {
+      float ratio = FarZ / NearZ;
+      return Froxel{ NearZ * std::pow(ratio, float(k) / LightClusters::CountZ), NearZ * std::pow(ratio, float(k + 1) / LightClusters::CountZ),
+         -1 + 2 * float(i) / LightClusters::CountX, -1 + 2 * float(i + 1) / LightClusters::CountX,
+         1 - 2 * float(j + 1) / LightClusters::CountY, 1 - 2 * float(j) / LightClusters::CountY };
+   }
+
+   // A light in view space, as the brute force sees it.
+   struct ViewLight
+   {
+      XMVECTOR Position;
+      XMVECTOR Direction;
+      float Range;
+      bool IsSpot;
+      float SpotAngle;
+   };
+
+   // What the froxel tests may accept: the sphere touches the froxel's box, and a cone doesn't cull the froxel's bounding sphere.
+   // A small tolerance covers rounding, the assignment must be a subset of these.
+   bool MayHit(const ViewLight& light, const Froxel& froxel, float p00, float p11)
+   {
+      XMFLOAT3 minimum(std::min(froxel.NdcX0 * froxel.Z0, froxel.NdcX0 * froxel.Z1) / p00, std::min(froxel.NdcY0 * froxel.Z0, froxel.NdcY0 * froxel.Z1) / p11, froxel.Z0);
+      XMFLOAT3 maximum(std::max(froxel.NdcX1 * froxel.Z0, froxel.NdcX1 * froxel.Z1) / p00, std::max(froxel.NdcY1 * froxel.Z0, froxel.NdcY1 * froxel.Z1) / p11, froxel.Z1);
+      XMVECTOR low = XMLoadFloat3(&minimum), high = XMLoadFloat3(&maximum);
+      XMVECTOR closestPoint = XMVectorClamp(light.Position, low, high);
+      float distanceSq = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(closestPoint, light.Position)));
+      float tolerance = 1e-3f * light.Range + 1e-4f;
+      if (distanceSq > (light.Range + tolerance) * (light.Range + tolerance)) return false;
+      if (!light.IsSpot) return true;
+      XMVECTOR center = XMVectorScale(XMVectorAdd(low, high), 0.5f);
+      float radius = XMVectorGetX(XMVector3Length(XMVectorSubtract(high, center)));
+      XMVECTOR v = XMVectorSubtract(center, light.Position);
+      float axial = XMVectorGetX(XMVector3Dot(v, light.Direction));
+      float lateral = std::sqrt(std::max(XMVectorGetX(XMVector3LengthSq(v)) - axial * axial, 0.f));
+      float closest = std::cos(light.SpotAngle) * lateral - axial * std::sin(light.SpotAngle);
+      tolerance += 1e-3f * radius;
+      return closest <= radius + tolerance && axial <= radius + light.Range + tolerance && axial >= -radius - tolerance;
+   }
+
+   // What the froxel tests must accept: a point inside the froxel is well inside the light's sphere, and its cone.
+   bool MustHit(const ViewLight& light, const Froxel& froxel, float p00, float p11)
+   {
+      for (int32_t a = 0; a < Samples; a++)
+      {
+         for (int32_t b = 0; b < Samples; b++)
+         {
+            for (int32_t c = 0; c < Samples; c++)
+            {
+               float z = froxel.Z0 + (froxel.Z1 - froxel.Z0) * (c + 0.5f) / Samples;
+               float ndcX = froxel.NdcX0 + (froxel.NdcX1 - froxel.NdcX0) * (a + 0.5f) / Samples;
+               float ndcY = froxel.NdcY0 + (froxel.NdcY1 - froxel.NdcY0) * (b + 0.5f) / Samples;
+               XMVECTOR v = XMVectorSubtract(XMVectorSet(ndcX * z / p00, ndcY * z / p11, z, 0), light.Position);
+               float length = XMVectorGetX(XMVector3Length(v));
+               if (length > light.Range * 0.999f) continue;
+               if (light.IsSpot && XMVectorGetX(XMVector3Dot(v, light.Direction)) <= length * std::cos(std::max(light.SpotAngle - 0.01f, 0.f))) continue;
+               return true;
+            }
+         }
+      }
+      return false;
+   }
+
+   // Flags of the lights listed by each cluster, checking the lists are packed, sorted and within their slots.
+   std::vector<uint8_t> GetAssignment(const LightClusters& clusters, int32_t lightCount)
+   {
+      std::vector<uint8_t> assigned(size_t(LightClusters::Count) * lightCount);
+      const std::vector<uint32_t>& indices = clusters.GetLightIndices();
+      uint32_t offset = 0;
+      int32_t maxCount = 0;
+      std::vector<uint8_t> isVisible(lightCount);
+      for (int32_t c = 0; c < LightClusters::Count; c++)
+      {
+         LightCluster cluster = clusters.GetClusters()[c];
+         CHECK(cluster.Offset == offset && cluster.Count <= uint32_t(LightClusters::MaxClusterLights));
+         offset += cluster.Count;
+         maxCount = std::max(maxCount, int32_t(cluster.Count));
+         for (uint32_t n = 0; n < cluster.Count; n++)
+         {
+            uint32_t light = indices[cluster.Offset + n];
+            CHECK(light < uint32_t(lightCount) && (n == 0 || light > indices[cluster.Offset + n - 1]));
+            assigned[size_t(c) * lightCount + light] = 1;
+            isVisible[light] = 1;
+         }
+      }
+      CHECK(offset == indices.size() && maxCount == clusters.GetMaxClusterLightCount());
+      CHECK(clusters.GetVisibleLightCount() == int32_t(std::count(isVisible.begin(), isVisible.end(), uint8_t(1))));
+      return assigned;
+   }
+
+   // Every froxel against every light, with the lists of one pass over all slices.
+   void TestBruteForce()
+   {
+      XMMATRIX view = XMMatrixLookToLH(XMVectorSet(3, 2, -5, 1), XMVectorSet(0.2f, -0.1f, 1, 0), XMVectorSet(0, 1, 0, 0));
+      XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.f / 9.f, NearZ, FarZ);
+      XMMATRIX viewToWorld = XMMatrixInverse(nullptr, view);
+      const int32_t LightCount = 300;
+      std::vector<Light> lights = MakeLights(LightCount, viewToWorld);
+      LightClusters clusters;
+      clusters.Begin(lights, view, projection);
+      clusters.AssignSlices(0, LightClusters::CountZ);
+      clusters.Finish();
+      CHECK(clusters.GetDroppedLightCount() == 0);
+      std::vector<uint8_t> assigned = GetAssignment(clusters, LightCount);
+      float p00 = XMVectorGetX(projection.r[0]), p11 = XMVectorGetY(projection.r[1]);
+      int32_t hits = 0;
+      for (int32_t l = 0; l < LightCount; l++)
+      {
+         const Light& light = lights[l];
+         ViewLight viewLight{ XMVector3TransformCoord(XMLoadFloat3(&light.Position), view),
+            XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&light.Direction), view)), light.Range,
+            light.SpotAngle > 0 && light.SpotAngle < XM_PIDIV2, light.SpotAngle };
+         int32_t lightHits = 0;
+         for (int32_t k = 0; k < LightClusters::CountZ; k++)
+         {
+            for (int32_t j = 0; j < LightClusters::CountY; j++)
+            {
+               for (int32_t i = 0; i < LightClusters::CountX; i++)
+               {
+                  Froxel froxel = GetFroxel(i, j, k);
+                  bool isAssigned = assigned[size_t((k * LightClusters::CountY + j) * LightClusters::CountX + i) * LightCount + l];
+                  bool mayHit = MayHit(viewLight, froxel, p00, p11);
+                  if (isAssigned) CHECK(mayHit);
+                  // Sampling only matters where the box test passes, the samples are inside the box.
+                  else if (mayHit) CHECK(!MustHit(viewLight, froxel, p00, p11));
+                  lightHits += isAssigned;
+               }
+            }
+         }
+         if (light.Range <= 0 || l == 4) CHECK(lightHits == 0);
+         hits += lightHits;
+      }
+      CHECK(hits == int32_t(clusters.GetLightIndices().size()));
+      CHECK(clusters.GetVisibleLightCount() > LightCount / 4 && clusters.GetVisibleLightCount() < LightCount);
+   }
+
+   // Slices are independent: assigned one at a time, out of order, the lists are the same. Then an empty frame clears them,
+   // and the next frame with lights matches the first.
+   void TestSlicesAndEmpty()
+   {
+      XMMATRIX view = XMMatrixTranslation(-1, 0, 2);
+      XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.f / 9.f, NearZ, FarZ);
+      std::vector<Light> lights = MakeLights(200, XMMatrixInverse(nullptr, view));
+      LightClusters whole, split;
+      whole.Begin(lights, view, projection);
+      whole.AssignSlices(0, LightClusters::CountZ);
+      whole.Finish();
+      split.Begin(lights, view, projection);
+      for (int32_t k = LightClusters::CountZ - 1; k >= 0; k -= 2) split.AssignSlices(k, k + 1);
+      split.AssignSlices(0, 0);
+      for (int32_t k = 0; k < LightClusters::CountZ; k += 2) split.AssignSlices(k, k + 1);
+      split.Finish();
+      CHECK(whole.GetLightIndices() == split.GetLightIndices() && whole.GetVisibleLightCount() == split.GetVisibleLightCount());
+      for (int32_t c = 0; c < LightClusters::Count; c++)
+      {
+         CHECK(whole.GetClusters()[c].Offset == split.GetClusters()[c].Offset && whole.GetClusters()[c].Count == split.GetClusters()[c].Count);
+      }
+      std::vector<uint32_t> indices = whole.GetLightIndices();
+      whole.Begin(std::vector<Light>(), view, projection);
+      whole.AssignSlices(0, LightClusters::CountZ);
+      whole.Finish();
+      CHECK(whole.GetLightIndices().empty() && whole.GetVisibleLightCount() == 0 && whole.GetMaxClusterLightCount() == 0);
+      for (const LightCluster& cluster : whole.GetClusters()) CHECK(cluster.Offset == 0 && cluster.Count == 0);
+      whole.Begin(lights, view, projection);
+      whole.AssignSlices(0, LightClusters::CountZ);
+      whole.Finish();
+      CHECK(whole.GetLightIndices() == indices);
+   }
+}
+
+int main()
+{
+   try
+   {
+      TestBruteForce();
+      TestSlicesAndEmpty();
+   }
+   catch (std::exception& e)
+   {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   std::printf("LightClusters tests passed.\n");
+   return 0;
+}
@@ -0,0 +1,138 @@
+// Level of detail selection in Commit(): hysteresis around a switching distance, the triangle budget, and the triangle count.
+#include <cmath>
+#include <vector>
+#include "Check.h"
+#include "Core/Renderers/Renderer.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   // 4 levels with a quarter of the triangles and 5x the error of the previous one, like the headless demo's.
+   LodChain MakeChain(NullRenderer& renderer)
+   {
+      LodChain chain;
+      chain.AddLevel(renderer.CreateResource(ResourceType::Mesh), 4096, 0);
+      for (int32_t level = 1; level < 4; level++)
+      {
+         chain.AddLevel(renderer.CreateResource(ResourceType::Mesh), 4096 >> (2 * level), 0.02f * std::pow(5.f, float(level - 1)));
+      }
+      return chain;
+   }
+
+   void Submit(const LodChain& chain, uint8_t& level, XMFLOAT3 position, ResourceHandle pipelineState, ResourceHandle material)
+   {
+      Drawcall drawcall{ MakeSortKey(0, pipelineState, material, 0, chain.Levels[0].Mesh, position.z), chain.Levels[0].Mesh, material, pipelineState,
+         InstanceData{} };
+      SubmitDrawcall(drawcall, BoundingBox(position, XMFLOAT3(0, 0, 0)), chain, level);
+   }
+
+   // With a 90 degree field of view at 1080p, the error of level 1 covers 0.02 * 540 / d pixels, 1 pixel at d = 10.8. An item
+   // moving a unit back and forth across that distance flips every frame without hysteresis, and keeps its level with it.
+   void TestHysteresis(NullRenderer& renderer)
+   {
+      ResourceHandle pipelineState = renderer.CreateResource(ResourceType::PiplelineState);
+      ResourceHandle material = renderer.CreateResource(ResourceType::ConstantBuffer);
+      LodChain chain = MakeChain(renderer);
+      for (float hysteresis : { 0.f, 0.25f })
+      {
+         renderer.SetLodPolicy(1, hysteresis, 0);
+         uint8_t level = 0;
+         int32_t changes = 0;
+         for (int32_t frame = 0; frame < 100; frame++)
+         {
+            uint8_t last = level;
+            Submit(chain, level, XMFLOAT3(0, 0, frame % 2 ? 11.8f : 9.8f), pipelineState, material);
+            renderer.Commit();
+            changes += level != last;
+            CHECK(level <= 1);
+            CHECK(renderer.GetLodStats().LodItems == 1 && renderer.GetLodStats().SubmittedTriangles == chain.Levels[level].TriangleCount);
+         }
+         if (hysteresis == 0) CHECK(changes >= 99);
+         else CHECK(changes == 0);
+         // Leaving the band switches: far enough away, the item coarsens, and close enough, it refines again.
+         Submit(chain, level, XMFLOAT3(0, 0, 15), pipelineState, material);
+         renderer.Commit();
+         CHECK(level == 1);
+         // Back at 11.8, level 1 is within the threshold either way.
+         Submit(chain, level, XMFLOAT3(0, 0, 11.8f), pipelineState, material);
+         renderer.Commit();
+         CHECK(level == 1);
+         Submit(chain, level, XMFLOAT3(0, 0, 8), pipelineState, material);
+         renderer.Commit();
+         CHECK(level == 0);
+      }
+   }
+
+   // Items spread from 2 to 400 units away, under budgets from none to less than all coarsest levels. The count is the sum of the
+   // selected levels, and stays within the budget unless every item is at its coarsest level.
+   void TestBudget(NullRenderer& renderer)
+   {
+      ResourceHandle pipelineState = renderer.CreateResource(ResourceType::PiplelineState);
+      ResourceHandle material = renderer.CreateResource(ResourceType::ConstantBuffer);
+      const int32_t ItemCount = 500;
+      std::vector<LodChain> chains;
+      for (int32_t i = 0; i < 4; i++) chains.push_back(MakeChain(renderer));
+      std::vector<uint8_t> levels(ItemCount);
+      int64_t unlimited = 0;
+      for (int64_t budget : { int64_t(0), int64_t(100000000), int64_t(200000), int64_t(60000), int64_t(ItemCount * 64), int64_t(1000) })
+      {
+         renderer.SetLodPolicy(1, 0.25f, budget);
+         for (int32_t frame = 0; frame < 3; frame++)
+         {
+            for (int32_t i = 0; i < ItemCount; i++)
+            {
+               float distance = 2 + float(uint32_t(i + 1) * 2654435761u % 3980) / 10;
+               Submit(chains[i % 4], levels[i], XMFLOAT3(float(i % 7) - 3, float(i % 5) - 2, distance), pipelineState, material);
+            }
+            renderer.Commit();
+            LodStats stats = renderer.GetLodStats();
+            int64_t sum = 0;
+            bool isCoarsest = true;
+            for (int32_t i = 0; i < ItemCount; i++)
+            {
+               const std::vector<MeshLod>& chain = chains[i % 4].Levels;
+               sum += chain[levels[i]].TriangleCount;
+               isCoarsest &= levels[i] + 1 == int32_t(chain.size());
+            }
+            CHECK(stats.LodItems == ItemCount && stats.SubmittedTriangles == sum);
+            if (budget == 0) unlimited = sum;
+            CHECK(stats.ErrorThreshold >= 1);
+            if (budget > 0) CHECK(sum <= budget || isCoarsest);
+            // A budget below all coarsest levels leaves every item at its coarsest.
+            if (budget > 0 && budget < ItemCount * 64) CHECK(isCoarsest && stats.ErrorThreshold > 1);
+            // A budget above the selection changes nothing.
+            if (budget >= unlimited) CHECK(sum == unlimited && stats.ErrorThreshold == 1);
+         }
+      }
+      // The budgets between cut into the selection.
+      CHECK(unlimited > 200000);
+   }
+}
+
+int main()
+{
+   ScreenSize = XMINT2{ 1920, 1080 };
+   InitializeRenderer(2, nullptr);
+   NullRenderer& renderer = static_cast<NullRenderer&>(*Instance);
+   renderer.SetWorkerAutotuning(false);
+   renderer.Launch();
+   renderer.SetCamera(XMMatrixIdentity(), XMMatrixPerspectiveFovLH(XM_PIDIV2, 16.f / 9.f, 0.1f, 1000.f));
+   try
+   {
+      TestHysteresis(renderer);
+      TestBudget(renderer);
+   }
+   catch (std::exception& e)
+   {
+      renderer.Terminate();
+      Instance.reset();
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   renderer.Terminate();
+   Instance.reset();
+   std::printf("Lods tests passed.\n");
+   return 0;
+}
@@ -0,0 +1,156 @@
+// OcclusionBuffer: boxes behind a known occluder quad are rejected and others kept, and results don't depend on how
+// ParallelFor() splits the setup, the bands and the tests.
+#include <algorithm>
+#include <vector>
+#include "Check.h"
+#include "Core/Renderers/Renderer.h"
+#include "Core/Renderers/Occlusion.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   // Looking down +z from the origin. The buffer's aspect is 2, so the view spans 2 units across per unit of depth, and 1 up.
+   const XMMATRIX ViewProjection = XMMatrixPerspectiveFovLH(XM_PIDIV2, 2, 0.1f, 1000);
+
+   void AddQuad(std::vector<XMFLOAT3>& vertices, XMFLOAT3 center, float halfWidth, float halfHeight)
+   {
+      XMFLOAT3 corners[4] = { { center.x - halfWidth, center.y - halfHeight, center.z }, { center.x + halfWidth, center.y - halfHeight, center.z },
+         { center.x + halfWidth, center.y + halfHeight, center.z }, { center.x - halfWidth, center.y + halfHeight, center.z } };
+      for (int32_t i : { 0, 1, 2, 0, 2, 3 }) vertices.push_back(corners[i]);
+   }
+
+   // Rasterize on the calling thread in one go.
+   void Rasterize(OcclusionBuffer& buffer, const std::vector<XMFLOAT3>& vertices)
+   {
+      buffer.Begin(vertices, ViewProjection);
+      buffer.SetupTriangles(0, int32_t(vertices.size() / 3));
+      buffer.Rasterize(0, OcclusionBuffer::Height);
+   }
+
+   // A 10 x 10 quad 10 units ahead covers the middle quarter of the width and half of the height.
+   void TestQuad()
+   {
+      std::vector<XMFLOAT3> vertices;
+      AddQuad(vertices, XMFLOAT3(0, 0, 10), 5, 5);
+      OcclusionBuffer buffer;
+      Rasterize(buffer, vertices);
+      CHECK(buffer.GetTriangleCount() == 2);
+      struct Case
+      {
+         BoundingBox Box;
+         uint8_t Visible;
+      };
+      const Case cases[] =
+      {
+         { BoundingBox(XMFLOAT3(0, 0, 20), XMFLOAT3(1, 1, 1)), 0 },     // Right behind it.
+         { BoundingBox(XMFLOAT3(3, -3, 100), XMFLOAT3(5, 5, 5)), 0 },   // Far behind it, off center.
+         { BoundingBox(XMFLOAT3(0, 0, 50), XMFLOAT3(30, 1, 1)), 1 },    // Behind it, but wider.
+         { BoundingBox(XMFLOAT3(15, 0, 20), XMFLOAT3(1, 1, 1)), 1 },    // Beside it.
+         { BoundingBox(XMFLOAT3(0, 12, 20), XMFLOAT3(1, 1, 1)), 1 },    // Above it.
+         { BoundingBox(XMFLOAT3(0, 0, 5), XMFLOAT3(1, 1, 1)), 1 },      // In front of it.
+         { BoundingBox(XMFLOAT3(0, 0, 10), XMFLOAT3(1, 1, 1)), 1 },     // Through it.
+         { BoundingBox(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1)), 1 },      // Around the camera.
+      };
+      BoundsArray bounds;
+      for (const Case& item : cases) bounds.Push(item.Box);
+      bounds.Pad();
+      std::vector<uint8_t> visibility(bounds.GetCount(), 1);
+      buffer.TestOccludees(bounds, 0, bounds.GetCount(), visibility.data());
+      for (size_t i = 0; i < std::size(cases); i++) CHECK(visibility[i] == cases[i].Visible);
+      // Items already invisible stay so.
+      std::fill(visibility.begin(), visibility.end(), uint8_t(0));
+      buffer.TestOccludees(bounds, 0, bounds.GetCount(), visibility.data());
+      for (uint8_t visible : visibility) CHECK(visible == 0);
+      // Without occluders, nothing is rejected.
+      std::vector<XMFLOAT3> none;
+      Rasterize(buffer, none);
+      std::fill(visibility.begin(), visibility.end(), uint8_t(1));
+      buffer.TestOccludees(bounds, 0, bounds.GetCount(), visibility.data());
+      for (uint8_t visible : visibility) CHECK(visible == 1);
+   }
+
+   // A triangle crossing the near plane is dropped, so it hides nothing.
+   void TestNearPlane()
+   {
+      std::vector<XMFLOAT3> vertices = { { -50, -50, -1 }, { 50, -50, 20 }, { 0, 50, 20 } };
+      OcclusionBuffer buffer;
+      Rasterize(buffer, vertices);
+      BoundsArray bounds;
+      bounds.Push(BoundingBox(XMFLOAT3(0, 0, 100), XMFLOAT3(1, 1, 1)));
+      bounds.Pad();
+      std::vector<uint8_t> visibility(bounds.GetCount(), 1);
+      buffer.TestOccludees(bounds, 0, bounds.GetCount(), visibility.data());
+      CHECK(visibility[0] == 1);
+   }
+
+   // Random occluders and occludees, run whole on one thread, then through ParallelFor() with several grains. Bands never share
+   // pixels, so every split gives the same visibility.
+   void TestSplits(GenericRenderer& renderer)
+   {
+      std::vector<XMFLOAT3> vertices;
+      for (int32_t i = 0; i < 300; i++)
+      {
+         uint32_t random = uint32_t(i + 1) * 2654435761u;
+         XMFLOAT3 center(float(random % 200) - 100, float(random / 200 % 100) - 50, 20 + float(random / 20000 % 100));
+         XMFLOAT3 a(center.x + float(random >> 28) * 2, center.y, center.z), b(center.x, center.y + float(random >> 24 & 15) * 2, center.z + 3);
+         vertices.push_back(center);
+         vertices.push_back(a);
+         vertices.push_back(b);
+      }
+      BoundsArray bounds;
+      for (int32_t i = 0; i < 5001; i++)
+      {
+         uint32_t random = uint32_t(i + 1) * 2246822519u;
+         float extent = 0.5f + float(random >> 30);
+         bounds.Push(BoundingBox(XMFLOAT3(float(random % 300) - 150, float(random / 300 % 150) - 75, 10 + float(random / 45000 % 200)),
+            XMFLOAT3(extent, extent, extent)));
+      }
+      bounds.Pad();
+      int32_t triangleCount = int32_t(vertices.size() / 3), count = bounds.GetCount();
+      OcclusionBuffer reference;
+      Rasterize(reference, vertices);
+      std::vector<uint8_t> expected(count, 1);
+      reference.TestOccludees(bounds, 0, count, expected.data());
+      int32_t occluded = int32_t(std::count(expected.begin(), expected.end(), uint8_t(0)));
+      CHECK(occluded > 0 && occluded < count);
+      for (int32_t grain : { 1, 7, 64 })
+      {
+         OcclusionBuffer buffer;
+         buffer.Begin(vertices, ViewProjection);
+         renderer.ParallelFor(triangleCount, grain, [&](int32_t begin, int32_t end) { buffer.SetupTriangles(begin, end); });
+         renderer.ParallelFor(OcclusionBuffer::Height, OcclusionBuffer::TileSize * (grain == 64 ? 4 : 1), [&](int32_t begin, int32_t end)
+            {
+               buffer.Rasterize(begin, end);
+            });
+         std::vector<uint8_t> visibility(count, 1);
+         renderer.ParallelFor(count, grain * 4, [&](int32_t begin, int32_t end) { buffer.TestOccludees(bounds, begin, end, visibility.data()); });
+         CHECK(visibility == expected);
+      }
+   }
+}
+
+int main()
+{
+   InitializeRenderer(3, nullptr);
+   Instance->SetWorkerAutotuning(false);
+   Instance->Launch();
+   try
+   {
+      TestQuad();
+      TestNearPlane();
+      TestSplits(*Instance);
+   }
+   catch (std::exception& e)
+   {
+      Instance->Terminate();
+      Instance.reset();
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   Instance->Terminate();
+   Instance.reset();
+   std::printf("Occlusion tests passed.\n");
+   return 0;
+}
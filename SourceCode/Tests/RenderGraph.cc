@@ -0,0 +1,167 @@
+// RenderGraph::Compile(): culling, lifetimes, aliasing of transient memory, barriers, and the errors it reports.
+#include "Check.h"
+#include "Core/Renderers/RenderGraph.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   using enum ResourceState;
+
+   const int64_t Kib = 1024;
+
+   bool HasBarrier(const std::vector<RenderGraphBarrier>& barriers, int32_t resource, ResourceState before, ResourceState after)
+   {
+      for (const RenderGraphBarrier& barrier : barriers)
+      {
+         if (barrier.Resource == resource && barrier.Before == before && barrier.After == after) return true;
+      }
+      return false;
+   }
+
+   // Passes in declaration order, the culled ones marked:
+   // 0 A        writes T1
+   // 1 B        reads T1, writes T2
+   // 2 C        writes T3, which nothing reads (culled)
+   // 3 Readback reads T2, has side effects
+   // 4 Stale    writes T4 (culled, Overwrite discards it)
+   // 5 Overwrite writes T4
+   // 6 Present  reads T2 and T4, writes the backbuffer
+   void TestFrame()
+   {
+      RenderGraph graph;
+      int32_t backbuffer = graph.ImportResource("Backbuffer", Present, Present, true);
+      int32_t t1 = graph.CreateTexture("T1", { 256, 256, 4 });
+      int32_t t2 = graph.CreateTexture("T2", { 128, 128, 4 });
+      int32_t t3 = graph.CreateTexture("T3", { 512, 512, 4 });
+      int32_t t4 = graph.CreateTexture("T4", { 256, 256, 4 });
+      int32_t pass = graph.AddPass("A");
+      graph.Write(pass, t1, RenderTarget, true);
+      pass = graph.AddPass("B");
+      graph.Read(pass, t1, ShaderResource);
+      graph.Write(pass, t2, RenderTarget, true);
+      pass = graph.AddPass("C");
+      graph.Write(pass, t3, RenderTarget, true);
+      pass = graph.AddPass("Readback", true);
+      graph.Read(pass, t2, CopySource);
+      pass = graph.AddPass("Stale");
+      graph.Write(pass, t4, UnorderedAccess, true);
+      pass = graph.AddPass("Overwrite");
+      graph.Write(pass, t4, RenderTarget, true);
+      pass = graph.AddPass("Present");
+      graph.Read(pass, t2, ShaderResource);
+      graph.Read(pass, t4, ShaderResource);
+      graph.Write(pass, backbuffer, RenderTarget);
+      graph.Compile();
+      CHECK(graph.IsCompiled());
+
+      // 1 Culling.
+      const RenderGraphStats& stats = graph.GetStats();
+      CHECK(stats.Passes == 7 && stats.CulledPasses == 2);
+      const std::vector<CompiledPass>& compiled = graph.GetCompiledPasses();
+      const int32_t livePasses[] = { 0, 1, 3, 5, 6 };
+      CHECK(compiled.size() == std::size(livePasses));
+      for (size_t i = 0; i < compiled.size(); i++) CHECK(compiled[i].Pass == livePasses[i]);
+      CHECK(graph.GetPassName(compiled[3].Pass) == "Overwrite");
+
+      // 2 Aliasing. T1 lives over A and B, T4 over Overwrite and Present, so they share memory. T2 lives over both.
+      CHECK(stats.TransientResources == 3);
+      CHECK(stats.TransientMemory == (256 + 64 + 256) * Kib);
+      CHECK(stats.AliasedTransientMemory == (256 + 64) * Kib);
+      CHECK(graph.GetPlacement(t1).Offset == 0 && graph.GetPlacement(t4).Offset == 0);
+      CHECK(graph.GetPlacement(t2).Offset == 256 * Kib && graph.GetPlacement(t2).Size == 64 * Kib);
+      CHECK(graph.GetPlacement(t3).Offset == -1);
+      CHECK(graph.GetPlacement(backbuffer).Offset == -1);
+      // Only T4 takes over memory another resource used.
+      CHECK(compiled[3].Activations == std::vector<int32_t>{ t4 });
+      for (size_t i = 0; i < compiled.size(); i++) CHECK(i == 3 || compiled[i].Activations.empty());
+
+      // 3 Barriers. Transient resources start in the state of their first use.
+      CHECK(compiled[0].Barriers.empty());
+      CHECK(compiled[1].Barriers.size() == 1 && HasBarrier(compiled[1].Barriers, t1, RenderTarget, ShaderResource));
+      CHECK(compiled[2].Barriers.size() == 1 && HasBarrier(compiled[2].Barriers, t2, RenderTarget, CopySource));
+      CHECK(compiled[3].Barriers.empty());
+      CHECK(compiled[4].Barriers.size() == 3);
+      CHECK(HasBarrier(compiled[4].Barriers, t2, CopySource, ShaderResource));
+      CHECK(HasBarrier(compiled[4].Barriers, t4, RenderTarget, ShaderResource));
+      CHECK(HasBarrier(compiled[4].Barriers, backbuffer, Present, RenderTarget));
+      CHECK(graph.GetFinalBarriers().size() == 1 && HasBarrier(graph.GetFinalBarriers(), backbuffer, RenderTarget, Present));
+      CHECK(stats.Barriers == 6);
+
+      // Declaring anything makes the graph stale until it's compiled again.
+      graph.AddPass("Late");
+      CHECK(!graph.IsCompiled());
+      graph.Reset();
+      graph.Compile();
+      CHECK(graph.GetStats().Passes == 0 && graph.GetCompiledPasses().empty());
+   }
+
+   // A pass declaring both a read and a discarding write of a resource keeps the earlier writer alive.
+   void TestReadWrite()
+   {
+      RenderGraph graph;
+      int32_t output = graph.ImportResource("Output", Common, Common, true);
+      int32_t history = graph.CreateTexture("History", { 64, 64, 8 });
+      int32_t pass = graph.AddPass("Clear");
+      graph.Write(pass, history, UnorderedAccess, true);
+      pass = graph.AddPass("Accumulate");
+      graph.Write(pass, history, UnorderedAccess, true);
+      graph.Read(pass, history, UnorderedAccess);
+      graph.Write(pass, output, UnorderedAccess);
+      graph.Compile();
+      CHECK(graph.GetStats().CulledPasses == 0);
+      // The output goes back to Common, no barrier sits between two UAV uses of the same state.
+      CHECK(graph.GetCompiledPasses()[1].Barriers.size() == 1);
+      CHECK(graph.GetFinalBarriers().size() == 1);
+   }
+
+   template<typename Function>
+   bool Throws(Function function)
+   {
+      try
+      {
+         function();
+      }
+      catch (std::runtime_error&)
+      {
+         return true;
+      }
+      return false;
+   }
+
+   void TestErrors()
+   {
+      RenderGraph graph;
+      int32_t output = graph.ImportResource("Output", Common, Present, true);
+      int32_t texture = graph.CreateTexture("Texture", { 64, 64, 4 });
+      int32_t pass = graph.AddPass("Draw");
+      CHECK(Throws([&]() { graph.Read(pass, 5, ShaderResource); }));
+      CHECK(Throws([&]() { graph.Read(3, texture, ShaderResource); }));
+      CHECK(Throws([&]() { graph.CreateTexture("Empty", { 0, 64, 4 }); }));
+      graph.Read(pass, texture, ShaderResource);
+      CHECK(Throws([&]() { graph.Write(pass, texture, RenderTarget); }));
+      graph.Write(pass, output, RenderTarget);
+      // The texture's memory may hold another resource's data, as nothing wrote all of it.
+      CHECK(Throws([&]() { graph.Compile(); }));
+      CHECK(!graph.IsCompiled());
+      CHECK(Throws([&]() { graph.GetPlacement(texture); }));
+   }
+}
+
+int main()
+{
+   try
+   {
+      TestFrame();
+      TestReadWrite();
+      TestErrors();
+   }
+   catch (std::exception& e)
+   {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   std::printf("RenderGraph tests passed.\n");
+   return 0;
+}
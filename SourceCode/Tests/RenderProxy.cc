@@ -0,0 +1,225 @@
+// ProxyScene's three buffers: snapshots match the game's state at their Publish(), a held snapshot never changes while the game
+// publishes, only changed proxies are copied on rotation, and Acquire() returns the latest published snapshot, also across threads.
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "Check.h"
+#include "Core/Renderers/RenderProxy.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   const int32_t ProxyCount = 64;
+
+   // Proxies are told apart by a value in their transform.
+   XMFLOAT3X4 MakeWorld(float tag)
+   {
+      XMFLOAT3X4 world(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0);
+      world._14 = tag;
+      return world;
+   }
+
+   float GetTag(const RenderProxy& proxy)
+   {
+      return proxy.Draw.Instance.World._14;
+   }
+
+   void SetTag(ProxyScene& scene, ProxyId id, float tag)
+   {
+      scene.SetTransform(id, MakeWorld(tag), BoundingBox(XMFLOAT3(tag, 0, 0), XMFLOAT3(1, 1, 1)));
+   }
+
+   ProxyScene* MakeScene(std::vector<float>& tags)
+   {
+      ProxyScene* scene = new ProxyScene(ProxyCount);
+      tags.assign(ProxyCount, 0);
+      for (int32_t i = 0; i < ProxyCount; i++)
+      {
+         RenderProxy proxy{};
+         proxy.Draw.Instance.World = MakeWorld(0);
+         proxy.IsVisible = true;
+         CHECK(scene->Create(proxy) == i);
+      }
+      return scene;
+   }
+
+   template<typename Function>
+   bool Throws(Function function)
+   {
+      try
+      {
+         function();
+      }
+      catch (std::runtime_error&)
+      {
+         return true;
+      }
+      return false;
+   }
+
+   void CheckSnapshot(const ProxySnapshot* snapshot, uint64_t sequence, const std::vector<float>& tags)
+   {
+      CHECK(snapshot != nullptr && snapshot->Sequence == sequence && snapshot->Proxies.size() == tags.size());
+      for (size_t i = 0; i < tags.size(); i++) CHECK(GetTag(snapshot->Proxies[i]) == tags[i] && snapshot->Proxies[i].Bounds.Center.x == tags[i]);
+   }
+
+   // Publishes change disjoint sets of proxies. The game's next buffer is the one published before, or the one the renderer
+   // returned, so each Publish() copies the changes of the publishes it missed, and the rest stays.
+   void TestRotation()
+   {
+      std::vector<float> tags;
+      std::unique_ptr<ProxyScene> scene(MakeScene(tags));
+      CHECK(scene->Acquire() == nullptr);
+      scene->Publish();
+      CheckSnapshot(scene->Acquire(), 1, tags);
+      // Warm up, so every buffer was published once.
+      for (int32_t i = 0; i < 2; i++)
+      {
+         scene->Publish();
+         CheckSnapshot(scene->Acquire(), scene->GetStats().Publishes, tags);
+      }
+      const int32_t Changes = 5;
+      for (bool isAcquiring : { false, true })
+      {
+         for (int32_t publish = 0; publish < 20; publish++)
+         {
+            uint64_t sequence = scene->GetStats().Publishes + 1;
+            for (int32_t i = 0; i < Changes; i++)
+            {
+               ProxyId id = ProxyId((sequence * Changes + i) % ProxyCount);
+               tags[id] = float(sequence);
+               SetTag(*scene, id, tags[id]);
+            }
+            // The game's own state changes right away.
+            CHECK(GetTag(scene->Get(ProxyId(sequence * Changes % ProxyCount))) == float(sequence));
+            scene->Publish();
+            ProxyStats stats = scene->GetStats();
+            CHECK(stats.Publishes == sequence && stats.ChangedProxies == Changes && stats.Proxies == ProxyCount);
+            // Without the renderer, the game gets back the buffer it published last, one publish behind. With it, the one the
+            // renderer read, two behind. The first publish of a phase gets whatever the renderer returned before it.
+            if (publish > 0) CHECK(stats.CopiedProxies == (isAcquiring ? 2 * Changes : Changes));
+            if (isAcquiring) CheckSnapshot(scene->Acquire(), sequence, tags);
+         }
+         CheckSnapshot(scene->Acquire(), scene->GetStats().Publishes, tags);
+      }
+   }
+
+   // The renderer holds a snapshot while the game publishes many times. The snapshot doesn't change, the publishes it missed are
+   // dropped, and the next Acquire() returns the latest. Its old buffer then comes back to the game older than the change log,
+   // and is copied whole.
+   void TestHeldSnapshot()
+   {
+      std::vector<float> tags;
+      std::unique_ptr<ProxyScene> scene(MakeScene(tags));
+      scene->Publish();
+      const ProxySnapshot* held = scene->Acquire();
+      CheckSnapshot(held, 1, tags);
+      std::vector<float> heldTags = tags;
+      const int32_t Publishes = ProxyScene::ChangeLogSize + 4;
+      for (int32_t publish = 0; publish < Publishes; publish++)
+      {
+         for (int32_t id = 0; id < ProxyCount; id += 3)
+         {
+            tags[id] += 1;
+            SetTag(*scene, id, tags[id]);
+         }
+         scene->SetVisible(ProxyId(publish), false);
+         scene->Publish();
+         CheckSnapshot(held, 1, heldTags);
+         for (const RenderProxy& proxy : held->Proxies) CHECK(proxy.IsVisible);
+      }
+      ProxyStats stats = scene->GetStats();
+      CHECK(stats.DroppedSnapshots == Publishes - 1 && stats.Acquisitions == 1);
+      const ProxySnapshot* latest = scene->Acquire();
+      CheckSnapshot(latest, Publishes + 1, tags);
+      for (int32_t id = 0; id < ProxyCount; id++) CHECK(latest->Proxies[id].IsVisible == (id >= Publishes));
+      // Nothing new, the same snapshot.
+      CHECK(scene->Acquire() == latest);
+      heldTags = tags;
+      tags[1] = 1000;
+      SetTag(*scene, 1, tags[1]);
+      scene->Publish();
+      CHECK(scene->GetStats().CopiedProxies == ProxyCount);
+      CheckSnapshot(latest, Publishes + 1, heldTags);
+      CheckSnapshot(scene->Acquire(), Publishes + 2, tags);
+      // Destroyed proxies are invisible in snapshots, and their IDs are reused.
+      scene->Destroy(7);
+      scene->Publish();
+      CHECK(!scene->Acquire()->Proxies[7].IsVisible && scene->GetStats().Proxies == ProxyCount - 1);
+      CHECK(Throws([&]() { scene->Get(7); }));
+      RenderProxy proxy{};
+      proxy.IsVisible = true;
+      CHECK(scene->Create(proxy) == 7);
+      scene->Publish();
+      CHECK(scene->Acquire()->Proxies[7].IsVisible);
+   }
+
+   // The game publishes as fast as it can, changing one proxy per publish to the publish's sequence. The renderer checks that
+   // every snapshot is the state at its Publish(), that it doesn't change while held, and that it's at least as new as the last
+   // publish the game announced before the Acquire().
+   void TestConcurrency()
+   {
+      std::vector<float> tags;
+      std::unique_ptr<ProxyScene> scene(MakeScene(tags));
+      const uint64_t Publishes = 20000;
+      std::atomic<uint64_t> announced{ 0 };
+      std::thread game([&]()
+         {
+            for (uint64_t sequence = 1; sequence <= Publishes; sequence++)
+            {
+               SetTag(*scene, ProxyId(sequence % ProxyCount), float(sequence));
+               scene->Publish();
+               announced.store(sequence, std::memory_order::release);
+            }
+         });
+      uint64_t last = 0;
+      bool isConsistent = true;
+      while (last < Publishes)
+      {
+         uint64_t published = announced.load(std::memory_order::acquire);
+         const ProxySnapshot* snapshot = scene->Acquire();
+         if (snapshot == nullptr)
+         {
+            isConsistent &= published == 0;
+            continue;
+         }
+         uint64_t sequence = snapshot->Sequence;
+         isConsistent &= sequence >= published && sequence >= last;
+         last = sequence;
+         // Proxy i holds the latest sequence up to this one that is i modulo ProxyCount.
+         for (int32_t i = 0; i < ProxyCount; i++)
+         {
+            uint64_t expected = sequence < uint64_t(i) ? 0 : sequence - (sequence - i) % ProxyCount;
+            isConsistent &= GetTag(snapshot->Proxies[i]) == float(expected);
+         }
+         std::vector<float> copy(ProxyCount);
+         for (int32_t i = 0; i < ProxyCount; i++) copy[i] = GetTag(snapshot->Proxies[i]);
+         std::this_thread::yield();
+         for (int32_t i = 0; i < ProxyCount; i++) isConsistent &= GetTag(snapshot->Proxies[i]) == copy[i];
+         isConsistent &= snapshot->Sequence == sequence;
+      }
+      game.join();
+      CHECK(isConsistent);
+      ProxyStats stats = scene->GetStats();
+      CHECK(stats.Publishes == Publishes && stats.Acquisitions + stats.DroppedSnapshots == Publishes);
+   }
+}
+
+int main()
+{
+   try
+   {
+      TestRotation();
+      TestHeldSnapshot();
+      TestConcurrency();
+   }
+   catch (std::exception& e)
+   {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   std::printf("RenderProxy tests passed.\n");
+   return 0;
+}
@@ -0,0 +1,195 @@
+// ResourceTable: stale handles, generations wrapping past 255, slots reused only once the fence of their release completes,
+// and the free stack under concurrent Create() and Release().
+#include <thread>
+#include <vector>
+#include "Check.h"
+#include "Core/Renderers/ResourceTable.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   template<typename Function>
+   bool Throws(Function function)
+   {
+      try
+      {
+         function();
+      }
+      catch (std::runtime_error&)
+      {
+         return true;
+      }
+      return false;
+   }
+
+   uint32_t GetGeneration(ResourceHandle handle)
+   {
+      return handle >> HandleGenerationShift & 0xFF;
+   }
+
+   void TestHandles()
+   {
+      ResourceTable<int32_t> table(ResourceType::Mesh, 4);
+      ResourceHandle a = table.Create(1), b = table.Create(2);
+      CHECK(GetResourceType(a) == ResourceType::Mesh && GetGeneration(a) == 1 && (a & HandleIndexMask) == 0);
+      CHECK((b & HandleIndexMask) == 1);
+      CHECK(table.IsAlive(a) && table.Get(a) == 1 && table.Get(b) == 2);
+      // Released handles are stale at once, while the slot waits for Reclaim().
+      table.Release(a);
+      CHECK(!table.IsAlive(a) && table.IsAlive(b));
+      CHECK(Throws([&]() { table.Release(a); }));
+#ifdef PILLOW_DEBUG
+      CHECK(Throws([&]() { table.Get(a); }));
+#endif
+      // Another type, or an index past the capacity, is never alive.
+      ResourceHandle wrongType = (b & ~HandleTypeMask) | uint32_t(ResourceType::Texture);
+      CHECK(!table.IsAlive(wrongType));
+      CHECK(Throws([&]() { table.Release(wrongType); }));
+      CHECK(!table.IsAlive(uint32_t(ResourceType::Mesh) | 1 << HandleGenerationShift | 4));
+      CHECK(!table.IsAlive(uint32_t(ResourceType::Mesh)));
+      // The table fills up, without counting the released slot.
+      table.Create(3);
+      table.Create(4);
+      CHECK(Throws([&]() { table.Create(5); }));
+   }
+
+   // A released slot returns after the fence of the first frame that can't reference it completes.
+   void TestReclaim()
+   {
+      ResourceTable<int32_t> table(ResourceType::Texture, 2);
+      ResourceHandle a = table.Create(1), b = table.Create(2);
+      table.Release(a);
+      table.Reclaim(5, 4);
+      CHECK(Throws([&]() { table.Create(3); }));
+      // Releases after the first Reclaim() retire behind it, with their own fence.
+      table.Release(b);
+      table.Reclaim(6, 4);
+      CHECK(Throws([&]() { table.Create(3); }));
+      table.Reclaim(7, 5);
+      ResourceHandle c = table.Create(3);
+      CHECK((c & HandleIndexMask) == (a & HandleIndexMask) && GetGeneration(c) == 2);
+      CHECK(!table.IsAlive(a) && table.IsAlive(c) && table.Get(c) == 3);
+      CHECK(Throws([&]() { table.Create(4); }));
+      table.Reclaim(8, 6);
+      ResourceHandle d = table.Create(4);
+      CHECK((d & HandleIndexMask) == (b & HandleIndexMask) && table.Get(d) == 4);
+      // A released payload is destroyed when its slot is reclaimed.
+      ResourceTable<std::shared_ptr<int32_t>> owners(ResourceType::ConstantBuffer, 1);
+      std::shared_ptr<int32_t> payload = std::make_shared<int32_t>(1);
+      owners.Release(owners.Create(std::shared_ptr<int32_t>(payload)));
+      owners.Reclaim(2, 1);
+      CHECK(payload.use_count() == 2);
+      owners.Reclaim(3, 2);
+      CHECK(payload.use_count() == 1);
+   }
+
+   // Generations run from 1 to 255 and wrap to 1, never 0, so a handle is never equal to its bare type.
+   void TestGenerations()
+   {
+      ResourceTable<int32_t> table(ResourceType::PiplelineState, 1);
+      ResourceHandle first = table.Create(0), handle = first;
+      for (uint32_t i = 1; i <= 600; i++)
+      {
+         table.Release(handle);
+         table.Reclaim(i, i);
+         handle = table.Create(int32_t(i));
+         CHECK(GetGeneration(handle) == i % 255 + 1);
+         CHECK(handle != uint32_t(ResourceType::PiplelineState));
+         CHECK(table.IsAlive(handle) && table.Get(handle) == int32_t(i));
+         // A handle is stale until its generation comes round again, 255 releases later.
+         CHECK(table.IsAlive(first) == (i % 255 == 0));
+      }
+   }
+
+   // Threads create and release while the render thread reclaims. The free stack must never hand out a slot twice, which each
+   // slot's owner flag would catch.
+   void TestConcurrency()
+   {
+      const int32_t Threads = 4, Capacity = 64, Iterations = 20000;
+      ResourceTable<int32_t> table(ResourceType::Mesh, Capacity);
+      std::vector<std::atomic<int32_t>> owners(Capacity);
+      std::atomic<bool> failed{};
+      std::atomic<int32_t> running{ Threads };
+      std::vector<std::thread> threads;
+      for (int32_t t = 0; t < Threads; t++)
+      {
+         threads.emplace_back([&, t]()
+            {
+               std::vector<ResourceHandle> handles;
+               for (int32_t i = 0; i < Iterations; i++)
+               {
+                  // Hold up to 8 handles, so the table fills up now and then.
+                  if (handles.size() < 8 && i % 3 != 2)
+                  {
+                     ResourceHandle handle;
+                     try
+                     {
+                        handle = table.Create(t + 1);
+                     }
+                     catch (std::runtime_error&)
+                     {
+                        continue;
+                     }
+                     int32_t expected = 0;
+                     if (!owners[handle & HandleIndexMask].compare_exchange_strong(expected, t + 1)) failed = true;
+                     handles.push_back(handle);
+                  }
+                  else if (!handles.empty())
+                  {
+                     ResourceHandle handle = handles.back();
+                     handles.pop_back();
+                     if (!table.IsAlive(handle) || table.Get(handle) != t + 1) failed = true;
+                     owners[handle & HandleIndexMask].store(0);
+                     table.Release(handle);
+                  }
+               }
+               for (ResourceHandle handle : handles)
+               {
+                  owners[handle & HandleIndexMask].store(0);
+                  table.Release(handle);
+               }
+               running.fetch_sub(1);
+            });
+      }
+      // Fences complete two frames behind.
+      uint64_t frame = 2;
+      while (running.load() > 0)
+      {
+         table.Reclaim(frame, frame - 2);
+         frame++;
+         std::this_thread::yield();
+      }
+      for (std::thread& thread : threads) thread.join();
+      CHECK(!failed);
+      // Every slot comes back, and each is handed out once.
+      table.Reclaim(frame, frame);
+      std::vector<bool> taken(Capacity);
+      for (int32_t i = 0; i < Capacity; i++)
+      {
+         uint32_t index = table.Create(0) & HandleIndexMask;
+         CHECK(!taken[index]);
+         taken[index] = true;
+      }
+      CHECK(Throws([&]() { table.Create(0); }));
+   }
+}
+
+int main()
+{
+   try
+   {
+      TestHandles();
+      TestReclaim();
+      TestGenerations();
+      TestConcurrency();
+   }
+   catch (std::exception& e)
+   {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   std::printf("ResourceTable tests passed.\n");
+   return 0;
+}
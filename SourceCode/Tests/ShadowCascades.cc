@@ -0,0 +1,174 @@
+// ShadowCascades: CullCasters() against the exact box tests of the cascade volumes, and texel snapping under small camera moves.
+#include <cmath>
+#include <vector>
+#include "Check.h"
+#include "Core/Renderers/ShadowCascades.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   const XMMATRIX Projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.f / 9.f, 0.5f, 1000);
+   const XMVECTOR LightDirection = XMVectorSet(0.4f, -1, 0.3f, 0);
+
+   XMMATRIX MakeView(XMFLOAT3 eye, float yaw)
+   {
+      return XMMatrixLookToLH(XMLoadFloat3(&eye), XMVectorSet(std::sin(yaw), -0.2f, std::cos(yaw), 0), XMVectorSet(0, 1, 0, 0));
+   }
+
+   // The volume grown by a rounding margin, for containment.
+   BoundingOrientedBox Grow(const BoundingOrientedBox& volume)
+   {
+      BoundingOrientedBox grown = volume;
+      grown.Extents = XMFLOAT3(volume.Extents.x * 1.0001f + 1e-3f, volume.Extents.y * 1.0001f + 1e-3f, volume.Extents.z * 1.0001f + 1e-3f);
+      return grown;
+   }
+
+   // Random casters around the camera, from pebbles to buildings. For every caster and cascade:
+   // 1.A caster intersecting the cascade's volume has its bit, or its skipped bit if a nearer cascade's volume contains it.
+   // 2.A skipped caster is inside a nearer cascade's volume, and casts into a nearer cascade.
+   void TestCasters()
+   {
+      ShadowCascades shadows;
+      shadows.SetSettings(ShadowSettings{});
+      shadows.Fit(MakeView(XMFLOAT3(10, 5, -20), 0.3f), Projection, LightDirection);
+      CHECK(shadows.GetCascadeCount() == 4);
+      BoundsArray bounds;
+      std::vector<BoundingBox> boxes;
+      for (int32_t i = 0; i < 30001; i++)
+      {
+         uint32_t random = uint32_t(i + 1) * 2654435761u, other = uint32_t(i + 1) * 2246822519u;
+         XMFLOAT3 center(float(random % 600) - 290, float(random / 600 % 80) - 20, float(other % 600) - 300);
+         float size = i % 100 == 0 ? 20 : 0.5f;
+         XMFLOAT3 extents(0.1f + size * float(other >> 28) / 4, 0.1f + size * float(other >> 24 & 15) / 4, 0.1f + size * float(random >> 28) / 4);
+         boxes.push_back(BoundingBox(center, extents));
+         bounds.Push(boxes.back());
+      }
+      bounds.Pad();
+      std::vector<uint8_t> masks(bounds.GetCount(), 0xFF);
+      shadows.CullCasters(bounds, 0, bounds.GetCount(), masks.data());
+      int32_t cast[ShadowCascades::MaxCascades] = {}, skipped[ShadowCascades::MaxCascades] = {};
+      for (size_t i = 0; i < boxes.size(); i++)
+      {
+         uint8_t mask = masks[i];
+         for (int32_t c = 0; c < ShadowCascades::MaxCascades; c++)
+         {
+            const BoundingOrientedBox& volume = shadows.GetCascade(c).Volume;
+            bool isCast = mask >> c & 1, isSkipped = mask >> (c + ShadowCascades::MaxCascades) & 1;
+            CHECK(!(isCast && isSkipped));
+            if (volume.Intersects(boxes[i])) CHECK(isCast || isSkipped);
+            cast[c] += isCast;
+            skipped[c] += isSkipped;
+            if (!isSkipped) continue;
+            bool isContained = false, isCastNearer = false;
+            for (int32_t nearer = 0; nearer < c; nearer++)
+            {
+               isContained |= Grow(shadows.GetCascade(nearer).Volume).Contains(boxes[i]) == CONTAINS;
+               isCastNearer |= (mask >> nearer & 1) != 0;
+            }
+            CHECK(isContained && isCastNearer);
+         }
+      }
+      // Cascades grow with distance: each one holds casters, and the farther ones skip some.
+      for (int32_t c = 0; c < ShadowCascades::MaxCascades; c++) CHECK(cast[c] > 0 && (c == 0 ? skipped[c] == 0 : skipped[c] > 0));
+      // Fewer cascades leave the other bits clear.
+      ShadowSettings settings;
+      settings.CascadeCount = 2;
+      shadows.SetSettings(settings);
+      shadows.Fit(MakeView(XMFLOAT3(10, 5, -20), 0.3f), Projection, LightDirection);
+      shadows.CullCasters(bounds, 0, bounds.GetCount(), masks.data());
+      for (uint8_t mask : masks) CHECK((mask & 0xCC) == 0);
+   }
+
+   // Where a world point lands in a cascade's map, in texels.
+   XMFLOAT2 ToTexels(const ShadowCascade& cascade, FXMVECTOR point, int32_t resolution)
+   {
+      XMFLOAT3 clip;
+      XMStoreFloat3(&clip, XMVector3TransformCoord(point, XMLoadFloat4x4(&cascade.ViewProjection)));
+      return XMFLOAT2((clip.x * 0.5f + 0.5f) * resolution, (clip.y * 0.5f + 0.5f) * resolution);
+   }
+
+   // The camera creeps sideways a tenth of the nearest cascade's texel per frame, then turns. The maps never change size, and
+   // move by whole texels only, so world points stay on the same texel centers. While creeping, they move at most one texel per
+   // frame, and only now and then.
+   void TestSnapping()
+   {
+      ShadowCascades shadows;
+      ShadowSettings settings;
+      settings.Distance = 100;
+      settings.Resolution = 1024;
+      shadows.SetSettings(settings);
+      XMFLOAT3 eye(3, 4, -7);
+      float yaw = 0;
+      shadows.Fit(MakeView(eye, yaw), Projection, LightDirection);
+      const int32_t CascadeCount = shadows.GetCascadeCount();
+      float step = shadows.GetCascade(0).TexelSize * 0.1f;
+      ShadowCascade previous[ShadowCascades::MaxCascades];
+      for (int32_t c = 0; c < CascadeCount; c++) previous[c] = shadows.GetCascade(c);
+      const XMVECTOR points[] = { XMVectorSet(3, 0, 5, 1), XMVectorSet(-4, 1, 20, 1), XMVectorSet(10, -2, 60, 1) };
+      const int32_t Frames = 200;
+      for (bool isTurning : { false, true })
+      {
+         int32_t moves[ShadowCascades::MaxCascades] = {};
+         for (int32_t frame = 0; frame < Frames; frame++)
+         {
+            if (isTurning) yaw += 0.01f;
+            else
+            {
+               eye.x += step;
+               eye.z += step * 0.5f;
+            }
+            shadows.Fit(MakeView(eye, yaw), Projection, LightDirection);
+            for (int32_t c = 0; c < CascadeCount; c++)
+            {
+               const ShadowCascade& cascade = shadows.GetCascade(c);
+               CHECK(cascade.TexelSize == previous[c].TexelSize);
+               // The scale is 2 / (max - min) of the snapped box, which may round differently as the box moves.
+               for (int32_t row = 0; row < 3; row++)
+               {
+                  for (int32_t column = 0; column < 3; column++)
+                  {
+                     float value = cascade.ViewProjection.m[row][column], last = previous[c].ViewProjection.m[row][column];
+                     CHECK(std::abs(value - last) <= 1e-5f * std::abs(last) + 1e-9f);
+                  }
+               }
+               bool isMoved = false;
+               for (FXMVECTOR point : points)
+               {
+                  XMFLOAT2 before = ToTexels(previous[c], point, settings.Resolution), after = ToTexels(cascade, point, settings.Resolution);
+                  for (float shift : { after.x - before.x, after.y - before.y })
+                  {
+                     CHECK(std::abs(shift - std::round(shift)) < 0.01f);
+                     if (!isTurning) CHECK(std::abs(shift) < 1.5f);
+                     isMoved |= std::round(shift) != 0;
+                  }
+               }
+               moves[c] += isMoved;
+               previous[c] = cascade;
+            }
+         }
+         // Creeping, the camera crossed about 22 of the nearest cascade's texels, fewer of the farther ones'. A map moves when its
+         // center crosses a texel along either axis of light space.
+         float distance = Frames * step * std::sqrt(1.25f);
+         for (int32_t c = 0; c < CascadeCount && !isTurning; c++) CHECK(moves[c] <= 2 * (int32_t(distance / previous[c].TexelSize) + 1));
+         CHECK(moves[0] > 0 && moves[CascadeCount - 1] > 0);
+      }
+   }
+}
+
+int main()
+{
+   try
+   {
+      TestCasters();
+      TestSnapping();
+   }
+   catch (std::exception& e)
+   {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   std::printf("ShadowCascades tests passed.\n");
+   return 0;
+}
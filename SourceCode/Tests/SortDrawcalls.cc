@@ -0,0 +1,87 @@
+// SortDrawcalls() and BatchDrawcalls() on the edge cases of the radix sort: no drawcalls, equal keys, few and all differing bits.
+#include <random>
+#include "Check.h"
+#include "Core/Renderers/Renderer.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   // Sorted by key, and stable: equal keys keep the submission order.
+   void CheckOrder(const std::vector<Drawcall>& drawcalls, const std::vector<uint32_t>& order)
+   {
+      CHECK(order.size() == drawcalls.size());
+      std::vector<uint8_t> seen(drawcalls.size());
+      for (size_t i = 0; i < order.size(); i++)
+      {
+         CHECK(order[i] < drawcalls.size() && !seen[order[i]]);
+         seen[order[i]] = 1;
+         if (i == 0) continue;
+         uint64_t last = drawcalls[order[i - 1]].SortKey, key = drawcalls[order[i]].SortKey;
+         CHECK(last < key || (last == key && order[i - 1] < order[i]));
+      }
+   }
+
+   void Sort(const std::vector<Drawcall>& drawcalls)
+   {
+      std::vector<uint32_t> order;
+      SortDrawcalls(drawcalls, order);
+      CheckOrder(drawcalls, order);
+   }
+}
+
+int main()
+{
+   try
+   {
+      std::vector<Drawcall> drawcalls;
+      Sort(drawcalls);
+      drawcalls.push_back(Drawcall{ 42, 1, 2, 3, InstanceData{} });
+      Sort(drawcalls);
+      // Equal keys: no bit differs.
+      drawcalls.assign(1000, Drawcall{ 42, 1, 2, 3, InstanceData{} });
+      Sort(drawcalls);
+      std::mt19937_64 random(1);
+      // A few differing bits far apart, compacted into one pass.
+      for (Drawcall& drawcall : drawcalls) drawcall.SortKey = 0x8000000000000000ull * (random() & 1) | (random() & 3) << 20 | 0x1234;
+      Sort(drawcalls);
+      // All 64 bits differ, so keys and indices don't fit in one word.
+      for (Drawcall& drawcall : drawcalls) drawcall.SortKey = random();
+      Sort(drawcalls);
+      // Batches follow the order, and cover every drawcall once.
+      for (size_t i = 0; i < drawcalls.size(); i++)
+      {
+         uint32_t mesh = uint32_t(random() % 4), material = uint32_t(random() % 2);
+         drawcalls[i] = Drawcall{ MakeSortKey(0, 1, material, 0, mesh, float(i % 100)), mesh, material, 1, InstanceData{} };
+         drawcalls[i].Instance.Params.x = float(i);
+      }
+      std::vector<uint32_t> order;
+      std::vector<DrawBatch> batches;
+      std::vector<InstanceData> instances;
+      SortDrawcalls(drawcalls, order);
+      CheckOrder(drawcalls, order);
+      BatchDrawcalls(drawcalls, order, batches, instances);
+      CHECK(batches.size() == 8);
+      int32_t next = 0;
+      for (const DrawBatch& batch : batches)
+      {
+         CHECK(batch.FirstInstance == next);
+         for (int32_t i = batch.FirstInstance; i < batch.FirstInstance + batch.InstanceCount; i++)
+         {
+            const Drawcall& drawcall = drawcalls[order[i]];
+            CHECK(drawcall.Mesh == batch.Mesh && drawcall.Material == batch.Material);
+            CHECK(instances[i].Params.x == drawcall.Instance.Params.x);
+         }
+         next += batch.InstanceCount;
+      }
+      CHECK(next == int32_t(drawcalls.size()));
+   }
+   catch (std::exception& e)
+   {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   std::printf("SortDrawcalls tests passed.\n");
+   return 0;
+}
@@ -0,0 +1,155 @@
+// TextureStreamer: tails and mip sizes of square and other textures, loads down to the wanted mip, evictions that free memory
+// only once reclaimed, and removing textures while they load.
+#include "Check.h"
+#include "Core/Renderers/TextureStreamer.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   // The mips of a 1024 x 1024 texture at a byte per pixel, from the 64-wide tail down.
+   const uint64_t TailBytes = 64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2 + 1;
+   const uint64_t FinerBytes = 1024 * 1024 + 512 * 512 + 256 * 256 + 128 * 128; // Of mips 0 to 3.
+
+   template<typename Function>
+   bool Throws(Function function)
+   {
+      try
+      {
+         function();
+      }
+      catch (std::runtime_error&)
+      {
+         return true;
+      }
+      return false;
+   }
+
+   // Request and complete loads at once until nothing is requested.
+   void LoadAll(TextureStreamer& streamer, uint64_t& frame, int32_t texture, float screenSize)
+   {
+      for (int32_t i = 0; i < 20; i++)
+      {
+         streamer.ReportUse(texture, screenSize, 0, ++frame);
+         streamer.Update(frame);
+         if (streamer.GetLoads().empty()) return;
+         for (const MipRequest& load : streamer.GetLoads()) streamer.CompleteLoad(load.Texture);
+      }
+   }
+
+   void TestTextures()
+   {
+      TextureStreamer streamer(TextureStreamingPolicy{});
+      int32_t square = streamer.AddTexture(1024, 1024, 11, 1);
+      CHECK(streamer.GetResidentMip(square) == 4);
+      // Wider than tall: the tail starts where the width reaches 64, and small mips are at least a texel tall.
+      int32_t wide = streamer.AddTexture(1024, 256, 11, 0.5f);
+      CHECK(streamer.GetResidentMip(wide) == 4);
+      CHECK(streamer.GetMipBytes(wide, 0) == 1024 * 256 / 2);
+      CHECK(streamer.GetMipBytes(wide, 4) == 64 * 16 / 2);
+      CHECK(streamer.GetMipBytes(wide, 9) == 1 && streamer.GetMipBytes(wide, 10) == 1);
+      streamer.Update(1);
+      CHECK(streamer.GetStats().ResidentBytes == TailBytes + (512 + 128 + 32 + 8 + 2 + 1 + 1));
+      CHECK(Throws([&]() { streamer.AddTexture(1024, 256, 12, 1); }));
+      CHECK(Throws([&]() { streamer.AddTexture(0, 256, 1, 1); }));
+      CHECK(Throws([&]() { streamer.AddTexture(256, 256, 1, 0); }));
+   }
+
+   // A texture filling 1024 pixels on screen wants mip 0, and gets it a mip per load.
+   void TestLoads()
+   {
+      TextureStreamer streamer(TextureStreamingPolicy{});
+      int32_t texture = streamer.AddTexture(1024, 1024, 11, 1);
+      uint64_t frame = 0;
+      streamer.ReportUse(texture, 1024, 0, ++frame);
+      streamer.Update(frame);
+      CHECK(streamer.GetWantedMip(texture) == 0);
+      CHECK(streamer.GetStats().MissingMips == 4);
+      CHECK(streamer.GetLoads().size() == 1 && streamer.GetLoads()[0].Mip == 3);
+      // One load per texture at a time.
+      streamer.Update(++frame);
+      CHECK(streamer.GetLoads().empty());
+      streamer.CompleteLoad(texture);
+      CHECK(streamer.GetResidentMip(texture) == 3);
+      LoadAll(streamer, frame, texture, 1024);
+      CHECK(streamer.GetResidentMip(texture) == 0);
+      CHECK(streamer.GetStats().MissingMips == 0 && streamer.GetStats().ResidentBytes == TailBytes + FinerBytes);
+      CHECK(Throws([&]() { streamer.CompleteLoad(texture); }));
+   }
+
+   // The budget holds one texture's finer mips. When the camera turns to another texture, the first one's mips are evicted,
+   // but the GPU may still read them, so the load waits until they are reclaimed.
+   void TestReclaim()
+   {
+      TextureStreamingPolicy policy;
+      policy.Budget = 2 * TailBytes + FinerBytes;
+      policy.UnusedFrames = 1;
+      TextureStreamer streamer(policy);
+      int32_t first = streamer.AddTexture(1024, 1024, 11, 1), second = streamer.AddTexture(1024, 1024, 11, 1);
+      uint64_t frame = 0;
+      LoadAll(streamer, frame, first, 1024);
+      CHECK(streamer.GetResidentMip(first) == 0);
+      frame += 2;
+      streamer.ReportUse(second, 1024, 0, frame);
+      streamer.Update(frame);
+      uint64_t evictionFrame = frame;
+      const TextureStreamingStats& stats = streamer.GetStats();
+      CHECK(streamer.GetEvictions().size() == 1 && streamer.GetEvictions()[0].Texture == first && streamer.GetEvictions()[0].Mip == 0);
+      CHECK(streamer.GetLoads().empty());
+      CHECK(stats.RetiringBytes == 1024 * 1024 && stats.ResidentBytes == 2 * TailBytes + FinerBytes - 1024 * 1024);
+      // The frame before isn't enough, and nothing more is evicted while the load waits.
+      streamer.Reclaim(evictionFrame - 1);
+      streamer.ReportUse(second, 1024, 0, ++frame);
+      streamer.Update(frame);
+      CHECK(streamer.GetLoads().empty() && streamer.GetEvictions().empty());
+      streamer.Reclaim(evictionFrame);
+      streamer.ReportUse(second, 1024, 0, ++frame);
+      streamer.Update(frame);
+      CHECK(stats.RetiringBytes == 0);
+      CHECK(streamer.GetLoads().size() == 1 && streamer.GetLoads()[0].Texture == second && streamer.GetLoads()[0].Mip == 3);
+   }
+
+   // A texture removed while a mip loads keeps its id until the load completes, so the backend can't confuse it with a new one.
+   void TestRemove()
+   {
+      TextureStreamer streamer(TextureStreamingPolicy{});
+      int32_t texture = streamer.AddTexture(1024, 1024, 11, 1);
+      streamer.ReportUse(texture, 1024, 0, 1);
+      streamer.Update(1);
+      CHECK(streamer.GetLoads().size() == 1);
+      streamer.RemoveTexture(texture);
+      CHECK(Throws([&]() { streamer.RemoveTexture(texture); }));
+      int32_t other = streamer.AddTexture(256, 256, 9, 1);
+      CHECK(other != texture);
+      streamer.Update(2);
+      const TextureStreamingStats& stats = streamer.GetStats();
+      CHECK(stats.Textures == 1);
+      // The removed tail retires, the load's bytes stay taken.
+      CHECK(stats.RetiringBytes == TailBytes && stats.LoadingBytes == 128 * 128);
+      streamer.CompleteLoad(texture);
+      CHECK(Throws([&]() { streamer.CompleteLoad(texture); }));
+      streamer.Reclaim(2);
+      streamer.Update(3);
+      CHECK(stats.RetiringBytes == 0 && stats.LoadingBytes == 0);
+      CHECK(streamer.AddTexture(512, 512, 10, 1) == texture);
+   }
+}
+
+int main()
+{
+   try
+   {
+      TestTextures();
+      TestLoads();
+      TestReclaim();
+      TestRemove();
+   }
+   catch (std::exception& e)
+   {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   std::printf("TextureStreamer tests passed.\n");
+   return 0;
+}
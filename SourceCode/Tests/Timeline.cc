@@ -0,0 +1,179 @@
+// The renderer's frame timelines: the ring kept past its capacity, stage order within a frame, and the CSV and JSON layouts.
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "Check.h"
+#include "Core/Renderers/Renderer.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   const int32_t WorkerCount = 2;
+   const char* const StageNames[] =
+   {
+      "CommitBegin", "WaitEnd", "CullEnd", "LodEnd", "SortEnd", "PioneerEnd", "BarrierEnd", "ExecuteEnd", "PresentEnd", "SyncEnd", "AssemblerEnd"
+   };
+
+   std::vector<string> ReadLines(const string& path)
+   {
+      std::ifstream file(path);
+      std::vector<string> lines;
+      for (string line; std::getline(file, line);) lines.push_back(line);
+      return lines;
+   }
+
+   std::vector<string> Split(const string& line)
+   {
+      std::vector<string> fields;
+      std::stringstream stream(line);
+      for (string field; std::getline(stream, field, ',');) fields.push_back(field);
+      return fields;
+   }
+
+   // Synchronous frames finish within Commit(), so every committed frame is finished.
+   std::vector<uint64_t> CommitFrames(NullRenderer& renderer, int32_t count)
+   {
+      std::vector<uint64_t> frames;
+      for (int32_t i = 0; i < count; i++)
+      {
+         frames.push_back(renderer.GetFrameIndex());
+         renderer.Commit();
+      }
+      return frames;
+   }
+
+   // Past the ring's capacity, the last FrameTimelineSize - 1 frames are kept, each in the slot of its index.
+   void TestRing(NullRenderer& renderer, const std::vector<uint64_t>& frames)
+   {
+      const size_t Kept = Constants::FrameTimelineSize - 1;
+      FrameTimeline timeline;
+      for (size_t i = 0; i < frames.size(); i++)
+      {
+         if (i > 0) CHECK(frames[i] == frames[i - 1] + 1);
+         bool isKept = i + Kept >= frames.size();
+         CHECK(renderer.GetFrameTimeline(frames[i], timeline) == isKept);
+         if (!isKept) continue;
+         CHECK(timeline.FrameIndex == frames[i] && timeline.RenderScale == 1);
+         // Stages run in order, and the workers record between the kick and the barrier.
+         const double* stages = timeline.Stages;
+         for (size_t s = 1; s < size_t(FrameStage::Count); s++)
+         {
+            if (stages[s] != 0) CHECK(stages[s] >= stages[size_t(FrameStage::CommitBegin)] && stages[s] <= stages[size_t(FrameStage::AssemblerEnd)]);
+         }
+         for (FrameStage s : { FrameStage::WaitEnd, FrameStage::CullEnd, FrameStage::LodEnd, FrameStage::SortEnd, FrameStage::PioneerEnd, FrameStage::BarrierEnd })
+         {
+            CHECK(stages[size_t(s)] >= stages[size_t(s) - 1]);
+         }
+         bool hasRecorded = false;
+         for (int32_t w = 0; w < WorkerCount; w++)
+         {
+            if (timeline.RecordBegin[w] == 0) continue;
+            hasRecorded = true;
+            CHECK(timeline.RecordBegin[w] >= stages[size_t(FrameStage::PioneerEnd)] && timeline.RecordBegin[w] <= timeline.RecordEnd[w]);
+            CHECK(timeline.RecordEnd[w] <= stages[size_t(FrameStage::BarrierEnd)]);
+         }
+         CHECK(hasRecorded);
+      }
+      CHECK(!renderer.GetFrameTimeline(frames.back() + 1, timeline));
+   }
+
+   // A header and a row per kept frame, with the stages, the render scale, the GPU time, and two columns per worker.
+   void TestCSV(NullRenderer& renderer, const std::vector<uint64_t>& frames)
+   {
+      string path = (std::filesystem::temp_directory_path() / "PillowTimeline.csv").string();
+      renderer.ExportFrameTimelines(path, TimelineFormat::CSV);
+      std::vector<string> lines = ReadLines(path);
+      std::filesystem::remove(path);
+      std::vector<string> header = Split(lines[0]);
+      std::vector<string> columns = { "Frame" };
+      for (const char* name : StageNames) columns.push_back(name);
+      columns.push_back("RenderScale");
+      columns.push_back("GPUTime");
+      for (int32_t w = 0; w < WorkerCount; w++)
+      {
+         columns.push_back("RecordBegin" + std::to_string(w));
+         columns.push_back("RecordEnd" + std::to_string(w));
+      }
+      CHECK(header == columns);
+      CHECK(lines.size() == size_t(Constants::FrameTimelineSize));
+      uint64_t frame = frames.back() + 2 - Constants::FrameTimelineSize;
+      FrameTimeline timeline;
+      for (size_t i = 1; i < lines.size(); i++, frame++)
+      {
+         std::vector<string> fields = Split(lines[i]);
+         CHECK(fields.size() == columns.size());
+         CHECK(std::stoull(fields[0]) == frame);
+         CHECK(renderer.GetFrameTimeline(frame, timeline));
+         for (size_t s = 0; s < size_t(FrameStage::Count); s++) CHECK(std::abs(std::stod(fields[1 + s]) - timeline.Stages[s]) < 1e-3);
+         CHECK(std::stod(fields[1 + size_t(FrameStage::Count)]) == 1);
+         CHECK(std::abs(std::stod(fields.back()) - timeline.RecordEnd[WorkerCount - 1]) < 1e-3);
+      }
+   }
+
+   // An array of a frame per line: {"Frame":N,"Stages":{"CommitBegin":T,...},"RenderScale":S,"GPUTime":G,"Workers":[{"RecordBegin":T,"RecordEnd":T},...]}
+   void TestJSON(NullRenderer& renderer, const std::vector<uint64_t>& frames)
+   {
+      string path = (std::filesystem::temp_directory_path() / "PillowTimeline.json").string();
+      renderer.ExportFrameTimelines(path, TimelineFormat::JSON);
+      std::vector<string> lines = ReadLines(path);
+      std::filesystem::remove(path);
+      CHECK(lines.size() == size_t(Constants::FrameTimelineSize) + 1);
+      CHECK(lines.front() == "[" && lines.back() == "]");
+      uint64_t frame = frames.back() + 2 - Constants::FrameTimelineSize;
+      for (size_t i = 1; i + 1 < lines.size(); i++, frame++)
+      {
+         const string& line = lines[i];
+         string prefix = "{\"Frame\":" + std::to_string(frame) + ",\"Stages\":{\"CommitBegin\":";
+         CHECK(line.compare(0, prefix.size(), prefix) == 0);
+         // Every line but the last ends with a comma.
+         CHECK(line.ends_with(i + 2 < lines.size() ? "]}," : "]}"));
+         size_t position = 0;
+         for (const char* name : StageNames)
+         {
+            position = line.find('"' + string(name) + "\":", position);
+            CHECK(position != string::npos);
+         }
+         size_t scale = line.find("},\"RenderScale\":", position), gpuTime = line.find(",\"GPUTime\":", scale), workers = line.find(",\"Workers\":[{", gpuTime);
+         CHECK(scale != string::npos && gpuTime != string::npos && workers != string::npos);
+         int32_t workerCount = 0;
+         for (size_t p = line.find("{\"RecordBegin\":", workers); p != string::npos; p = line.find("{\"RecordBegin\":", p + 1))
+         {
+            CHECK(line.find(",\"RecordEnd\":", p) < line.find('}', p));
+            workerCount++;
+         }
+         CHECK(workerCount == WorkerCount);
+      }
+   }
+}
+
+int main()
+{
+   InitializeRenderer(WorkerCount, nullptr);
+   NullRenderer& renderer = static_cast<NullRenderer&>(*Instance);
+   renderer.SetWorkerAutotuning(false);
+   renderer.SetPipelining(PipeliningMode::Synchronous);
+   renderer.Launch();
+   try
+   {
+      // The mode takes effect at the first Commit(), which then finishes its frame too.
+      std::vector<uint64_t> frames = CommitFrames(renderer, Constants::FrameTimelineSize + 100);
+      TestRing(renderer, frames);
+      TestCSV(renderer, frames);
+      TestJSON(renderer, frames);
+   }
+   catch (std::exception& e)
+   {
+      renderer.Terminate();
+      Instance.reset();
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   renderer.Terminate();
+   Instance.reset();
+   std::printf("Timeline tests passed.\n");
+   return 0;
+}
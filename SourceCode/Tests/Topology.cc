@@ -0,0 +1,195 @@
+// CpuTopology::ParseSysfs() over canned sysfs trees of an SMT desktop, an Arm big.LITTLE SoC and a hybrid Intel part,
+// and where ThreadPlacementPolicy puts the engine's threads on them.
+#include <filesystem>
+#include <fstream>
+#include "Check.h"
+#include "Core/Topology.h"
+
+using namespace Pillow;
+
+namespace
+{
+   namespace fs = std::filesystem;
+
+   // A scratch tree laid out like /sys/devices, removed when the test ends.
+   class SysfsTree
+   {
+   public:
+      SysfsTree(const string& name) : root(fs::temp_directory_path() / ("PillowTopology" + name))
+      {
+         fs::remove_all(root);
+      }
+
+      ~SysfsTree()
+      {
+         fs::remove_all(root);
+      }
+
+      void Write(const string& path, const string& line)
+      {
+         fs::path file = root / path;
+         fs::create_directories(file.parent_path());
+         std::ofstream(file) << line << "\n";
+      }
+
+      // Caches of one CPU, as cache/indexN directories.
+      void WriteCaches(int32_t cpu, std::initializer_list<std::tuple<int32_t, const char*, const char*>> caches)
+      {
+         int32_t index = 0;
+         for (const auto& [level, type, shared] : caches)
+         {
+            string cache = "system/cpu/cpu" + std::to_string(cpu) + "/cache/index" + std::to_string(index++);
+            Write(cache + "/level", std::to_string(level));
+            Write(cache + "/type", type);
+            Write(cache + "/shared_cpu_list", shared);
+         }
+      }
+
+      CpuTopology Parse(const std::vector<int32_t>& allowedCpus = {}) const
+      {
+         return CpuTopology::ParseSysfs((root / "system/cpu").string(), allowedCpus);
+      }
+
+   private:
+      fs::path root;
+   };
+
+   const LogicalCpu& FindCpu(const CpuTopology& topology, int32_t index)
+   {
+      for (const LogicalCpu& cpu : topology.GetCpus())
+      {
+         if (cpu.Index == index) return cpu;
+      }
+      throw std::runtime_error("CPU " + std::to_string(index) + " is missing.");
+   }
+
+   // 4 cores with 2 threads each, numbered like Linux does on x86: CPU n and n + 4 are siblings. L1 and L2 per core, one L3.
+   void TestDesktop()
+   {
+      SysfsTree tree("Desktop");
+      tree.Write("system/cpu/online", "0-7");
+      for (int32_t cpu = 0; cpu < 8; cpu++)
+      {
+         string core = std::to_string(cpu % 4) + "," + std::to_string(cpu % 4 + 4);
+         tree.Write("system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list", core);
+         tree.Write("system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/cpuinfo_max_freq", "4200000");
+         tree.WriteCaches(cpu, { { 1, "Data", core.c_str() }, { 1, "Instruction", core.c_str() }, { 2, "Unified", core.c_str() },
+            { 3, "Unified", "0-7" } });
+      }
+      CpuTopology topology = tree.Parse();
+      CHECK(topology.GetCpus().size() == 8);
+      CHECK(topology.GetCoreCount() == 4);
+      CHECK(topology.GetCacheDomainCount() == 1);
+      CHECK(!topology.IsHybrid());
+      CHECK(FindCpu(topology, 6).Core == 2);
+      CHECK(FindCpu(topology, 6).CacheDomain == 0);
+      CHECK(FindCpu(topology, 6).Capacity == 1024);
+      // The affinity set limits the CPUs, like taskset does.
+      CpuTopology limited = tree.Parse({ 1, 5, 6 });
+      CHECK(limited.GetCpus().size() == 3);
+      CHECK(limited.GetCpus()[0].Index == 1 && limited.GetCpus()[2].Index == 6);
+      // Physical cores first, so the 4 first threads get a core each, and SMT siblings come after.
+      ThreadPlacementPolicy policy(topology, AffinityMode::Pinned, 3, 1, 1);
+      CHECK(policy.Get(ThreadRole::Game).Cpu == 0);
+      for (int32_t i = 0; i < 3; i++)
+      {
+         CHECK(policy.Get(ThreadRole::Renderer, i).Cpu == i + 1);
+         CHECK(policy.Get(ThreadRole::Renderer, i).Cpus == std::vector<int32_t>{ i + 1 });
+      }
+      CHECK(policy.Get(ThreadRole::Tick).Cpu == 4);
+      CHECK(policy.Get(ThreadRole::Physics).Cpu == 5);
+      CHECK(policy.Get(ThreadRole::Background).Cpus.empty());
+   }
+
+   // 4 little cores and 4 big ones in clusters, published as capacities and without cache information.
+   void TestBigLittle()
+   {
+      SysfsTree tree("BigLittle");
+      // A blank range is skipped.
+      tree.Write("system/cpu/online", "0-3,,4-7");
+      for (int32_t cpu = 0; cpu < 8; cpu++)
+      {
+         string base = "system/cpu/cpu" + std::to_string(cpu);
+         tree.Write(base + "/topology/thread_siblings_list", std::to_string(cpu));
+         tree.Write(base + "/topology/cluster_cpus_list", cpu < 4 ? "0-3" : "4-7");
+         tree.Write(base + "/topology/core_siblings_list", "0-7");
+         tree.Write(base + "/cpu_capacity", cpu < 4 ? "446" : "1024");
+      }
+      CpuTopology topology = tree.Parse();
+      CHECK(topology.GetCpus().size() == 8);
+      CHECK(topology.GetCoreCount() == 8);
+      CHECK(topology.GetCacheDomainCount() == 2);
+      CHECK(topology.IsHybrid());
+      CHECK(FindCpu(topology, 2).CacheDomain == 0 && FindCpu(topology, 5).CacheDomain == 4);
+      CHECK(FindCpu(topology, 2).Capacity == 446 && FindCpu(topology, 5).Capacity == 1024);
+      // The game thread and the renderer workers take the big cluster, the rest spills over to the little one.
+      ThreadPlacementPolicy policy(topology, AffinityMode::Cluster, 3, 1, 1);
+      CHECK(policy.Get(ThreadRole::Game).Cpu == 4);
+      CHECK(policy.Get(ThreadRole::Game).Cpus == (std::vector<int32_t>{ 4, 5, 6, 7 }));
+      for (int32_t i = 0; i < 3; i++) CHECK(policy.Get(ThreadRole::Renderer, i).Cpu == 5 + i);
+      CHECK(policy.Get(ThreadRole::Tick).Cpu == 0);
+      CHECK(policy.Get(ThreadRole::Tick).Cpus == (std::vector<int32_t>{ 0, 1, 2, 3 }));
+      CHECK(policy.Get(ThreadRole::Background).Cpus == (std::vector<int32_t>{ 0, 1, 2, 3 }));
+   }
+
+   // 2 performance cores with SMT and 4 efficiency cores under the cpu_atom PMU, all at similar maximum frequencies.
+   // The efficiency cores share an L2 per module of 4, everything shares the L3.
+   void TestHybridIntel()
+   {
+      SysfsTree tree("Hybrid");
+      tree.Write("system/cpu/online", "0-7");
+      tree.Write("cpu_atom/cpus", "4-7");
+      for (int32_t cpu = 0; cpu < 8; cpu++)
+      {
+         string base = "system/cpu/cpu" + std::to_string(cpu);
+         string core = cpu < 4 ? std::to_string(cpu & ~1) + "-" + std::to_string(cpu | 1) : std::to_string(cpu);
+         tree.Write(base + "/topology/thread_siblings_list", core);
+         tree.Write(base + "/cpufreq/cpuinfo_max_freq", cpu < 4 ? "4700000" : "3600000");
+         tree.WriteCaches(cpu, { { 1, "Data", core.c_str() }, { 2, "Unified", cpu < 4 ? core.c_str() : "4-7" }, { 3, "Unified", "0-7" } });
+      }
+      CpuTopology topology = tree.Parse();
+      CHECK(topology.GetCpus().size() == 8);
+      CHECK(topology.GetCoreCount() == 6);
+      CHECK(topology.GetCacheDomainCount() == 1);
+      CHECK(topology.IsHybrid());
+      CHECK(FindCpu(topology, 1).Core == 0);
+      // Halved for being an atom: 3.6 / 4.7 / 2 of the fastest one.
+      CHECK(FindCpu(topology, 5).Capacity == 3600000 / 2 * 1024 / 4700000);
+      // Performance cores first, then efficiency cores, then SMT siblings.
+      ThreadPlacementPolicy policy(topology, AffinityMode::Pinned, 1, 1, 1);
+      CHECK(policy.Get(ThreadRole::Game).Cpu == 0);
+      CHECK(policy.Get(ThreadRole::Renderer).Cpu == 2);
+      CHECK(policy.Get(ThreadRole::Tick).Cpu == 4);
+      CHECK(policy.Get(ThreadRole::Physics).Cpu == 5);
+      CHECK(policy.Get(ThreadRole::Background).Cpus == (std::vector<int32_t>{ 4, 5, 6, 7 }));
+   }
+
+   // A tree without any of the files, like a sandbox hiding sysfs.
+   void TestEmpty()
+   {
+      SysfsTree tree("Empty");
+      CpuTopology topology = tree.Parse();
+      CHECK(topology.GetCpus().empty());
+      ThreadPlacementPolicy policy(topology, AffinityMode::Cluster, 2, 1, 1);
+      CHECK(policy.Get(ThreadRole::Game).Cpu == -1);
+      CHECK(policy.Get(ThreadRole::Renderer, 1).Cpu == -1 && policy.Get(ThreadRole::Renderer, 1).Cpus.empty());
+   }
+}
+
+int main()
+{
+   try
+   {
+      TestDesktop();
+      TestBigLittle();
+      TestHybridIntel();
+      TestEmpty();
+   }
+   catch (std::exception& e)
+   {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   std::printf("Topology tests passed.\n");
+   return 0;
+}
@@ -0,0 +1,165 @@
+// UploadRing against a simulated GPU that completes each frame's fence a few frames late: live allocations never overlap,
+// wrap-around, stalls on a full ring, and the errors it reports.
+#include <random>
+#include "Check.h"
+#include "Core/Renderers/UploadRing.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   // Frame n signals fence n + 1 once the GPU has copied its uploads, "Lag" frames after it was submitted.
+   class SimulatedGpu
+   {
+   public:
+      static const uint64_t Lag = 4;
+
+      void Submit(uint64_t fence)
+      {
+         submitted = fence;
+         if (submitted > Lag) completed = std::max(completed, submitted - Lag);
+      }
+
+      // Blocks until "fence" completes, like ID3D12Fence::SetEventOnCompletion() with an event.
+      uint64_t WaitForFence(uint64_t fence)
+      {
+         CHECK(fence <= submitted);
+         completed = std::max(completed, fence);
+         return completed;
+      }
+
+      ForceInline uint64_t GetCompleted() const { return completed; }
+
+   private:
+      uint64_t submitted = 0, completed = 0;
+   };
+
+   struct Range
+   {
+      uint64_t Offset, Size, Fence;
+   };
+
+   // Random uploads over many frames. Every allocation stays live until its frame's fence completes, and no two live ones
+   // may share a byte.
+   void TestRandom()
+   {
+      const uint64_t Capacity = 48 << 10;
+      UploadRing ring(Capacity);
+      SimulatedGpu gpu;
+      std::mt19937 random(1);
+      std::vector<Range> live;
+      uint64_t fence = 0;
+      for (int32_t frame = 0; frame < 2000; frame++)
+      {
+         fence++;
+         int32_t count = int32_t(random() % 8);
+         for (int32_t i = 0; i < count; i++)
+         {
+            uint64_t size = random() % 3 == 0 ? random() % (5 << 10) : random() % 1024;
+            uint64_t alignment = uint64_t(1) << (random() % 10);
+            uint64_t offset = ring.Allocate(size, alignment, [&](uint64_t wanted) { return gpu.WaitForFence(wanted); });
+            CHECK(offset % alignment == 0);
+            CHECK(offset + size <= Capacity);
+            std::erase_if(live, [&](const Range& range) { return range.Fence <= gpu.GetCompleted(); });
+            for (const Range& range : live)
+            {
+               CHECK(size == 0 || range.Size == 0 || offset + size <= range.Offset || range.Offset + range.Size <= offset);
+            }
+            live.push_back(Range{ offset, size, fence });
+         }
+         ring.FinishFrame(fence);
+         gpu.Submit(fence);
+         ring.Reclaim(gpu.GetCompleted());
+         CHECK(ring.GetStats().UsedBytes <= Capacity);
+      }
+      const UploadRingStats& stats = ring.GetStats();
+      CHECK(stats.PeakUsedBytes <= Capacity);
+      CHECK(stats.Allocations > 5000);
+      // A frame uploads at most 7 * 5 KB plus padding, which always fits. 5 frames in flight of large uploads don't.
+      CHECK(stats.Stalls > 0);
+   }
+
+   // A ring of 4 KB: allocations wrap to the start rather than cross the end, and a full ring waits for the oldest frame only.
+   void TestWrapAndStall()
+   {
+      UploadRing ring(4096);
+      SimulatedGpu gpu;
+      int32_t waits = 0;
+      auto Wait = [&](uint64_t fence)
+         {
+            waits++;
+            CHECK(fence == 1);
+            return gpu.WaitForFence(fence);
+         };
+      CHECK(ring.Allocate(3000, 256, Wait) == 0);
+      ring.FinishFrame(1);
+      gpu.Submit(1);
+      // 1096 bytes are left at the end, too few, and the start is still in use.
+      uint64_t offset;
+      CHECK(!ring.TryAllocate(2048, 256, offset));
+      CHECK(ring.Allocate(1000, 8, Wait) == 3000);
+      ring.FinishFrame(2);
+      gpu.Submit(2);
+      CHECK(ring.Allocate(2048, 256, Wait) == 0);
+      CHECK(waits == 1 && ring.GetStats().Stalls == 1);
+      // The tail skipped by the wrap-around counts as used until frame 2 is reclaimed.
+      CHECK(ring.GetStats().UsedBytes == 4096 - 3000 + 2048);
+      ring.FinishFrame(3);
+      gpu.Submit(3);
+      ring.Reclaim(3);
+      CHECK(ring.GetStats().UsedBytes == 0);
+      // A frame without allocations is dropped, and fences may skip values.
+      ring.FinishFrame(7);
+      CHECK(ring.Allocate(2048, 2048, Wait) == 2048);
+      ring.FinishFrame(9);
+      CHECK(ring.GetStats().PeakUsedBytes == 4000);
+   }
+
+   template<typename Function>
+   bool Throws(Function function)
+   {
+      try
+      {
+         function();
+      }
+      catch (std::runtime_error&)
+      {
+         return true;
+      }
+      return false;
+   }
+
+   void TestErrors()
+   {
+      CHECK(Throws([]() { UploadRing ring(0); }));
+      UploadRing ring(1024);
+      uint64_t offset;
+      auto Wait = [](uint64_t fence) { return fence; };
+      CHECK(Throws([&]() { ring.TryAllocate(16, 3, offset); }));
+      CHECK(Throws([&]() { ring.TryAllocate(16, 2048, offset); }));
+      CHECK(Throws([&]() { ring.TryAllocate(2048, 16, offset); }));
+      // The uploads of the unfinished frame fill the ring, no fence can free them.
+      ring.Allocate(1000, 8, Wait);
+      CHECK(Throws([&]() { ring.Allocate(100, 8, Wait); }));
+      ring.FinishFrame(5);
+      CHECK(Throws([&]() { ring.FinishFrame(5); }));
+   }
+}
+
+int main()
+{
+   try
+   {
+      TestRandom();
+      TestWrapAndStall();
+      TestErrors();
+   }
+   catch (std::exception& e)
+   {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   std::printf("UploadRing tests passed.\n");
+   return 0;
+}
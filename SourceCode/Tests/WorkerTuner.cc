@@ -0,0 +1,96 @@
+// WorkerTuner on canned windows: growing and shrinking, reverting a change that made recording slower, cooldowns, and the log.
+#include "Check.h"
+#include "Core/Renderers/WorkerTuner.h"
+
+using namespace Pillow;
+using namespace Pillow::Graphics;
+
+namespace
+{
+   WorkerTuningWindow Window(double utilization, double span)
+   {
+      return WorkerTuningWindow{ utilization, span, span * (1 - utilization) };
+   }
+
+   void TestGrowAndShrink()
+   {
+      WorkerTuner tuner;
+      // Busy workers get company up to the pool size, each step faster than the last.
+      CHECK(tuner.Update(Window(0.9, 10), 2, 4, 64) == 3);
+      CHECK(tuner.Update(Window(0.9, 8), 3, 4, 128) == 4);
+      CHECK(tuner.Update(Window(0.9, 7), 4, 4, 192) == 4);
+      // Between the thresholds, nothing changes.
+      CHECK(tuner.Update(Window(0.6, 7), 4, 4, 256) == 4);
+      // Waiting workers are parked down to one.
+      CHECK(tuner.Update(Window(0.3, 7), 4, 4, 320) == 3);
+      CHECK(tuner.Update(Window(0.3, 7), 3, 4, 384) == 2);
+      CHECK(tuner.Update(Window(0.3, 7), 2, 4, 448) == 1);
+      CHECK(tuner.Update(Window(0.3, 7), 1, 4, 512) == 1);
+      // Only changes are logged, with the window's means.
+      const std::vector<WorkerTuningDecision>& decisions = tuner.GetDecisions();
+      CHECK(decisions.size() == 5);
+      const WorkerTuningDecision& first = decisions[0];
+      CHECK(first.FrameIndex == 64 && first.ChangeReason == WorkerTuningDecision::Grow && first.FromWorkers == 2 && first.ToWorkers == 3);
+      CHECK(first.Utilization == 0.9 && first.RecordSpan == 10 && first.BarrierWaitTime == Window(0.9, 10).BarrierWaitTime);
+      CHECK(decisions[1].ToWorkers == 4);
+      for (size_t i = 2; i < decisions.size(); i++) CHECK(decisions[i].ChangeReason == WorkerTuningDecision::Shrink);
+      CHECK(decisions.back().FrameIndex == 448 && decisions.back().ToWorkers == 1);
+   }
+
+   // The window after a change compares its span with the one before. Slower by more than the tolerance, the change is undone,
+   // and its direction is held back until the RevertCooldownWindows-th window after the revert.
+   void TestRevert()
+   {
+      WorkerTuner tuner;
+      CHECK(tuner.Update(Window(0.9, 10), 2, 8, 0) == 3);
+      CHECK(tuner.Update(Window(0.9, 11), 3, 8, 1) == 2);
+      CHECK(tuner.GetDecisions().back().ChangeReason == WorkerTuningDecision::Revert);
+      // A revert isn't checked again, so a slower window after it changes nothing.
+      CHECK(tuner.Update(Window(0.6, 20), 2, 8, 2) == 2);
+      for (int32_t window = 2; window < WorkerTuner::RevertCooldownWindows; window++) CHECK(tuner.Update(Window(0.9, 10), 2, 8, window + 1) == 2);
+      CHECK(tuner.Update(Window(0.9, 10), 2, 8, 100) == 3);
+      // Within the tolerance, the change stays, and the next one is taken.
+      CHECK(tuner.Update(Window(0.9, 10 * (1 + WorkerTuner::RevertTolerance)), 3, 8, 101) == 4);
+      // Shrinking is reverted the same way, and growing isn't held back by it.
+      WorkerTuner shrinking;
+      CHECK(shrinking.Update(Window(0.3, 5), 4, 8, 0) == 3);
+      CHECK(shrinking.Update(Window(0.3, 6), 3, 8, 1) == 4);
+      CHECK(shrinking.Update(Window(0.3, 6), 4, 8, 2) == 4);
+      CHECK(shrinking.Update(Window(0.9, 6), 4, 8, 3) == 5);
+      // Reset() forgets the last change, e.g. after the count was set by hand.
+      WorkerTuner reset;
+      CHECK(reset.Update(Window(0.9, 10), 2, 8, 0) == 3);
+      reset.Reset();
+      CHECK(reset.Update(Window(0.6, 20), 3, 8, 1) == 3);
+   }
+
+   // Past MaxDecisions, the oldest decisions are dropped.
+   void TestLog()
+   {
+      WorkerTuner tuner;
+      int32_t active = 1;
+      const uint64_t Windows = WorkerTuner::MaxDecisions + 500;
+      for (uint64_t window = 0; window < Windows; window++) active = tuner.Update(Window(active == 1 ? 0.9 : 0.3, 10), active, 2, window);
+      const std::vector<WorkerTuningDecision>& decisions = tuner.GetDecisions();
+      CHECK(decisions.size() == WorkerTuner::MaxDecisions);
+      CHECK(decisions.front().FrameIndex == Windows - WorkerTuner::MaxDecisions && decisions.back().FrameIndex == Windows - 1);
+      for (size_t i = 1; i < decisions.size(); i++) CHECK(decisions[i].FrameIndex == decisions[i - 1].FrameIndex + 1);
+   }
+}
+
+int main()
+{
+   try
+   {
+      TestGrowAndShrink();
+      TestRevert();
+      TestLog();
+   }
+   catch (std::exception& e)
+   {
+      std::fprintf(stderr, "%s\n", e.what());
+      return 1;
+   }
+   std::printf("WorkerTuner tests passed.\n");
+   return 0;
+}
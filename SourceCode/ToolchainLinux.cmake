@@ -0,0 +1,3 @@
+# Headless Linux build. The only renderer is the NullRenderer, which runs the frame pipeline without a GPU.
+# Single-config generators pick one configuration at generation time.
+set(CMAKE_BUILD_TYPE "Release" CACHE STRING "Debug, RelWithDebInfo or Release")